@@ -0,0 +1,189 @@
+// Copyright © Mattias Larsson Sköld
+
+// Small self contained micro benchmark harness
+//
+// Each benchmark is a function that performs a known number of operations.
+// It is first run for a warmup period, which is also used to find how many
+// calls that are needed for one sample to be long enough to time reliably.
+// The samples are then sorted to get the median and percentiles, which are
+// less sensitive to interruptions than the mean.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bench {
+
+//! Prevent the compiler from optimizing away the calculation of value
+template <class T>
+inline void doNotOptimize(const T &value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    const volatile char *p = reinterpret_cast<const volatile char *>(&value);
+    (void)*p;
+#endif
+}
+
+struct Options {
+    //! Number of timed samples per benchmark
+    size_t repetitions = 25;
+
+    //! Time spent running the benchmark before measuring
+    std::chrono::milliseconds warmup{50};
+
+    //! Shortest time for one sample, more calls are made per sample if needed
+    std::chrono::microseconds minSampleTime{1000};
+
+    //! Only run benchmarks with names containing this string
+    std::string filter;
+};
+
+//! All times are in nanoseconds per operation
+struct Result {
+    std::string name;
+    size_t operationsPerSample = 0;
+    size_t repetitions = 0;
+    double median = 0;
+    double p10 = 0;
+    double p90 = 0;
+    double min = 0;
+    double max = 0;
+
+    //! Operations per second based on the median
+    double throughput() const {
+        return median > 0 ? 1e9 / median : 0;
+    }
+};
+
+//! Linear interpolation between the closest ranks of a sorted vector
+inline double percentile(const std::vector<double> &sorted, double fraction) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    const auto position = fraction * (sorted.size() - 1);
+    const auto index = static_cast<size_t>(position);
+    if (index + 1 >= sorted.size()) {
+        return sorted.back();
+    }
+    const auto amount = position - index;
+    return sorted[index] * (1 - amount) + sorted[index + 1] * amount;
+}
+
+class Runner {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    Runner(Options options = {}) : _options(std::move(options)) {}
+
+    //! Run f, that performs `operations` operations for each call, and
+    //! record the result. Returns false if excluded by the filter
+    template <class F>
+    bool run(const std::string &name, size_t operations, F f) {
+        if (name.find(_options.filter) == std::string::npos) {
+            return false;
+        }
+
+        // Warmup, and find the number of calls for a sample
+        size_t calls = 0;
+        const auto warmupStart = Clock::now();
+        auto elapsed = Clock::duration{};
+        do {
+            f();
+            ++calls;
+            elapsed = Clock::now() - warmupStart;
+        } while (elapsed < _options.warmup);
+
+        const auto perCall =
+            std::chrono::duration<double>(elapsed).count() / calls;
+        const auto callsPerSample = std::max<size_t>(
+            1,
+            static_cast<size_t>(
+                std::chrono::duration<double>(_options.minSampleTime)
+                    .count() /
+                perCall));
+
+        auto samples = std::vector<double>{};
+        samples.reserve(_options.repetitions);
+        for (size_t r = 0; r < _options.repetitions; ++r) {
+            const auto start = Clock::now();
+            for (size_t i = 0; i < callsPerSample; ++i) {
+                f();
+            }
+            const auto end = Clock::now();
+            samples.push_back(
+                std::chrono::duration<double, std::nano>(end - start).count() /
+                static_cast<double>(callsPerSample * operations));
+        }
+        std::sort(samples.begin(), samples.end());
+
+        auto result = Result{};
+        result.name = name;
+        result.operationsPerSample = callsPerSample * operations;
+        result.repetitions = samples.size();
+        result.median = percentile(samples, .5);
+        result.p10 = percentile(samples, .1);
+        result.p90 = percentile(samples, .9);
+        result.min = samples.empty() ? 0 : samples.front();
+        result.max = samples.empty() ? 0 : samples.back();
+        _results.push_back(result);
+        return true;
+    }
+
+    const std::vector<Result> &results() const {
+        return _results;
+    }
+
+    //! Human readable table
+    void print(std::ostream &stream) const {
+        stream << std::left << std::setw(44) << "benchmark" << std::right
+               << std::setw(12) << "median ns" << std::setw(12) << "p10 ns"
+               << std::setw(12) << "p90 ns" << std::setw(14) << "Mops/s"
+               << "\n";
+        for (auto &r : _results) {
+            stream << std::left << std::setw(44) << r.name << std::right
+                   << std::fixed << std::setprecision(3) << std::setw(12)
+                   << r.median << std::setw(12) << r.p10 << std::setw(12)
+                   << r.p90 << std::setw(14) << r.throughput() * 1e-6
+                   << "\n";
+        }
+        stream.unsetf(std::ios::fixed);
+    }
+
+    //! Machine readable results, context is written as string key/values
+    void writeJson(
+        std::ostream &stream,
+        const std::vector<std::pair<std::string, std::string>> &context) const {
+        stream << "{\n  \"context\": {";
+        for (size_t i = 0; i < context.size(); ++i) {
+            stream << (i ? ",\n" : "\n") << "    \"" << context[i].first
+                   << "\": \"" << context[i].second << "\"";
+        }
+        stream << "\n  },\n  \"benchmarks\": [";
+        stream << std::setprecision(6);
+        for (size_t i = 0; i < _results.size(); ++i) {
+            auto &r = _results[i];
+            stream << (i ? ",\n" : "\n") << "    {\"name\": \"" << r.name
+                   << "\", \"operations\": " << r.operationsPerSample
+                   << ", \"repetitions\": " << r.repetitions
+                   << ", \"median_ns\": " << r.median
+                   << ", \"p10_ns\": " << r.p10 << ", \"p90_ns\": " << r.p90
+                   << ", \"min_ns\": " << r.min << ", \"max_ns\": " << r.max
+                   << ", \"ops_per_second\": " << r.throughput() << "}";
+        }
+        stream << "\n  ]\n}\n";
+    }
+
+private:
+    Options _options;
+    std::vector<Result> _results;
+};
+
+} // namespace bench
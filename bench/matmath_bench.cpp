@@ -0,0 +1,1006 @@
+// Copyright © Mattias Larsson Sköld
+
+// Micro benchmarks for the hot operations of the library
+//
+// Usage: matmath_bench [--json <file>] [--filter <text>]
+//                      [--repetitions <n>] [--warmup <ms>]
+//
+// --json writes the results to file, or to standard output if the file is -
+// Build with optimizations and the instruction sets you want to measure,
+// for example -O2 -march=native, and compare the json output from different
+// builds or revisions
+
+#include "benchmark.h"
+#include "matmath/aabb.h"
+#include "matmath/affinematrix.h"
+#include "matmath/bvh.h"
+#include "matmath/constmath.h"
+#include "matmath/dispatch.h"
+#include "matmath/dualquaternion.h"
+#include "matmath/frustum.h"
+#include "matmath/kdtree.h"
+#include "matmath/matrix.h"
+#include "matmath/matrixbatch.h"
+#include "matmath/parallel.h"
+#include "matmath/quaternion.h"
+#include "matmath/ray.h"
+#include "matmath/simdmath.h"
+#include "matmath/transform2.h"
+#include "matmath/transform3.h"
+#include "matmath/transformhierarchy.h"
+#include "matmath/vec4.h"
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+//! Number of elements processed for each call of a benchmark. Small enough
+//! that the data stays in cache
+constexpr size_t count = 1024;
+
+template <class T>
+std::vector<Matrix<T>> rotations() {
+    auto ret = std::vector<Matrix<T>>{};
+    ret.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        const auto a = static_cast<T>(i) * T(.01);
+        ret.push_back(Matrix<T>::RotationZ(a) * Matrix<T>::RotationX(a * 3) *
+                      Matrix<T>::Translation(1, 2, 3));
+    }
+    return ret;
+}
+
+//! The scalar loop used by Matrix::operator* in constant evaluation, as a
+//! reference for the simd version
+template <class T>
+Matrix<T> scalarMultiply(const Matrix<T> &a, const Matrix<T> &b) {
+    Matrix<T> product;
+    for (int y = 0; y < 4; ++y) {
+        for (int x = 0; x < 4; ++x) {
+            T value = 0;
+            for (int i = 0; i < 4; ++i) {
+                value += a(x, i) * b(i, y);
+            }
+            product(x, y) = value;
+        }
+    }
+    return product;
+}
+
+template <class T>
+void matrixBenchmarks(bench::Runner &runner, const std::string &type) {
+    const auto input = rotations<T>();
+    auto output = std::vector<Matrix<T>>(count);
+    const auto transform = Matrix<T>::RotationY(.3) *
+                           Matrix<T>::Translation(3, 2, 1);
+
+    runner.run("Matrix<" + type + ">::operator*", count, [&] {
+        for (size_t i = 0; i < count; ++i) {
+            output[i] = input[i] * transform;
+        }
+        bench::doNotOptimize(output);
+    });
+
+    runner.run("Matrix<" + type + "> scalar multiplication", count, [&] {
+        for (size_t i = 0; i < count; ++i) {
+            output[i] = scalarMultiply(input[i], transform);
+        }
+        bench::doNotOptimize(output);
+    });
+
+    runner.run("Matrix<" + type + ">::multiply", count, [&] {
+        Matrix<T>::multiply(input.data(), input.data(), output.data(), count);
+        bench::doNotOptimize(output);
+    });
+
+    runner.run("Matrix<" + type + ">::premultiply", count, [&] {
+        Matrix<T>::premultiply(transform, input.data(), output.data(), count);
+        bench::doNotOptimize(output);
+    });
+
+    runner.run("Matrix<" + type + ">::inverse", count, [&] {
+        for (size_t i = 0; i < count; ++i) {
+            output[i] = input[i].inverse();
+        }
+        bench::doNotOptimize(output);
+    });
+
+    runner.run("Matrix<" + type + ">::inverseOrthogonal", count, [&] {
+        for (size_t i = 0; i < count; ++i) {
+            output[i] = input[i].inverseOrthogonal();
+        }
+        bench::doNotOptimize(output);
+    });
+}
+
+template <class T>
+void affineMatrixBenchmarks(bench::Runner &runner, const std::string &type) {
+    auto input = std::vector<AffineMatrix<T>>{};
+    for (auto &m : rotations<T>()) {
+        input.emplace_back(m);
+    }
+    auto output = input;
+    const auto transform = AffineMatrix<T>{Matrix<T>::RotationY(.3) *
+                                           Matrix<T>::Translation(3, 2, 1)};
+
+    runner.run("AffineMatrix<" + type + ">::operator*", count, [&] {
+        for (size_t i = 0; i < count; ++i) {
+            output[i] = input[i] * transform;
+        }
+        bench::doNotOptimize(output);
+    });
+}
+
+//! Points as VecT compared with the padded Vec4T
+template <class T>
+void vec4Benchmarks(bench::Runner &runner, const std::string &type) {
+    const auto m = Matrix<T>::RotationY(.3) * Matrix<T>::Translation(3, 2, 1);
+    auto points = std::vector<VecT<T>>{};
+    auto points4 = std::vector<Vec4T<T>>{};
+    for (size_t i = 0; i < count; ++i) {
+        points.push_back({T(i), 1, -2});
+        points4.push_back({points.back(), 1});
+    }
+    auto output = points;
+    auto output4 = points4;
+
+    runner.run("Matrix<" + type + ">::operator*(Vec)", count, [&] {
+        for (size_t i = 0; i < count; ++i) {
+            output[i] = m * points[i];
+        }
+        bench::doNotOptimize(output);
+    });
+
+    runner.run("Matrix<" + type + ">::transformPoints", count, [&] {
+        m.transformPoints(points.data(), output.data(), count);
+        bench::doNotOptimize(output);
+    });
+
+    runner.run("Matrix<" + type + ">::operator*(Vec4)", count, [&] {
+        for (size_t i = 0; i < count; ++i) {
+            output4[i] = m * points4[i];
+        }
+        bench::doNotOptimize(output4);
+    });
+
+    runner.run("transform(Matrix<" + type + ">, Vec4 *)", count, [&] {
+        transform(m, points4.data(), output4.data(), count);
+        bench::doNotOptimize(output4);
+    });
+
+    runner.run("Vec4T<" + type + "> normalize", count, [&] {
+        for (size_t i = 0; i < count; ++i) {
+            output4[i] = points4[i];
+            output4[i].normalize();
+        }
+        bench::doNotOptimize(output4);
+    });
+
+    runner.run("VecT<" + type + "> normalize", count, [&] {
+        for (size_t i = 0; i < count; ++i) {
+            output[i] = points[i];
+            output[i].normalize();
+        }
+        bench::doNotOptimize(output);
+    });
+}
+
+//! Bounds transformed by all eight corners compared with Arvo's method
+template <class T>
+void aabbBenchmarks(bench::Runner &runner, const std::string &type) {
+    const auto m = Matrix<T>::RotationY(.3) * Matrix<T>::Translation(3, 2, 1);
+    auto boxes = std::vector<AABB<T>>{};
+    for (size_t i = 0; i < count; ++i) {
+        const auto min = VecT<T>{T(i), 1, -2};
+        boxes.push_back({min, min + VecT<T>{1, 2, T(i % 7)}});
+    }
+    auto output = boxes;
+
+    runner.run("AABB<" + type + "> eight corners", count, [&] {
+        for (size_t i = 0; i < count; ++i) {
+            const auto &box = boxes[i];
+            auto ret = AABB<T>{};
+            for (int c = 0; c < 8; ++c) {
+                ret = ret.merge(m * VecT<T>{c & 1 ? box.max.x : box.min.x,
+                                            c & 2 ? box.max.y : box.min.y,
+                                            c & 4 ? box.max.z : box.min.z});
+            }
+            output[i] = ret;
+        }
+        bench::doNotOptimize(output);
+    });
+
+    runner.run("Matrix<" + type + ">::operator*(AABB)", count, [&] {
+        for (size_t i = 0; i < count; ++i) {
+            output[i] = m * boxes[i];
+        }
+        bench::doNotOptimize(output);
+    });
+
+    runner.run("transform(Matrix<" + type + ">, AABB *)", count, [&] {
+        transform(m, boxes.data(), output.data(), count);
+        bench::doNotOptimize(output);
+    });
+}
+
+//! Rays against triangles one at a time compared with packets of rays and
+//! blocks of triangles
+template <class T>
+void rayBenchmarks(bench::Runner &runner, const std::string &type) {
+    constexpr int packetSize = 16;
+    auto vertices = std::vector<VecT<T>>{};
+    auto triangles = TriangleSoA<T>{};
+    for (size_t i = 0; i < count; ++i) {
+        const auto x = T(i % 32) - 16, y = T(i / 32) - 16, z = T(-10);
+        vertices.push_back({x, y, z});
+        vertices.push_back({x + 1, y, z});
+        vertices.push_back({x, y + 1, z - T(.1)});
+        triangles.push_back(vertices[i * 3], vertices[i * 3 + 1],
+                            vertices[i * 3 + 2]);
+    }
+    auto rays = std::vector<Ray<T>>{};
+    for (int i = 0; i < packetSize; ++i) {
+        rays.push_back({{0, 0, 0}, {T(i % 4) / 8, T(i / 4) / 8, -1}});
+    }
+    const auto packet = RayPacket<T, packetSize>{rays.data()};
+    auto hits = std::vector<RayHit<T>>(packetSize);
+    auto packetHit = PacketHit<T, packetSize>{};
+
+    runner.run("intersectTriangle(Ray<" + type + ">)",
+               count * packetSize,
+               [&] {
+                   for (size_t i = 0; i < count; ++i) {
+                       for (int r = 0; r < packetSize; ++r) {
+                           intersectTriangle(rays[r],
+                                             vertices[i * 3],
+                                             vertices[i * 3 + 1],
+                                             vertices[i * 3 + 2],
+                                             hits[r]);
+                       }
+                   }
+                   bench::doNotOptimize(hits);
+               });
+
+    runner.run("intersectTriangle(RayPacket<" + type + ", 16>)",
+               count * packetSize,
+               [&] {
+                   for (size_t i = 0; i < count; ++i) {
+                       intersectTriangle(packet,
+                                         vertices[i * 3],
+                                         vertices[i * 3 + 1],
+                                         vertices[i * 3 + 2],
+                                         packetHit);
+                   }
+                   bench::doNotOptimize(packetHit);
+               });
+
+    runner.run("intersectTriangles(Ray<" + type + ">, TriangleSoA)",
+               count * packetSize,
+               [&] {
+                   for (int r = 0; r < packetSize; ++r) {
+                       intersectTriangles(rays[r], triangles, hits[r]);
+                   }
+                   bench::doNotOptimize(hits);
+               });
+}
+
+//! Build time of the tree with one and all threads, and queries compared
+//! with testing all triangles
+template <class T>
+void bvhBenchmarks(bench::Runner &runner, const std::string &type) {
+    constexpr size_t triangleCount = 1 << 14;
+    auto vertices = std::vector<VecT<T>>{};
+    auto triangles = TriangleSoA<T>{};
+    for (size_t i = 0; i < triangleCount; ++i) {
+        // A bumpy grid of triangles in front of the rays
+        const auto x = T(i % 128) / 4 - 16, y = T(i / 128) / 4 - 16;
+        const auto z = T(-10) + T((i * 7) % 5) / 4;
+        vertices.push_back({x, y, z});
+        vertices.push_back({x + T(.3), y, z});
+        vertices.push_back({x, y + T(.3), z - T(.1)});
+        triangles.push_back(vertices[i * 3], vertices[i * 3 + 1],
+                            vertices[i * 3 + 2]);
+    }
+    auto rays = std::vector<Ray<T>>{};
+    auto points = std::vector<VecT<T>>{};
+    for (size_t i = 0; i < count; ++i) {
+        rays.push_back(
+            {{0, 0, 0}, {T(i % 32) / 32 - T(.5), T(i / 32) / 32 - T(.5), -1}});
+        points.push_back({T(i % 32) - 16, T(i / 32) - 16, T(i % 3) - 11});
+    }
+
+    // Built outside of the benchmarks so that the queries have a tree also
+    // when the build benchmarks are filtered out
+    auto single = matmath::ThreadPool{1};
+    auto bvh = Bvh<T>{};
+    bvh.build(vertices.data(), triangleCount);
+    runner.run("Bvh<" + type + ">::build(1 thread)", triangleCount, [&] {
+        bvh.build(vertices.data(), triangleCount, single);
+        bench::doNotOptimize(bvh);
+    });
+
+    runner.run("Bvh<" + type + ">::build(all threads)", triangleCount, [&] {
+        bvh.build(vertices.data(), triangleCount);
+        bench::doNotOptimize(bvh);
+    });
+
+    auto hits = std::vector<RayHit<T>>(count);
+    runner.run("Bvh<" + type + ">::raycast", count, [&] {
+        for (size_t i = 0; i < count; ++i) {
+            hits[i] = {};
+            bvh.raycast(rays[i], hits[i]);
+        }
+        bench::doNotOptimize(hits);
+    });
+
+    // All triangles for a few of the rays, the tree is expected to be
+    // orders of magnitude faster
+    constexpr size_t bruteForceCount = 16;
+    runner.run("intersectTriangles(Ray<" + type + ">, all triangles)",
+               bruteForceCount,
+               [&] {
+                   for (size_t i = 0; i < bruteForceCount; ++i) {
+                       hits[i] = {};
+                       intersectTriangles(rays[i], triangles, hits[i]);
+                   }
+                   bench::doNotOptimize(hits);
+               });
+
+    auto closest = std::vector<typename Bvh<T>::Closest>(count);
+    runner.run("Bvh<" + type + ">::closestPoint", count, [&] {
+        for (size_t i = 0; i < count; ++i) {
+            closest[i] = {};
+            bvh.closestPoint(points[i], closest[i]);
+        }
+        bench::doNotOptimize(closest);
+    });
+
+    const auto m = Matrix<T>::RotationZ(T(.001));
+    runner.run("Bvh<" + type + ">::refit(Matrix)", triangleCount, [&] {
+        bvh.refit(m);
+        bench::doNotOptimize(bvh);
+    });
+}
+
+//! Build and queries of the k-d tree compared with a linear scan with abs2()
+template <class Vec>
+void kdTreeBenchmarks(bench::Runner &runner, const std::string &type) {
+    using T = typename KdTree<Vec>::T;
+    constexpr size_t pointCount = 1 << 16;
+    auto points = std::vector<Vec>{};
+    auto queries = std::vector<Vec>{};
+    auto random = std::minstd_rand{1u};
+    auto coordinate = std::uniform_real_distribution<T>{0, 256};
+    for (size_t i = 0; i < pointCount + count; ++i) {
+        auto &target = i < pointCount ? points : queries;
+        if constexpr (KdTree<Vec>::dimensions == 2) {
+            target.push_back({coordinate(random), coordinate(random)});
+        }
+        else {
+            target.push_back(
+                {coordinate(random), coordinate(random), coordinate(random)});
+        }
+    }
+
+    // Built outside of the benchmarks, like for Bvh, so that the queries
+    // have a tree also when the build benchmarks are filtered out
+    auto single = matmath::ThreadPool{1};
+    auto tree = KdTree<Vec>{points.data(), pointCount};
+    runner.run("KdTree<" + type + ">::build(1 thread)", pointCount, [&] {
+        tree.build(points.data(), pointCount, single);
+        bench::doNotOptimize(tree);
+    });
+
+    runner.run("KdTree<" + type + ">::build(all threads)", pointCount, [&] {
+        tree.build(points.data(), pointCount);
+        bench::doNotOptimize(tree);
+    });
+
+    using Neighbour = typename KdTree<Vec>::Neighbour;
+    auto nearest = std::vector<Neighbour>(count);
+    runner.run("KdTree<" + type + ">::nearest", count, [&] {
+        for (size_t i = 0; i < count; ++i) {
+            nearest[i] = {};
+            tree.nearest(queries[i], nearest[i]);
+        }
+        bench::doNotOptimize(nearest);
+    });
+
+    // All points for a few of the queries
+    constexpr size_t linearCount = 16;
+    runner.run("linear nearest(" + type + ")", linearCount, [&] {
+        for (size_t i = 0; i < linearCount; ++i) {
+            nearest[i] = {};
+            for (size_t j = 0; j < pointCount; ++j) {
+                const auto distance2 = (points[j] - queries[i]).abs2();
+                if (distance2 < nearest[i].distance2) {
+                    nearest[i] = {j, distance2};
+                }
+            }
+        }
+        bench::doNotOptimize(nearest);
+    });
+
+    constexpr size_t k = 8;
+    auto kNearest = std::vector<Neighbour>(count * k);
+    runner.run("KdTree<" + type + ">::kNearest(8)", count, [&] {
+        for (size_t i = 0; i < count; ++i) {
+            tree.kNearest(queries[i], kNearest.data() + i * k, k);
+        }
+        bench::doNotOptimize(kNearest);
+    });
+
+    runner.run("KdTree<" + type + ">::kNearest(8, batch)", count, [&] {
+        tree.kNearest(queries.data(), count, kNearest.data(), k);
+        bench::doNotOptimize(kNearest);
+    });
+
+    size_t found = 0;
+    runner.run("KdTree<" + type + ">::radiusSearch", count, [&] {
+        for (size_t i = 0; i < count; ++i) {
+            tree.radiusSearch(
+                queries[i], T(4), [&](size_t, T) { ++found; });
+        }
+        bench::doNotOptimize(found);
+    });
+}
+
+//! Culling of bounding volumes one at a time compared with the batch versions
+template <class T>
+void frustumBenchmarks(bench::Runner &runner, const std::string &type) {
+    // clang-format off
+    const auto projection = Matrix<T>{
+        1, 0, 0,  0,
+        0, 1, 0,  0,
+        0, 0, -1.02, -1,
+        0, 0, -2.02,  0,
+    };
+    // clang-format on
+    const auto frustum = Frustum<T>::fromMatrix(
+        projection * Matrix<T>::RotationY(.3) *
+        Matrix<T>::Translation(0, 0, -T(count) / 20));
+    auto centers = std::vector<VecT<T>>{};
+    auto max = std::vector<VecT<T>>{};
+    auto radii = std::vector<T>{};
+    for (size_t i = 0; i < count; ++i) {
+        centers.push_back({T(i % 37) - 18, T(i % 11) - 5, -T(i) / 10});
+        max.push_back(centers.back() + VecT<T>{1, 1, 1});
+        radii.push_back(1);
+    }
+    const auto soa = VecSoA<T>{centers};
+    auto visible = std::vector<uint32_t>(Frustum<T>::maskSize(count));
+    auto visibleBools = std::vector<char>(count);
+
+    runner.run("Frustum<" + type + ">::intersectsSphere", count, [&] {
+        for (size_t i = 0; i < count; ++i) {
+            visibleBools[i] = frustum.intersectsSphere(centers[i], radii[i]);
+        }
+        bench::doNotOptimize(visibleBools);
+    });
+
+    runner.run("Frustum<" + type + ">::cullSpheres", count, [&] {
+        frustum.cullSpheres(
+            centers.data(), radii.data(), count, visible.data());
+        bench::doNotOptimize(visible);
+    });
+
+    runner.run("Frustum<" + type + ">::cullSpheres(VecSoA)", count, [&] {
+        frustum.cullSpheres(soa, radii.data(), visible.data());
+        bench::doNotOptimize(visible);
+    });
+
+    runner.run("Frustum<" + type + ">::intersectsBox", count, [&] {
+        for (size_t i = 0; i < count; ++i) {
+            visibleBools[i] = frustum.intersectsBox(centers[i], max[i]);
+        }
+        bench::doNotOptimize(visibleBools);
+    });
+
+    runner.run("Frustum<" + type + ">::cullBoxes", count, [&] {
+        frustum.cullBoxes(centers.data(), max.data(), count, visible.data());
+        bench::doNotOptimize(visible);
+    });
+}
+
+void quaternionBenchmarks(bench::Runner &runner) {
+    const auto input = rotations<float>();
+    auto quaternions = std::vector<Quaternion>(count);
+
+    runner.run("Quaternion(Matrix)", count, [&] {
+        for (size_t i = 0; i < count; ++i) {
+            quaternions[i] = Quaternion(input[i]);
+        }
+        bench::doNotOptimize(quaternions);
+    });
+
+    auto output = std::vector<Quaternion>(count);
+    runner.run("Quaternion::interpolate", count, [&] {
+        for (size_t i = 0; i < count; ++i) {
+            output[i] = quaternions[i].interpolate(quaternions[count - 1 - i],
+                                                   .3f);
+        }
+        bench::doNotOptimize(output);
+    });
+
+    runner.run("Quaternion::slerp", count, [&] {
+        for (size_t i = 0; i < count; ++i) {
+            output[i] = quaternions[i].slerp(quaternions[count - 1 - i], .3f);
+        }
+        bench::doNotOptimize(output);
+    });
+
+    runner.run("Quaternion::fastSlerp", count, [&] {
+        for (size_t i = 0; i < count; ++i) {
+            output[i] =
+                quaternions[i].fastSlerp(quaternions[count - 1 - i], .3f);
+        }
+        bench::doNotOptimize(output);
+    });
+
+    auto reversed = std::vector<Quaternion>(quaternions.rbegin(),
+                                            quaternions.rend());
+    auto blend = std::vector<float>(count);
+    for (size_t i = 0; i < count; ++i) {
+        blend[i] = static_cast<float>(i % 100) / 100;
+    }
+
+    runner.run("Quaternion::slerp batch", count, [&] {
+        Quaternion::slerp(quaternions.data(),
+                          reversed.data(),
+                          blend.data(),
+                          output.data(),
+                          count);
+        bench::doNotOptimize(output);
+    });
+
+    runner.run("Quaternion::fastSlerp batch", count, [&] {
+        Quaternion::fastSlerp(quaternions.data(),
+                              reversed.data(),
+                              blend.data(),
+                              output.data(),
+                              count);
+        bench::doNotOptimize(output);
+    });
+
+    auto vectors = std::vector<Vecf>(count, Vecf{1, 2, 3});
+    auto rotated = std::vector<Vecf>(count);
+    runner.run("Quaternion -> Matrix * Vec", count, [&] {
+        for (size_t i = 0; i < count; ++i) {
+            rotated[i] = Matrixf(quaternions[i]) * Vec{vectors[i]};
+        }
+        bench::doNotOptimize(rotated);
+    });
+
+    runner.run("Quaternion::rotate", count, [&] {
+        for (size_t i = 0; i < count; ++i) {
+            rotated[i] = quaternions[i].rotate(vectors[i]);
+        }
+        bench::doNotOptimize(rotated);
+    });
+
+    runner.run("Quaternion::rotate batch", count, [&] {
+        quaternions[0].rotate(vectors.data(), rotated.data(), count);
+        bench::doNotOptimize(rotated);
+    });
+}
+
+void dualQuaternionBenchmarks(bench::Runner &runner) {
+    constexpr size_t joints = 64;
+    const auto input = rotations<float>();
+    auto palette = std::vector<DualQuaternionf>{};
+    for (size_t i = 0; i < joints; ++i) {
+        palette.emplace_back(input[i * 7]);
+    }
+
+    auto indices = std::vector<uint16_t>(count * 4);
+    auto weights = std::vector<float>(count * 4);
+    auto positions = std::vector<Vecf>(count);
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t k = 0; k < 4; ++k) {
+            indices[i * 4 + k] = static_cast<uint16_t>((i / 8 + k) % joints);
+            weights[i * 4 + k] = .4f - .1f * static_cast<float>(k);
+        }
+        positions[i] = {static_cast<float>(i), 1, 2};
+    }
+    auto output = std::vector<Vecf>(count);
+
+    runner.run("DualQuaternion::skin", count, [&] {
+        DualQuaternionf::skin(palette.data(),
+                              indices.data(),
+                              weights.data(),
+                              positions.data(),
+                              output.data(),
+                              count);
+        bench::doNotOptimize(output);
+    });
+
+    // Baseline, linear blend skinning with matrices
+    auto matrices = std::vector<Matrixf>(palette.begin(), palette.end());
+    runner.run("Matrix linear blend skinning", count, [&] {
+        for (size_t i = 0; i < count; ++i) {
+            auto sum = Vec{};
+            for (size_t k = 0; k < 4; ++k) {
+                sum += matrices[indices[i * 4 + k]] * Vec{positions[i]} *
+                       weights[i * 4 + k];
+            }
+            output[i] = Vecf{sum};
+        }
+        bench::doNotOptimize(output);
+    });
+}
+
+template <class T>
+void transform2Benchmarks(bench::Runner &runner, const std::string &type) {
+    auto input = std::vector<Transform2T<T>>{};
+    input.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        input.push_back({{static_cast<T>(i), 1}, static_cast<T>(i) * T(.01)});
+    }
+    auto output = std::vector<Transform2T<T>>(count);
+    const auto transform = Transform2T<T>{{1, 2}, T(.3)};
+
+    runner.run("Transform2T<" + type + ">::operator*", count, [&] {
+        for (size_t i = 0; i < count; ++i) {
+            output[i] = input[i] * transform;
+        }
+        bench::doNotOptimize(output);
+    });
+
+    runner.run("Transform2T<" + type + "> lerp", count, [&] {
+        for (size_t i = 0; i < count; ++i) {
+            output[i] = lerp(input[i], input[count - 1 - i], T(.3));
+        }
+        bench::doNotOptimize(output);
+    });
+}
+
+void transform3Benchmarks(bench::Runner &runner) {
+    const auto matrices = rotations<float>();
+    auto input = std::vector<Transform3f>{};
+    input.reserve(count);
+    for (const auto &m : matrices) {
+        input.emplace_back(m);
+    }
+    auto output = std::vector<Transform3f>(count);
+    const auto transform = Transform3f{{1, 2, 3}, Quaternion{}, 2};
+
+    runner.run("Transform3T<float>::operator*", count, [&] {
+        for (size_t i = 0; i < count; ++i) {
+            output[i] = input[i] * transform;
+        }
+        bench::doNotOptimize(output);
+    });
+
+    runner.run("Transform3T<float>::inverse", count, [&] {
+        for (size_t i = 0; i < count; ++i) {
+            output[i] = input[i].inverse();
+        }
+        bench::doNotOptimize(output);
+    });
+
+    runner.run("Transform3T<float> slerp", count, [&] {
+        for (size_t i = 0; i < count; ++i) {
+            output[i] = slerp(input[i], input[count - 1 - i], .3f);
+        }
+        bench::doNotOptimize(output);
+    });
+}
+
+template <class T, size_t Lanes>
+void matrixBatchBenchmarks(bench::Runner &runner, const std::string &type) {
+    using Batch = MatrixBatch<T, Lanes>;
+    const auto input = rotations<T>();
+    auto a = std::vector<Batch>(count / Lanes);
+    Batch::pack(input.data(), a.data(), count);
+    const auto b = a;
+    auto output = std::vector<Batch>(count / Lanes);
+    const auto name =
+        "MatrixBatch<" + type + ", " + std::to_string(Lanes) + ">";
+
+    // Compare with Matrix::multiply
+    runner.run(name + "::operator*", count, [&] {
+        for (size_t i = 0; i < a.size(); ++i) {
+            output[i] = a[i] * b[i];
+        }
+        bench::doNotOptimize(output);
+    });
+
+    runner.run(name + "::inverse", count, [&] {
+        for (size_t i = 0; i < a.size(); ++i) {
+            output[i] = a[i].inverse();
+        }
+        bench::doNotOptimize(output);
+    });
+
+    runner.run(name + "::inverseOrthogonal", count, [&] {
+        for (size_t i = 0; i < a.size(); ++i) {
+            output[i] = a[i].inverseOrthogonal();
+        }
+        bench::doNotOptimize(output);
+    });
+
+    auto unpacked = std::vector<Matrix<T>>(count);
+    runner.run(name + " pack and unpack", count, [&] {
+        Batch::pack(input.data(), output.data(), count);
+        Batch::unpack(output.data(), unpacked.data(), count);
+        bench::doNotOptimize(unpacked);
+    });
+}
+
+//! Arrays larger than the caches, where the threads shares the memory
+//! bandwidth
+template <class T>
+void parallelBenchmarks(bench::Runner &runner, const std::string &type) {
+    constexpr size_t large = 1 << 18;
+    auto a = std::vector<Matrix<T>>{};
+    a.reserve(large);
+    for (const auto &m : rotations<T>()) {
+        a.push_back(m);
+    }
+    a.resize(large, Matrix<T>::RotationX(.2));
+    const auto b = a;
+    auto out = std::vector<Matrix<T>>(large);
+    const auto m = Matrix<T>::RotationY(.3) * Matrix<T>::Translation(3, 2, 1);
+
+    auto threadCounts = std::vector<unsigned>{1};
+    if (std::thread::hardware_concurrency() > 1) {
+        threadCounts.push_back(std::thread::hardware_concurrency());
+    }
+    for (const auto threads : threadCounts) {
+        auto pool = matmath::ThreadPool{threads};
+        const auto suffix = " " + std::to_string(threads) + " threads";
+
+        runner.run("matmath::multiply<" + type + ">" + suffix, large, [&] {
+            matmath::multiply(a.data(), b.data(), out.data(), large, pool);
+            bench::doNotOptimize(out);
+        });
+
+        runner.run("matmath::premultiply<" + type + ">" + suffix, large, [&] {
+            matmath::premultiply(m, a.data(), out.data(), large, pool);
+            bench::doNotOptimize(out);
+        });
+    }
+}
+
+void transformHierarchyBenchmarks(bench::Runner &runner) {
+    // A scene sized hierarchy where a few percent of the nodes moves
+    constexpr size_t nodes = 500000;
+    constexpr size_t moving = nodes / 50;
+    auto hierarchy = TransformHierarchyf{};
+    hierarchy.reserve(nodes);
+    const auto local = AffineMatrixf{Matrixf::RotationZ(.01f) *
+                                     Matrixf::Translation(1, 0, 0)};
+    for (size_t i = 0; i < nodes; ++i) {
+        const auto parent = i % 1000 == 0 ? TransformHierarchyf::none
+                                          : static_cast<uint32_t>(i / 4);
+        hierarchy.add(local, parent);
+    }
+    hierarchy.update();
+
+    auto threadCounts = std::vector<unsigned>{1};
+    if (std::thread::hardware_concurrency() > 1) {
+        threadCounts.push_back(std::thread::hardware_concurrency());
+    }
+    for (const auto threads : threadCounts) {
+        auto pool = matmath::ThreadPool{threads};
+        const auto suffix = " " + std::to_string(threads) + " threads";
+        runner.run("TransformHierarchy update all" + suffix, nodes, [&] {
+            for (uint32_t i = 0; i < nodes; i += 1000) {
+                hierarchy.local(i, local);
+            }
+            hierarchy.update(pool);
+            bench::doNotOptimize(hierarchy.worldData());
+        });
+
+        runner.run("TransformHierarchy update 2%" + suffix, moving, [&] {
+            for (size_t i = 0; i < moving; ++i) {
+                hierarchy.local(static_cast<uint32_t>(nodes - 1 - i * 50),
+                                local);
+            }
+            hierarchy.update(pool);
+            bench::doNotOptimize(hierarchy.worldData());
+        });
+    }
+}
+
+void sinBenchmarks(bench::Runner &runner) {
+    auto angles = std::vector<double>(count);
+    for (size_t i = 0; i < count; ++i) {
+        angles[i] = static_cast<double>(i) * .013 - 6;
+    }
+    auto output = std::vector<double>(count);
+
+    runner.run("constmath::sin", count, [&] {
+        for (size_t i = 0; i < count; ++i) {
+            output[i] = constmath::sin(angles[i]);
+        }
+        bench::doNotOptimize(output);
+    });
+
+    // Baselines for constmath::sin
+    runner.run("std::sin", count, [&] {
+        for (size_t i = 0; i < count; ++i) {
+            output[i] = std::sin(angles[i]);
+        }
+        bench::doNotOptimize(output);
+    });
+
+    auto cosOutput = std::vector<double>(count);
+    runner.run("simd::sincos<double>", count, [&] {
+        matmath::simd::sincos(
+            angles.data(), output.data(), cosOutput.data(), count);
+        bench::doNotOptimize(output);
+        bench::doNotOptimize(cosOutput);
+    });
+}
+
+//! The runtime selected kernels for each instruction set that the cpu
+//! supports, to compare with each other and with the compile time kernels
+void dispatchBenchmarks(bench::Runner &runner) {
+    using namespace matmath::simd;
+    const auto a = rotations<float>();
+    const auto b = a;
+    auto out = std::vector<Matrixf>(count);
+
+    auto points = std::vector<Vecf>{};
+    auto angles = std::vector<float>{};
+    for (size_t i = 0; i < count; ++i) {
+        points.push_back({static_cast<float>(i), 1, -2});
+        angles.push_back(static_cast<float>(i) * .013f - 6);
+    }
+    auto transformed = points;
+    auto sin = angles, cos = angles;
+    const auto q = Quaternionf{a[3]};
+
+    const auto best = static_cast<int>(cpuFeatures().best());
+    for (int i = 0; i <= best; ++i) {
+        const auto &k = kernels(static_cast<InstructionSet>(i));
+        const auto prefix = std::string{"dispatch "} +
+                            name(k.instructionSet) + " ";
+
+        runner.run(prefix + "multiply", count, [&] {
+            k.multiply(a.front().data(),
+                       b.front().data(),
+                       out.front().data(),
+                       count);
+            bench::doNotOptimize(out);
+        });
+
+        runner.run(prefix + "transform3", count, [&] {
+            k.transform3(a.front().data(),
+                         &points.front().x,
+                         &transformed.front().x,
+                         count,
+                         TransformMode::Point);
+            bench::doNotOptimize(transformed);
+        });
+
+        runner.run(prefix + "rotate3", count, [&] {
+            k.rotate3(&q.w, &points.front().x, &transformed.front().x, count);
+            bench::doNotOptimize(transformed);
+        });
+
+        runner.run(prefix + "sincos", count, [&] {
+            k.sincos(angles.data(), sin.data(), cos.data(), count);
+            bench::doNotOptimize(sin);
+            bench::doNotOptimize(cos);
+        });
+    }
+}
+
+const char *instructionSet() {
+#if defined(matmath_avx) && defined(matmath_fma)
+    return "avx+fma";
+#elif defined(matmath_avx)
+    return "avx";
+#elif defined(matmath_sse2)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+const char *compiler() {
+#if defined(__clang__)
+    return "clang " __clang_version__;
+#elif defined(__GNUC__)
+    return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+    return "msvc";
+#else
+    return "unknown";
+#endif
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    auto options = bench::Options{};
+    auto jsonPath = std::string{};
+
+    for (int i = 1; i < argc; ++i) {
+        const auto arg = std::string{argv[i]};
+        if (i + 1 == argc) {
+            std::cerr << "missing value for " << arg << "\n";
+            return 1;
+        }
+        const auto value = std::string{argv[++i]};
+        if (arg == "--json") {
+            jsonPath = value;
+        }
+        else if (arg == "--filter") {
+            options.filter = value;
+        }
+        else if (arg == "--repetitions") {
+            options.repetitions = std::max(1, std::atoi(value.c_str()));
+        }
+        else if (arg == "--warmup") {
+            options.warmup =
+                std::chrono::milliseconds{std::atoi(value.c_str())};
+        }
+        else {
+            std::cerr << "unknown argument " << arg << "\n";
+            return 1;
+        }
+    }
+
+    auto runner = bench::Runner{options};
+
+    matrixBenchmarks<float>(runner, "float");
+    matrixBenchmarks<double>(runner, "double");
+    affineMatrixBenchmarks<float>(runner, "float");
+    affineMatrixBenchmarks<double>(runner, "double");
+    vec4Benchmarks<float>(runner, "float");
+    vec4Benchmarks<double>(runner, "double");
+    aabbBenchmarks<float>(runner, "float");
+    aabbBenchmarks<double>(runner, "double");
+    frustumBenchmarks<float>(runner, "float");
+    frustumBenchmarks<double>(runner, "double");
+    rayBenchmarks<float>(runner, "float");
+    rayBenchmarks<double>(runner, "double");
+    bvhBenchmarks<float>(runner, "float");
+    bvhBenchmarks<double>(runner, "double");
+    kdTreeBenchmarks<VecT<float>>(runner, "Vecf");
+    kdTreeBenchmarks<Vec2T<float>>(runner, "Vec2f");
+    quaternionBenchmarks(runner);
+    dualQuaternionBenchmarks(runner);
+    transform2Benchmarks<float>(runner, "float");
+    transform2Benchmarks<double>(runner, "double");
+    transform3Benchmarks(runner);
+    matrixBatchBenchmarks<float, 8>(runner, "float");
+    matrixBatchBenchmarks<float, 16>(runner, "float");
+    matrixBatchBenchmarks<double, 4>(runner, "double");
+    parallelBenchmarks<float>(runner, "float");
+    parallelBenchmarks<double>(runner, "double");
+    transformHierarchyBenchmarks(runner);
+    sinBenchmarks(runner);
+    dispatchBenchmarks(runner);
+
+    const auto context = std::vector<std::pair<std::string, std::string>>{
+        {"instruction_set", instructionSet()},
+        {"compiler", compiler()},
+        {"dispatch", matmath::simd::name(matmath::simd::instructionSet())},
+    };
+
+    if (jsonPath == "-") {
+        runner.writeJson(std::cout, context);
+        return 0;
+    }
+
+    runner.print(std::cout);
+    if (!jsonPath.empty()) {
+        auto file = std::ofstream{jsonPath};
+        if (!file) {
+            std::cerr << "could not open " << jsonPath << "\n";
+            return 1;
+        }
+        runner.writeJson(file, context);
+    }
+}
@@ -0,0 +1,210 @@
+//! Copyright © Mattias Larsson Sköld 2020
+//! Distributed under terms specified under licence.txt
+
+#pragma once
+
+#include "matmath/export.h"
+
+#ifndef matmath_use_modules
+
+#include "affinematrix.h"
+#include "matrix.h"
+#include "simd.h"
+#include "vec.h"
+#include <cstddef>
+#include <limits>
+#include <ostream>
+#if __cplusplus >= 202002L
+#include <span>
+#endif
+
+#endif
+
+//! Axis aligned bounding box with the corners min and max.
+//!
+//! A default constructed box is empty, with min larger than max, so that
+//! boxes can be built with merge(). Transforming an empty box does not give
+//! a meaningful result.
+matmath_export template <typename T>
+struct AABB {
+    VecT<T> min = {std::numeric_limits<T>::max(),
+                   std::numeric_limits<T>::max(),
+                   std::numeric_limits<T>::max()};
+    VecT<T> max = {std::numeric_limits<T>::lowest(),
+                   std::numeric_limits<T>::lowest(),
+                   std::numeric_limits<T>::lowest()};
+
+    constexpr AABB() = default;
+    constexpr AABB(const VecT<T> &min, const VecT<T> &max)
+        : min(min), max(max) {}
+
+    //! The smallest box that contains all points
+    static constexpr AABB FromPoints(const VecT<T> *points, size_t count) {
+        auto box = AABB{};
+        for (size_t i = 0; i < count; ++i) {
+            box = box.merge(points[i]);
+        }
+        return box;
+    }
+
+    constexpr bool isEmpty() const {
+        return min.x > max.x || min.y > max.y || min.z > max.z;
+    }
+
+    constexpr VecT<T> center() const {
+        return (min + max) * T(.5);
+    }
+
+    //! Half the size of the box
+    constexpr VecT<T> extents() const {
+        return (max - min) * T(.5);
+    }
+
+    constexpr bool contains(const VecT<T> &p) const {
+        return p.x >= min.x && p.y >= min.y && p.z >= min.z && //
+               p.x <= max.x && p.y <= max.y && p.z <= max.z;
+    }
+
+    constexpr bool contains(const AABB &box) const {
+        return contains(box.min) && contains(box.max);
+    }
+
+    //! True if the boxes overlaps or touches
+    constexpr bool intersects(const AABB &box) const {
+        return min.x <= box.max.x && min.y <= box.max.y &&
+               min.z <= box.max.z && box.min.x <= max.x &&
+               box.min.y <= max.y && box.min.z <= max.z;
+    }
+
+    //! The union of the boxes
+    constexpr AABB merge(const AABB &box) const {
+        return {lower(min, box.min), upper(max, box.max)};
+    }
+
+    //! The smallest box that contains both this box and p
+    constexpr AABB merge(const VecT<T> &p) const {
+        return {lower(min, p), upper(max, p)};
+    }
+
+    //! The overlapping part, which is empty if the boxes does not intersect
+    constexpr AABB intersection(const AABB &box) const {
+        return {upper(min, box.min), lower(max, box.max)};
+    }
+
+    constexpr bool operator==(const AABB &box) const {
+        return min == box.min && max == box.max;
+    }
+
+    constexpr bool operator!=(const AABB &box) const {
+        return !(*this == box);
+    }
+
+private:
+    static constexpr T smallest(T a, T b) {
+        return a < b ? a : b;
+    }
+
+    static constexpr T largest(T a, T b) {
+        return a < b ? b : a;
+    }
+
+    static constexpr VecT<T> lower(const VecT<T> &a, const VecT<T> &b) {
+        return {smallest(a.x, b.x), smallest(a.y, b.y), smallest(a.z, b.z)};
+    }
+
+    static constexpr VecT<T> upper(const VecT<T> &a, const VecT<T> &b) {
+        return {largest(a.x, b.x), largest(a.y, b.y), largest(a.z, b.z)};
+    }
+};
+
+namespace matmath::detail {
+
+//! Arvo's method for Matrix and AffineMatrix, which have the same names for
+//! the rotation and scale part
+template <typename T, class M>
+constexpr AABB<T> transformBox(const M &m, const AABB<T> &box) {
+    const auto absolute = [](T value) { return value < 0 ? -value : value; };
+    const auto center = m * box.center();
+    const auto e = box.extents();
+    const auto extents = VecT<T>{
+        absolute(m.x1) * e.x + absolute(m.x2) * e.y + absolute(m.x3) * e.z,
+        absolute(m.y1) * e.x + absolute(m.y2) * e.y + absolute(m.y3) * e.z,
+        absolute(m.z1) * e.x + absolute(m.z2) * e.y + absolute(m.z3) * e.z,
+    };
+    return {center - extents, center + extents};
+}
+
+} // namespace matmath::detail
+
+//! The box that contains the transformed box, calculated from the center
+//! and the extents instead of by transforming all eight corners. The w
+//! values of the matrix are ignored, so this is only correct for affine
+//! matrices
+matmath_export template <typename T>
+constexpr AABB<T> operator*(const Matrix<T> &m, const AABB<T> &box) {
+    return matmath::detail::transformBox(m, box);
+}
+
+matmath_export template <typename T>
+constexpr AABB<T> operator*(const AffineMatrix<T> &m, const AABB<T> &box) {
+    return matmath::detail::transformBox(m, box);
+}
+
+//! out[i] = m * in[i] for count boxes. in and out may be the same array
+matmath_export template <typename T>
+void transform(const Matrix<T> &m,
+               const AABB<T> *in,
+               AABB<T> *out,
+               size_t count) noexcept {
+    static_assert(sizeof(AABB<T>) == sizeof(T) * 6,
+                  "AABB is expected to be six tightly packed values");
+    const auto src = reinterpret_cast<const T *>(in);
+    const auto dst = reinterpret_cast<T *>(out);
+    const auto done =
+        matmath::simd::transformBounds3(m.data(), src, dst, count);
+    for (size_t i = done; i < count; ++i) {
+        out[i] = m * in[i];
+    }
+}
+
+matmath_export template <typename T>
+void transform(const AffineMatrix<T> &m,
+               const AABB<T> *in,
+               AABB<T> *out,
+               size_t count) noexcept {
+    static_assert(sizeof(AABB<T>) == sizeof(T) * 6,
+                  "AABB is expected to be six tightly packed values");
+    const auto src = reinterpret_cast<const T *>(in);
+    const auto dst = reinterpret_cast<T *>(out);
+    const auto done =
+        matmath::simd::transformBounds3(m.data(), src, dst, count, 3);
+    for (size_t i = done; i < count; ++i) {
+        out[i] = m * in[i];
+    }
+}
+
+#if __cplusplus >= 202002L
+//! out should be at least as long as in
+matmath_export template <typename T>
+void transform(const Matrix<T> &m,
+               std::span<const AABB<T>> in,
+               std::span<AABB<T>> out) noexcept {
+    transform(m, in.data(), out.data(), in.size());
+}
+
+matmath_export template <typename T>
+void transform(const AffineMatrix<T> &m,
+               std::span<const AABB<T>> in,
+               std::span<AABB<T>> out) noexcept {
+    transform(m, in.data(), out.data(), in.size());
+}
+#endif
+
+matmath_export template <class T>
+std::ostream &operator<<(std::ostream &out, const AABB<T> &box) {
+    out << "(" << box.min << "), (" << box.max << ")";
+    return out;
+}
+
+matmath_export using AABBf = AABB<float>;
+matmath_export using AABBd = AABB<double>;
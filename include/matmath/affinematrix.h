@@ -0,0 +1,360 @@
+//! Copyright © Mattias Larsson Sköld 2020
+//! Distributed under terms specified under licence.txt
+
+#pragma once
+
+#include "export.h"
+
+#ifndef matmath_use_modules
+
+#include "matrix.h"
+#include "simd.h"
+#include "vec.h"
+#include <cstddef>
+#if __cplusplus >= 202002L
+#include <span>
+#endif
+
+#endif
+
+//! A Matrix where w1 = w2 = w3 = 0 and w4 = 1, which is the case for all
+//! combinations of rotation, scaling and translation. Only the 12 other
+//! values are stored, with the same names and order as in Matrix, so
+//! composition needs 36 multiplications instead of 64.
+matmath_export template <class T>
+class AffineMatrix {
+public:
+    // clang-format off
+    constexpr AffineMatrix(T x1, T y1, T z1,
+                           T x2, T y2, T z2,
+                           T x3, T y3, T z3,
+                           T x4 = 0, T y4 = 0, T z4 = 0)
+        : x1(x1), y1(y1), z1(z1)
+        , x2(x2), y2(y2), z2(z2)
+        , x3(x3), y3(y3), z3(z3)
+        , x4(x4), y4(y4), z4(z4)
+    {}
+    // clang-format on
+
+    constexpr AffineMatrix(VecT<T> row1,
+                           VecT<T> row2,
+                           VecT<T> row3,
+                           VecT<T> row4 = {})
+        : AffineMatrix(
+              // clang-format off
+              row1.x, row1.y, row1.z,
+              row2.x, row2.y, row2.z,
+              row3.x, row3.y, row3.z,
+              row4.x, row4.y, row4.z
+              // clang-format on
+          ) {}
+
+    //! Convert from a full matrix. The w values are ignored, so this is only
+    //! lossless if m.isAffine()
+    constexpr explicit AffineMatrix(const Matrix<T> &m)
+        : AffineMatrix(
+              // clang-format off
+              m.x1, m.y1, m.z1,
+              m.x2, m.y2, m.z2,
+              m.x3, m.y3, m.z3,
+              m.x4, m.y4, m.z4
+              // clang-format on
+          ) {}
+
+    constexpr AffineMatrix() = default;
+    constexpr AffineMatrix(const AffineMatrix &) = default;
+    constexpr AffineMatrix &operator=(const AffineMatrix &) = default;
+
+    //! Convert to a full matrix, this is always lossless
+    constexpr operator Matrix<T>() const {
+        return toMatrix();
+    }
+
+    constexpr Matrix<T> toMatrix() const {
+        // clang-format off
+        return Matrix<T>{
+            x1, y1, z1, 0,
+            x2, y2, z2, 0,
+            x3, y3, z3, 0,
+            x4, y4, z4, 1,
+        };
+        // clang-format on
+    }
+
+    constexpr T *data() {
+        return &x1;
+    }
+
+    constexpr const T *data() const {
+        return &x1;
+    }
+
+    constexpr VecT<T> row(int num) const {
+        switch (num) {
+        case 0:
+            return {x1, y1, z1};
+        case 1:
+            return {x2, y2, z2};
+        case 2:
+            return {x3, y3, z3};
+        default:
+            return {x4, y4, z4};
+        }
+    }
+
+    constexpr AffineMatrix &row(int num, VecT<T> v) {
+        switch (num) {
+        case 0:
+            x1 = v.x;
+            y1 = v.y;
+            z1 = v.z;
+            break;
+        case 1:
+            x2 = v.x;
+            y2 = v.y;
+            z2 = v.z;
+            break;
+        case 2:
+            x3 = v.x;
+            y3 = v.y;
+            z3 = v.z;
+            break;
+        default:
+            x4 = v.x;
+            y4 = v.y;
+            z4 = v.z;
+            break;
+        }
+        return *this;
+    }
+
+    constexpr VecT<T> translation() const {
+        return {x4, y4, z4};
+    }
+
+    constexpr AffineMatrix &setTranslation(VecT<T> v) {
+        return row(3, v);
+    }
+
+    //! Same as Matrix::operator*, but skipping the terms with w values
+    constexpr AffineMatrix operator*(const AffineMatrix &m) const {
+        if (!matmath::simd::isConstantEvaluated()) {
+            AffineMatrix product;
+            if (matmath::simd::multiplyAffine(
+                    data(), m.data(), product.data())) {
+                return product;
+            }
+        }
+
+        // clang-format off
+        return {
+            x1 * m.x1 + x2 * m.y1 + x3 * m.z1,
+            y1 * m.x1 + y2 * m.y1 + y3 * m.z1,
+            z1 * m.x1 + z2 * m.y1 + z3 * m.z1,
+
+            x1 * m.x2 + x2 * m.y2 + x3 * m.z2,
+            y1 * m.x2 + y2 * m.y2 + y3 * m.z2,
+            z1 * m.x2 + z2 * m.y2 + z3 * m.z2,
+
+            x1 * m.x3 + x2 * m.y3 + x3 * m.z3,
+            y1 * m.x3 + y2 * m.y3 + y3 * m.z3,
+            z1 * m.x3 + z2 * m.y3 + z3 * m.z3,
+
+            x1 * m.x4 + x2 * m.y4 + x3 * m.z4 + x4,
+            y1 * m.x4 + y2 * m.y4 + y3 * m.z4 + y4,
+            z1 * m.x4 + z2 * m.y4 + z3 * m.z4 + z4,
+        };
+        // clang-format on
+    }
+
+    constexpr AffineMatrix &operator*=(const AffineMatrix &m) {
+        return *this = *this * m;
+    }
+
+    //! Transform a point, the same as Matrix::operator*(Vec)
+    constexpr VecT<T> operator*(const VecT<T> &v) const {
+        return {
+            x1 * v.x + x2 * v.y + x3 * v.z + x4,
+            y1 * v.x + y2 * v.y + y3 * v.z + y4,
+            z1 * v.x + z2 * v.y + z3 * v.z + z4,
+        };
+    }
+
+    //! Transform a direction, that is without translation
+    constexpr VecT<T> transformDirection(const VecT<T> &v) const {
+        return {
+            x1 * v.x + x2 * v.y + x3 * v.z,
+            y1 * v.x + y2 * v.y + y3 * v.z,
+            z1 * v.x + z2 * v.y + z3 * v.z,
+        };
+    }
+
+    //! Batch versions, see Matrix::transformPoints
+    //! in and out may be the same array
+    void transformPoints(const VecT<T> *in,
+                         VecT<T> *out,
+                         size_t count) const noexcept {
+        transform(in, out, count, matmath::simd::TransformMode::Point);
+    }
+
+    void transformDirections(const VecT<T> *in,
+                             VecT<T> *out,
+                             size_t count) const noexcept {
+        transform(in, out, count, matmath::simd::TransformMode::Direction);
+    }
+
+#if __cplusplus >= 202002L
+    void transformPoints(std::span<const VecT<T>> in,
+                         std::span<VecT<T>> out) const noexcept {
+        transformPoints(in.data(), out.data(), in.size());
+    }
+
+    void transformDirections(std::span<const VecT<T>> in,
+                             std::span<VecT<T>> out) const noexcept {
+        transformDirections(in.data(), out.data(), in.size());
+    }
+#endif
+
+    //! Invert into out and return the determinant, see Matrix::tryInverse
+    //! If the matrix is singular 0 is returned and out is left unchanged
+    constexpr T tryInverse(AffineMatrix &out) const noexcept {
+        const auto r1 = VecT<T>{x1, y1, z1};
+        const auto r2 = VecT<T>{x2, y2, z2};
+        const auto r3 = VecT<T>{x3, y3, z3};
+        const auto t = VecT<T>{x4, y4, z4};
+
+        const auto c1 = r2.cross(r3);
+        const auto c2 = r3.cross(r1);
+        const auto c3 = r1.cross(r2);
+        const auto det = r1 * c1;
+
+        if (det == 0) {
+            return det;
+        }
+
+        const auto l = 1 / det;
+
+        // clang-format off
+        out = {
+            c1.x * l, c2.x * l, c3.x * l,
+            c1.y * l, c2.y * l, c3.y * l,
+            c1.z * l, c2.z * l, c3.z * l,
+            -(c1 * t) * l, -(c2 * t) * l, -(c3 * t) * l,
+        };
+        // clang-format on
+
+        return det;
+    }
+
+    //! Inverse of an invertible matrix, throws if the matrix is singular
+    constexpr AffineMatrix inverse() const {
+        AffineMatrix inv;
+        if (tryInverse(inv) == 0) {
+            throw "could not invert matrix";
+        }
+        return inv;
+    }
+
+    //! See Matrix::inverseOrthogonal
+    constexpr AffineMatrix inverseOrthogonal() const {
+        auto l1 = (T)1. / (x1 * x1 + x2 * x2 + x3 * x3);
+        auto l2 = (T)1. / (y1 * y1 + y2 * y2 + y3 * y3);
+        auto l3 = (T)1. / (z1 * z1 + z2 * z2 + z3 * z3);
+        // clang-format off
+        return {
+            x1 * l1, x2 * l1, x3 * l1,
+            y1 * l2, y2 * l2, y3 * l2,
+            z1 * l3, z2 * l3, z3 * l3,
+            -x4 * x1 * l1 - y4 * y1 * l2 - z4 * z1 * l3,
+            -x4 * x2 * l1 - y4 * y2 * l2 - z4 * z2 * l3,
+            -x4 * x3 * l1 - y4 * y3 * l2 - z4 * z3 * l3,
+        };
+        // clang-format on
+    }
+
+    //! See Matrix::inverseNormalized
+    constexpr AffineMatrix inverseNormalized() const {
+        // clang-format off
+        return {
+            x1, x2, x3,
+            y1, y2, y3,
+            z1, z2, z3,
+            -x4 * x1 - y4 * y1 - z4 * z1,
+            -x4 * x2 - y4 * y2 - z4 * z2,
+            -x4 * x3 - y4 * y3 - z4 * z3,
+        };
+        // clang-format on
+    }
+
+    constexpr static AffineMatrix Identity() {
+        return {};
+    }
+
+    constexpr static AffineMatrix Translation(T x, T y, T z = 0) {
+        // clang-format off
+        return {
+            1, 0, 0,
+            0, 1, 0,
+            0, 0, 1,
+            x, y, z,
+        };
+        // clang-format on
+    }
+
+    constexpr static AffineMatrix Translation(VecT<T> v) {
+        return Translation(v.x, v.y, v.z);
+    }
+
+    constexpr static AffineMatrix Scale(T x, T y, T z = 1) {
+        // clang-format off
+        return {
+            x, 0, 0,
+            0, y, 0,
+            0, 0, z,
+        };
+        // clang-format on
+    }
+
+    constexpr static AffineMatrix Scale(T s) {
+        return Scale(s, s, s);
+    }
+
+    T x1 = 1, y1 = 0, z1 = 0;
+    T x2 = 0, y2 = 1, z2 = 0;
+    T x3 = 0, y3 = 0, z3 = 1;
+    T x4 = 0, y4 = 0, z4 = 0;
+
+private:
+    void transform(const VecT<T> *in,
+                   VecT<T> *out,
+                   size_t count,
+                   matmath::simd::TransformMode mode) const noexcept {
+        auto done =
+            matmath::simd::transform3(data(),
+                                      reinterpret_cast<const T *>(in),
+                                      reinterpret_cast<T *>(out),
+                                      count,
+                                      mode,
+                                      3);
+
+        for (auto i = done; i < count; ++i) {
+            out[i] = mode == matmath::simd::TransformMode::Point
+                         ? *this * in[i]
+                         : transformDirection(in[i]);
+        }
+    }
+};
+
+//! Multiplication between the matrix types gives a full Matrix
+matmath_export template <class T>
+constexpr Matrix<T> operator*(const Matrix<T> &a, const AffineMatrix<T> &b) {
+    return a * b.toMatrix();
+}
+
+matmath_export template <class T>
+constexpr Matrix<T> operator*(const AffineMatrix<T> &a, const Matrix<T> &b) {
+    return a.toMatrix() * b;
+}
+
+matmath_export using AffineMatrixf = AffineMatrix<float>;
+matmath_export using AffineMatrixd = AffineMatrix<double>;
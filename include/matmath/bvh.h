@@ -0,0 +1,972 @@
+//! Copyright © Mattias Larsson Sköld 2020
+//! Distributed under terms specified under licence.txt
+
+#pragma once
+
+#include "matmath/export.h"
+
+#ifndef matmath_use_modules
+
+#include "aabb.h"
+#include "matrix.h"
+#include "parallel.h"
+#include "ray.h"
+#include "simd.h"
+#include "vec.h"
+#include "vecsoa.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#endif
+
+//! The closest point on the triangle (a, b, c) to p
+matmath_export template <typename T>
+constexpr VecT<T> closestPointOnTriangle(const VecT<T> &p,
+                                         const VecT<T> &a,
+                                         const VecT<T> &b,
+                                         const VecT<T> &c) {
+    // Find the voronoi region of p, from Real-Time Collision Detection by
+    // Christer Ericson
+    const auto ab = b - a;
+    const auto ac = c - a;
+    const auto ap = p - a;
+    const auto d1 = ab * ap;
+    const auto d2 = ac * ap;
+    if (d1 <= 0 && d2 <= 0) {
+        return a;
+    }
+
+    const auto bp = p - b;
+    const auto d3 = ab * bp;
+    const auto d4 = ac * bp;
+    if (d3 >= 0 && d4 <= d3) {
+        return b;
+    }
+
+    const auto vc = d1 * d4 - d3 * d2;
+    if (vc <= 0 && d1 >= 0 && d3 <= 0) {
+        return a + ab * (d1 / (d1 - d3));
+    }
+
+    const auto cp = p - c;
+    const auto d5 = ab * cp;
+    const auto d6 = ac * cp;
+    if (d6 >= 0 && d5 <= d6) {
+        return c;
+    }
+
+    const auto vb = d5 * d2 - d1 * d6;
+    if (vb <= 0 && d2 >= 0 && d6 <= 0) {
+        return a + ac * (d2 / (d2 - d6));
+    }
+
+    const auto va = d3 * d6 - d5 * d4;
+    if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0) {
+        return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    }
+
+    const auto denominator = 1 / (va + vb + vc);
+    return a + ab * (vb * denominator) + ac * (vc * denominator);
+}
+
+//! Bounding volume hierarchy over triangles or boxes, for ray casts,
+//! closest point and overlap queries.
+//!
+//! The tree is built with binned surface area heuristic splits and stored
+//! as nodes with four children each, with the bounds of the children in
+//! one array per axis so that all four are tested at once. Triangles are
+//! stored in leaf order as TriangleSoA and tested with intersectTriangles.
+//! Queries does not allocate. The indices returned from the queries are
+//! the indices of the triangles or boxes passed to build()
+matmath_export template <typename T>
+class Bvh {
+public:
+    //! Nodes are stored depth first, so that children always comes after
+    //! their parent. A child is either another node or a leaf, which is a
+    //! range of primitives
+    struct alignas(64) Node {
+        T minX[4], minY[4], minZ[4];
+        T maxX[4], maxY[4], maxZ[4];
+        //! Index of the child node, or the first primitive of a leaf
+        uint32_t child[4];
+        //! Number of primitives of a leaf, 0 for nodes and empty slots
+        uint32_t count[4];
+
+        bool isLeaf(int i) const {
+            return count[i] != 0;
+        }
+
+        bool isEmpty(int i) const {
+            return child[i] == invalid;
+        }
+
+        AABB<T> bounds(int i) const {
+            return {{minX[i], minY[i], minZ[i]}, {maxX[i], maxY[i], maxZ[i]}};
+        }
+
+        void bounds(int i, const AABB<T> &box) {
+            minX[i] = box.min.x;
+            minY[i] = box.min.y;
+            minZ[i] = box.min.z;
+            maxX[i] = box.max.x;
+            maxY[i] = box.max.y;
+            maxZ[i] = box.max.z;
+        }
+    };
+
+    //! Result of closestPoint, like RayHit only points closer than distance
+    //! are accepted
+    struct Closest {
+        VecT<T> point;
+        T distance = std::numeric_limits<T>::max();
+        size_t index = 0;
+    };
+
+    static constexpr uint32_t invalid = ~uint32_t{0};
+
+    //! Leaves are not split further than this
+    static constexpr uint32_t minLeafSize = 2;
+    //! Leaves larger than this are split even if it does not lower the cost
+    static constexpr uint32_t maxLeafSize = 16;
+
+    Bvh() = default;
+
+    //! Build over count triangles where triangle i is vertices[i * 3],
+    //! vertices[i * 3 + 1] and vertices[i * 3 + 2]
+    void build(const VecT<T> *vertices,
+               size_t count,
+               matmath::ThreadPool &pool = matmath::ThreadPool::global()) {
+        _isTriangles = true;
+        _boxes.clear();
+        _sourceBoxes.clear();
+        auto bounds = std::vector<AABB<T>>(count);
+        pool.parallelFor(
+            count,
+            pool.chunkSize(count, sizeof(VecT<T>) * 3),
+            [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    bounds[i] = AABB<T>::FromPoints(vertices + i * 3, 3);
+                }
+            });
+        buildTree(bounds, pool);
+
+        _sourceTriangles.clear();
+        _sourceTriangles.reserve(count);
+        for (auto i : _primitives) {
+            const auto v = vertices + size_t{i} * 3;
+            _sourceTriangles.push_back(v[0], v[1], v[2]);
+        }
+        _triangles = _sourceTriangles;
+    }
+
+    //! Build over count boxes
+    void build(const AABB<T> *boxes,
+               size_t count,
+               matmath::ThreadPool &pool = matmath::ThreadPool::global()) {
+        _isTriangles = false;
+        _triangles.clear();
+        _sourceTriangles.clear();
+        buildTree(std::vector<AABB<T>>(boxes, boxes + count), pool);
+
+        _sourceBoxes.clear();
+        _sourceBoxes.reserve(count);
+        for (auto i : _primitives) {
+            _sourceBoxes.push_back(boxes[i]);
+        }
+        _boxes = _sourceBoxes;
+    }
+
+    //! Place the triangles or boxes that the tree was built with at m and
+    //! update the bounds of the tree without changing its structure. m is
+    //! the whole transform from the positions passed to build() or the last
+    //! refit with new positions, so boxes does not grow from being
+    //! transformed several times. The queries gets slower if the primitives
+    //! moves a lot relative to each other
+    void refit(const Matrix<T> &m) {
+        if (_isTriangles) {
+            using matmath::simd::TransformMode;
+            transformVectors(m,
+                             _sourceTriangles.vertex,
+                             _triangles.vertex,
+                             TransformMode::Point);
+            transformVectors(m,
+                             _sourceTriangles.edge1,
+                             _triangles.edge1,
+                             TransformMode::Direction);
+            transformVectors(m,
+                             _sourceTriangles.edge2,
+                             _triangles.edge2,
+                             TransformMode::Direction);
+        }
+        else {
+            transform(m, _sourceBoxes.data(), _boxes.data(), _boxes.size());
+        }
+        refitNodes();
+    }
+
+    //! Replace the triangles with new positions for the same triangles that
+    //! the tree was built with, and update the bounds
+    void refit(const VecT<T> *vertices) {
+        if (!_isTriangles) {
+            throw "refit with triangles on a Bvh built with boxes";
+        }
+        for (size_t i = 0; i < _primitives.size(); ++i) {
+            const auto v = vertices + size_t{_primitives[i]} * 3;
+            _sourceTriangles.vertex.set(i, v[0]);
+            _sourceTriangles.edge1.set(i, v[1] - v[0]);
+            _sourceTriangles.edge2.set(i, v[2] - v[0]);
+        }
+        _triangles = _sourceTriangles;
+        refitNodes();
+    }
+
+    //! Replace the boxes, see refit(const VecT<T> *)
+    void refit(const AABB<T> *boxes) {
+        if (_isTriangles) {
+            throw "refit with boxes on a Bvh built with triangles";
+        }
+        for (size_t i = 0; i < _primitives.size(); ++i) {
+            _sourceBoxes[i] = boxes[_primitives[i]];
+        }
+        _boxes = _sourceBoxes;
+        refitNodes();
+    }
+
+    //! Find the closest triangle hit by the ray, or the closest box that the
+    //! ray enters. hit.index is set to the triangle or box, u and v are 0
+    //! for boxes
+    bool raycast(const Ray<T> &ray, RayHit<T> &hit) const noexcept {
+        if (_nodes.empty()) {
+            return false;
+        }
+        const auto inverse = VecT<T>{T(1) / ray.direction.x,
+                                     T(1) / ray.direction.y,
+                                     T(1) / ray.direction.z};
+
+        auto found = false;
+        Entry stack[stackSize];
+        int size = 0;
+        stack[size++] = {0, 0, 0};
+        while (size) {
+            const auto entry = stack[--size];
+            if (entry.distance > hit.distance) {
+                continue;
+            }
+            if (entry.count) {
+                found |= raycastLeaf(ray, entry, hit);
+                continue;
+            }
+
+            const auto &node = _nodes[entry.child];
+            T distance[4];
+            const auto bits = intersectChildren(
+                node, ray.origin, inverse, hit.distance, distance);
+
+            // Push the furthest child first, so that the closest is tested
+            // first and can make the test of the others stop early
+            int order[4];
+            int hits = 0;
+            for (int i = 0; i < 4; ++i) {
+                if ((bits >> i) & 1) {
+                    auto j = hits++;
+                    for (; j > 0 && distance[order[j - 1]] < distance[i]; --j) {
+                        order[j] = order[j - 1];
+                    }
+                    order[j] = i;
+                }
+            }
+            for (int i = 0; i < hits; ++i) {
+                const auto c = order[i];
+                stack[size++] = {node.child[c], node.count[c], distance[c]};
+            }
+        }
+        return found;
+    }
+
+    //! Find the closest point on the triangles or boxes, points inside of
+    //! boxes are their own closest point
+    bool closestPoint(const VecT<T> &p, Closest &closest) const noexcept {
+        if (_nodes.empty()) {
+            return false;
+        }
+
+        auto found = false;
+        auto best = closest.distance * closest.distance;
+        if (closest.distance >= std::sqrt(std::numeric_limits<T>::max())) {
+            best = std::numeric_limits<T>::max();
+        }
+
+        Entry stack[stackSize];
+        int size = 0;
+        stack[size++] = {0, 0, 0};
+        while (size) {
+            const auto entry = stack[--size];
+            if (entry.distance > best) {
+                continue;
+            }
+            if (entry.count) {
+                for (auto i = entry.child; i < entry.child + entry.count;
+                     ++i) {
+                    const auto point = closestPoint(p, i);
+                    const auto distance = (point - p).abs2();
+                    if (distance <= best) {
+                        best = distance;
+                        closest.point = point;
+                        closest.index = _primitives[i];
+                        found = true;
+                    }
+                }
+                continue;
+            }
+
+            const auto &node = _nodes[entry.child];
+            T distance[4];
+            const auto bits = distanceToChildren(node, p, best, distance);
+            int order[4];
+            int hits = 0;
+            for (int i = 0; i < 4; ++i) {
+                if ((bits >> i) & 1) {
+                    auto j = hits++;
+                    for (; j > 0 && distance[order[j - 1]] < distance[i]; --j) {
+                        order[j] = order[j - 1];
+                    }
+                    order[j] = i;
+                }
+            }
+            for (int i = 0; i < hits; ++i) {
+                const auto c = order[i];
+                stack[size++] = {node.child[c], node.count[c], distance[c]};
+            }
+        }
+
+        if (found) {
+            using std::sqrt;
+            closest.distance = sqrt(best);
+        }
+        return found;
+    }
+
+    //! Call f(index) for each triangle or box with bounds that overlaps box
+    template <typename F>
+    void overlap(const AABB<T> &box, F &&f) const {
+        if (_nodes.empty()) {
+            return;
+        }
+
+        Entry stack[stackSize];
+        int size = 0;
+        stack[size++] = {0, 0, 0};
+        while (size) {
+            const auto entry = stack[--size];
+            if (entry.count) {
+                for (auto i = entry.child; i < entry.child + entry.count;
+                     ++i) {
+                    if (primitiveBounds(i).intersects(box)) {
+                        f(size_t{_primitives[i]});
+                    }
+                }
+                continue;
+            }
+
+            const auto &node = _nodes[entry.child];
+            const auto bits = overlapChildren(node, box);
+            for (int i = 0; i < 4; ++i) {
+                if ((bits >> i) & 1) {
+                    stack[size++] = {node.child[i], node.count[i], 0};
+                }
+            }
+        }
+    }
+
+    //! Bounds of everything in the tree
+    AABB<T> bounds() const {
+        auto ret = AABB<T>{};
+        if (!_nodes.empty()) {
+            for (int i = 0; i < 4; ++i) {
+                if (!_nodes.front().isEmpty(i)) {
+                    ret = ret.merge(_nodes.front().bounds(i));
+                }
+            }
+        }
+        return ret;
+    }
+
+    //! Number of triangles or boxes
+    size_t size() const {
+        return _primitives.size();
+    }
+
+    bool empty() const {
+        return _primitives.empty();
+    }
+
+    const std::vector<Node> &nodes() const {
+        return _nodes;
+    }
+
+private:
+    //! A binary tree is built first and then collapsed to four children per
+    //! node. The depth is limited so that the stack of the queries can have
+    //! a fixed size
+    static constexpr int maxDepth = 64;
+    static constexpr int stackSize = maxDepth * 3 + 1;
+    static constexpr int binCount = 16;
+
+    struct Entry {
+        uint32_t child;
+        uint32_t count;
+        T distance;
+    };
+
+    struct BuildNode {
+        AABB<T> bounds;
+        uint32_t left = invalid;
+        uint32_t right = invalid;
+        uint32_t begin = 0;
+        uint32_t count = 0;
+
+        bool isLeaf() const {
+            return left == invalid;
+        }
+    };
+
+    //! Primitives [begin, end) with their bounds and the bounds of their
+    //! centers
+    struct Range {
+        uint32_t begin = 0;
+        uint32_t end = 0;
+        AABB<T> bounds;
+        AABB<T> centers;
+    };
+
+    struct Bin {
+        AABB<T> bounds;
+        AABB<T> centers;
+        uint32_t count = 0;
+    };
+
+    using Bins = std::array<Bin, binCount>;
+
+    //! A subtree that is built by one thread
+    struct Task {
+        Range range;
+        int depth;
+        uint32_t node;
+        std::vector<BuildNode> nodes;
+    };
+
+    //! State used while building
+    struct Builder {
+        const std::vector<AABB<T>> &bounds;
+        std::vector<VecT<T>> centers;
+        std::vector<uint32_t> &primitives;
+        matmath::ThreadPool &pool;
+        //! Ranges smaller than this are built in parallel as tasks
+        size_t taskSize;
+        std::vector<Task> tasks;
+    };
+
+    static T area(const AABB<T> &box) {
+        const auto size = box.max - box.min;
+        return size.x * size.y + size.y * size.z + size.z * size.x;
+    }
+
+    void buildTree(const std::vector<AABB<T>> &bounds,
+                   matmath::ThreadPool &pool) {
+        const auto count = bounds.size();
+        _nodes.clear();
+        _primitives.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            _primitives[i] = static_cast<uint32_t>(i);
+        }
+        if (!count) {
+            return;
+        }
+
+        auto builder = Builder{bounds, {}, _primitives, pool, 0, {}};
+        builder.centers.resize(count);
+        pool.parallelFor(count,
+                         pool.chunkSize(count, sizeof(AABB<T>)),
+                         [&](size_t begin, size_t end) {
+                             for (size_t i = begin; i < end; ++i) {
+                                 builder.centers[i] = bounds[i].center();
+                             }
+                         });
+
+        // The top of the tree is built by one thread with parallel binning,
+        // and the rest is split into a few subtrees per thread
+        builder.taskSize =
+            pool.size() > 1
+                ? std::max<size_t>(count / (pool.size() * 8), 1024)
+                : count;
+        auto nodes = std::vector<BuildNode>{};
+        buildNode(builder,
+                  rangeOf(builder, 0, static_cast<uint32_t>(count)),
+                  0,
+                  nodes,
+                  true);
+
+        const auto buildTasks = [&](size_t begin, size_t end) {
+            for (auto i = begin; i < end; ++i) {
+                auto &task = builder.tasks[i];
+                buildNode(builder, task.range, task.depth, task.nodes, false);
+            }
+        };
+        pool.parallelFor(builder.tasks.size(), 1, buildTasks);
+
+        for (auto &task : builder.tasks) {
+            // The root of the task replaces the placeholder in nodes
+            const auto offset = static_cast<uint32_t>(nodes.size() - 1);
+            const auto moved = [offset](BuildNode node) {
+                if (!node.isLeaf()) {
+                    node.left += offset;
+                    node.right += offset;
+                }
+                return node;
+            };
+            nodes[task.node] = moved(task.nodes.front());
+            for (size_t i = 1; i < task.nodes.size(); ++i) {
+                nodes.push_back(moved(task.nodes[i]));
+            }
+        }
+
+        _nodes.reserve(nodes.size() / 2 + 1);
+        _nodes.emplace_back();
+        if (nodes.front().isLeaf()) {
+            // Put a single leaf below the root node
+            auto &root = _nodes.front();
+            clearNode(root);
+            root.bounds(0, nodes.front().bounds);
+            root.child[0] = nodes.front().begin;
+            root.count[0] = nodes.front().count;
+        }
+        else {
+            collapse(nodes, 0, 0);
+        }
+    }
+
+    static void clearNode(Node &node) {
+        for (int i = 0; i < 4; ++i) {
+            node.bounds(i, AABB<T>{});
+            node.child[i] = invalid;
+            node.count[i] = 0;
+        }
+    }
+
+    static Range rangeOf(const Builder &builder,
+                         uint32_t begin,
+                         uint32_t end) {
+        auto range = Range{begin, end, {}, {}};
+        for (auto i = begin; i < end; ++i) {
+            const auto p = builder.primitives[i];
+            range.bounds = range.bounds.merge(builder.bounds[p]);
+            range.centers = range.centers.merge(builder.centers[p]);
+        }
+        return range;
+    }
+
+    //! Binary build of the range, returns the index of the node in nodes
+    static uint32_t buildNode(Builder &builder,
+                              const Range &range,
+                              int depth,
+                              std::vector<BuildNode> &nodes,
+                              bool isTop) {
+        const auto index = static_cast<uint32_t>(nodes.size());
+        nodes.emplace_back();
+        nodes[index].bounds = range.bounds;
+        nodes[index].begin = range.begin;
+        nodes[index].count = range.end - range.begin;
+
+        if (isTop && range.end - range.begin <= builder.taskSize) {
+            builder.tasks.push_back({range, depth, index, {}});
+            return index;
+        }
+
+        auto left = Range{};
+        auto right = Range{};
+        if (!split(builder, range, depth, isTop, left, right)) {
+            return index;
+        }
+
+        const auto leftIndex =
+            buildNode(builder, left, depth + 1, nodes, isTop);
+        const auto rightIndex =
+            buildNode(builder, right, depth + 1, nodes, isTop);
+        nodes[index].left = leftIndex;
+        nodes[index].right = rightIndex;
+        return index;
+    }
+
+    //! Partition the range in two, returns false if it should be a leaf.
+    //! The bounds of the halves are taken from the bins so that they does
+    //! not need to be calculated again
+    static bool split(Builder &builder,
+                      const Range &range,
+                      int depth,
+                      bool isParallel,
+                      Range &left,
+                      Range &right) {
+        const auto begin = range.begin;
+        const auto end = range.end;
+        const auto count = end - begin;
+        if (count <= minLeafSize || depth >= maxDepth) {
+            return false;
+        }
+
+        const auto halves = [&](uint32_t middle) {
+            left = rangeOf(builder, begin, middle);
+            right = rangeOf(builder, middle, end);
+            return true;
+        };
+
+        const auto size = range.centers.max - range.centers.min;
+        const auto axis = size.x > size.y ? (size.x > size.z ? 0 : 2)
+                                          : (size.y > size.z ? 1 : 2);
+        const auto &centers = builder.centers;
+        auto &primitives = builder.primitives;
+        if (!(size[axis] > 0)) {
+            // All centers at the same point
+            return count > maxLeafSize && halves(begin + count / 2);
+        }
+
+        const auto offset = range.centers.min[axis];
+        const auto scale = binCount / size[axis] * T(.9999);
+        const auto binOf = [&](uint32_t p) {
+            const auto bin =
+                static_cast<int>((centers[p][axis] - offset) * scale);
+            return std::min(std::max(bin, 0), binCount - 1);
+        };
+
+        auto bins = Bins{};
+        const auto binRange = [&](uint32_t first, uint32_t last, Bins &b) {
+            for (auto i = first; i < last; ++i) {
+                const auto p = primitives[i];
+                auto &bin = b[binOf(p)];
+                bin.bounds = bin.bounds.merge(builder.bounds[p]);
+                bin.centers = bin.centers.merge(centers[p]);
+                ++bin.count;
+            }
+        };
+        if (isParallel) {
+            auto &pool = builder.pool;
+            const auto chunk = pool.chunkSize(count, sizeof(AABB<T>));
+            auto partial = std::vector<Bins>((count + chunk - 1) / chunk);
+            pool.parallelFor(count, chunk, [&](size_t first, size_t last) {
+                binRange(static_cast<uint32_t>(begin + first),
+                         static_cast<uint32_t>(begin + last),
+                         partial[first / chunk]);
+            });
+            for (auto &p : partial) {
+                for (int i = 0; i < binCount; ++i) {
+                    bins[i].bounds = bins[i].bounds.merge(p[i].bounds);
+                    bins[i].centers = bins[i].centers.merge(p[i].centers);
+                    bins[i].count += p[i].count;
+                }
+            }
+        }
+        else {
+            binRange(begin, end, bins);
+        }
+
+        // Cost of splitting after each bin, counted from the right
+        T rightCost[binCount] = {};
+        auto rightBounds = AABB<T>{};
+        uint32_t rightCount = 0;
+        for (int i = binCount - 1; i > 0; --i) {
+            rightBounds = rightBounds.merge(bins[i].bounds);
+            rightCount += bins[i].count;
+            rightCost[i - 1] = rightCount ? area(rightBounds) * rightCount : 0;
+        }
+
+        auto leftBounds = AABB<T>{};
+        uint32_t leftCount = 0;
+        auto bestCost = std::numeric_limits<T>::max();
+        int bestSplit = -1;
+        for (int i = 0; i < binCount - 1; ++i) {
+            leftBounds = leftBounds.merge(bins[i].bounds);
+            leftCount += bins[i].count;
+            if (!leftCount || leftCount == count) {
+                continue;
+            }
+            const auto cost = area(leftBounds) * leftCount + rightCost[i];
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestSplit = i;
+            }
+        }
+
+        // Compare with the cost of making a leaf, with the cost of a node
+        // the same as for one primitive
+        const auto leafCost = area(range.bounds) * count;
+        if (bestSplit < 0) {
+            return count > maxLeafSize && halves(begin + count / 2);
+        }
+        if (count <= maxLeafSize && bestCost + area(range.bounds) >= leafCost) {
+            return false;
+        }
+
+        const auto first = primitives.begin() + begin;
+        const auto middle = std::partition(
+            first, primitives.begin() + end, [&](uint32_t p) {
+                return binOf(p) <= bestSplit;
+            });
+        const auto split = begin + static_cast<uint32_t>(middle - first);
+
+        left = Range{begin, split, {}, {}};
+        right = Range{split, end, {}, {}};
+        for (int i = 0; i < binCount; ++i) {
+            auto &half = i <= bestSplit ? left : right;
+            half.bounds = half.bounds.merge(bins[i].bounds);
+            half.centers = half.centers.merge(bins[i].centers);
+        }
+        return true;
+    }
+
+    //! Write the binary node to _nodes[target] with up to four children,
+    //! by opening the largest of the child nodes
+    void collapse(const std::vector<BuildNode> &nodes,
+                  uint32_t index,
+                  size_t target) {
+        uint32_t children[4] = {nodes[index].left, nodes[index].right};
+        int count = 2;
+        while (count < 4) {
+            int largest = -1;
+            for (int i = 0; i < count; ++i) {
+                const auto &child = nodes[children[i]];
+                if (!child.isLeaf() &&
+                    (largest < 0 ||
+                     area(child.bounds) >
+                         area(nodes[children[largest]].bounds))) {
+                    largest = i;
+                }
+            }
+            if (largest < 0) {
+                break;
+            }
+            const auto &open = nodes[children[largest]];
+            children[largest] = open.left;
+            children[count++] = open.right;
+        }
+
+        clearNode(_nodes[target]);
+        for (int i = 0; i < count; ++i) {
+            const auto &child = nodes[children[i]];
+            _nodes[target].bounds(i, child.bounds);
+            if (child.isLeaf()) {
+                _nodes[target].child[i] = child.begin;
+                _nodes[target].count[i] = child.count;
+            }
+            else {
+                const auto next = _nodes.size();
+                _nodes[target].child[i] = static_cast<uint32_t>(next);
+                _nodes.emplace_back();
+                collapse(nodes, children[i], next);
+            }
+        }
+    }
+
+    //! Recalculate the bounds from the primitives. Children always comes
+    //! after their parent, so the nodes are updated from the back
+    void refitNodes() {
+        for (auto n = _nodes.size(); n-- > 0;) {
+            auto &node = _nodes[n];
+            for (int i = 0; i < 4; ++i) {
+                if (node.isEmpty(i)) {
+                    continue;
+                }
+                auto bounds = AABB<T>{};
+                if (node.isLeaf(i)) {
+                    const auto first = node.child[i];
+                    for (auto p = first; p < first + node.count[i]; ++p) {
+                        bounds = bounds.merge(primitiveBounds(p));
+                    }
+                }
+                else {
+                    const auto &child = _nodes[node.child[i]];
+                    for (int j = 0; j < 4; ++j) {
+                        if (!child.isEmpty(j)) {
+                            bounds = bounds.merge(child.bounds(j));
+                        }
+                    }
+                }
+                node.bounds(i, bounds);
+            }
+        }
+    }
+
+    //! Bounds of primitive i in leaf order
+    AABB<T> primitiveBounds(uint32_t i) const {
+        if (!_isTriangles) {
+            return _boxes[i];
+        }
+        const auto a = _triangles.vertex[i];
+        return AABB<T>{a, a}
+            .merge(a + _triangles.edge1[i])
+            .merge(a + _triangles.edge2[i]);
+    }
+
+    VecT<T> closestPoint(const VecT<T> &p, uint32_t i) const {
+        if (!_isTriangles) {
+            const auto &box = _boxes[i];
+            const auto clamp = [](T value, T min, T max) {
+                return std::min(std::max(value, min), max);
+            };
+            return {clamp(p.x, box.min.x, box.max.x),
+                    clamp(p.y, box.min.y, box.max.y),
+                    clamp(p.z, box.min.z, box.max.z)};
+        }
+        const auto a = _triangles.vertex[i];
+        return closestPointOnTriangle(
+            p, a, a + _triangles.edge1[i], a + _triangles.edge2[i]);
+    }
+
+    bool raycastLeaf(const Ray<T> &ray,
+                     const Entry &entry,
+                     RayHit<T> &hit) const noexcept {
+        const auto first = entry.child;
+        const auto last = first + entry.count;
+        if (_isTriangles) {
+            if (intersectTriangles(ray, _triangles, first, last, hit)) {
+                hit.index = _primitives[hit.index];
+                return true;
+            }
+            return false;
+        }
+
+        auto found = false;
+        for (auto i = first; i < last; ++i) {
+            T near = 0, far = hit.distance;
+            if (intersectBox(ray, _boxes[i], near, far) &&
+                near <= hit.distance) {
+                hit = {near, 0, 0};
+                hit.index = _primitives[i];
+                found = true;
+            }
+        }
+        return found;
+    }
+
+    using Pack = typename matmath::detail::PacketPackType<T, 4>::type;
+
+    static unsigned validChildren(const Node &node) {
+        unsigned bits = 0;
+        for (int i = 0; i < 4; ++i) {
+            bits |= unsigned{!node.isEmpty(i)} << i;
+        }
+        return bits;
+    }
+
+    //! Slab test of the ray against the four children. Returns a mask of
+    //! the children that are hit and writes the distances where they are
+    //! entered
+    static unsigned intersectChildren(const Node &node,
+                                      const VecT<T> &origin,
+                                      const VecT<T> &inverse,
+                                      T maxDistance,
+                                      T *distance) noexcept {
+        using P = Pack;
+        unsigned bits = 0;
+        for (int i = 0; i < 4; i += P::size) {
+            auto near = P::broadcast(0);
+            auto far = P::broadcast(maxDistance);
+            const auto slab = [&](const T *lower, const T *upper, int axis) {
+                const auto o = P::broadcast(origin[axis]);
+                const auto inv = P::broadcast(inverse[axis]);
+                const auto t1 = (P::load(lower + i) - o) * inv;
+                const auto t2 = (P::load(upper + i) - o) * inv;
+                near = max(near, min(t1, t2));
+                far = min(far, max(t1, t2));
+            };
+            slab(node.minX, node.maxX, 0);
+            slab(node.minY, node.maxY, 1);
+            slab(node.minZ, node.maxZ, 2);
+            near.store(distance + i);
+            const auto misses = maskBits(far < near);
+            bits |= (~misses & ((1u << P::size) - 1)) << i;
+        }
+        return bits & validChildren(node);
+    }
+
+    //! Squared distance from p to the four children, returns a mask of the
+    //! children closer than maxDistance
+    static unsigned distanceToChildren(const Node &node,
+                                       const VecT<T> &p,
+                                       T maxDistance,
+                                       T *distance) noexcept {
+        using P = Pack;
+        unsigned bits = 0;
+        const auto zero = P::broadcast(0);
+        for (int i = 0; i < 4; i += P::size) {
+            const auto axis = [&](const T *lower, const T *upper, T value) {
+                const auto v = P::broadcast(value);
+                const auto d = max(max(P::load(lower + i) - v, zero),
+                                   v - P::load(upper + i));
+                return d * d;
+            };
+            const auto d = axis(node.minX, node.maxX, p.x) +
+                           axis(node.minY, node.maxY, p.y) +
+                           axis(node.minZ, node.maxZ, p.z);
+            d.store(distance + i);
+            const auto misses = maskBits(P::broadcast(maxDistance) < d);
+            bits |= (~misses & ((1u << P::size) - 1)) << i;
+        }
+        return bits & validChildren(node);
+    }
+
+    static unsigned overlapChildren(const Node &node,
+                                    const AABB<T> &box) noexcept {
+        using P = Pack;
+        unsigned bits = 0;
+        for (int i = 0; i < 4; i += P::size) {
+            const auto misses =
+                maskBits(P::broadcast(box.max.x) < P::load(node.minX + i)) |
+                maskBits(P::broadcast(box.max.y) < P::load(node.minY + i)) |
+                maskBits(P::broadcast(box.max.z) < P::load(node.minZ + i)) |
+                maskBits(P::load(node.maxX + i) < P::broadcast(box.min.x)) |
+                maskBits(P::load(node.maxY + i) < P::broadcast(box.min.y)) |
+                maskBits(P::load(node.maxZ + i) < P::broadcast(box.min.z));
+            bits |= (~misses & ((1u << P::size) - 1)) << i;
+        }
+        return bits & validChildren(node);
+    }
+
+    //! Transform all vectors in from to the vectors in to, of the same size
+    static void transformVectors(const Matrix<T> &m,
+                                 const VecSoA<T> &from,
+                                 VecSoA<T> &to,
+                                 matmath::simd::TransformMode mode) {
+        const auto isPoint = mode == matmath::simd::TransformMode::Point;
+        matmath::simd::forEachPack<T>(from.size(), [&](auto p, size_t i) {
+            using P = decltype(p);
+            const auto b = [](T value) { return P::broadcast(value); };
+            const auto x = P::load(from.x.data() + i);
+            const auto y = P::load(from.y.data() + i);
+            const auto z = P::load(from.z.data() + i);
+            const auto row = [&](T a, T b2, T c, T d) {
+                return madd(x, b(a), madd(y, b(b2), madd(z, b(c), b(d))));
+            };
+            row(m.x1, m.x2, m.x3, isPoint ? m.x4 : 0).store(to.x.data() + i);
+            row(m.y1, m.y2, m.y3, isPoint ? m.y4 : 0).store(to.y.data() + i);
+            row(m.z1, m.z2, m.z3, isPoint ? m.z4 : 0).store(to.z.data() + i);
+        });
+    }
+
+    std::vector<Node> _nodes;
+    //! Index of the original triangle or box for each primitive in leaf order
+    std::vector<uint32_t> _primitives;
+    //! The triangles or boxes used by the queries, and the positions that
+    //! refit(const Matrix<T> &) transforms them from
+    TriangleSoA<T> _triangles;
+    TriangleSoA<T> _sourceTriangles;
+    std::vector<AABB<T>> _boxes;
+    std::vector<AABB<T>> _sourceBoxes;
+    bool _isTriangles = true;
+};
+
+matmath_export using Bvhf = Bvh<float>;
+matmath_export using Bvhd = Bvh<double>;
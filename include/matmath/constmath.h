@@ -7,6 +7,10 @@
 
 #ifndef matmath_use_modules
 #include "pi.h"
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <type_traits>
 #endif
 
 namespace constmath {
@@ -25,7 +29,7 @@ constexpr T cabs(T x) {
 matmath_export template <typename T>
 constexpr T floor(T x) {
     long long num = (long long)x;
-    if (x >= 0) {
+    if (x >= 0 || num == x) {
         return (double)num;
     }
     else {
@@ -38,24 +42,142 @@ constexpr T round(T x) {
     return floor(x + .5);
 }
 
+//! True when the calling function is evaluated in a constant expression
+matmath_export constexpr bool isConstantEvaluated() noexcept {
+#if defined(__cpp_lib_is_constant_evaluated)
+    return std::is_constant_evaluated();
+#else
+    return __builtin_is_constant_evaluated();
+#endif
+}
+
 namespace detail {
-constexpr double ffactorial(double x) {
-    double factorial = 1;
-    double d = 2;
-    for (int i = 2; i <= x; ++i) {
-        factorial *= d;
-        ++d;
+
+constexpr double nan = std::numeric_limits<double>::quiet_NaN();
+constexpr double infinity = std::numeric_limits<double>::infinity();
+
+//! Taylor coefficients of sin(x) / x and cos(x) in x^2, enough for double
+//! precision in [-pi / 4, pi / 4]
+inline constexpr double sinCoefficients[] = {
+    1.,
+    -1. / 6.,
+    1. / 120.,
+    -1. / 5040.,
+    1. / 362880.,
+    -1. / 39916800.,
+    1. / 6227020800.,
+    -1. / 1307674368000.,
+    1. / 355687428096000.,
+};
+
+inline constexpr double cosCoefficients[] = {
+    1.,
+    -1. / 2.,
+    1. / 24.,
+    -1. / 720.,
+    1. / 40320.,
+    -1. / 3628800.,
+    1. / 479001600.,
+    -1. / 87178291200.,
+    1. / 20922789888000.,
+    -1. / 6402373705728000.,
+};
+
+//! Polynomial in x2 evaluated with Horner's method
+template <size_t N>
+constexpr double horner(const double (&coefficients)[N], double x2) {
+    double sum = coefficients[N - 1];
+    for (size_t i = N - 1; i > 0; --i) {
+        sum = sum * x2 + coefficients[i - 1];
     }
-    return factorial;
+    return sum;
 }
 
-//! pow with integer exponentials
-constexpr double whole_pow(double x, int power) {
-    double product = x;
-    for (int i = 1; i < power; ++i) {
-        product *= x;
+//! sin and cos for x in [-pi / 4, pi / 4]
+constexpr double sinReduced(double x) {
+    return x * horner(sinCoefficients, x * x);
+}
+
+constexpr double cosReduced(double x) {
+    return horner(cosCoefficients, x * x);
+}
+
+//! Above this the error of quadrant * pi_2 in sinQuadrant is as large as
+//! the reduced angle, and neighbouring doubles are more than 1/2 apart
+constexpr double maxReducedAngle = 0x1p52;
+
+//! sin(x + quadrant * pi / 2) where quadrant is x / (pi / 2) rounded
+constexpr double sinQuadrant(double x, long long offset) {
+    // Also keeps the conversion of quadrant to long long defined
+    if (x != x || cabs(x) > maxReducedAngle) {
+        return nan;
+    }
+    const auto quadrant = (long long)round(x / pi_2);
+    const auto r = x - quadrant * pi_2;
+    switch (((quadrant + offset) % 4 + 4) % 4) {
+    case 0:
+        return sinReduced(r);
+    case 1:
+        return cosReduced(r);
+    case 2:
+        return -sinReduced(r);
+    default:
+        return -cosReduced(r);
     }
-    return product;
+}
+
+constexpr double sqrt(double x) {
+    if (x < 0 || x != x) {
+        return nan;
+    }
+    if (x == 0 || x == infinity) {
+        return x;
+    }
+
+    // Scale into [1, 4) with powers of 4 so that the scale of the root is
+    // exact, and so that Newton's method converges in a few iterations
+    double scale = 1;
+    while (x >= 0x1p64) {
+        x *= 0x1p-64;
+        scale *= 0x1p32;
+    }
+    while (x < 0x1p-64) {
+        x *= 0x1p64;
+        scale *= 0x1p-32;
+    }
+    while (x >= 4) {
+        x *= .25;
+        scale *= 2;
+    }
+    while (x < 1) {
+        x *= 4;
+        scale *= .5;
+    }
+
+    // The relative error is at most 1/4 from the start and is squared in each
+    // iteration
+    double root = (x + 1) * .5;
+    for (int i = 0; i < 6; ++i) {
+        root = (root + x / root) * .5;
+    }
+    return root * scale;
+}
+
+//! atan for |x| <= 1
+constexpr double atanReduced(double x) {
+    // atan(x) = 2 * atan(x / (1 + sqrt(1 + x^2))), used twice to get
+    // |x| <= tan(pi / 16) where the series converges fast
+    x = x / (1 + sqrt(1 + x * x));
+    x = x / (1 + sqrt(1 + x * x));
+
+    const double x2 = x * x;
+    double sum = 0;
+    double term = x;
+    for (int i = 1; i < 40; i += 2) {
+        sum += term / i;
+        term *= -x2;
+    }
+    return sum * 4;
 }
 
 } // namespace detail
@@ -63,42 +185,100 @@ constexpr double whole_pow(double x, int power) {
 //! Constexpr version of sin
 matmath_export template <typename T>
 constexpr T sin(T x) {
-    // Fold angle to always be around 0
-    x -= (pi2)*round(x / (pi2));
-    if (x > pi_2) {
-        x = pi - x;
+    return detail::sinQuadrant(x, 0);
+}
+
+//! Constexpr version of cos
+matmath_export template <typename T>
+constexpr T cos(T x) {
+    return detail::sinQuadrant(x, 1);
+}
+
+matmath_export template <typename T>
+constexpr T tan(T x) {
+    return detail::sinQuadrant(x, 0) / detail::sinQuadrant(x, 1);
+}
+
+//! Same arguments as std::atan2, that is the angle of the vector (x, y)
+matmath_export template <typename T>
+constexpr T atan2(T y, T x) {
+    const double dy = y, dx = x;
+    if (dy != dy || dx != dx) {
+        return detail::nan;
+    }
+    if (dx == 0 && dy == 0) {
+        return 0;
     }
-    else if (x < -pi_2) {
-        x = -pi - x;
+    if (cabs(dy) <= cabs(dx)) {
+        const auto angle = detail::atanReduced(dy / dx);
+        if (dx > 0) {
+            return angle;
+        }
+        return dy < 0 ? angle - pi : angle + pi;
     }
+    const auto angle = detail::atanReduced(dx / dy);
+    return dy > 0 ? pi_2 - angle : -pi_2 - angle;
+}
+
+matmath_export template <typename T>
+constexpr T atan(T x) {
+    return atan2<double>(x, 1);
+}
 
-    // Tailor expansion around 0
-    double ret = 0;
-    double sign = 1;
-    for (int i = 1; i < 20; i += 2) {
-        ret += detail::whole_pow(x, i) / detail::ffactorial(i) * sign;
-        sign *= -1;
+matmath_export template <typename T>
+constexpr T asin(T x) {
+    if (x < -1 || x > 1) {
+        return detail::nan;
     }
-    return ret;
+    return atan2<double>(x, detail::sqrt(1. - (double)x * x));
 }
 
-//! Constexpr version of cos
 matmath_export template <typename T>
-constexpr T cos(T x) {
-    return sin(x + pi / 2.);
+constexpr T acos(T x) {
+    if (x < -1 || x > 1) {
+        return detail::nan;
+    }
+    return atan2<double>(detail::sqrt(1. - (double)x * x), x);
 }
 
+//! Constexpr version of sqrt using Newton's method, negative values gives nan
 matmath_export template <typename T>
-constexpr T atan2(T x, T y) {
-    // Todo: implement this
+constexpr T sqrt(T x) {
+    return detail::sqrt(x);
+}
+
+//! The functions in this namespace uses the constexpr versions above in
+//! constant evaluation and the standard library at runtime. Used by the
+//! constexpr functions in the rest of the library so that they can be
+//! evaluated at compile time without being slower at runtime
+namespace dispatch {
+
+matmath_export template <typename T>
+constexpr T sin(T x) {
+    return isConstantEvaluated() ? constmath::sin(x) : std::sin(x);
+}
 
-    return 0;
+matmath_export template <typename T>
+constexpr T cos(T x) {
+    return isConstantEvaluated() ? constmath::cos(x) : std::cos(x);
 }
 
 matmath_export template <typename T>
 constexpr T sqrt(T x) {
-    // Todo: implement this
-    return 0;
+    return isConstantEvaluated() ? constmath::sqrt(x) : std::sqrt(x);
+}
+
+matmath_export template <typename T>
+constexpr T atan2(T y, T x) {
+    return isConstantEvaluated() ? constmath::atan2(y, x)
+                                 : std::atan2(y, x);
 }
 
+matmath_export template <typename T>
+constexpr T acos(T x) {
+    return isConstantEvaluated() ? constmath::acos(x) : std::acos(x);
+}
+
+} // namespace dispatch
+
 } // namespace constmath
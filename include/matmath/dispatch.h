@@ -0,0 +1,726 @@
+//! Copyright © Mattias Larsson Sköld 2020
+//! Distributed under terms specified under licence.txt
+
+//! Runtime selection of the single precision batch kernels
+//!
+//! The kernels in simd.h are selected at compile time, so a binary built for
+//! plain x86-64 never uses avx. The kernels here are compiled once for each
+//! instruction set with target attributes, and the widest one that the cpu
+//! supports is picked through a table of function pointers on first use.
+//!
+//! The selection can be overridden with the environment variable MATMATH_ISA
+//! (scalar, sse2, avx2 or avx512), or with instructionSet(). Instruction sets
+//! that the cpu does not support are lowered to the best supported one.
+
+#pragma once
+
+#include "matmath/export.h"
+
+#ifndef matmath_use_modules
+
+#include "simd.h"
+#include "simdmath.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+#endif
+
+// Only for x86-64, where sse2 is always available
+#if !defined(matmath_no_simd) && (defined(__x86_64__) || defined(_M_X64))
+#define matmath_dispatch_x86
+#if defined(_MSC_VER) && !defined(__clang__)
+#if !defined(matmath_use_modules)
+#include <intrin.h>
+#endif
+// msvc allows all intrinsics in every function
+#define matmath_target(isa)
+#define matmath_flatten
+#else
+#if !defined(matmath_use_modules)
+#include <cpuid.h>
+#endif
+#define matmath_target(isa) __attribute__((target(isa)))
+#define matmath_flatten __attribute__((flatten))
+#endif
+#endif
+
+namespace matmath {
+namespace simd {
+
+matmath_export enum class InstructionSet {
+    Scalar,
+    Sse2,
+    Avx2,   //!< avx2 and fma
+    Avx512, //!< avx512f
+};
+
+matmath_export inline const char *name(InstructionSet set) noexcept {
+    switch (set) {
+    case InstructionSet::Scalar:
+        return "scalar";
+    case InstructionSet::Sse2:
+        return "sse2";
+    case InstructionSet::Avx2:
+        return "avx2";
+    case InstructionSet::Avx512:
+        return "avx512";
+    }
+    return "unknown";
+}
+
+//! Parse the names returned by name(). Returns false if the name is unknown
+matmath_export inline bool parseInstructionSet(const char *str,
+                                               InstructionSet &set) noexcept {
+    if (!str) {
+        return false;
+    }
+    for (int i = 0; i <= static_cast<int>(InstructionSet::Avx512); ++i) {
+        if (std::strcmp(str, name(static_cast<InstructionSet>(i))) == 0) {
+            set = static_cast<InstructionSet>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+//! Instruction sets supported by both the cpu and the operating system
+matmath_export struct CpuFeatures {
+    bool sse2 = false;
+    bool avx = false;
+    bool avx2 = false;
+    bool fma = false;
+    bool avx512f = false;
+
+    static CpuFeatures detect() noexcept {
+        auto features = CpuFeatures{};
+#if defined(matmath_dispatch_x86)
+        unsigned leaf1[4] = {}, leaf7[4] = {};
+        const auto maxLeaf = cpuid(0, 0, leaf1);
+        cpuid(1, 0, leaf1);
+        if (maxLeaf >= 7) {
+            cpuid(7, 0, leaf7);
+        }
+        const auto edx1 = leaf1[3], ecx1 = leaf1[2], ebx7 = leaf7[1];
+
+        features.sse2 = edx1 & (1u << 26);
+
+        // The registers are only usable if the os saves them on context
+        // switches, which is reported in xcr0
+        const auto osxsave = (ecx1 & (1u << 27)) != 0;
+        const auto xcr0 = osxsave ? xgetbv() : 0;
+        const auto ymm = (xcr0 & 0x6) == 0x6;
+        const auto zmm = (xcr0 & 0xe6) == 0xe6;
+
+        features.avx = ymm && (ecx1 & (1u << 28));
+        features.fma = features.avx && (ecx1 & (1u << 12));
+        features.avx2 = features.avx && (ebx7 & (1u << 5));
+        features.avx512f = zmm && (ebx7 & (1u << 16));
+#endif
+        return features;
+    }
+
+    //! The widest instruction set with kernels that can be used
+    InstructionSet best() const noexcept {
+#if defined(matmath_dispatch_x86)
+        if (avx512f) {
+            return InstructionSet::Avx512;
+        }
+        if (avx2 && fma) {
+            return InstructionSet::Avx2;
+        }
+        if (sse2) {
+            return InstructionSet::Sse2;
+        }
+#endif
+        return InstructionSet::Scalar;
+    }
+
+private:
+#if defined(matmath_dispatch_x86)
+    //! Returns eax, the registers are stored as eax, ebx, ecx, edx
+    static unsigned cpuid(unsigned leaf,
+                          unsigned subleaf,
+                          unsigned (&regs)[4]) noexcept {
+#if defined(_MSC_VER) && !defined(__clang__)
+        int r[4];
+        __cpuidex(r, static_cast<int>(leaf), static_cast<int>(subleaf));
+        for (int i = 0; i < 4; ++i) {
+            regs[i] = static_cast<unsigned>(r[i]);
+        }
+#else
+        __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+        return regs[0];
+    }
+
+    static unsigned long long xgetbv() noexcept {
+#if defined(_MSC_VER) && !defined(__clang__)
+        return _xgetbv(0);
+#else
+        unsigned eax, edx;
+        __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+    }
+#endif
+};
+
+//! Detected once and cached
+matmath_export inline const CpuFeatures &cpuFeatures() noexcept {
+    static const auto features = CpuFeatures::detect();
+    return features;
+}
+
+//! Batch kernels for one instruction set. All arrays are interleaved in the
+//! same layout as Matrixf, Vecf and Quaternionf, see simd.h
+matmath_export struct Kernels {
+    InstructionSet instructionSet;
+
+    //! out[i] = a[i] * b[i] for count 4x4 matrices, out may alias a or b
+    void (*multiply)(const float *a, const float *b, float *out, size_t count);
+
+    //! m * in[i] for count xyz values, in and out may be the same array
+    void (*transform3)(const float *m,
+                       const float *in,
+                       float *out,
+                       size_t count,
+                       TransformMode mode);
+
+    //! Rotate count xyz values with the quaternion q stored as (w, x, y, z)
+    void (*rotate3)(const float *q, const float *in, float *out, size_t count);
+
+    //! sin and cos of count angles, see simdmath.h
+    void (*sincos)(const float *angles, float *sin, float *cos, size_t count);
+};
+
+namespace dispatch {
+
+//! Process the full blocks with P and the rest one value at a time
+template <class P, class F>
+void forEach(size_t count, F &&f) {
+    size_t i = 0;
+    for (; i + P::size <= count; i += P::size) {
+        f(P{}, i);
+    }
+    for (; i < count; ++i) {
+        f(Pack<float, 1>{}, i);
+    }
+}
+
+//! The kernels written once for all packs, the instruction set specific
+//! versions are instantiated in functions with the matching target
+template <class P>
+struct Generic {
+    static void transform3(const float *m,
+                           const float *in,
+                           float *out,
+                           size_t count,
+                           TransformMode mode) noexcept {
+        const auto done = simd::transform3<float, P>(m, in, out, count, mode);
+        simd::transform3<float, Pack<float, 1>>(
+            m, in + done * 3, out + done * 3, count - done, mode);
+    }
+
+    static void rotate3(const float *q,
+                        const float *in,
+                        float *out,
+                        size_t count) noexcept {
+        const auto done = simd::rotate3<float, P>(q, in, out, count);
+        simd::rotate3<float, Pack<float, 1>>(
+            q, in + done * 3, out + done * 3, count - done);
+    }
+
+    static void sincos(const float *angles,
+                       float *sin,
+                       float *cos,
+                       size_t count) noexcept {
+        forEach<P>(count, [&](auto p, size_t i) {
+            using PP = decltype(p);
+            PP s, c;
+            detail::sincosAnyAngle<float>(PP::load(angles + i), s, c);
+            s.store(sin + i);
+            c.store(cos + i);
+        });
+    }
+};
+
+inline void multiplyScalar(const float *a,
+                           const float *b,
+                           float *out,
+                           size_t count) noexcept {
+    for (size_t i = 0; i < count; ++i, a += 16, b += 16, out += 16) {
+        float result[16];
+        for (int y = 0; y < 4; ++y) {
+            for (int x = 0; x < 4; ++x) {
+                auto sum = a[x] * b[y * 4];
+                for (int k = 1; k < 4; ++k) {
+                    sum += a[x + 4 * k] * b[k + 4 * y];
+                }
+                result[x + 4 * y] = sum;
+            }
+        }
+        for (int k = 0; k < 16; ++k) {
+            out[k] = result[k];
+        }
+    }
+}
+
+inline const Kernels &scalarKernels() noexcept {
+    using G = Generic<Pack<float, 1>>;
+    static constexpr auto kernels = Kernels{
+        InstructionSet::Scalar,
+        multiplyScalar,
+        G::transform3,
+        G::rotate3,
+        G::sincos,
+    };
+    return kernels;
+}
+
+#if defined(matmath_dispatch_x86)
+
+//! The header kernels compiled for the baseline target, which are sse2 on
+//! x86-64 unless the translation unit enables more
+struct Sse2 {
+    static constexpr auto set = InstructionSet::Sse2;
+    using G = Generic<Pack<float, 4>>;
+
+    matmath_flatten static void multiply(const float *a,
+                                         const float *b,
+                                         float *out,
+                                         size_t count) noexcept {
+        for (size_t i = 0; i < count; ++i) {
+            multiply4x4(a + i * 16, b + i * 16, out + i * 16);
+        }
+    }
+
+    matmath_flatten static void transform3(const float *m,
+                                           const float *in,
+                                           float *out,
+                                           size_t count,
+                                           TransformMode mode) noexcept {
+        G::transform3(m, in, out, count, mode);
+    }
+
+    matmath_flatten static void rotate3(const float *q,
+                                        const float *in,
+                                        float *out,
+                                        size_t count) noexcept {
+        G::rotate3(q, in, out, count);
+    }
+
+    matmath_flatten static void sincos(const float *angles,
+                                       float *sin,
+                                       float *cos,
+                                       size_t count) noexcept {
+        G::sincos(angles, sin, cos, count);
+    }
+};
+
+//! Eight floats for functions compiled for avx2 and fma. The values are kept
+//! in an array instead of a __m256, since the shared kernels that they are
+//! passed through are not compiled for the target and would disagree on how
+//! to pass vector registers when they are not inlined (as in debug builds).
+//! When everything is inlined the values stay in registers.
+//! load3 and store3 works on two 128 bit halves like Pack<float, 8>
+struct Avx2Pack {
+    static constexpr int size = 8;
+    float v[8];
+
+    matmath_target("avx2,fma") static Avx2Pack make(__m256 r) noexcept {
+        Avx2Pack p;
+        _mm256_storeu_ps(p.v, r);
+        return p;
+    }
+
+    matmath_target("avx2,fma") __m256 get() const noexcept {
+        return _mm256_loadu_ps(v);
+    }
+
+    matmath_target("avx2,fma") static Avx2Pack load(const float *p) noexcept {
+        return make(_mm256_loadu_ps(p));
+    }
+
+    matmath_target("avx2,fma") static Avx2Pack broadcast(float f) noexcept {
+        return make(_mm256_set1_ps(f));
+    }
+
+    matmath_target("avx2,fma") void store(float *p) const noexcept {
+        _mm256_storeu_ps(p, get());
+    }
+
+    matmath_target("avx2,fma") static void load3(const float *p,
+                                                 Avx2Pack &x,
+                                                 Avx2Pack &y,
+                                                 Avx2Pack &z) noexcept {
+        const auto a = halves(p, p + 12), b = halves(p + 4, p + 16),
+                   c = halves(p + 8, p + 20);
+        x = make(combine(pick<0, 3>(a, a), pick<2, 1>(b, c)));
+        y = make(combine(pick<1, 0>(a, b), pick<3, 2>(b, c)));
+        z = make(combine(pick<2, 1>(a, b), pick<0, 3>(c, c)));
+    }
+
+    matmath_target("avx2,fma") static void store3(float *p,
+                                                  Avx2Pack x,
+                                                  Avx2Pack y,
+                                                  Avx2Pack z) noexcept {
+        const auto vx = x.get(), vy = y.get(), vz = z.get();
+        const __m256 r[] = {
+            combine(pick<0, 0>(vx, vy), pick<0, 1>(vz, vx)),
+            combine(pick<1, 1>(vy, vz), pick<2, 2>(vx, vy)),
+            combine(pick<2, 3>(vz, vx), pick<3, 3>(vy, vz)),
+        };
+        for (int i = 0; i < 3; ++i) {
+            _mm_storeu_ps(p + i * 4, _mm256_castps256_ps128(r[i]));
+            _mm_storeu_ps(p + 12 + i * 4, _mm256_extractf128_ps(r[i], 1));
+        }
+    }
+
+    matmath_target("avx2,fma") friend Avx2Pack operator+(Avx2Pack a,
+                                                         Avx2Pack b) noexcept {
+        return make(_mm256_add_ps(a.get(), b.get()));
+    }
+
+    matmath_target("avx2,fma") friend Avx2Pack operator-(Avx2Pack a,
+                                                         Avx2Pack b) noexcept {
+        return make(_mm256_sub_ps(a.get(), b.get()));
+    }
+
+    matmath_target("avx2,fma") friend Avx2Pack operator*(Avx2Pack a,
+                                                         Avx2Pack b) noexcept {
+        return make(_mm256_mul_ps(a.get(), b.get()));
+    }
+
+    matmath_target("avx2,fma") friend Avx2Pack madd(Avx2Pack a,
+                                                    Avx2Pack b,
+                                                    Avx2Pack c) noexcept {
+        return make(_mm256_fmadd_ps(a.get(), b.get(), c.get()));
+    }
+
+    matmath_target("avx2,fma") friend Avx2Pack operator<(Avx2Pack a,
+                                                         Avx2Pack b) noexcept {
+        return make(_mm256_cmp_ps(a.get(), b.get(), _CMP_LT_OQ));
+    }
+
+    matmath_target("avx2,fma") friend Avx2Pack select(Avx2Pack mask,
+                                                      Avx2Pack a,
+                                                      Avx2Pack b) noexcept {
+        return make(_mm256_blendv_ps(b.get(), a.get(), mask.get()));
+    }
+
+private:
+    template <int i, int j>
+    matmath_target("avx2,fma") static __m256 pick(__m256 a,
+                                                  __m256 b) noexcept {
+        return _mm256_shuffle_ps(a, b, _MM_SHUFFLE(j, j, i, i));
+    }
+
+    matmath_target("avx2,fma") static __m256 combine(__m256 a,
+                                                     __m256 b) noexcept {
+        return _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+    }
+
+    matmath_target("avx2,fma") static __m256 halves(const float *low,
+                                                    const float *high) {
+        return _mm256_insertf128_ps(
+            _mm256_castps128_ps256(_mm_loadu_ps(low)), _mm_loadu_ps(high), 1);
+    }
+};
+
+struct Avx2 {
+    static constexpr auto set = InstructionSet::Avx2;
+    using G = Generic<Avx2Pack>;
+
+    //! Two rows of the result per register, the weights from b are
+    //! broadcast within each 128 bit half
+    matmath_target("avx2,fma") matmath_flatten static void multiply(
+        const float *a, const float *b, float *out, size_t count) noexcept {
+        for (size_t i = 0; i < count; ++i, a += 16, b += 16, out += 16) {
+            const auto a0 = _mm256_broadcast_ps(
+                reinterpret_cast<const __m128 *>(a));
+            const auto a1 = _mm256_broadcast_ps(
+                reinterpret_cast<const __m128 *>(a + 4));
+            const auto a2 = _mm256_broadcast_ps(
+                reinterpret_cast<const __m128 *>(a + 8));
+            const auto a3 = _mm256_broadcast_ps(
+                reinterpret_cast<const __m128 *>(a + 12));
+            const __m256 rows[] = {_mm256_loadu_ps(b), _mm256_loadu_ps(b + 8)};
+
+            for (int j = 0; j < 2; ++j) {
+                const auto w = rows[j];
+                auto sum = _mm256_mul_ps(a0, _mm256_permute_ps(w, 0x00));
+                sum = _mm256_fmadd_ps(a1, _mm256_permute_ps(w, 0x55), sum);
+                sum = _mm256_fmadd_ps(a2, _mm256_permute_ps(w, 0xaa), sum);
+                sum = _mm256_fmadd_ps(a3, _mm256_permute_ps(w, 0xff), sum);
+                _mm256_storeu_ps(out + j * 8, sum);
+            }
+        }
+    }
+
+    matmath_target("avx2,fma") matmath_flatten static void transform3(
+        const float *m,
+        const float *in,
+        float *out,
+        size_t count,
+        TransformMode mode) noexcept {
+        G::transform3(m, in, out, count, mode);
+    }
+
+    matmath_target("avx2,fma") matmath_flatten static void rotate3(
+        const float *q, const float *in, float *out, size_t count) noexcept {
+        G::rotate3(q, in, out, count);
+    }
+
+    matmath_target("avx2,fma") matmath_flatten static void sincos(
+        const float *angles, float *sin, float *cos, size_t count) noexcept {
+        G::sincos(angles, sin, cos, count);
+    }
+};
+
+//! Comparison result of Avx512Pack
+struct Avx512Mask {
+    __mmask16 m;
+};
+
+//! Sixteen floats for functions compiled for avx512f, stored the same way as
+//! Avx2Pack. load3 and store3 works on four 128 bit quarters, with the same
+//! shuffles as Avx2Pack
+struct Avx512Pack {
+    static constexpr int size = 16;
+    float v[16];
+
+    matmath_target("avx512f") static Avx512Pack make(__m512 r) noexcept {
+        Avx512Pack p;
+        _mm512_storeu_ps(p.v, r);
+        return p;
+    }
+
+    matmath_target("avx512f") __m512 get() const noexcept {
+        return _mm512_loadu_ps(v);
+    }
+
+    matmath_target("avx512f") static Avx512Pack load(const float *p) noexcept {
+        return make(_mm512_loadu_ps(p));
+    }
+
+    matmath_target("avx512f") static Avx512Pack broadcast(float f) noexcept {
+        return make(_mm512_set1_ps(f));
+    }
+
+    matmath_target("avx512f") void store(float *p) const noexcept {
+        _mm512_storeu_ps(p, get());
+    }
+
+    matmath_target("avx512f") static void load3(const float *p,
+                                                Avx512Pack &x,
+                                                Avx512Pack &y,
+                                                Avx512Pack &z) noexcept {
+        const auto a = quarters(p), b = quarters(p + 4),
+                   c = quarters(p + 8);
+        x = make(combine(pick<0, 3>(a, a), pick<2, 1>(b, c)));
+        y = make(combine(pick<1, 0>(a, b), pick<3, 2>(b, c)));
+        z = make(combine(pick<2, 1>(a, b), pick<0, 3>(c, c)));
+    }
+
+    matmath_target("avx512f") static void store3(float *p,
+                                                 Avx512Pack x,
+                                                 Avx512Pack y,
+                                                 Avx512Pack z) noexcept {
+        const auto vx = x.get(), vy = y.get(), vz = z.get();
+        const __m512 r[] = {
+            combine(pick<0, 0>(vx, vy), pick<0, 1>(vz, vx)),
+            combine(pick<1, 1>(vy, vz), pick<2, 2>(vx, vy)),
+            combine(pick<2, 3>(vz, vx), pick<3, 3>(vy, vz)),
+        };
+        for (int i = 0; i < 3; ++i) {
+            _mm_storeu_ps(p + i * 4, quarter<0>(r[i]));
+            _mm_storeu_ps(p + 12 + i * 4, quarter<1>(r[i]));
+            _mm_storeu_ps(p + 24 + i * 4, quarter<2>(r[i]));
+            _mm_storeu_ps(p + 36 + i * 4, quarter<3>(r[i]));
+        }
+    }
+
+    matmath_target("avx512f") friend Avx512Pack
+        operator+(Avx512Pack a, Avx512Pack b) noexcept {
+        return make(_mm512_add_ps(a.get(), b.get()));
+    }
+
+    matmath_target("avx512f") friend Avx512Pack
+        operator-(Avx512Pack a, Avx512Pack b) noexcept {
+        return make(_mm512_sub_ps(a.get(), b.get()));
+    }
+
+    matmath_target("avx512f") friend Avx512Pack
+        operator*(Avx512Pack a, Avx512Pack b) noexcept {
+        return make(_mm512_mul_ps(a.get(), b.get()));
+    }
+
+    matmath_target("avx512f") friend Avx512Pack
+        madd(Avx512Pack a, Avx512Pack b, Avx512Pack c) noexcept {
+        return make(_mm512_fmadd_ps(a.get(), b.get(), c.get()));
+    }
+
+    matmath_target("avx512f") friend Avx512Mask
+        operator<(Avx512Pack a, Avx512Pack b) noexcept {
+        return {_mm512_cmp_ps_mask(a.get(), b.get(), _CMP_LT_OQ)};
+    }
+
+    matmath_target("avx512f") friend Avx512Pack
+        select(Avx512Mask mask, Avx512Pack a, Avx512Pack b) noexcept {
+        return make(_mm512_mask_blend_ps(mask.m, b.get(), a.get()));
+    }
+
+    //! The 128 bit quarter i in all four quarters
+    template <int i>
+    matmath_target("avx512f") static __m512 broadcastQuarter(
+        __m512 a) noexcept {
+        return _mm512_mask_shuffle_f32x4(
+            a, 0xffff, a, a, _MM_SHUFFLE(i, i, i, i));
+    }
+
+private:
+    template <int i, int j>
+    matmath_target("avx512f") static __m512 pick(__m512 a,
+                                                 __m512 b) noexcept {
+        return _mm512_shuffle_ps(a, b, _MM_SHUFFLE(j, j, i, i));
+    }
+
+    matmath_target("avx512f") static __m512 combine(__m512 a,
+                                                    __m512 b) noexcept {
+        return _mm512_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+    }
+
+    //! The masked version is used since the plain extract (and cast) gives
+    //! false maybe-uninitialized warnings with some versions of gcc
+    template <int i>
+    matmath_target("avx512f") static __m128 quarter(__m512 a) noexcept {
+        return _mm512_maskz_extractf32x4_ps(0xf, a, i);
+    }
+
+    //! Four values from each group of 12, p[0..3], p[12..15] and so on
+    matmath_target("avx512f") static __m512 quarters(const float *p) {
+        auto r = _mm512_castps128_ps512(_mm_loadu_ps(p));
+        r = _mm512_insertf32x4(r, _mm_loadu_ps(p + 12), 1);
+        r = _mm512_insertf32x4(r, _mm_loadu_ps(p + 24), 2);
+        return _mm512_insertf32x4(r, _mm_loadu_ps(p + 36), 3);
+    }
+};
+
+struct Avx512 {
+    static constexpr auto set = InstructionSet::Avx512;
+    using G = Generic<Avx512Pack>;
+
+    //! All four rows of the result in one register
+    matmath_target("avx512f") matmath_flatten static void multiply(
+        const float *a, const float *b, float *out, size_t count) noexcept {
+        for (size_t i = 0; i < count; ++i, a += 16, b += 16, out += 16) {
+            const auto rows = _mm512_loadu_ps(a);
+            const auto a0 = Avx512Pack::broadcastQuarter<0>(rows);
+            const auto a1 = Avx512Pack::broadcastQuarter<1>(rows);
+            const auto a2 = Avx512Pack::broadcastQuarter<2>(rows);
+            const auto a3 = Avx512Pack::broadcastQuarter<3>(rows);
+            const auto w = _mm512_loadu_ps(b);
+
+            auto sum = _mm512_mul_ps(a0, _mm512_shuffle_ps(w, w, 0x00));
+            sum = _mm512_fmadd_ps(a1, _mm512_shuffle_ps(w, w, 0x55), sum);
+            sum = _mm512_fmadd_ps(a2, _mm512_shuffle_ps(w, w, 0xaa), sum);
+            sum = _mm512_fmadd_ps(a3, _mm512_shuffle_ps(w, w, 0xff), sum);
+            _mm512_storeu_ps(out, sum);
+        }
+    }
+
+    matmath_target("avx512f") matmath_flatten static void transform3(
+        const float *m,
+        const float *in,
+        float *out,
+        size_t count,
+        TransformMode mode) noexcept {
+        G::transform3(m, in, out, count, mode);
+    }
+
+    matmath_target("avx512f") matmath_flatten static void rotate3(
+        const float *q, const float *in, float *out, size_t count) noexcept {
+        G::rotate3(q, in, out, count);
+    }
+
+    matmath_target("avx512f") matmath_flatten static void sincos(
+        const float *angles, float *sin, float *cos, size_t count) noexcept {
+        G::sincos(angles, sin, cos, count);
+    }
+};
+
+template <class K>
+const Kernels &kernelsFor() noexcept {
+    static constexpr auto kernels = Kernels{
+        K::set,
+        K::multiply,
+        K::transform3,
+        K::rotate3,
+        K::sincos,
+    };
+    return kernels;
+}
+
+#endif
+
+//! The kernels of set, or of the best supported set below it
+inline const Kernels &lookup(InstructionSet set) noexcept {
+    const auto best = cpuFeatures().best();
+    if (best < set) {
+        set = best;
+    }
+#if defined(matmath_dispatch_x86)
+    switch (set) {
+    case InstructionSet::Avx512:
+        return kernelsFor<Avx512>();
+    case InstructionSet::Avx2:
+        return kernelsFor<Avx2>();
+    case InstructionSet::Sse2:
+        return kernelsFor<Sse2>();
+    case InstructionSet::Scalar:
+        break;
+    }
+#endif
+    return scalarKernels();
+}
+
+inline std::atomic<const Kernels *> &current() noexcept {
+    static auto kernels = [] {
+        auto set = cpuFeatures().best();
+        auto requested = set;
+        if (parseInstructionSet(std::getenv("MATMATH_ISA"), requested)) {
+            set = requested;
+        }
+        return std::atomic<const Kernels *>{&lookup(set)};
+    }();
+    return kernels;
+}
+
+} // namespace dispatch
+
+//! Kernels for set, or for the best supported set if the cpu does not
+//! support set
+matmath_export inline const Kernels &kernels(InstructionSet set) noexcept {
+    return dispatch::lookup(set);
+}
+
+//! The kernels selected on first use or by the last call to
+//! instructionSet(set)
+matmath_export inline const Kernels &kernels() noexcept {
+    return *dispatch::current().load(std::memory_order_acquire);
+}
+
+matmath_export inline InstructionSet instructionSet() noexcept {
+    return kernels().instructionSet;
+}
+
+//! Change the kernels used by kernels() for all threads
+matmath_export inline void instructionSet(InstructionSet set) noexcept {
+    dispatch::current().store(&dispatch::lookup(set),
+                              std::memory_order_release);
+}
+
+} // namespace simd
+} // namespace matmath
@@ -0,0 +1,264 @@
+//! Copyright © Mattias Larsson Sköld 2020
+//! Distributed under terms specified under licence.txt
+
+#pragma once
+
+#include "matmath/export.h"
+
+#ifndef matmath_use_modules
+
+#include "matrix.h"
+#include "quaternion.h"
+#include "simd.h"
+#include "vec.h"
+#include <cstddef>
+#if __cplusplus >= 202002L
+#include <span>
+#endif
+
+#endif
+
+//! Rigid transform (rotation followed by translation) stored as a dual
+//! quaternion real + e dual, which is 8 values instead of the 16 of a Matrix.
+//!
+//! real is the rotation with the same meaning as in QuaternionT, so
+//! transformPoint(p) = real.rotate(p) + translation(). As for QuaternionT the
+//! product a * b is the transform that applies a first and then b, that is
+//! Matrix<T>(a * b) == Matrix<T>(b) * Matrix<T>(a)
+matmath_export template <typename T>
+struct DualQuaternion {
+    QuaternionT<T> real = {1, 0, 0, 0};
+    QuaternionT<T> dual = {0, 0, 0, 0};
+
+    constexpr DualQuaternion() = default;
+
+    constexpr DualQuaternion(const QuaternionT<T> &real,
+                             const QuaternionT<T> &dual)
+        : real(real), dual(dual) {}
+
+    //! Rotate with rotation and then translate with translation
+    constexpr DualQuaternion(const QuaternionT<T> &rotation,
+                             const VecT<T> &translation)
+        : real(rotation),
+          dual(rotation *
+               QuaternionT<T>{0, translation.x, translation.y, translation.z} *
+               T(-.5)) {}
+
+    //! Create from a matrix with only rotation and translation, for example
+    //! the matrices that can be inverted with Matrix::inverseNormalized
+    constexpr explicit DualQuaternion(const Matrix<T> &matrix)
+        : DualQuaternion(QuaternionT<T>{matrix},
+                         VecT<T>{matrix.x4, matrix.y4, matrix.z4}) {}
+
+    template <typename U>
+    constexpr explicit DualQuaternion(const DualQuaternion<U> &dq)
+        : real(dq.real), dual(dq.dual) {}
+
+    static constexpr DualQuaternion Translation(const VecT<T> &translation) {
+        return {QuaternionT<T>{}, translation};
+    }
+
+    constexpr operator Matrix<T>() const {
+        auto ret = Matrix<T>(real);
+        const auto t = translation();
+        ret.x4 = t.x;
+        ret.y4 = t.y;
+        ret.z4 = t.z;
+        return ret;
+    }
+
+    constexpr const QuaternionT<T> &rotation() const {
+        return real;
+    }
+
+    //! t = -2 vec(real' dual) where real' is the conjugate
+    constexpr VecT<T> translation() const {
+        const auto v = VecT<T>{real.x, real.y, real.z};
+        const auto d = VecT<T>{dual.x, dual.y, dual.z};
+        return (v * dual.w - d * real.w + v.cross(d)) * 2;
+    }
+
+    constexpr VecT<T> transformPoint(const VecT<T> &p) const {
+        return real.rotate(p) + translation();
+    }
+
+    constexpr VecT<T> transformDirection(const VecT<T> &v) const {
+        return real.rotate(v);
+    }
+
+    //! The transform that applies this first and then dq
+    constexpr DualQuaternion operator*(const DualQuaternion &dq) const {
+        return {real * dq.real, real * dq.dual + dual * dq.real};
+    }
+
+    constexpr DualQuaternion &operator*=(const DualQuaternion &dq) {
+        return *this = *this * dq;
+    }
+
+    constexpr DualQuaternion operator*(T value) const {
+        return {real * value, dual * value};
+    }
+
+    constexpr DualQuaternion operator+(const DualQuaternion &dq) const {
+        return {real + dq.real, dual + dq.dual};
+    }
+
+    //! Inverse of a normalized dual quaternion, the equivalent of
+    //! Matrix::inverseNormalized
+    constexpr DualQuaternion inverse() const {
+        return {real.conjugate(), dual.conjugate()};
+    }
+
+    //! Scale so that real has unit length and make dual orthogonal to real,
+    //! which makes it a rigid transform again after for example blending
+    constexpr DualQuaternion &normalize() {
+        const auto scale = 1 / real.abs();
+        real *= scale;
+        dual *= scale;
+        dual = dual - real * real.dot(dual);
+        return *this;
+    }
+
+    constexpr DualQuaternion normalized() const {
+        auto ret = *this;
+        return ret.normalize();
+    }
+
+    //! Dual quaternion linear blending (DLB) of count transforms, with the
+    //! signs chosen so that all rotations are blended along the shortest path
+    //! to the first one
+    static constexpr DualQuaternion blend(const DualQuaternion *transforms,
+                                          const T *weights,
+                                          size_t count) {
+        auto sum = DualQuaternion{{0, 0, 0, 0}, {0, 0, 0, 0}};
+        for (size_t i = 0; i < count; ++i) {
+            const auto &dq = transforms[i];
+            const auto weight =
+                dq.real.dot(transforms[0].real) < 0 ? -weights[i] : weights[i];
+            sum = sum + dq * weight;
+        }
+        return sum.normalize();
+    }
+
+    //! Skin count vertices with dual quaternion linear blending. Vertex i is
+    //! transformed by the blend of palette[joints[i * 4 + k]] with the weights
+    //! weights[i * 4 + k] for k = 0..3. Unused influences should have weight
+    //! 0 and a valid joint index. in and out may be the same array. With
+    //! TransformMode::Direction only the rotation is applied, for normals
+    template <typename Index>
+    static void skin(const DualQuaternion *palette,
+                     const Index *joints,
+                     const T *weights,
+                     const VecT<T> *in,
+                     VecT<T> *out,
+                     size_t count,
+                     matmath::simd::TransformMode mode =
+                         matmath::simd::TransformMode::Point) noexcept {
+        static_assert(sizeof(DualQuaternion) == sizeof(T) * 8,
+                      "DualQuaternion is expected to be eight packed values");
+        static_assert(sizeof(VecT<T>) == sizeof(T) * 3,
+                      "VecT is expected to be three tightly packed values");
+        using namespace matmath::simd;
+        const auto pin = reinterpret_cast<const T *>(in);
+        const auto pout = reinterpret_cast<T *>(out);
+        const auto isPoint = mode == TransformMode::Point;
+
+        forEachPack<T>(count, [&](auto p, size_t i) {
+            using P = decltype(p);
+            constexpr auto size = P::size;
+            const auto zero = P::broadcast(0);
+
+            P weight[4];
+            P::load4(
+                weights + i * 4, weight[0], weight[1], weight[2], weight[3]);
+
+            P rw = zero, rx = zero, ry = zero, rz = zero;
+            P dw = zero, dx = zero, dy = zero, dz = zero;
+            P fw = zero, fx = zero, fy = zero, fz = zero;
+            for (size_t k = 0; k < 4; ++k) {
+                // Gather the transforms of the influence to transpose them
+                // with load4, one lane per vertex
+                alignas(sizeof(T) * 4) T gathered[size * 8];
+                for (size_t lane = 0; lane < size; ++lane) {
+                    const auto &dq = palette[joints[(i + lane) * 4 + k]];
+                    for (size_t j = 0; j < 4; ++j) {
+                        gathered[lane * 4 + j] = dq.real.data()[j];
+                        gathered[(size + lane) * 4 + j] = dq.dual.data()[j];
+                    }
+                }
+
+                P qw, qx, qy, qz, ew, ex, ey, ez;
+                P::load4(gathered, qw, qx, qy, qz);
+                P::load4(gathered + size * 4, ew, ex, ey, ez);
+
+                auto w = weight[k];
+                if (k == 0) {
+                    fw = qw, fx = qx, fy = qy, fz = qz;
+                }
+                else {
+                    const auto d =
+                        madd(qw, fw, madd(qx, fx, madd(qy, fy, qz * fz)));
+                    w = select(d < zero, zero - w, w);
+                }
+
+                rw = madd(qw, w, rw), rx = madd(qx, w, rx);
+                ry = madd(qy, w, ry), rz = madd(qz, w, rz);
+                dw = madd(ew, w, dw), dx = madd(ex, w, dx);
+                dy = madd(ey, w, dy), dz = madd(ez, w, dz);
+            }
+
+            const auto scale =
+                rsqrt(madd(rw, rw, madd(rx, rx, madd(ry, ry, rz * rz))));
+            rw = rw * scale, rx = rx * scale, ry = ry * scale, rz = rz * scale;
+
+            P x, y, z;
+            P::load3(pin + i * 3, x, y, z);
+
+            // Rotate as in QuaternionT::rotate, t = 2 (v x q), v + w t + t x q
+            const auto rx2 = rx + rx, ry2 = ry + ry, rz2 = rz + rz;
+            const auto tx = y * rz2 - z * ry2;
+            const auto ty = z * rx2 - x * rz2;
+            const auto tz = x * ry2 - y * rx2;
+            auto ox = madd(rw, tx, x) + (ty * rz - tz * ry);
+            auto oy = madd(rw, ty, y) + (tz * rx - tx * rz);
+            auto oz = madd(rw, tz, z) + (tx * ry - ty * rx);
+
+            if (isPoint) {
+                // The translation as in translation(), the part of dual that
+                // is parallel to real does not affect it so only the scale
+                // needs to be applied
+                const auto two = scale + scale;
+                dw = dw * two, dx = dx * two, dy = dy * two, dz = dz * two;
+                ox = ox + (madd(rx, dw, zero - rw * dx) + (ry * dz - rz * dy));
+                oy = oy + (madd(ry, dw, zero - rw * dy) + (rz * dx - rx * dz));
+                oz = oz + (madd(rz, dw, zero - rw * dz) + (rx * dy - ry * dx));
+            }
+
+            P::store3(pout + i * 3, ox, oy, oz);
+        });
+    }
+
+#if __cplusplus >= 202002L
+    //! joints and weights should have four values for each vertex in in, and
+    //! out should be at least as long as in
+    template <typename Index>
+    static void skin(std::span<const DualQuaternion> palette,
+                     std::span<const Index> joints,
+                     std::span<const T> weights,
+                     std::span<const VecT<T>> in,
+                     std::span<VecT<T>> out,
+                     matmath::simd::TransformMode mode =
+                         matmath::simd::TransformMode::Point) noexcept {
+        skin(palette.data(),
+             joints.data(),
+             weights.data(),
+             in.data(),
+             out.data(),
+             in.size(),
+             mode);
+    }
+#endif
+};
+
+matmath_export using DualQuaternionf = DualQuaternion<float>;
+matmath_export using DualQuaterniond = DualQuaternion<double>;
@@ -0,0 +1,582 @@
+//! Copyright © Mattias Larsson Sköld 2020
+//! Distributed under terms specified under licence.txt
+
+#pragma once
+
+#include "export.h"
+
+#ifndef matmath_use_modules
+
+#include "matrix.h"
+#include "vec.h"
+#include <type_traits>
+#include <utility>
+
+#endif
+
+//! Opt in lazy evaluation of VecT and Matrix arithmetic
+//!
+//! Wrap one operand with lazy() and the operators will build expression
+//! nodes instead of temporary vectors and matrices. The expression is
+//! evaluated when it is converted to VecT or Matrix (or with eval()).
+//!
+//!     using matmath::expr::lazy;
+//!     Vecf v = lazy(a) * s + b - lazy(c).cross(d);
+//!     Matrixf m = lazy(m1) + lazy(m2) * 2.f; // one pass over the values
+//!     Vecf p = lazy(m1) * m2 * m3 * v;   // three matrix vector products
+//!
+//! Element wise operations are evaluated in a single pass. Matrix products
+//! are kept unevaluated until they are needed, so a product chain that ends
+//! with a vector is evaluated from the right as matrix vector products
+//! instead of matrix products.
+//!
+//! Vectors and matrices that are not lvalues are copied into the
+//! expression, but lvalue matrices are only referenced, so do not keep an
+//! expression after the matrices it uses is destroyed.
+namespace matmath {
+namespace expr {
+
+matmath_export template <class Derived>
+struct VecExpression;
+
+matmath_export template <class Derived>
+struct MatrixExpression;
+
+namespace detail {
+
+template <class X>
+struct IsVecT : std::false_type {};
+
+template <class T>
+struct IsVecT<VecT<T>> : std::true_type {};
+
+template <class X>
+struct IsMatrix : std::false_type {};
+
+template <class T>
+struct IsMatrix<Matrix<T>> : std::true_type {};
+
+template <class X>
+constexpr bool isVecExpression =
+    std::is_base_of_v<VecExpression<X>, X>;
+
+template <class X>
+constexpr bool isMatrixExpression =
+    std::is_base_of_v<MatrixExpression<X>, X>;
+
+template <class X>
+constexpr bool isExpression = isVecExpression<std::decay_t<X>> ||
+                              isMatrixExpression<std::decay_t<X>>;
+
+template <class X>
+constexpr bool isVec = isVecExpression<std::decay_t<X>> ||
+                       IsVecT<std::decay_t<X>>::value;
+
+template <class X>
+constexpr bool isMatrix = isMatrixExpression<std::decay_t<X>> ||
+                          IsMatrix<std::decay_t<X>>::value;
+
+template <class X>
+constexpr bool isScalar = std::is_arithmetic_v<std::decay_t<X>>;
+
+template <class X>
+constexpr bool isOperand = isVec<X> || isMatrix<X> || isScalar<X>;
+
+//! True if the operators in this namespace should handle A and B
+template <class A, class B>
+constexpr bool isOperation = (isExpression<A> || isExpression<B>) &&
+                             isOperand<A> && isOperand<B>;
+
+struct Add {
+    template <class T>
+    constexpr static T apply(T a, T b) {
+        return a + b;
+    }
+};
+
+struct Subtract {
+    template <class T>
+    constexpr static T apply(T a, T b) {
+        return a - b;
+    }
+};
+
+struct Multiply {
+    template <class T>
+    constexpr static T apply(T a, T b) {
+        return a * b;
+    }
+};
+
+struct Divide {
+    template <class T>
+    constexpr static T apply(T a, T b) {
+        return a / b;
+    }
+};
+
+//! Homogeneous vector used when matrix products are applied to vectors
+template <class T>
+struct Vec4 {
+    T v[4] = {};
+};
+
+template <class Op, class T>
+constexpr Vec4<T> apply(Vec4<T> a, Vec4<T> b) {
+    return {Op::apply(a.v[0], b.v[0]),
+            Op::apply(a.v[1], b.v[1]),
+            Op::apply(a.v[2], b.v[2]),
+            Op::apply(a.v[3], b.v[3])};
+}
+
+template <class Op, class T>
+constexpr Vec4<T> apply(Vec4<T> a, T t) {
+    return {Op::apply(a.v[0], t),
+            Op::apply(a.v[1], t),
+            Op::apply(a.v[2], t),
+            Op::apply(a.v[3], t)};
+}
+
+template <int i, class T>
+constexpr T component(const VecT<T> &v) {
+    if constexpr (i == 0) {
+        return v.x;
+    }
+    else if constexpr (i == 1) {
+        return v.y;
+    }
+    else {
+        return v.z;
+    }
+}
+
+} // namespace detail
+
+//! Base of all vector nodes. Derived classes has value_type and get<i>()
+//! for the three components
+matmath_export template <class Derived>
+struct VecExpression {
+    constexpr const Derived &self() const {
+        return static_cast<const Derived &>(*this);
+    }
+
+    constexpr auto eval() const {
+        using T = typename Derived::value_type;
+        return VecT<T>{self().template get<0>(),
+                       self().template get<1>(),
+                       self().template get<2>()};
+    }
+
+    template <class T,
+              class D = Derived,
+              class = std::enable_if_t<
+                  std::is_same_v<T, typename D::value_type>>>
+    constexpr operator VecT<T>() const {
+        return eval();
+    }
+
+    constexpr auto abs2() const {
+        const auto v = eval();
+        return v * v;
+    }
+
+    template <class B>
+    constexpr auto cross(B &&b) const;
+};
+
+//! Base of all matrix nodes. Derived classes has value_type, eval() and
+//! apply(Vec4) that multiplies the matrix with a homogeneous vector. Element
+//! wise nodes also has at(i)
+matmath_export template <class Derived>
+struct MatrixExpression {
+    constexpr const Derived &self() const {
+        return static_cast<const Derived &>(*this);
+    }
+
+    template <class T,
+              class D = Derived,
+              class = std::enable_if_t<
+                  std::is_same_v<T, typename D::value_type>>>
+    constexpr operator Matrix<T>() const {
+        return self().eval();
+    }
+};
+
+matmath_export template <class T>
+struct VecValue : VecExpression<VecValue<T>> {
+    using value_type = T;
+
+    VecT<T> v;
+
+    constexpr VecValue(const VecT<T> &v) : v(v) {}
+
+    template <int i>
+    constexpr T get() const {
+        return detail::component<i>(v);
+    }
+};
+
+matmath_export template <class Op, class A, class B>
+struct VecBinary : VecExpression<VecBinary<Op, A, B>> {
+    using value_type = typename A::value_type;
+
+    A a;
+    B b;
+
+    constexpr VecBinary(A a, B b) : a(a), b(b) {}
+
+    template <int i>
+    constexpr value_type get() const {
+        return Op::apply(a.template get<i>(), b.template get<i>());
+    }
+};
+
+matmath_export template <class Op, class A>
+struct VecScalar : VecExpression<VecScalar<Op, A>> {
+    using value_type = typename A::value_type;
+
+    A a;
+    value_type t;
+
+    constexpr VecScalar(A a, value_type t) : a(a), t(t) {}
+
+    template <int i>
+    constexpr value_type get() const {
+        return Op::apply(a.template get<i>(), t);
+    }
+};
+
+//! Each component of the operands is used twice by the cross product, so
+//! the operands are evaluated once when the node is created
+matmath_export template <class T>
+struct VecCross : VecExpression<VecCross<T>> {
+    using value_type = T;
+
+    VecT<T> a, b;
+
+    constexpr VecCross(const VecT<T> &a, const VecT<T> &b) : a(a), b(b) {}
+
+    template <int i>
+    constexpr T get() const {
+        using detail::component;
+        constexpr int j = (i + 1) % 3;
+        constexpr int k = (i + 2) % 3;
+        return component<j>(a) * component<k>(b) -
+               component<k>(a) * component<j>(b);
+    }
+};
+
+//! Leaf that references a matrix
+matmath_export template <class T>
+struct MatrixRef : MatrixExpression<MatrixRef<T>> {
+    using value_type = T;
+
+    const Matrix<T> &m;
+
+    constexpr MatrixRef(const Matrix<T> &m) : m(m) {}
+
+    constexpr T at(int i) const {
+        return m.at(i);
+    }
+
+    constexpr const Matrix<T> &eval() const {
+        return m;
+    }
+
+    constexpr detail::Vec4<T> apply(const detail::Vec4<T> &v) const {
+        detail::Vec4<T> ret;
+        for (int x = 0; x < 4; ++x) {
+            ret.v[x] = m.at(x) * v.v[0] + m.at(x + 4) * v.v[1] +
+                       m.at(x + 8) * v.v[2] + m.at(x + 12) * v.v[3];
+        }
+        return ret;
+    }
+};
+
+//! Leaf that holds a matrix, used for temporaries and evaluated products
+matmath_export template <class T>
+struct MatrixValue : MatrixExpression<MatrixValue<T>> {
+    using value_type = T;
+
+    Matrix<T> m;
+
+    constexpr MatrixValue(const Matrix<T> &m) : m(m) {}
+
+    constexpr T at(int i) const {
+        return m.at(i);
+    }
+
+    constexpr const Matrix<T> &eval() const {
+        return m;
+    }
+
+    constexpr detail::Vec4<T> apply(const detail::Vec4<T> &v) const {
+        return MatrixRef<T>{m}.apply(v);
+    }
+};
+
+matmath_export template <class Op, class A, class B>
+struct MatrixBinary : MatrixExpression<MatrixBinary<Op, A, B>> {
+    using value_type = typename A::value_type;
+
+    A a;
+    B b;
+
+    constexpr MatrixBinary(A a, B b) : a(a), b(b) {}
+
+    constexpr value_type at(int i) const {
+        return Op::apply(a.at(i), b.at(i));
+    }
+
+    constexpr Matrix<value_type> eval() const {
+        Matrix<value_type> ret;
+        for (int i = 0; i < 16; ++i) {
+            ret[i] = at(i);
+        }
+        return ret;
+    }
+
+    //! (a + b) * v = a * v + b * v
+    constexpr detail::Vec4<value_type> apply(
+        const detail::Vec4<value_type> &v) const {
+        return detail::apply<Op>(a.apply(v), b.apply(v));
+    }
+};
+
+matmath_export template <class Op, class A>
+struct MatrixScalar : MatrixExpression<MatrixScalar<Op, A>> {
+    using value_type = typename A::value_type;
+
+    A a;
+    value_type t;
+
+    constexpr MatrixScalar(A a, value_type t) : a(a), t(t) {}
+
+    constexpr value_type at(int i) const {
+        return Op::apply(a.at(i), t);
+    }
+
+    constexpr Matrix<value_type> eval() const {
+        Matrix<value_type> ret;
+        for (int i = 0; i < 16; ++i) {
+            ret[i] = at(i);
+        }
+        return ret;
+    }
+
+    constexpr detail::Vec4<value_type> apply(
+        const detail::Vec4<value_type> &v) const {
+        return detail::apply<Op>(a.apply(v), t);
+    }
+};
+
+//! Unevaluated matrix product
+matmath_export template <class A, class B>
+struct MatrixProduct : MatrixExpression<MatrixProduct<A, B>> {
+    using value_type = typename A::value_type;
+
+    A a;
+    B b;
+
+    constexpr MatrixProduct(A a, B b) : a(a), b(b) {}
+
+    constexpr Matrix<value_type> eval() const {
+        return a.eval() * b.eval();
+    }
+
+    //! (a * b) * v = a * (b * v)
+    constexpr detail::Vec4<value_type> apply(
+        const detail::Vec4<value_type> &v) const {
+        return a.apply(b.apply(v));
+    }
+};
+
+namespace detail {
+
+template <class X>
+struct IsProduct : std::false_type {};
+
+template <class A, class B>
+struct IsProduct<MatrixProduct<A, B>> : std::true_type {};
+
+//! Convert an operand to a vector node
+template <class X>
+constexpr auto vecNode(X &&x) {
+    if constexpr (IsVecT<std::decay_t<X>>::value) {
+        return VecValue<decltype(x.x)>{x};
+    }
+    else {
+        return std::decay_t<X>{x};
+    }
+}
+
+//! Convert an operand to a matrix node
+template <class X>
+constexpr auto matrixNode(X &&x) {
+    using Type = std::decay_t<X>;
+    if constexpr (IsMatrix<Type>::value) {
+        using T = std::decay_t<decltype(x.x1)>;
+        if constexpr (std::is_lvalue_reference_v<X>) {
+            return MatrixRef<T>{x};
+        }
+        else {
+            return MatrixValue<T>{x};
+        }
+    }
+    else {
+        return Type{x};
+    }
+}
+
+//! Products does not have element access, so they are evaluated before
+//! they are used in element wise operations
+template <class X>
+constexpr auto elementNode(X &&x) {
+    auto node = matrixNode(std::forward<X>(x));
+    using Node = decltype(node);
+    if constexpr (IsProduct<Node>::value) {
+        return MatrixValue<typename Node::value_type>{node.eval()};
+    }
+    else {
+        return node;
+    }
+}
+
+template <class Op, class A, class B>
+constexpr auto binary(A &&a, B &&b) {
+    if constexpr (isVec<A> && isVec<B>) {
+        auto na = vecNode(std::forward<A>(a));
+        auto nb = vecNode(std::forward<B>(b));
+        return VecBinary<Op, decltype(na), decltype(nb)>{na, nb};
+    }
+    else {
+        static_assert(isMatrix<A> && isMatrix<B>,
+                      "operands must both be vectors or matrices");
+        auto na = elementNode(std::forward<A>(a));
+        auto nb = elementNode(std::forward<B>(b));
+        return MatrixBinary<Op, decltype(na), decltype(nb)>{na, nb};
+    }
+}
+
+template <class Op, class A, class S>
+constexpr auto scalar(A &&a, S t) {
+    if constexpr (isVec<A>) {
+        auto na = vecNode(std::forward<A>(a));
+        using Node = decltype(na);
+        return VecScalar<Op, Node>{na, typename Node::value_type(t)};
+    }
+    else {
+        auto na = elementNode(std::forward<A>(a));
+        using Node = decltype(na);
+        return MatrixScalar<Op, Node>{na, typename Node::value_type(t)};
+    }
+}
+
+} // namespace detail
+
+template <class Derived>
+template <class B>
+constexpr auto VecExpression<Derived>::cross(B &&b) const {
+    using T = typename Derived::value_type;
+    return VecCross<T>{eval(), detail::vecNode(std::forward<B>(b)).eval()};
+}
+
+//! Start a lazy expression
+matmath_export template <class T>
+constexpr VecValue<T> lazy(const VecT<T> &v) {
+    return {v};
+}
+
+matmath_export template <class T>
+constexpr MatrixRef<T> lazy(const Matrix<T> &m) {
+    return {m};
+}
+
+matmath_export template <class T>
+constexpr MatrixValue<T> lazy(Matrix<T> &&m) {
+    return {m};
+}
+
+//! Evaluate an expression, the same as converting it to VecT or Matrix
+matmath_export template <class Derived>
+constexpr auto eval(const VecExpression<Derived> &e) {
+    return e.eval();
+}
+
+matmath_export template <class Derived>
+constexpr Matrix<typename Derived::value_type> eval(
+    const MatrixExpression<Derived> &e) {
+    return e.self().eval();
+}
+
+matmath_export template <
+    class A,
+    class B,
+    class = std::enable_if_t<detail::isOperation<A, B>>>
+constexpr auto operator+(A &&a, B &&b) {
+    return detail::binary<detail::Add>(std::forward<A>(a),
+                                       std::forward<B>(b));
+}
+
+matmath_export template <
+    class A,
+    class B,
+    class = std::enable_if_t<detail::isOperation<A, B>>>
+constexpr auto operator-(A &&a, B &&b) {
+    return detail::binary<detail::Subtract>(std::forward<A>(a),
+                                            std::forward<B>(b));
+}
+
+//! Scaling, dot product, matrix product and matrix vector product
+//!
+//! A matrix times a vector is a transformed point, like
+//! Matrix::operator*(Vec), and is evaluated directly into a vector node
+matmath_export template <
+    class A,
+    class B,
+    class = std::enable_if_t<detail::isOperation<A, B>>>
+constexpr auto operator*(A &&a, B &&b) {
+    using namespace detail;
+    if constexpr (isScalar<A>) {
+        return scalar<Multiply>(std::forward<B>(b), a);
+    }
+    else if constexpr (isScalar<B>) {
+        return scalar<Multiply>(std::forward<A>(a), b);
+    }
+    else if constexpr (isVec<A> && isVec<B>) {
+        const auto va = vecNode(std::forward<A>(a)).eval();
+        const auto vb = vecNode(std::forward<B>(b)).eval();
+        return va * vb;
+    }
+    else if constexpr (isMatrix<A> && isMatrix<B>) {
+        auto na = matrixNode(std::forward<A>(a));
+        auto nb = matrixNode(std::forward<B>(b));
+        return MatrixProduct<decltype(na), decltype(nb)>{na, nb};
+    }
+    else {
+        static_assert(isMatrix<A> && isVec<B>,
+                      "vectors can only be multiplied from the left by "
+                      "matrices");
+        const auto v = vecNode(std::forward<B>(b)).eval();
+        using T = decltype(v.x);
+        const auto p =
+            matrixNode(std::forward<A>(a)).apply({v.x, v.y, v.z, 1});
+        return VecValue<T>{{p.v[0], p.v[1], p.v[2]}};
+    }
+}
+
+matmath_export template <
+    class A,
+    class S,
+    class = std::enable_if_t<detail::isExpression<A> && detail::isScalar<S>>>
+constexpr auto operator/(A &&a, S t) {
+    return detail::scalar<detail::Divide>(std::forward<A>(a), t);
+}
+
+matmath_export template <class Derived>
+constexpr auto operator-(const VecExpression<Derived> &v) {
+    return detail::scalar<detail::Multiply>(v.self(), -1);
+}
+
+} // namespace expr
+} // namespace matmath
@@ -0,0 +1,291 @@
+//! Copyright © Mattias Larsson Sköld 2020
+//! Distributed under terms specified under licence.txt
+
+#pragma once
+
+#include "matmath/export.h"
+
+#ifndef matmath_use_modules
+
+#include "aabb.h"
+#include "matrix.h"
+#include "simd.h"
+#include "vec.h"
+#include "vecsoa.h"
+#include <cstddef>
+#include <cstdint>
+#if __cplusplus >= 202002L
+#include <span>
+#endif
+
+#endif
+
+//! The depth range of the clip space of a projection matrix
+matmath_export enum class ClipDepth {
+    NegativeOneToOne, //!< OpenGL
+    ZeroToOne,        //!< Direct3D, Vulkan and Metal
+};
+
+//! The six planes of a view frustum, with the normals pointing inwards, used
+//! to test if bounding volumes are visible.
+//!
+//! The batch functions writes one bit per object to visible, with bit i % 32
+//! of visible[i / 32] set for objects that are at least partly inside. The
+//! tests are conservative, objects close to the corners of the frustum can
+//! be reported as visible even if they are outside.
+matmath_export template <typename T>
+struct Frustum {
+    //! Points where normal * p + distance >= 0 are on the inside
+    struct Plane {
+        VecT<T> normal;
+        T distance = 0;
+
+        constexpr T distanceTo(const VecT<T> &p) const {
+            return normal * p + distance;
+        }
+    };
+
+    enum Side { Left, Right, Bottom, Top, Near, Far };
+
+    Plane planes[6] = {};
+
+    //! Extract the planes from a view projection matrix, where the visible
+    //! points p are the ones where m * (p, 1) is inside the clip volume
+    static constexpr Frustum fromMatrix(
+        const Matrix<T> &m, ClipDepth depth = ClipDepth::NegativeOneToOne) {
+        // Rows of the matrix as it is applied to a vector
+        const auto row = [&m](int i) {
+            return Plane{{m(i, 0), m(i, 1), m(i, 2)}, m(i, 3)};
+        };
+        const auto add = [](const Plane &a, const Plane &b, T sign) {
+            return Plane{a.normal + b.normal * sign,
+                         a.distance + b.distance * sign};
+        };
+
+        const auto x = row(0), y = row(1), z = row(2), w = row(3);
+        auto frustum = Frustum{};
+        frustum.planes[Left] = add(w, x, 1);
+        frustum.planes[Right] = add(w, x, -1);
+        frustum.planes[Bottom] = add(w, y, 1);
+        frustum.planes[Top] = add(w, y, -1);
+        frustum.planes[Near] =
+            depth == ClipDepth::ZeroToOne ? z : add(w, z, 1);
+        frustum.planes[Far] = add(w, z, -1);
+
+        for (auto &plane : frustum.planes) {
+            const auto length = plane.normal.abs();
+            plane.normal /= length;
+            plane.distance /= length;
+        }
+        return frustum;
+    }
+
+    constexpr bool contains(const VecT<T> &p) const {
+        for (auto &plane : planes) {
+            if (plane.distanceTo(p) < 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    constexpr bool intersectsSphere(const VecT<T> &center, T radius) const {
+        for (auto &plane : planes) {
+            if (plane.distanceTo(center) < -radius) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    //! Axis aligned box with the corners min and max
+    constexpr bool intersectsBox(const VecT<T> &min,
+                                 const VecT<T> &max) const {
+        const auto center = (min + max) * T(.5);
+        const auto extents = (max - min) * T(.5);
+        for (auto &plane : planes) {
+            // Distance from the center to the corner furthest along the
+            // normal
+            const auto &n = plane.normal;
+            const auto radius = absolute(n.x) * extents.x +
+                                absolute(n.y) * extents.y +
+                                absolute(n.z) * extents.z;
+            if (plane.distanceTo(center) < -radius) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    constexpr bool intersectsBox(const AABB<T> &box) const {
+        return intersectsBox(box.min, box.max);
+    }
+
+    //! Spheres with the centers in separate x, y and z arrays
+    void cullSpheres(const T *x,
+                     const T *y,
+                     const T *z,
+                     const T *radii,
+                     size_t count,
+                     uint32_t *visible) const noexcept {
+        clear(visible, count);
+        matmath::simd::forEachPack<T>(count, [&](auto p, size_t i) {
+            using P = decltype(p);
+            const auto outside = sphereOutside(P::load(x + i),
+                                               P::load(y + i),
+                                               P::load(z + i),
+                                               P::load(radii + i));
+            write(visible, i, P::size, outside);
+        });
+    }
+
+    void cullSpheres(const VecSoA<T> &centers,
+                     const T *radii,
+                     uint32_t *visible) const noexcept {
+        cullSpheres(centers.x.data(),
+                    centers.y.data(),
+                    centers.z.data(),
+                    radii,
+                    centers.size(),
+                    visible);
+    }
+
+    //! Spheres with interleaved centers
+    void cullSpheres(const VecT<T> *centers,
+                     const T *radii,
+                     size_t count,
+                     uint32_t *visible) const noexcept {
+        static_assert(sizeof(VecT<T>) == sizeof(T) * 3,
+                      "VecT must be tightly packed");
+        clear(visible, count);
+        const auto c = reinterpret_cast<const T *>(centers);
+        matmath::simd::forEachPack<T>(count, [&](auto p, size_t i) {
+            using P = decltype(p);
+            P x, y, z;
+            P::load3(c + i * 3, x, y, z);
+            const auto outside = sphereOutside(x, y, z, P::load(radii + i));
+            write(visible, i, P::size, outside);
+        });
+    }
+
+    //! Axis aligned boxes stored as arrays of min and max corners
+    void cullBoxes(const VecT<T> *min,
+                   const VecT<T> *max,
+                   size_t count,
+                   uint32_t *visible) const noexcept {
+        static_assert(sizeof(VecT<T>) == sizeof(T) * 3,
+                      "VecT must be tightly packed");
+        clear(visible, count);
+        const auto lo = reinterpret_cast<const T *>(min);
+        const auto hi = reinterpret_cast<const T *>(max);
+        matmath::simd::forEachPack<T>(count, [&](auto p, size_t i) {
+            using P = decltype(p);
+            P x0, y0, z0, x1, y1, z1;
+            P::load3(lo + i * 3, x0, y0, z0);
+            P::load3(hi + i * 3, x1, y1, z1);
+            const auto half = P::broadcast(T(.5));
+            const auto outside = boxOutside((x0 + x1) * half,
+                                            (y0 + y1) * half,
+                                            (z0 + z1) * half,
+                                            (x1 - x0) * half,
+                                            (y1 - y0) * half,
+                                            (z1 - z0) * half);
+            write(visible, i, P::size, outside);
+        });
+    }
+
+#if __cplusplus >= 202002L
+    //! visible should have at least (count + 31) / 32 values
+    void cullSpheres(std::span<const VecT<T>> centers,
+                     std::span<const T> radii,
+                     std::span<uint32_t> visible) const noexcept {
+        cullSpheres(
+            centers.data(), radii.data(), centers.size(), visible.data());
+    }
+
+    void cullBoxes(std::span<const VecT<T>> min,
+                   std::span<const VecT<T>> max,
+                   std::span<uint32_t> visible) const noexcept {
+        cullBoxes(min.data(), max.data(), min.size(), visible.data());
+    }
+#endif
+
+    //! Number of uint32_t needed for the result of count objects
+    static constexpr size_t maskSize(size_t count) {
+        return (count + 31) / 32;
+    }
+
+    //! Check the result of the batch functions for object i
+    static constexpr bool isVisible(const uint32_t *visible, size_t i) {
+        return (visible[i / 32] >> (i % 32)) & 1;
+    }
+
+private:
+    static constexpr T absolute(T value) {
+        return value < 0 ? -value : value;
+    }
+
+    static void clear(uint32_t *visible, size_t count) noexcept {
+        for (size_t i = 0; i < maskSize(count); ++i) {
+            visible[i] = 0;
+        }
+    }
+
+    //! The native packs are at most 32 values, so a block never crosses
+    //! into the next value of the mask
+    static void write(uint32_t *visible,
+                      size_t i,
+                      int size,
+                      unsigned outside) noexcept {
+        const auto all = size == 32 ? ~0u : (1u << size) - 1;
+        visible[i / 32] |= (~outside & all) << (i % 32);
+    }
+
+    template <class P>
+    unsigned sphereOutside(P x, P y, P z, P radius) const noexcept {
+        // The smallest distance to any plane, plus the radius
+        auto closest = P::broadcast(0);
+        for (int i = 0; i < 6; ++i) {
+            const auto &plane = planes[i];
+            const auto distance =
+                madd(x,
+                     P::broadcast(plane.normal.x),
+                     madd(y,
+                          P::broadcast(plane.normal.y),
+                          madd(z,
+                               P::broadcast(plane.normal.z),
+                               P::broadcast(plane.distance)))) +
+                radius;
+            closest = i ? min(closest, distance) : distance;
+        }
+        return maskBits(closest < P::broadcast(0));
+    }
+
+    template <class P>
+    unsigned boxOutside(P x, P y, P z, P ex, P ey, P ez) const noexcept {
+        auto closest = P::broadcast(0);
+        for (int i = 0; i < 6; ++i) {
+            const auto &n = planes[i].normal;
+            const auto radius =
+                madd(ex,
+                     P::broadcast(absolute(n.x)),
+                     madd(ey,
+                          P::broadcast(absolute(n.y)),
+                          ez * P::broadcast(absolute(n.z))));
+            const auto distance =
+                madd(x,
+                     P::broadcast(n.x),
+                     madd(y,
+                          P::broadcast(n.y),
+                          madd(z,
+                               P::broadcast(n.z),
+                               P::broadcast(planes[i].distance)))) +
+                radius;
+            closest = i ? min(closest, distance) : distance;
+        }
+        return maskBits(closest < P::broadcast(0));
+    }
+};
+
+matmath_export using Frustumf = Frustum<float>;
+matmath_export using Frustumd = Frustum<double>;
@@ -0,0 +1,356 @@
+//! Copyright © Mattias Larsson Sköld 2020
+//! Distributed under terms specified under licence.txt
+
+#pragma once
+
+#include "matmath/export.h"
+
+#ifndef matmath_use_modules
+
+#include "parallel.h"
+#include "vec.h"
+#include "vec2.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#endif
+
+namespace matmath::detail {
+
+//! Access to the coordinates of the point types that KdTree supports
+template <class Vec>
+struct KdPoint;
+
+template <typename T>
+struct KdPoint<VecT<T>> {
+    using Type = T;
+    static constexpr int dimensions = 3;
+
+    static constexpr T get(const VecT<T> &v, int axis) {
+        return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+    }
+};
+
+template <typename T>
+struct KdPoint<Vec2T<T>> {
+    using Type = T;
+    static constexpr int dimensions = 2;
+
+    static constexpr T get(const Vec2T<T> &v, int axis) {
+        return axis == 0 ? v.x : v.y;
+    }
+};
+
+} // namespace matmath::detail
+
+//! k-d tree for nearest neighbour and radius queries over VecT or Vec2T.
+//!
+//! The points are reordered so that the point that splits a range
+//! [begin, end) is at its middle, begin + (end - begin) / 2, with the
+//! points on the lower side before it and the rest after it. The tree is
+//! implicit in that order and only the split axis is stored per point.
+//! Small ranges are not split further and are searched linearly.
+//!
+//! Distances are squared, like abs2(), and the indices returned are the
+//! indices of the points passed to build(). Queries does not allocate
+matmath_export template <class Vec>
+class KdTree {
+public:
+    using T = typename matmath::detail::KdPoint<Vec>::Type;
+    static constexpr int dimensions =
+        matmath::detail::KdPoint<Vec>::dimensions;
+
+    //! Ranges of this size or smaller are searched linearly
+    static constexpr uint32_t bucketSize = 8;
+
+    //! Result of the queries. Like RayHit only points within distance2 are
+    //! accepted, so it can be set to limit the search
+    struct Neighbour {
+        size_t index = 0;
+        //! The squared distance to the point
+        T distance2 = std::numeric_limits<T>::max();
+
+        bool operator<(const Neighbour &other) const {
+            return distance2 < other.distance2;
+        }
+    };
+
+    KdTree() = default;
+
+    KdTree(const Vec *points,
+           size_t count,
+           matmath::ThreadPool &pool = matmath::ThreadPool::global()) {
+        build(points, count, pool);
+    }
+
+    //! Build over count points. The top of the tree is split by the calling
+    //! thread and the subtrees below are built in parallel
+    void build(const Vec *points,
+               size_t count,
+               matmath::ThreadPool &pool = matmath::ThreadPool::global()) {
+        auto entries = std::vector<Entry>(count);
+        for (size_t i = 0; i < count; ++i) {
+            entries[i] = {points[i], static_cast<uint32_t>(i)};
+        }
+        _axes.assign(count, 0);
+
+        auto tasks = std::vector<Range>{};
+        const auto taskSize =
+            pool.size() > 1
+                ? std::max<size_t>(count / (pool.size() * 4), 1024)
+                : count;
+        split(entries, {0, static_cast<uint32_t>(count)}, taskSize, &tasks);
+
+        pool.parallelFor(tasks.size(), 1, [&](size_t begin, size_t end) {
+            for (auto i = begin; i < end; ++i) {
+                split(entries, tasks[i], std::numeric_limits<size_t>::max());
+            }
+        });
+
+        _points.resize(count);
+        _indices.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            _points[i] = entries[i].point;
+            _indices[i] = entries[i].index;
+        }
+    }
+
+    //! Find the closest point. Returns false if there is no point within
+    //! result.distance2
+    bool nearest(const Vec &p, Neighbour &result) const noexcept {
+        auto found = false;
+        search(p, result.distance2, [&](uint32_t i, T distance2) {
+            result = {_indices[i], distance2};
+            found = true;
+            return distance2;
+        });
+        return found;
+    }
+
+    //! Find the k closest points and write them to out sorted by distance,
+    //! closest first. out is used as a bounded heap while searching, so no
+    //! memory is allocated. Returns the number of points found, which is
+    //! less than k if the tree has fewer points
+    size_t kNearest(const Vec &p,
+                    Neighbour *out,
+                    size_t k,
+                    T maxDistance2 = std::numeric_limits<T>::max()) const
+        noexcept {
+        if (!k) {
+            return 0;
+        }
+        size_t count = 0;
+        search(p, maxDistance2, [&](uint32_t i, T distance2) {
+            if (count == k) {
+                std::pop_heap(out, out + count);
+                --count;
+            }
+            out[count++] = {_indices[i], distance2};
+            std::push_heap(out, out + count);
+            // Only points closer than the furthest can change the result
+            return count == k ? out[0].distance2 : maxDistance2;
+        });
+        std::sort_heap(out, out + count);
+        return count;
+    }
+
+    //! Call f(index, distance2) for each point within radius from p, in no
+    //! particular order
+    template <typename F>
+    void radiusSearch(const Vec &p, T radius, F &&f) const {
+        const auto radius2 = radius * radius;
+        search(p, radius2, [&](uint32_t i, T distance2) {
+            f(size_t{_indices[i]}, distance2);
+            return radius2;
+        });
+    }
+
+    //! nearest() for count queries spread over the threads of the pool.
+    //! Queries without a result gets a default Neighbour
+    void nearest(const Vec *queries,
+                 size_t count,
+                 Neighbour *out,
+                 matmath::ThreadPool &pool = matmath::ThreadPool::global())
+        const {
+        pool.parallelFor(
+            count, queryChunk(count, pool), [&](size_t begin, size_t end) {
+                for (auto i = begin; i < end; ++i) {
+                    out[i] = {};
+                    nearest(queries[i], out[i]);
+                }
+            });
+    }
+
+    //! kNearest() for count queries, where the result of query i is written
+    //! to out[i * k] to out[i * k + k - 1]. Results that was not found are
+    //! default constructed Neighbours
+    void kNearest(const Vec *queries,
+                  size_t count,
+                  Neighbour *out,
+                  size_t k,
+                  matmath::ThreadPool &pool = matmath::ThreadPool::global())
+        const {
+        pool.parallelFor(
+            count, queryChunk(count, pool), [&](size_t begin, size_t end) {
+                for (auto i = begin; i < end; ++i) {
+                    const auto result = out + i * k;
+                    const auto found = kNearest(queries[i], result, k);
+                    std::fill(result + found, result + k, Neighbour{});
+                }
+            });
+    }
+
+    size_t size() const {
+        return _points.size();
+    }
+
+    bool empty() const {
+        return _points.empty();
+    }
+
+    //! The points in tree order
+    const std::vector<Vec> &points() const {
+        return _points;
+    }
+
+private:
+    struct Entry {
+        Vec point;
+        uint32_t index;
+    };
+
+    struct Range {
+        uint32_t begin;
+        uint32_t end;
+    };
+
+    //! A range that is left to search, with the squared distance to the
+    //! plane that separates it from the query point
+    struct Pending {
+        Range range;
+        T distance2;
+    };
+
+    //! The depth is at most about log2 of the number of points, which fits
+    //! in 32 bits
+    static constexpr int stackSize = 64;
+
+    static T get(const Vec &v, int axis) {
+        return matmath::detail::KdPoint<Vec>::get(v, axis);
+    }
+
+    static uint32_t middle(const Range &range) {
+        return range.begin + (range.end - range.begin) / 2;
+    }
+
+    static size_t queryChunk(size_t count, matmath::ThreadPool &pool) {
+        // Queries take much longer than writing the result, so the chunks
+        // are only there to balance the load
+        return std::max<size_t>(count / (pool.size() * 16), 16);
+    }
+
+    //! Split the range around the middle point and continue with both
+    //! halves. Ranges smaller than taskSize are saved in tasks instead
+    void split(std::vector<Entry> &entries,
+               Range range,
+               size_t taskSize,
+               std::vector<Range> *tasks = nullptr) {
+        while (range.end - range.begin > bucketSize) {
+            if (tasks && range.end - range.begin <= taskSize) {
+                tasks->push_back(range);
+                return;
+            }
+
+            // Split the axis with the largest extent
+            T min[dimensions], max[dimensions];
+            for (int a = 0; a < dimensions; ++a) {
+                min[a] = max[a] = get(entries[range.begin].point, a);
+            }
+            for (auto i = range.begin + 1; i < range.end; ++i) {
+                for (int a = 0; a < dimensions; ++a) {
+                    const auto value = get(entries[i].point, a);
+                    min[a] = std::min(min[a], value);
+                    max[a] = std::max(max[a], value);
+                }
+            }
+            int axis = 0;
+            for (int a = 1; a < dimensions; ++a) {
+                if (max[a] - min[a] > max[axis] - min[axis]) {
+                    axis = a;
+                }
+            }
+
+            const auto m = middle(range);
+            std::nth_element(entries.begin() + range.begin,
+                             entries.begin() + m,
+                             entries.begin() + range.end,
+                             [axis](const Entry &a, const Entry &b) {
+                                 return get(a.point, axis) <
+                                        get(b.point, axis);
+                             });
+            _axes[m] = static_cast<uint8_t>(axis);
+
+            split(entries, {range.begin, m}, taskSize, tasks);
+            range.begin = m + 1;
+        }
+    }
+
+    //! Visit all points closer than maxDistance2. visit(i, distance2) is
+    //! called with the position of the point in the tree, and returns the
+    //! new max distance
+    template <typename F>
+    void search(const Vec &p, T maxDistance2, F &&visit) const {
+        if (_points.empty()) {
+            return;
+        }
+
+        Pending stack[stackSize];
+        int size = 0;
+        stack[size++] = {{0, static_cast<uint32_t>(_points.size())}, 0};
+        while (size) {
+            const auto pending = stack[--size];
+            if (pending.distance2 > maxDistance2) {
+                continue;
+            }
+
+            auto range = pending.range;
+            while (range.end - range.begin > bucketSize) {
+                const auto m = middle(range);
+                const auto distance2 = (_points[m] - p).abs2();
+                if (distance2 <= maxDistance2) {
+                    maxDistance2 = visit(m, distance2);
+                }
+
+                // Continue on the side of p and save the other side
+                const auto d = get(p, _axes[m]) - get(_points[m], _axes[m]);
+                const auto lower = Range{range.begin, m};
+                const auto upper = Range{m + 1, range.end};
+                if (d * d <= maxDistance2) {
+                    stack[size++] = {d < 0 ? upper : lower, d * d};
+                }
+                range = d < 0 ? lower : upper;
+            }
+
+            for (auto i = range.begin; i < range.end; ++i) {
+                const auto distance2 = (_points[i] - p).abs2();
+                if (distance2 <= maxDistance2) {
+                    maxDistance2 = visit(i, distance2);
+                }
+            }
+        }
+    }
+
+    std::vector<Vec> _points;
+    //! Index of the original point for each point in tree order
+    std::vector<uint32_t> _indices;
+    //! Split axis of the ranges, at the position of the middle point
+    std::vector<uint8_t> _axes;
+};
+
+matmath_export using KdTreef = KdTree<VecT<float>>;
+matmath_export using KdTreed = KdTree<VecT<double>>;
+matmath_export using KdTree2f = KdTree<Vec2T<float>>;
+matmath_export using KdTree2d = KdTree<Vec2T<double>>;
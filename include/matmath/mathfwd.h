@@ -12,8 +12,49 @@ matmath_export using Vec = VecT<double>;
 matmath_export using Vecd = VecT<double>;
 matmath_export using Vecf = VecT<float>;
 
+matmath_export template <typename T>
+class Vec4T;
+
+matmath_export using Vec4 = Vec4T<double>;
+matmath_export using Vec4d = Vec4T<double>;
+matmath_export using Vec4f = Vec4T<float>;
+
 matmath_export template <typename T>
 class Matrix;
 
 matmath_export using Matrixf = Matrix<float>;
 matmath_export using Matrixd = Matrix<double>;
+
+matmath_export template <typename T>
+class AffineMatrix;
+
+matmath_export using AffineMatrixf = AffineMatrix<float>;
+matmath_export using AffineMatrixd = AffineMatrix<double>;
+
+matmath_export template <class T, int R, int C>
+class MatrixN;
+
+matmath_export template <typename T>
+struct QuaternionT;
+
+matmath_export using Quaternion = QuaternionT<float>;
+matmath_export using Quaternionf = QuaternionT<float>;
+matmath_export using Quaterniond = QuaternionT<double>;
+
+matmath_export template <typename T>
+struct DualQuaternion;
+
+matmath_export using DualQuaternionf = DualQuaternion<float>;
+matmath_export using DualQuaterniond = DualQuaternion<double>;
+
+matmath_export template <typename T>
+struct AABB;
+
+matmath_export using AABBf = AABB<float>;
+matmath_export using AABBd = AABB<double>;
+
+matmath_export template <typename T>
+struct Frustum;
+
+matmath_export using Frustumf = Frustum<float>;
+matmath_export using Frustumd = Frustum<double>;
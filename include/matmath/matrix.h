@@ -8,8 +8,16 @@
 
 #ifndef matmath_use_modules
 
+#include "constmath.h"
+#include "simd.h"
+#include "simdmath.h"
 #include "vec.h"
+#include <algorithm>
 #include <cmath>
+#include <cstddef>
+#if __cplusplus >= 202002L
+#include <span>
+#endif
 
 #endif
 
@@ -52,10 +60,16 @@ public:
     }
 
     constexpr T &at(int i) {
+        if (matmath::simd::isConstantEvaluated()) {
+            return member(*this, i);
+        }
         return (&x1)[i];
     }
 
     constexpr T at(int i) const {
+        if (matmath::simd::isConstantEvaluated()) {
+            return member(*this, i);
+        }
         return (&x1)[i];
     }
 
@@ -211,9 +225,12 @@ public:
     }
 
     constexpr Matrix &normalizeScale() {
-        auto l1 = (T)1. / sqrt(x1 * x1 + y1 * y1 + z1 * z1);
-        auto l2 = (T)1. / sqrt(x2 * x2 + y2 * y2 + z2 * z2);
-        auto l3 = (T)1. / sqrt(x3 * x3 + y3 * y3 + z3 * z3);
+        auto l1 =
+            (T)1. / constmath::dispatch::sqrt(x1 * x1 + y1 * y1 + z1 * z1);
+        auto l2 =
+            (T)1. / constmath::dispatch::sqrt(x2 * x2 + y2 * y2 + z2 * z2);
+        auto l3 =
+            (T)1. / constmath::dispatch::sqrt(x3 * x3 + y3 * y3 + z3 * z3);
         // clang-format off
         x1 *= l1; y1 *= l1; z1 *= l1;
         x2 *= l2; y2 *= l2; z2 *= l2;
@@ -225,6 +242,11 @@ public:
     constexpr Matrix operator*(const Matrix &m) const {
         Matrix product;
 
+        if (!matmath::simd::isConstantEvaluated() &&
+            matmath::simd::multiply4x4(data(), m.data(), product.data())) {
+            return product;
+        }
+
         for (int y = 0; y < 4; ++y)
             for (int x = 0; x < 4; ++x) {
                 T value = 0;
@@ -253,7 +275,79 @@ public:
         return product;
     }
 
+    //! Transform count points, the same as operator*(Vec) for each point
+    //! in and out may be the same array
+    void transformPoints(const VecT<T> *in,
+                         VecT<T> *out,
+                         size_t count) const noexcept {
+        transform(in, out, count, matmath::simd::TransformMode::Point);
+    }
+
+    //! Transform count directions, like transformPoints but without
+    //! translation
+    void transformDirections(const VecT<T> *in,
+                             VecT<T> *out,
+                             size_t count) const noexcept {
+        transform(in, out, count, matmath::simd::TransformMode::Direction);
+    }
+
+    //! Transform count normals with normalMatrix() so that they stay
+    //! perpendicular to transformed surfaces even with non uniform scaling.
+    //! The result is not normalized
+    void transformNormals(const VecT<T> *in,
+                          VecT<T> *out,
+                          size_t count) const noexcept {
+        normalMatrix().transformDirections(in, out, count);
+    }
+
+#if __cplusplus >= 202002L
+    //! Span versions of the functions above, out should be at least as long
+    //! as in
+    void transformPoints(std::span<const VecT<T>> in,
+                         std::span<VecT<T>> out) const noexcept {
+        transformPoints(in.data(), out.data(), in.size());
+    }
+
+    void transformDirections(std::span<const VecT<T>> in,
+                             std::span<VecT<T>> out) const noexcept {
+        transformDirections(in.data(), out.data(), in.size());
+    }
+
+    void transformNormals(std::span<const VecT<T>> in,
+                          std::span<VecT<T>> out) const noexcept {
+        transformNormals(in.data(), out.data(), in.size());
+    }
+#endif
+
+    //! Inverse transpose of the rotation and scale part, used to transform
+    //! normals. Translation is removed. A singular matrix gives
+    //! values that are not finite
+    constexpr Matrix normalMatrix() const {
+        const auto r1 = VecT<T>{x1, y1, z1};
+        const auto r2 = VecT<T>{x2, y2, z2};
+        const auto r3 = VecT<T>{x3, y3, z3};
+
+        const auto c1 = r2.cross(r3);
+        const auto c2 = r3.cross(r1);
+        const auto c3 = r1.cross(r2);
+        const auto det = r1 * c1;
+
+        // clang-format off
+        return Matrix{
+            c1.x / det, c1.y / det, c1.z / det, 0,
+            c2.x / det, c2.y / det, c2.z / det, 0,
+            c3.x / det, c3.y / det, c3.z / det, 0,
+            0, 0, 0, 1,
+        };
+        // clang-format on
+    }
+
     constexpr Matrix &operator*=(const Matrix &m) {
+        if (!matmath::simd::isConstantEvaluated() &&
+            matmath::simd::multiply4x4(data(), m.data(), data())) {
+            return *this;
+        }
+
         Matrix mTemp(*this * m);
         (*this) = mTemp;
         return *this;
@@ -288,7 +382,7 @@ public:
     }
 
     constexpr T abs() const {
-        return sqrt(abs2());
+        return constmath::dispatch::sqrt(abs2());
     }
 
     // Return a transposed copy of the matrix
@@ -302,144 +396,71 @@ public:
     }
 
     // The heaviest invertion method
-    // Invert a invertible matrix
-    // Consider using inverseOrthogonal or inverseNormalized for faster
-    // computations
+    // Invert a invertible matrix, throws if the matrix is singular
+    // Consider using tryInverse to avoid the exception, or
+    // inverseOrthogonal or inverseNormalized for faster computations
     constexpr Matrix inverse() const {
-        // https://stackoverflow.com/questions/1148309/inverting-a-4x4-matrix
-        auto &m = *this;
         Matrix inv;
-        double det = 0;
-
-        int i = 0;
-
-        // clang-format off
-        inv[0] = m[5]  * m[10] * m[15] -
-                 m[5]  * m[11] * m[14] -
-                 m[9]  * m[6]  * m[15] +
-                 m[9]  * m[7]  * m[14] +
-                 m[13] * m[6]  * m[11] -
-                 m[13] * m[7]  * m[10];
-
-        inv[4] = -m[4]  * m[10] * m[15] +
-                  m[4]  * m[11] * m[14] +
-                  m[8]  * m[6]  * m[15] -
-                  m[8]  * m[7]  * m[14] -
-                  m[12] * m[6]  * m[11] +
-                  m[12] * m[7]  * m[10];
-
-        inv[8] = m[4]  * m[9] * m[15] -
-                 m[4]  * m[11] * m[13] -
-                 m[8]  * m[5] * m[15] +
-                 m[8]  * m[7] * m[13] +
-                 m[12] * m[5] * m[11] -
-                 m[12] * m[7] * m[9];
-
-        inv[12] = -m[4]  * m[9] * m[14] +
-                   m[4]  * m[10] * m[13] +
-                   m[8]  * m[5] * m[14] -
-                   m[8]  * m[6] * m[13] -
-                   m[12] * m[5] * m[10] +
-                   m[12] * m[6] * m[9];
-
-        inv[1] = -m[1]  * m[10] * m[15] +
-                  m[1]  * m[11] * m[14] +
-                  m[9]  * m[2] * m[15] -
-                  m[9]  * m[3] * m[14] -
-                  m[13] * m[2] * m[11] +
-                  m[13] * m[3] * m[10];
-
-        inv[5] = m[0]  * m[10] * m[15] -
-                 m[0]  * m[11] * m[14] -
-                 m[8]  * m[2] * m[15] +
-                 m[8]  * m[3] * m[14] +
-                 m[12] * m[2] * m[11] -
-                 m[12] * m[3] * m[10];
-
-        inv[9] = -m[0]  * m[9] * m[15] +
-                  m[0]  * m[11] * m[13] +
-                  m[8]  * m[1] * m[15] -
-                  m[8]  * m[3] * m[13] -
-                  m[12] * m[1] * m[11] +
-                  m[12] * m[3] * m[9];
-
-        inv[13] = m[0]  * m[9] * m[14] -
-                  m[0]  * m[10] * m[13] -
-                  m[8]  * m[1] * m[14] +
-                  m[8]  * m[2] * m[13] +
-                  m[12] * m[1] * m[10] -
-                  m[12] * m[2] * m[9];
-
-        inv[2] = m[1]  * m[6] * m[15] -
-                 m[1]  * m[7] * m[14] -
-                 m[5]  * m[2] * m[15] +
-                 m[5]  * m[3] * m[14] +
-                 m[13] * m[2] * m[7] -
-                 m[13] * m[3] * m[6];
-
-        inv[6] = -m[0]  * m[6] * m[15] +
-                  m[0]  * m[7] * m[14] +
-                  m[4]  * m[2] * m[15] -
-                  m[4]  * m[3] * m[14] -
-                  m[12] * m[2] * m[7] +
-                  m[12] * m[3] * m[6];
-
-        inv[10] = m[0]  * m[5] * m[15] -
-                  m[0]  * m[7] * m[13] -
-                  m[4]  * m[1] * m[15] +
-                  m[4]  * m[3] * m[13] +
-                  m[12] * m[1] * m[7] -
-                  m[12] * m[3] * m[5];
+        if (tryInverse(inv) == 0) {
+            throw "could not invert matrix";
+        }
+        return inv;
+    }
 
-        inv[14] = -m[0]  * m[5] * m[14] +
-                   m[0]  * m[6] * m[13] +
-                   m[4]  * m[1] * m[14] -
-                   m[4]  * m[2] * m[13] -
-                   m[12] * m[1] * m[6] +
-                   m[12] * m[2] * m[5];
+    //! Invert the matrix into out and return the determinant
+    //! If the matrix is singular 0 is returned and out is left unchanged
+    //! Affine matrices (w1 = w2 = w3 = 0 and w4 = 1) are detected and
+    //! inverted with a cheaper 3x3 inverse and translation
+    constexpr T tryInverse(Matrix &out) const noexcept {
+        if (isAffine()) {
+            return tryInverseAffine(out);
+        }
 
-        inv[3] = -m[1] * m[6] * m[11] +
-                  m[1] * m[7] * m[10] +
-                  m[5] * m[2] * m[11] -
-                  m[5] * m[3] * m[10] -
-                  m[9] * m[2] * m[7] +
-                  m[9] * m[3] * m[6];
+        if (!matmath::simd::isConstantEvaluated()) {
+            T det = 0;
+            if (matmath::simd::inverse4x4(data(), out.data(), det)) {
+                return det;
+            }
+        }
 
-        inv[7] = m[0] * m[6] * m[11] -
-                 m[0] * m[7] * m[10] -
-                 m[4] * m[2] * m[11] +
-                 m[4] * m[3] * m[10] +
-                 m[8] * m[2] * m[7] -
-                 m[8] * m[3] * m[6];
+        return tryInverseGeneral(out);
+    }
 
-        inv[11] = -m[0] * m[5] * m[11] +
-                   m[0] * m[7] * m[9] +
-                   m[4] * m[1] * m[11] -
-                   m[4] * m[3] * m[9] -
-                   m[8] * m[1] * m[7] +
-                   m[8] * m[3] * m[5];
+    //! True if w1 = w2 = w3 = 0 and w4 = 1, that is if the matrix only
+    //! rotates, scales, shears and translates
+    constexpr bool isAffine() const {
+        return w1 == 0 && w2 == 0 && w3 == 0 && w4 == 1;
+    }
 
-        inv[15] = m[0] * m[5] * m[10] -
-                  m[0] * m[6] * m[9] -
-                  m[4] * m[1] * m[10] +
-                  m[4] * m[2] * m[9] +
-                  m[8] * m[1] * m[6] -
-                  m[8] * m[2] * m[5];
-        // clang-format on
+    //! Inverse of a matrix that is known to be affine, see isAffine()
+    //! Returns the determinant, if it is 0 out is left unchanged
+    constexpr T tryInverseAffine(Matrix &out) const noexcept {
+        const auto r1 = VecT<T>{x1, y1, z1};
+        const auto r2 = VecT<T>{x2, y2, z2};
+        const auto r3 = VecT<T>{x3, y3, z3};
+        const auto t = VecT<T>{x4, y4, z4};
 
-        det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+        const auto c1 = r2.cross(r3);
+        const auto c2 = r3.cross(r1);
+        const auto c3 = r1.cross(r2);
+        const auto det = r1 * c1;
 
         if (det == 0) {
-            throw "could not invert matrix";
+            return det;
         }
 
-        det = 1.0 / det;
+        const auto l = 1 / det;
 
-        for (i = 0; i < 16; i++) {
-            inv[i] *= det;
-        }
+        // clang-format off
+        out = {
+            c1.x * l, c2.x * l, c3.x * l, 0,
+            c1.y * l, c2.y * l, c3.y * l, 0,
+            c1.z * l, c2.z * l, c3.z * l, 0,
+            -(c1 * t) * l, -(c2 * t) * l, -(c3 * t) * l, 1,
+        };
+        // clang-format on
 
-        return inv;
+        return det;
     }
 
     // Inverse a orthogonal rotation + translation matrix
@@ -608,8 +629,8 @@ public:
     // https://github.com/LWJGL --> Matrix4f
     constexpr Matrix rotationFromThis(T angle, Vec axis) const {
         Matrix dest = Identity();
-        T c = (T)cos(angle);
-        T s = (T)sin(angle);
+        T c = (T)constmath::dispatch::cos<double>(angle);
+        T s = (T)constmath::dispatch::sin<double>(angle);
         T ci = 1.0f - c;
         T xy = axis.x * axis.y;
         T yz = axis.y * axis.z;
@@ -655,8 +676,8 @@ public:
 
     constexpr static Matrix RotationX(double angle) {
         Matrix m = Identity();
-        double c = cos(angle);
-        double s = sin(angle);
+        double c = constmath::dispatch::cos(angle);
+        double s = constmath::dispatch::sin(angle);
         m.y2 = c;
         m.z2 = -s;
         m.y3 = s;
@@ -666,19 +687,19 @@ public:
 
     constexpr static Matrix RotationY(double angle) {
         Matrix m = Identity();
-        double c = cos(angle);
-        double s = sin(angle);
+        double c = constmath::dispatch::cos(angle);
+        double s = constmath::dispatch::sin(angle);
         m.x1 = c;
         m.z1 = s;
-        m.x3 = s;
-        m.z3 = -c;
+        m.x3 = -s;
+        m.z3 = c;
         return m;
     }
 
     static constexpr Matrix RotationZ(double angle) {
         Matrix m = Identity();
-        double c = cos(angle);
-        double s = sin(angle);
+        double c = constmath::dispatch::cos(angle);
+        double s = constmath::dispatch::sin(angle);
         m.x1 = c;
         m.y1 = -s;
         m.x2 = s;
@@ -686,6 +707,76 @@ public:
         return m;
     }
 
+    //! Create count rotation matrices at once, with simd::sincos
+    static void RotationZ(const T *angles, Matrix *out, size_t count) noexcept {
+        constexpr size_t block = 64;
+        T sin[block], cos[block];
+        for (size_t i = 0; i < count; i += block) {
+            const auto n = std::min(block, count - i);
+            matmath::simd::sincos(angles + i, sin, cos, n);
+            for (size_t j = 0; j < n; ++j) {
+                auto &m = out[i + j];
+                m = Identity();
+                m.x1 = cos[j];
+                m.y1 = -sin[j];
+                m.x2 = sin[j];
+                m.y2 = cos[j];
+            }
+        }
+    }
+
+#if __cplusplus >= 202002L
+    static void RotationZ(std::span<const T> angles,
+                          std::span<Matrix> out) noexcept {
+        RotationZ(angles.data(), out.data(), angles.size());
+    }
+#endif
+
+    //! out[i] = a[i] * b[i] for count matrices. out may be the same array as
+    //! a or b
+    static void multiply(const Matrix *a,
+                         const Matrix *b,
+                         Matrix *out,
+                         size_t count) noexcept {
+        for (size_t i = 0; i < count; ++i) {
+            out[i] = a[i] * b[i];
+        }
+    }
+
+    //! out[i] = m * in[i] for count matrices, for example with m = P * V to
+    //! calculate P * V * M[i]. in and out may be the same array
+    static void premultiply(const Matrix &m,
+                            const Matrix *in,
+                            Matrix *out,
+                            size_t count) noexcept {
+        static_assert(sizeof(Matrix) == sizeof(T) * 16,
+                      "Matrix is expected to be 16 packed values");
+        const auto copy = m;
+        const auto done =
+            matmath::simd::premultiply4x4(copy.data(),
+                                          reinterpret_cast<const T *>(in),
+                                          reinterpret_cast<T *>(out),
+                                          count);
+        for (auto i = done; i < count; ++i) {
+            out[i] = copy * in[i];
+        }
+    }
+
+#if __cplusplus >= 202002L
+    //! out should be at least as long as a and b
+    static void multiply(std::span<const Matrix> a,
+                         std::span<const Matrix> b,
+                         std::span<Matrix> out) noexcept {
+        multiply(a.data(), b.data(), out.data(), a.size());
+    }
+
+    static void premultiply(const Matrix &m,
+                            std::span<const Matrix> in,
+                            std::span<Matrix> out) noexcept {
+        premultiply(m, in.data(), out.data(), in.size());
+    }
+#endif
+
     constexpr Matrix rotationPart() const {
         Matrix product = *this;
         product.x4 = 0;
@@ -705,6 +796,186 @@ public:
     T x2 = 0, y2 = 1, z2 = 0, w2 = 0;
     T x3 = 0, y3 = 0, z3 = 1, w3 = 0;
     T x4 = 0, y4 = 0, z4 = 0, w4 = 1;
+
+private:
+    //! Full cofactor expansion used for non affine matrices
+    constexpr T tryInverseGeneral(Matrix &out) const noexcept {
+        // https://stackoverflow.com/questions/1148309/inverting-a-4x4-matrix
+        auto &m = *this;
+        Matrix inv;
+
+        // clang-format off
+        inv[0] = m[5]  * m[10] * m[15] -
+                 m[5]  * m[11] * m[14] -
+                 m[9]  * m[6]  * m[15] +
+                 m[9]  * m[7]  * m[14] +
+                 m[13] * m[6]  * m[11] -
+                 m[13] * m[7]  * m[10];
+
+        inv[4] = -m[4]  * m[10] * m[15] +
+                  m[4]  * m[11] * m[14] +
+                  m[8]  * m[6]  * m[15] -
+                  m[8]  * m[7]  * m[14] -
+                  m[12] * m[6]  * m[11] +
+                  m[12] * m[7]  * m[10];
+
+        inv[8] = m[4]  * m[9] * m[15] -
+                 m[4]  * m[11] * m[13] -
+                 m[8]  * m[5] * m[15] +
+                 m[8]  * m[7] * m[13] +
+                 m[12] * m[5] * m[11] -
+                 m[12] * m[7] * m[9];
+
+        inv[12] = -m[4]  * m[9] * m[14] +
+                   m[4]  * m[10] * m[13] +
+                   m[8]  * m[5] * m[14] -
+                   m[8]  * m[6] * m[13] -
+                   m[12] * m[5] * m[10] +
+                   m[12] * m[6] * m[9];
+
+        inv[1] = -m[1]  * m[10] * m[15] +
+                  m[1]  * m[11] * m[14] +
+                  m[9]  * m[2] * m[15] -
+                  m[9]  * m[3] * m[14] -
+                  m[13] * m[2] * m[11] +
+                  m[13] * m[3] * m[10];
+
+        inv[5] = m[0]  * m[10] * m[15] -
+                 m[0]  * m[11] * m[14] -
+                 m[8]  * m[2] * m[15] +
+                 m[8]  * m[3] * m[14] +
+                 m[12] * m[2] * m[11] -
+                 m[12] * m[3] * m[10];
+
+        inv[9] = -m[0]  * m[9] * m[15] +
+                  m[0]  * m[11] * m[13] +
+                  m[8]  * m[1] * m[15] -
+                  m[8]  * m[3] * m[13] -
+                  m[12] * m[1] * m[11] +
+                  m[12] * m[3] * m[9];
+
+        inv[13] = m[0]  * m[9] * m[14] -
+                  m[0]  * m[10] * m[13] -
+                  m[8]  * m[1] * m[14] +
+                  m[8]  * m[2] * m[13] +
+                  m[12] * m[1] * m[10] -
+                  m[12] * m[2] * m[9];
+
+        inv[2] = m[1]  * m[6] * m[15] -
+                 m[1]  * m[7] * m[14] -
+                 m[5]  * m[2] * m[15] +
+                 m[5]  * m[3] * m[14] +
+                 m[13] * m[2] * m[7] -
+                 m[13] * m[3] * m[6];
+
+        inv[6] = -m[0]  * m[6] * m[15] +
+                  m[0]  * m[7] * m[14] +
+                  m[4]  * m[2] * m[15] -
+                  m[4]  * m[3] * m[14] -
+                  m[12] * m[2] * m[7] +
+                  m[12] * m[3] * m[6];
+
+        inv[10] = m[0]  * m[5] * m[15] -
+                  m[0]  * m[7] * m[13] -
+                  m[4]  * m[1] * m[15] +
+                  m[4]  * m[3] * m[13] +
+                  m[12] * m[1] * m[7] -
+                  m[12] * m[3] * m[5];
+
+        inv[14] = -m[0]  * m[5] * m[14] +
+                   m[0]  * m[6] * m[13] +
+                   m[4]  * m[1] * m[14] -
+                   m[4]  * m[2] * m[13] -
+                   m[12] * m[1] * m[6] +
+                   m[12] * m[2] * m[5];
+
+        inv[3] = -m[1] * m[6] * m[11] +
+                  m[1] * m[7] * m[10] +
+                  m[5] * m[2] * m[11] -
+                  m[5] * m[3] * m[10] -
+                  m[9] * m[2] * m[7] +
+                  m[9] * m[3] * m[6];
+
+        inv[7] = m[0] * m[6] * m[11] -
+                 m[0] * m[7] * m[10] -
+                 m[4] * m[2] * m[11] +
+                 m[4] * m[3] * m[10] +
+                 m[8] * m[2] * m[7] -
+                 m[8] * m[3] * m[6];
+
+        inv[11] = -m[0] * m[5] * m[11] +
+                   m[0] * m[7] * m[9] +
+                   m[4] * m[1] * m[11] -
+                   m[4] * m[3] * m[9] -
+                   m[8] * m[1] * m[7] +
+                   m[8] * m[3] * m[5];
+
+        inv[15] = m[0] * m[5] * m[10] -
+                  m[0] * m[6] * m[9] -
+                  m[4] * m[1] * m[10] +
+                  m[4] * m[2] * m[9] +
+                  m[8] * m[1] * m[6] -
+                  m[8] * m[2] * m[5];
+        // clang-format on
+
+        T det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+
+        if (det == 0) {
+            return det;
+        }
+
+        const T l = 1 / det;
+
+        for (int i = 0; i < 16; i++) {
+            inv[i] *= l;
+        }
+
+        out = inv;
+        return det;
+    }
+
+    void transform(const VecT<T> *in,
+                   VecT<T> *out,
+                   size_t count,
+                   matmath::simd::TransformMode mode) const noexcept {
+        static_assert(sizeof(VecT<T>) == sizeof(T) * 3,
+                      "VecT is expected to be three tightly packed values");
+
+        auto done =
+            matmath::simd::transform3(data(),
+                                      reinterpret_cast<const T *>(in),
+                                      reinterpret_cast<T *>(out),
+                                      count,
+                                      mode);
+
+        const auto isPoint = mode == matmath::simd::TransformMode::Point;
+        for (auto i = done; i < count; ++i) {
+            const auto v = in[i];
+            out[i] = {
+                x1 * v.x + x2 * v.y + x3 * v.z + (isPoint ? x4 : 0),
+                y1 * v.x + y2 * v.y + y3 * v.z + (isPoint ? y4 : 0),
+                z1 * v.x + z2 * v.y + z3 * v.z + (isPoint ? z4 : 0),
+            };
+        }
+    }
+
+    //! Indexing from &x1 is not allowed in constant expressions, so the
+    //! members are named explicitly there instead
+    template <class Self>
+    static constexpr auto &member(Self &self, int i) {
+        // clang-format off
+        switch (i) {
+        case 0: return self.x1; case 1: return self.y1;
+        case 2: return self.z1; case 3: return self.w1;
+        case 4: return self.x2; case 5: return self.y2;
+        case 6: return self.z2; case 7: return self.w2;
+        case 8: return self.x3; case 9: return self.y3;
+        case 10: return self.z3; case 11: return self.w3;
+        case 12: return self.x4; case 13: return self.y4;
+        case 14: return self.z4; default: return self.w4;
+        }
+        // clang-format on
+    }
 };
 
 matmath_export typedef Matrix<float> Matrixf;
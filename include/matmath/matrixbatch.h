@@ -0,0 +1,346 @@
+//! Copyright © Mattias Larsson Sköld 2020
+//! Distributed under terms specified under licence.txt
+
+#pragma once
+
+#include "matmath/export.h"
+
+#ifndef matmath_use_modules
+
+#include "matrix.h"
+#include "simd.h"
+#include "vec.h"
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+#if __cplusplus >= 202002L
+#include <span>
+#endif
+
+#endif
+
+//! Lanes matrices stored with each of the 16 values in a separate array
+//! (structure of arrays), values[k][lane] is value k in the Matrix layout of
+//! matrix lane. All operations are made lanewise, so each simd instruction
+//! handles one value of several matrices without any shuffles. Large jobs
+//! should use arrays of MatrixBatch, see pack and unpack
+matmath_export template <typename T, size_t Lanes>
+struct alignas(sizeof(T) * Lanes) MatrixBatch {
+    static_assert(Lanes > 0 && (Lanes & (Lanes - 1)) == 0,
+                  "the number of lanes should be a power of two");
+
+    static constexpr size_t lanes = Lanes;
+
+    //! Identity matrices by default, as for Matrix
+    T values[16][Lanes];
+
+    constexpr MatrixBatch() : values{} {
+        for (size_t lane = 0; lane < Lanes; ++lane) {
+            values[0][lane] = values[5][lane] = 1;
+            values[10][lane] = values[15][lane] = 1;
+        }
+    }
+
+    //! Create from Lanes matrices
+    explicit MatrixBatch(const Matrix<T> *matrices) {
+        for (size_t lane = 0; lane < Lanes; ++lane) {
+            set(lane, matrices[lane]);
+        }
+    }
+
+    //! The same matrix in all lanes
+    static MatrixBatch Broadcast(const Matrix<T> &m) {
+        auto ret = MatrixBatch{};
+        for (size_t lane = 0; lane < Lanes; ++lane) {
+            ret.set(lane, m);
+        }
+        return ret;
+    }
+
+    Matrix<T> get(size_t lane) const {
+        auto m = Matrix<T>{};
+        for (int k = 0; k < 16; ++k) {
+            m(k) = values[k][lane];
+        }
+        return m;
+    }
+
+    MatrixBatch &set(size_t lane, const Matrix<T> &m) {
+        for (int k = 0; k < 16; ++k) {
+            values[k][lane] = m(k);
+        }
+        return *this;
+    }
+
+    Matrix<T> operator[](size_t lane) const {
+        return get(lane);
+    }
+
+    //! Store count matrices in (count + Lanes - 1) / Lanes batches. Unused
+    //! lanes in the last batch are set to identity
+    static void pack(const Matrix<T> *in, MatrixBatch *out, size_t count) {
+        for (size_t i = 0; i < count; i += Lanes) {
+            auto &batch = out[i / Lanes];
+            const auto n = std::min(Lanes, count - i);
+            if (n < Lanes) {
+                batch = {};
+            }
+            for (size_t lane = 0; lane < n; ++lane) {
+                const auto m = in[i + lane].data();
+                for (int k = 0; k < 16; ++k) {
+                    batch.values[k][lane] = m[k];
+                }
+            }
+        }
+    }
+
+    //! Write the first count matrices of the batches in to out
+    static void unpack(const MatrixBatch *in, Matrix<T> *out, size_t count) {
+        for (size_t i = 0; i < count; i += Lanes) {
+            const auto &batch = in[i / Lanes];
+            const auto n = std::min(Lanes, count - i);
+            for (size_t lane = 0; lane < n; ++lane) {
+                const auto m = out[i + lane].data();
+                for (int k = 0; k < 16; ++k) {
+                    m[k] = batch.values[k][lane];
+                }
+            }
+        }
+    }
+
+#if __cplusplus >= 202002L
+    //! out should have room for (in.size() + Lanes - 1) / Lanes batches
+    static void pack(std::span<const Matrix<T>> in,
+                     std::span<MatrixBatch> out) {
+        pack(in.data(), out.data(), in.size());
+    }
+
+    //! Unpack out.size() matrices
+    static void unpack(std::span<const MatrixBatch> in,
+                       std::span<Matrix<T>> out) {
+        unpack(in.data(), out.data(), out.size());
+    }
+#endif
+
+    //! Lanewise product, the same as Matrix::operator* for each lane. Each
+    //! value of b is loaded once, and the values of this are loaded when
+    //! they are used, to not need more than 16 registers
+    MatrixBatch operator*(const MatrixBatch &b) const noexcept {
+        auto ret = MatrixBatch{uninitialized};
+        forEachPack([&](auto p, size_t l) {
+            using P = decltype(p);
+            const auto a = [&](int k) { return P::load(&values[k][l]); };
+            for (int y = 0; y < 4; ++y) {
+                const auto m0 = P::load(&b.values[4 * y][l]);
+                const auto m1 = P::load(&b.values[4 * y + 1][l]);
+                const auto m2 = P::load(&b.values[4 * y + 2][l]);
+                const auto m3 = P::load(&b.values[4 * y + 3][l]);
+                const auto column = [&](int x) {
+                    const auto sum = madd(a(x + 4), m1, a(x) * m0);
+                    return madd(a(x + 12), m3, madd(a(x + 8), m2, sum));
+                };
+                column(0).store(&ret.values[4 * y][l]);
+                column(1).store(&ret.values[4 * y + 1][l]);
+                column(2).store(&ret.values[4 * y + 2][l]);
+                column(3).store(&ret.values[4 * y + 3][l]);
+            }
+        });
+        return ret;
+    }
+
+    MatrixBatch &operator*=(const MatrixBatch &b) noexcept {
+        return *this = *this * b;
+    }
+
+    //! Lanewise general inverse from the 2x2 sub determinants. Singular
+    //! matrices gives values that are not finite, use determinant() to find
+    //! them
+    MatrixBatch inverse() const noexcept {
+        auto ret = MatrixBatch{uninitialized};
+        forEachPack([&](auto p, size_t l) {
+            using P = decltype(p);
+            P a[16], s[6], c[6];
+            load(a, l);
+            subDeterminants(a, s, c);
+
+            const auto det = determinant(s, c);
+            const auto d = P::broadcast(1) / det;
+            const P out[16] = {
+                (a[5] * c[5] - a[6] * c[4] + a[7] * c[3]) * d,
+                (a[2] * c[4] - a[1] * c[5] - a[3] * c[3]) * d,
+                (a[13] * s[5] - a[14] * s[4] + a[15] * s[3]) * d,
+                (a[10] * s[4] - a[9] * s[5] - a[11] * s[3]) * d,
+
+                (a[6] * c[2] - a[4] * c[5] - a[7] * c[1]) * d,
+                (a[0] * c[5] - a[2] * c[2] + a[3] * c[1]) * d,
+                (a[14] * s[2] - a[12] * s[5] - a[15] * s[1]) * d,
+                (a[8] * s[5] - a[10] * s[2] + a[11] * s[1]) * d,
+
+                (a[4] * c[4] - a[5] * c[2] + a[7] * c[0]) * d,
+                (a[1] * c[2] - a[0] * c[4] - a[3] * c[0]) * d,
+                (a[12] * s[4] - a[13] * s[2] + a[15] * s[0]) * d,
+                (a[9] * s[2] - a[8] * s[4] - a[11] * s[0]) * d,
+
+                (a[5] * c[1] - a[4] * c[3] - a[6] * c[0]) * d,
+                (a[0] * c[3] - a[1] * c[1] + a[2] * c[0]) * d,
+                (a[13] * s[1] - a[12] * s[3] - a[14] * s[0]) * d,
+                (a[8] * s[3] - a[9] * s[1] + a[10] * s[0]) * d,
+            };
+            ret.store(out, l);
+        });
+        return ret;
+    }
+
+    //! Lanewise determinant
+    void determinant(T (&out)[Lanes]) const noexcept {
+        forEachPack([&](auto p, size_t l) {
+            using P = decltype(p);
+            P a[16], s[6], c[6];
+            load(a, l);
+            subDeterminants(a, s, c);
+            determinant(s, c).store(out + l);
+        });
+    }
+
+    //! See Matrix::inverseOrthogonal
+    MatrixBatch inverseOrthogonal() const noexcept {
+        auto ret = MatrixBatch{uninitialized};
+        forEachPack([&](auto p, size_t l) {
+            using P = decltype(p);
+            P a[16];
+            load(a, l);
+            const auto one = P::broadcast(1), zero = P::broadcast(0);
+            const P scale[3] = {
+                one / madd(a[0], a[0], madd(a[4], a[4], a[8] * a[8])),
+                one / madd(a[1], a[1], madd(a[5], a[5], a[9] * a[9])),
+                one / madd(a[2], a[2], madd(a[6], a[6], a[10] * a[10])),
+            };
+            invertRigid(a, scale, zero, one, ret, l);
+        });
+        return ret;
+    }
+
+    //! See Matrix::inverseNormalized
+    MatrixBatch inverseNormalized() const noexcept {
+        auto ret = MatrixBatch{uninitialized};
+        forEachPack([&](auto p, size_t l) {
+            using P = decltype(p);
+            P a[16];
+            load(a, l);
+            const auto one = P::broadcast(1), zero = P::broadcast(0);
+            const P scale[3] = {one, one, one};
+            invertRigid(a, scale, zero, one, ret, l);
+        });
+        return ret;
+    }
+
+    //! out[lane] = get(lane) * in[lane] for all lanes, in and out should
+    //! have Lanes values and may be the same array
+    void transformPoints(const VecT<T> *in, VecT<T> *out) const noexcept {
+        static_assert(sizeof(VecT<T>) == sizeof(T) * 3,
+                      "VecT is expected to be three tightly packed values");
+        const auto pin = reinterpret_cast<const T *>(in);
+        const auto pout = reinterpret_cast<T *>(out);
+        forEachPack([&](auto p, size_t l) {
+            using P = decltype(p);
+            P a[16], x, y, z;
+            load(a, l);
+            P::load3(pin + l * 3, x, y, z);
+            P::store3(pout + l * 3,
+                      madd(a[0], x, madd(a[4], y, madd(a[8], z, a[12]))),
+                      madd(a[1], x, madd(a[5], y, madd(a[9], z, a[13]))),
+                      madd(a[2], x, madd(a[6], y, madd(a[10], z, a[14]))));
+        });
+    }
+
+private:
+    struct Uninitialized {};
+    static constexpr auto uninitialized = Uninitialized{};
+
+    //! For results where all values are written
+    explicit MatrixBatch(Uninitialized) {}
+
+    //! Native packs if they fit the lanes, otherwise one lane at a time
+    template <typename F>
+    static void forEachPack(F &&f) {
+        using Native = matmath::simd::NativePack<T>;
+        if constexpr (!std::is_void_v<Native>) {
+            if constexpr (Lanes % Native::size == 0) {
+                for (size_t l = 0; l < Lanes; l += Native::size) {
+                    f(Native{}, l);
+                }
+                return;
+            }
+        }
+        for (size_t l = 0; l < Lanes; ++l) {
+            f(matmath::simd::Pack<T, 1>{}, l);
+        }
+    }
+
+    template <typename P>
+    void load(P (&a)[16], size_t l) const noexcept {
+        for (int k = 0; k < 16; ++k) {
+            a[k] = P::load(&values[k][l]);
+        }
+    }
+
+    template <typename P>
+    void store(const P (&a)[16], size_t l) noexcept {
+        for (int k = 0; k < 16; ++k) {
+            a[k].store(&values[k][l]);
+        }
+    }
+
+    //! The 2x2 determinants of the first two (s) and last two (c) groups of
+    //! four values
+    template <typename P>
+    static void subDeterminants(const P (&a)[16], P (&s)[6], P (&c)[6]) {
+        s[0] = a[0] * a[5] - a[4] * a[1];
+        s[1] = a[0] * a[6] - a[4] * a[2];
+        s[2] = a[0] * a[7] - a[4] * a[3];
+        s[3] = a[1] * a[6] - a[5] * a[2];
+        s[4] = a[1] * a[7] - a[5] * a[3];
+        s[5] = a[2] * a[7] - a[6] * a[3];
+
+        c[0] = a[8] * a[13] - a[12] * a[9];
+        c[1] = a[8] * a[14] - a[12] * a[10];
+        c[2] = a[8] * a[15] - a[12] * a[11];
+        c[3] = a[9] * a[14] - a[13] * a[10];
+        c[4] = a[9] * a[15] - a[13] * a[11];
+        c[5] = a[10] * a[15] - a[14] * a[11];
+    }
+
+    template <typename P>
+    static P determinant(const P (&s)[6], const P (&c)[6]) {
+        return s[0] * c[5] - s[1] * c[4] + s[2] * c[3] + s[3] * c[2] -
+               s[4] * c[1] + s[5] * c[0];
+    }
+
+    //! Transposed rotation with the rows scaled by scale, and the inverse
+    //! translation
+    template <typename P>
+    static void invertRigid(const P (&a)[16],
+                            const P (&scale)[3],
+                            P zero,
+                            P one,
+                            MatrixBatch &ret,
+                            size_t l) {
+        P out[16];
+        for (int y = 0; y < 3; ++y) {
+            for (int x = 0; x < 3; ++x) {
+                out[x + 4 * y] = a[y + 4 * x] * scale[y];
+            }
+            out[3 + 4 * y] = zero;
+        }
+        for (int x = 0; x < 3; ++x) {
+            out[12 + x] =
+                zero - madd(a[12], out[x],
+                            madd(a[13], out[x + 4], a[14] * out[x + 8]));
+        }
+        out[15] = one;
+        ret.store(out, l);
+    }
+};
+
+matmath_export using MatrixBatchf = MatrixBatch<float, 8>;
+matmath_export using MatrixBatchd = MatrixBatch<double, 4>;
@@ -0,0 +1,443 @@
+//! Copyright © Mattias Larsson Sköld 2020
+//! Distributed under terms specified under licence.txt
+
+#pragma once
+
+#include "export.h"
+
+#ifndef matmath_use_modules
+
+#include "matrix.h"
+#include "simd.h"
+#include "vec.h"
+#include "vec2.h"
+#include <type_traits>
+#include <utility>
+
+#endif
+
+//! Fixed size matrix with R rows and C columns
+//!
+//! The values are stored column by column, the same way as in Matrix, where
+//! x1, y1, z1, w1 is the first column. operator()(row, col) has the same
+//! argument order as Matrix::operator()(x, y), so MatrixN<T, 4, 4> and
+//! Matrix<T> can be converted to each other without reordering.
+//!
+//! Multiplication is unrolled at compile time. Matrices with four rows of
+//! float (or double with avx) are multiplied one column at a time with simd.
+matmath_export template <class T, int R, int C>
+class MatrixN {
+public:
+    static_assert(R > 0 && C > 0, "matrix needs at least one row and column");
+
+    static constexpr int rows = R;
+    static constexpr int cols = C;
+
+    T values[R * C] = {};
+
+    //! Zero matrix, use Identity() for the identity matrix
+    constexpr MatrixN() = default;
+    constexpr MatrixN(const MatrixN &) = default;
+    constexpr MatrixN &operator=(const MatrixN &) = default;
+
+    //! Create from all R * C values, column by column
+    template <
+        class... Args,
+        class = std::enable_if_t<sizeof...(Args) == R * C && (R * C > 1) &&
+                                 (std::is_arithmetic_v<Args> && ...)>>
+    constexpr MatrixN(Args... args) : values{static_cast<T>(args)...} {}
+
+    //! Create from the upper left part of a Matrix. The other values of the
+    //! matrix is lost if the matrix is smaller than 4x4
+    constexpr explicit MatrixN(const Matrix<T> &m) {
+        static_assert(R <= 4 && C <= 4, "matrix is larger than Matrix");
+        for (int col = 0; col < C; ++col) {
+            for (int row = 0; row < R; ++row) {
+                at(row, col) = m(row, col);
+            }
+        }
+    }
+
+    //! Convert to a Matrix, values outside of this matrix are taken from the
+    //! identity matrix
+    constexpr Matrix<T> toMatrix() const {
+        static_assert(R <= 4 && C <= 4, "matrix is larger than Matrix");
+        auto m = Matrix<T>::Identity();
+        for (int col = 0; col < C; ++col) {
+            for (int row = 0; row < R; ++row) {
+                m(row, col) = at(row, col);
+            }
+        }
+        return m;
+    }
+
+    template <int R2 = R, int C2 = C>
+    constexpr operator std::enable_if_t<R2 == 4 && C2 == 4, Matrix<T>>()
+        const {
+        return toMatrix();
+    }
+
+    constexpr T *data() {
+        return values;
+    }
+
+    constexpr const T *data() const {
+        return values;
+    }
+
+    constexpr T &at(int i) {
+        return values[i];
+    }
+
+    constexpr T at(int i) const {
+        return values[i];
+    }
+
+    constexpr T &at(int row, int col) {
+        return values[row + col * R];
+    }
+
+    constexpr T at(int row, int col) const {
+        return values[row + col * R];
+    }
+
+    constexpr T &operator[](int i) {
+        return at(i);
+    }
+
+    constexpr T operator[](int i) const {
+        return at(i);
+    }
+
+    constexpr T &operator()(int row, int col) {
+        return at(row, col);
+    }
+
+    constexpr T operator()(int row, int col) const {
+        return at(row, col);
+    }
+
+    constexpr static MatrixN Identity() {
+        static_assert(R == C, "only square matrices has identity");
+        MatrixN m;
+        for (int i = 0; i < R; ++i) {
+            m(i, i) = 1;
+        }
+        return m;
+    }
+
+    template <int K>
+    constexpr MatrixN<T, R, K> operator*(const MatrixN<T, C, K> &m) const {
+        if constexpr (R == 4 && matmath::simd::HasPack<T, 4>::value) {
+            if (!matmath::simd::isConstantEvaluated()) {
+                MatrixN<T, R, K> product;
+                multiplyColumns(m, product, std::make_index_sequence<K>{});
+                return product;
+            }
+        }
+        return multiply(m, std::make_index_sequence<R * K>{});
+    }
+
+    template <int C2 = C>
+    constexpr std::enable_if_t<C2 == R, MatrixN &> operator*=(
+        const MatrixN &m) {
+        return *this = *this * m;
+    }
+
+    constexpr MatrixN operator*(T t) const {
+        return apply([t](T a) { return a * t; });
+    }
+
+    constexpr MatrixN operator+(const MatrixN &m) const {
+        return apply(m, [](T a, T b) { return a + b; });
+    }
+
+    constexpr MatrixN operator-(const MatrixN &m) const {
+        return apply(m, [](T a, T b) { return a - b; });
+    }
+
+    //! Sum of all squared values
+    constexpr T abs2() const {
+        T sum = 0;
+        for (auto value : values) {
+            sum += value * value;
+        }
+        return sum;
+    }
+
+    constexpr MatrixN<T, C, R> transpose() const {
+        return transpose(std::make_index_sequence<R * C>{});
+    }
+
+    //! Only for square matrices
+    constexpr T determinant() const {
+        static_assert(R == C, "determinant needs a square matrix");
+        auto &m = *this;
+        if constexpr (R == 1) {
+            return m(0, 0);
+        }
+        else if constexpr (R == 2) {
+            return m(0, 0) * m(1, 1) - m(0, 1) * m(1, 0);
+        }
+        else if constexpr (R == 3) {
+            return column(0) * column(1).cross(column(2));
+        }
+        else if constexpr (R == 4) {
+            // Laplace expansion with 2x2 minors of the first two and last two
+            // rows
+            const auto s0 = m(0, 0) * m(1, 1) - m(1, 0) * m(0, 1);
+            const auto s1 = m(0, 0) * m(1, 2) - m(1, 0) * m(0, 2);
+            const auto s2 = m(0, 0) * m(1, 3) - m(1, 0) * m(0, 3);
+            const auto s3 = m(0, 1) * m(1, 2) - m(1, 1) * m(0, 2);
+            const auto s4 = m(0, 1) * m(1, 3) - m(1, 1) * m(0, 3);
+            const auto s5 = m(0, 2) * m(1, 3) - m(1, 2) * m(0, 3);
+
+            const auto c5 = m(2, 2) * m(3, 3) - m(3, 2) * m(2, 3);
+            const auto c4 = m(2, 1) * m(3, 3) - m(3, 1) * m(2, 3);
+            const auto c3 = m(2, 1) * m(3, 2) - m(3, 1) * m(2, 2);
+            const auto c2 = m(2, 0) * m(3, 3) - m(3, 0) * m(2, 3);
+            const auto c1 = m(2, 0) * m(3, 2) - m(3, 0) * m(2, 2);
+            const auto c0 = m(2, 0) * m(3, 1) - m(3, 0) * m(2, 1);
+
+            return s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+        }
+        else {
+            auto copy = m;
+            T det = 0;
+            copy.gaussJordan(nullptr, det);
+            return det;
+        }
+    }
+
+    //! Invert into out and return the determinant, see Matrix::tryInverse
+    //! If the matrix is singular 0 is returned and out is left unchanged
+    constexpr T tryInverse(MatrixN &out) const noexcept {
+        static_assert(R == C, "inverse needs a square matrix");
+        auto &m = *this;
+        if constexpr (R == 1) {
+            if (m(0, 0) != 0) {
+                out(0, 0) = 1 / m(0, 0);
+            }
+            return m(0, 0);
+        }
+        else if constexpr (R == 2) {
+            const auto det = determinant();
+            if (det != 0) {
+                const auto l = 1 / det;
+                out = {m(1, 1) * l, -m(1, 0) * l, -m(0, 1) * l, m(0, 0) * l};
+            }
+            return det;
+        }
+        else if constexpr (R == 3) {
+            // The rows of the inverse is the cross products of the columns
+            const auto c0 = column(0), c1 = column(1), c2 = column(2);
+            const auto r0 = c1.cross(c2), r1 = c2.cross(c0),
+                       r2 = c0.cross(c1);
+            const auto det = c0 * r0;
+            if (det != 0) {
+                const auto l = 1 / det;
+                // clang-format off
+                out = {
+                    r0.x * l, r1.x * l, r2.x * l,
+                    r0.y * l, r1.y * l, r2.y * l,
+                    r0.z * l, r1.z * l, r2.z * l,
+                };
+                // clang-format on
+            }
+            return det;
+        }
+        else if constexpr (R == 4) {
+            auto inverse = Matrix<T>{};
+            const auto det = toMatrix().tryInverse(inverse);
+            if (det != 0) {
+                out = MatrixN{inverse};
+            }
+            return det;
+        }
+        else {
+            auto copy = m;
+            auto inverse = Identity();
+            T det = 0;
+            copy.gaussJordan(&inverse, det);
+            if (det != 0) {
+                out = inverse;
+            }
+            return det;
+        }
+    }
+
+    //! Inverse of an invertible matrix, throws if the matrix is singular
+    constexpr MatrixN inverse() const {
+        MatrixN inv;
+        if (tryInverse(inv) == 0) {
+            throw "could not invert matrix";
+        }
+        return inv;
+    }
+
+    //! Matrix vector multiplication for 3x3 and 2x2 matrices
+    template <int R2 = R, int C2 = C>
+    constexpr std::enable_if_t<R2 == 3 && C2 == 3, VecT<T>> operator*(
+        const VecT<T> &v) const {
+        return column(0) * v.x + column(1) * v.y + column(2) * v.z;
+    }
+
+    template <int R2 = R, int C2 = C>
+    constexpr std::enable_if_t<R2 == 2 && C2 == 2, Vec2T<T>> operator*(
+        const Vec2T<T> &v) const {
+        return {at(0, 0) * v.x + at(0, 1) * v.y,
+                at(1, 0) * v.x + at(1, 1) * v.y};
+    }
+
+private:
+    template <class, int, int>
+    friend class MatrixN;
+
+    //! The first three values of a column
+    constexpr VecT<T> column(int col) const {
+        return {at(0, col), at(1, col), at(2, col)};
+    }
+
+    template <int K, size_t... I>
+    constexpr MatrixN<T, R, K> multiply(const MatrixN<T, C, K> &m,
+                                        std::index_sequence<I...>) const {
+        return {dot<I % R, I / R>(m, std::make_index_sequence<C>{})...};
+    }
+
+    //! Row `row` of this times column `col` of m
+    template <int row, int col, int K, size_t... I>
+    constexpr T dot(const MatrixN<T, C, K> &m,
+                    std::index_sequence<I...>) const {
+        return ((at(row, I) * m(I, col)) + ...);
+    }
+
+    //! Each column of the product is the columns of this weighted with a
+    //! column of m, which is one broadcast and multiplication per column
+    template <int K, size_t... I>
+    void multiplyColumns(const MatrixN<T, C, K> &m,
+                         MatrixN<T, R, K> &out,
+                         std::index_sequence<I...>) const {
+        using P = matmath::simd::Pack<T, 4>;
+        (weightedColumns<P>(m.data() + I * C, std::make_index_sequence<C>{})
+             .store(out.data() + I * R),
+         ...);
+    }
+
+    template <class P, size_t... I>
+    P weightedColumns(const T *weights, std::index_sequence<I...>) const {
+        return ((P::load(data() + I * R) * P::broadcast(weights[I])) + ...);
+    }
+
+    template <size_t... I>
+    constexpr MatrixN<T, C, R> transpose(std::index_sequence<I...>) const {
+        // Value I of the result is at row I % C, column I / C
+        return {at(I / C, I % C)...};
+    }
+
+    template <class F>
+    constexpr MatrixN apply(F f) const {
+        MatrixN ret;
+        for (int i = 0; i < R * C; ++i) {
+            ret.values[i] = f(values[i]);
+        }
+        return ret;
+    }
+
+    template <class F>
+    constexpr MatrixN apply(const MatrixN &m, F f) const {
+        MatrixN ret;
+        for (int i = 0; i < R * C; ++i) {
+            ret.values[i] = f(values[i], m.values[i]);
+        }
+        return ret;
+    }
+
+    //! Gauss Jordan elimination with partial pivoting, used for matrices
+    //! larger than 4x4. Reduces this to the identity matrix while applying
+    //! the same row operations to inverse (if not null). det is set to the
+    //! determinant, and to 0 for singular matrices
+    constexpr void gaussJordan(MatrixN *inverse, T &det) {
+        det = 1;
+        for (int col = 0; col < C; ++col) {
+            int pivot = col;
+            for (int row = col + 1; row < R; ++row) {
+                if (cabs(at(row, col)) > cabs(at(pivot, col))) {
+                    pivot = row;
+                }
+            }
+            if (at(pivot, col) == 0) {
+                det = 0;
+                return;
+            }
+            if (pivot != col) {
+                swapRows(pivot, col);
+                if (inverse) {
+                    inverse->swapRows(pivot, col);
+                }
+                det = -det;
+            }
+
+            const auto p = at(col, col);
+            det *= p;
+            scaleRow(col, 1 / p);
+            if (inverse) {
+                inverse->scaleRow(col, 1 / p);
+            }
+
+            for (int row = 0; row < R; ++row) {
+                if (row == col || at(row, col) == 0) {
+                    continue;
+                }
+                const auto factor = at(row, col);
+                subtractRow(row, col, factor);
+                if (inverse) {
+                    inverse->subtractRow(row, col, factor);
+                }
+            }
+        }
+    }
+
+    constexpr static T cabs(T value) {
+        return value < 0 ? -value : value;
+    }
+
+    constexpr void swapRows(int a, int b) {
+        for (int col = 0; col < C; ++col) {
+            auto tmp = at(a, col);
+            at(a, col) = at(b, col);
+            at(b, col) = tmp;
+        }
+    }
+
+    constexpr void scaleRow(int row, T factor) {
+        for (int col = 0; col < C; ++col) {
+            at(row, col) *= factor;
+        }
+    }
+
+    //! row -= source * factor
+    constexpr void subtractRow(int row, int source, T factor) {
+        for (int col = 0; col < C; ++col) {
+            at(row, col) -= at(source, col) * factor;
+        }
+    }
+};
+
+matmath_export template <class T, int R, int C>
+constexpr MatrixN<T, R, C> operator*(T t, const MatrixN<T, R, C> &m) {
+    return m * t;
+}
+
+matmath_export template <class T>
+using Matrix2T = MatrixN<T, 2, 2>;
+matmath_export template <class T>
+using Matrix3T = MatrixN<T, 3, 3>;
+matmath_export template <class T>
+using Matrix3x4T = MatrixN<T, 3, 4>;
+
+matmath_export using Matrix2f = Matrix2T<float>;
+matmath_export using Matrix2d = Matrix2T<double>;
+matmath_export using Matrix3f = Matrix3T<float>;
+matmath_export using Matrix3d = Matrix3T<double>;
+matmath_export using Matrix3x4f = Matrix3x4T<float>;
+matmath_export using Matrix3x4d = Matrix3x4T<double>;
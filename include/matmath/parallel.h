@@ -0,0 +1,221 @@
+//! Copyright © Mattias Larsson Sköld 2020
+//! Distributed under terms specified under licence.txt
+
+#pragma once
+
+#include "matmath/export.h"
+
+#ifndef matmath_use_modules
+
+#include "matrix.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#if __cplusplus >= 202002L
+#include <span>
+#endif
+
+#endif
+
+namespace matmath {
+
+//! Assumed size of a cache line, chunks of output are aligned to this so that
+//! two threads never writes to the same line
+matmath_export constexpr size_t cacheLineSize = 64;
+
+//! A fixed set of threads that runs parallelFor loops. The calling thread
+//! takes part in the work, so a pool with size n has n - 1 worker threads
+matmath_export class ThreadPool {
+public:
+    explicit ThreadPool(unsigned size = std::thread::hardware_concurrency()) {
+        for (unsigned i = 1; i < size; ++i) {
+            _threads.emplace_back([this] { work(); });
+        }
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    ~ThreadPool() {
+        {
+            auto lock = std::unique_lock{_mutex};
+            _isStopped = true;
+        }
+        _wake.notify_all();
+        for (auto &thread : _threads) {
+            thread.join();
+        }
+    }
+
+    //! Number of threads that runs the work, including the calling thread
+    unsigned size() const {
+        return static_cast<unsigned>(_threads.size()) + 1;
+    }
+
+    //! Pool with one thread per core, created on first use
+    static ThreadPool &global() {
+        static auto pool = ThreadPool{};
+        return pool;
+    }
+
+    //! Call f(begin, end) for consecutive chunks of [0, count) of at most
+    //! chunk elements each, spread over the threads, and return when all
+    //! calls are done. f should not throw or call parallelFor on the same
+    //! pool. Calls from several threads are run one at a time
+    template <typename F>
+    void parallelFor(size_t count, size_t chunk, F &&f) {
+        chunk = std::max<size_t>(chunk, 1);
+        if (_threads.empty() || count <= chunk) {
+            if (count) {
+                f(size_t{0}, count);
+            }
+            return;
+        }
+
+        const auto function = std::function<void(size_t, size_t)>{f};
+        auto job = Job{&function, count, chunk};
+        const auto submitLock = std::unique_lock{_submitMutex};
+        {
+            auto lock = std::unique_lock{_mutex};
+            _job = &job;
+            ++_generation;
+        }
+        _wake.notify_all();
+
+        run(job);
+
+        auto lock = std::unique_lock{_mutex};
+        _job = nullptr;
+        _done.wait(lock, [this] { return _active == 0; });
+    }
+
+    //! Number of elements per chunk when count elements of elementSize bytes
+    //! are split between the threads. Each thread gets a few chunks for load
+    //! balancing, and chunks are whole cache lines if the array starts on a
+    //! cache line
+    size_t chunkSize(size_t count, size_t elementSize) const {
+        // Elements needed to end exactly on a cache line
+        auto step = size_t{1};
+        while ((step * elementSize) % cacheLineSize != 0 &&
+               step < cacheLineSize) {
+            ++step;
+        }
+
+        // Small chunks are not worth the synchronization
+        constexpr size_t minBytes = 16 * 1024;
+        auto chunk = count / (size() * 4);
+        chunk = std::max(chunk, minBytes / std::max<size_t>(elementSize, 1));
+        return (chunk + step - 1) / step * step;
+    }
+
+private:
+    struct Job {
+        const std::function<void(size_t, size_t)> *f;
+        size_t count;
+        size_t chunk;
+        std::atomic<size_t> next{0};
+    };
+
+    static void run(Job &job) {
+        for (auto begin = job.next.fetch_add(job.chunk); begin < job.count;
+             begin = job.next.fetch_add(job.chunk)) {
+            (*job.f)(begin, std::min(begin + job.chunk, job.count));
+        }
+    }
+
+    void work() {
+        auto lock = std::unique_lock{_mutex};
+        uint64_t generation = 0;
+        for (;;) {
+            _wake.wait(lock, [&] {
+                return _isStopped || _generation != generation;
+            });
+            if (_isStopped) {
+                return;
+            }
+            generation = _generation;
+            const auto job = _job;
+            if (!job) {
+                continue;
+            }
+
+            ++_active;
+            lock.unlock();
+            run(*job);
+            lock.lock();
+            if (--_active == 0) {
+                _done.notify_all();
+            }
+        }
+    }
+
+    std::vector<std::thread> _threads;
+    std::mutex _submitMutex;
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::condition_variable _done;
+    Job *_job = nullptr;
+    uint64_t _generation = 0;
+    unsigned _active = 0;
+    bool _isStopped = false;
+};
+
+//! out[i] = a[i] * b[i] for count matrices, split over the threads of pool.
+//! out may be the same array as a or b
+matmath_export template <typename T>
+void multiply(const Matrix<T> *a,
+              const Matrix<T> *b,
+              Matrix<T> *out,
+              size_t count,
+              ThreadPool &pool = ThreadPool::global()) {
+    pool.parallelFor(
+        count,
+        pool.chunkSize(count, sizeof(Matrix<T>)),
+        [=](size_t begin, size_t end) {
+            const auto n = end - begin;
+            Matrix<T>::multiply(a + begin, b + begin, out + begin, n);
+        });
+}
+
+//! out[i] = m * in[i] for count matrices, split over the threads of pool.
+//! in and out may be the same array
+matmath_export template <typename T>
+void premultiply(const Matrix<T> &m,
+                 const Matrix<T> *in,
+                 Matrix<T> *out,
+                 size_t count,
+                 ThreadPool &pool = ThreadPool::global()) {
+    pool.parallelFor(
+        count,
+        pool.chunkSize(count, sizeof(Matrix<T>)),
+        [=, &m](size_t begin, size_t end) {
+            Matrix<T>::premultiply(m, in + begin, out + begin, end - begin);
+        });
+}
+
+#if __cplusplus >= 202002L
+//! out should be at least as long as a and b
+matmath_export template <typename T>
+void multiply(std::span<const Matrix<T>> a,
+              std::span<const Matrix<T>> b,
+              std::span<Matrix<T>> out,
+              ThreadPool &pool = ThreadPool::global()) {
+    multiply(a.data(), b.data(), out.data(), a.size(), pool);
+}
+
+matmath_export template <typename T>
+void premultiply(const Matrix<T> &m,
+                 std::span<const Matrix<T>> in,
+                 std::span<Matrix<T>> out,
+                 ThreadPool &pool = ThreadPool::global()) {
+    premultiply(m, in.data(), out.data(), in.size(), pool);
+}
+#endif
+
+} // namespace matmath
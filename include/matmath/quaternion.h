@@ -11,71 +11,104 @@
 
 #ifndef matmath_use_modules
 
+#include "constmath.h"
 #include "matrix.h"
+#include "simd.h"
+#include "simdmath.h"
+#include "vec.h"
+#include <algorithm>
 #include <cmath>
+#include <cstddef>
+#include <limits>
+#include <utility>
+#if __cplusplus >= 202002L
+#include <span>
+#endif
 
 #endif
 
-matmath_export struct Quaternion {
-    typedef float T;
+//! Quaternion stored as (w, x, y, z), aligned so that it can be loaded
+//! into one simd register (one 128 bit register for float and one 256 bit
+//! register for double)
+matmath_export template <typename T>
+struct alignas(4 * sizeof(T)) QuaternionT {
     T w = 1, x = 0, y = 0, z = 0;
 
-    Quaternion() {}
-    Quaternion(T w, T x = 0, T y = 0, T z = 0) : w(w), x(x), y(y), z(z) {}
-
-    // Create quaternion from a rotation matrix
-    Quaternion(const Matrix<T> matrix) {
-        float diagonal = matrix.x1 + matrix.y2 + matrix.z3;
-        if (diagonal > 0) {
-            float w4 = (float)(sqrt(diagonal + 1.) * 2.);
-            w = w4 / 4.;
-            x = (matrix.y3 - matrix.z2) / w4;
-            y = (matrix.z1 - matrix.x3) / w4;
-            z = (matrix.x2 - matrix.y1) / w4;
-        }
-        else if ((matrix.x1 > matrix.y2) && (matrix.x1 > matrix.z3)) {
-            float x4 =
-                (float)(sqrt(1. + matrix.x1 - matrix.y2 - matrix.z3) * 2.);
-            w = (matrix.y3 - matrix.z2) / x4;
-            x = x4 / 4.;
-            y = (matrix.y1 + matrix.x2) / x4;
-            z = (matrix.z1 + matrix.x3) / x4;
-        }
-        else if (matrix.y2 > matrix.z3) {
-            float y4 =
-                (float)(sqrt(1. + matrix.y2 - matrix.x1 - matrix.z3) * 2.);
-            w = (matrix.z1 - matrix.x3) / y4;
-            x = (matrix.y1 + matrix.x2) / y4;
-            y = y4 / 4.;
-            z = (matrix.z2 + matrix.y3) / y4;
+    constexpr QuaternionT() = default;
+    constexpr QuaternionT(T w, T x = 0, T y = 0, T z = 0)
+        : w(w), x(x), y(y), z(z) {}
+
+    template <typename U>
+    constexpr explicit QuaternionT(const QuaternionT<U> &q)
+        : w(static_cast<T>(q.w)), x(static_cast<T>(q.x)),
+          y(static_cast<T>(q.y)), z(static_cast<T>(q.z)) {}
+
+    //! Create quaternion from a rotation matrix
+    //! The largest of the components is calculated from the diagonal and
+    //! the other three from sums and differences of the off diagonal values,
+    //! which gives two comparisons and a single square root, see
+    //! "Converting a Rotation Matrix to a Quaternion" by Mike Day
+    constexpr QuaternionT(const Matrix<T> &matrix) {
+        const auto &m = matrix;
+        T t = 0;
+        if (m.z3 < 0) {
+            if (m.x1 > m.y2) {
+                t = 1 + m.x1 - m.y2 - m.z3;
+                *this = {m.y3 - m.z2, t, m.y1 + m.x2, m.z1 + m.x3};
+            }
+            else {
+                t = 1 - m.x1 + m.y2 - m.z3;
+                *this = {m.z1 - m.x3, m.y1 + m.x2, t, m.z2 + m.y3};
+            }
         }
         else {
-            float z4 =
-                (float)(sqrt(1. + matrix.z3 - matrix.x1 - matrix.y2) * 2.);
-            w = (matrix.x2 - matrix.y1) / z4;
-            x = (matrix.z1 + matrix.x3) / z4;
-            y = (matrix.z2 + matrix.y3) / z4;
-            z = z4 / 4.;
+            if (m.x1 < -m.y2) {
+                t = 1 - m.x1 - m.y2 + m.z3;
+                *this = {m.x2 - m.y1, m.z1 + m.x3, m.z2 + m.y3, t};
+            }
+            else {
+                t = 1 + m.x1 + m.y2 + m.z3;
+                *this = {t, m.y3 - m.z2, m.z1 - m.x3, m.x2 - m.y1};
+            }
         }
+        *this *= T(.5) / constmath::dispatch::sqrt(t);
+    }
+
+    constexpr T *data() {
+        return &w;
+    }
+
+    constexpr const T *data() const {
+        return &w;
     }
 
-    Quaternion operator*(const Quaternion q) const {
-        //		T e = q.x, f = q.y, g = q.z, h = q.w;
-        return Quaternion(w * q.w - x * q.x - y * q.y - z * q.z,
-                          w * q.x + x * q.w + y * q.z - z * q.y,
-                          w * q.y + y * q.w + z * q.x - x * q.z,
-                          w * q.z + z * q.w + x * q.y - y * q.x);
+    constexpr QuaternionT operator*(const QuaternionT &q) const {
+        if (!matmath::simd::isConstantEvaluated()) {
+            QuaternionT product;
+            if (matmath::simd::multiplyQuaternion(
+                    data(), q.data(), product.data())) {
+                return product;
+            }
+        }
+        return QuaternionT(w * q.w - x * q.x - y * q.y - z * q.z,
+                           w * q.x + x * q.w + y * q.z - z * q.y,
+                           w * q.y + y * q.w + z * q.x - x * q.z,
+                           w * q.z + z * q.w + x * q.y - y * q.x);
     }
 
-    Quaternion &operator*=(const Quaternion q) {
+    constexpr QuaternionT &operator*=(const QuaternionT &q) {
+        if (!matmath::simd::isConstantEvaluated() &&
+            matmath::simd::multiplyQuaternion(data(), q.data(), data())) {
+            return *this;
+        }
         return *this = *this * q;
     }
 
-    Quaternion operator/(const Quaternion q) const {
+    constexpr QuaternionT operator/(const QuaternionT &q) const {
         return *this * q.inverse();
     }
 
-    Quaternion &operator*=(T value) {
+    constexpr QuaternionT &operator*=(T value) {
         w *= value;
         x *= value;
         y *= value;
@@ -83,7 +116,7 @@ matmath_export struct Quaternion {
         return *this;
     }
 
-    Quaternion &operator/=(T value) {
+    constexpr QuaternionT &operator/=(T value) {
         w /= value;
         x /= value;
         y /= value;
@@ -91,94 +124,322 @@ matmath_export struct Quaternion {
         return *this;
     }
 
-    operator Matrix<T>() const {
-        T xy = x * y;
-        T xz = x * z;
-        T xw = x * w;
-        T yz = x * z;
-        T yw = y * w;
-        T zw = z * w;
-        T x2 = x * x;
-        T y2 = y * y;
-        T z2 = z * z;
-        return Matrix<T>({1 - 2 * (y2 + z2),
-                          2 * (xy - zw),
-                          2 * (xz + yw),
-                          0,
-
-                          2 * (xy + zw),
-                          1 - 2 * (x2 + z2),
-                          2 * (yz - xw),
-                          0,
-
-                          2 * (xz - yw),
-                          2 * (yz + xw),
-                          1 - 2 * (x2 + y2),
-                          0,
-
-                          0,
-                          0,
-                          0,
-                          1});
-    }
-
-    // Interpolates between this and q using normalized lerp
-    Quaternion interpolate(const Quaternion &q, T blend) const {
-        float blendI = 1. - blend;
-        if (q.dot(*this) < 0) {
-            return Quaternion(blendI * w + blend * -q.w,
-                              blendI * x + blend * -q.x,
-                              blendI * y + blend * -q.y,
-                              blendI * z + blend * -q.z)
-                .normalize();
+    //! Rotation matrix, the inverse of the conversion from a matrix
+    constexpr operator Matrix<T>() const {
+        const T x2 = x + x, y2 = y + y, z2 = z + z;
+        const T xx = x * x2, yy = y * y2, zz = z * z2;
+        const T xy = x * y2, xz = x * z2, yz = y * z2;
+        const T xw = w * x2, yw = w * y2, zw = w * z2;
+
+        // clang-format off
+        return Matrix<T>(1 - yy - zz, xy - zw,     xz + yw,     0,
+                         xy + zw,     1 - xx - zz, yz - xw,     0,
+                         xz - yw,     yz + xw,     1 - xx - yy, 0,
+                         0,           0,           0,           1);
+        // clang-format on
+    }
+
+    //! Rotate v, same result as Matrix<T>(*this) * v without building the
+    //! matrix. Uses t = 2 (v x q), v' = v + w t + t x q where q is the
+    //! vector part, which is 15 multiplications
+    constexpr VecT<T> rotate(const VecT<T> &v) const {
+        const auto t = v.cross({x + x, y + y, z + z});
+        return v + t * w + t.cross({x, y, z});
+    }
+
+    //! Rotate count vectors from in to out. in and out may be the same array
+    void rotate(const VecT<T> *in,
+                VecT<T> *out,
+                size_t count) const noexcept {
+        static_assert(sizeof(VecT<T>) == sizeof(T) * 3,
+                      "VecT is expected to be three tightly packed values");
+
+        const auto done =
+            matmath::simd::rotate3(data(),
+                                   reinterpret_cast<const T *>(in),
+                                   reinterpret_cast<T *>(out),
+                                   count);
+        for (auto i = done; i < count; ++i) {
+            out[i] = rotate(in[i]);
         }
-        else {
-            return Quaternion(blendI * w + blend * q.w,
-                              blendI * x + blend * q.x,
-                              blendI * y + blend * q.y,
-                              blendI * z + blend * q.z)
-                .normalize();
+    }
+
+#if __cplusplus >= 202002L
+    //! out should be at least as long as in
+    void rotate(std::span<const VecT<T>> in,
+                std::span<VecT<T>> out) const noexcept {
+        rotate(in.data(), out.data(), in.size());
+    }
+#endif
+
+    //! Interpolates between this and q using normalized lerp
+    constexpr QuaternionT interpolate(const QuaternionT &q, T blend) const {
+        const T blendI = 1 - blend;
+        const T blendQ = q.dot(*this) < 0 ? -blend : blend;
+        return QuaternionT(blendI * w + blendQ * q.w,
+                           blendI * x + blendQ * q.x,
+                           blendI * y + blendQ * q.y,
+                           blendI * z + blendQ * q.z)
+            .normalize();
+    }
+
+    //! Spherical linear interpolation from this (blend = 0) to q (blend = 1)
+    //! along the shortest path, with constant angular velocity. Both
+    //! quaternions should be normalized
+    constexpr QuaternionT slerp(const QuaternionT &q, T blend) const {
+        const auto d = dot(q);
+        const T sign = d < 0 ? -1 : 1;
+        const auto cosAngle = d * sign;
+        const auto sinAngle =
+            constmath::dispatch::sqrt(std::max(1 - cosAngle * cosAngle, T(0)));
+        if (sinAngle == 0) {
+            return *this * (1 - blend) + q * (blend * sign);
         }
+
+        const auto angle = constmath::dispatch::atan2(sinAngle, cosAngle);
+        const auto a = constmath::dispatch::sin((1 - blend) * angle);
+        const auto b = constmath::dispatch::sin(blend * angle);
+        return *this * (a / sinAngle) + q * (b * sign / sinAngle);
     }
 
-    inline Quaternion operator*(T value) const {
-        return Quaternion(w * value, x * value, y * value, z * value);
+    //! Approximation of slerp that is normalized lerp with the blend value
+    //! adjusted by a polynomial in the blend value and the dot product. The
+    //! rotation differs less than 4e-5 radians from slerp, with the cost of
+    //! a normalized lerp
+    constexpr QuaternionT fastSlerp(const QuaternionT &q, T blend) const {
+        const auto d = dot(q);
+        const T sign = d < 0 ? -1 : 1;
+        const auto t = fastSlerpBlend(blend, d * sign);
+        return (*this * (1 - t) + q * (t * sign)).normalize();
     }
 
-    inline Quaternion inverse() const {
-        return conjugate() / abs2();
+    //! out[i] = a[i].slerp(b[i], blend[i]) for count quaternions, calculated
+    //! in simd registers. out may be the same array as a or b
+    static void slerp(const QuaternionT *a,
+                      const QuaternionT *b,
+                      const T *blend,
+                      QuaternionT *out,
+                      size_t count) noexcept {
+        using namespace matmath::simd;
+        blendEach(a, b, blend, out, count, [](auto d, auto t) {
+            using P = decltype(d);
+            const auto zero = P::broadcast(0), one = P::broadcast(1);
+            const auto s = sqrt(max(one - d * d, zero));
+            const auto angle = detail::atan2<T>(s, d);
+
+            P sinA, sinB, cosA, cosB;
+            detail::sincos<T>((one - t) * angle, sinA, cosA);
+            detail::sincos<T>(t * angle, sinB, cosB);
+
+            // Parallel quaternions gives s = 0, which is lerp
+            const auto parallel =
+                s < P::broadcast(std::numeric_limits<T>::min());
+            const auto safe = select(parallel, one, s);
+            return std::pair{select(parallel, one - t, sinA / safe),
+                             select(parallel, t, sinB / safe)};
+        });
     }
 
-    Quaternion &normalize() {
+    //! out[i] = a[i].fastSlerp(b[i], blend[i]), see slerp above
+    static void fastSlerp(const QuaternionT *a,
+                          const QuaternionT *b,
+                          const T *blend,
+                          QuaternionT *out,
+                          size_t count) noexcept {
+        using namespace matmath::simd;
+        blendEach(
+            a, b, blend, out, count, [](auto d, auto t) {
+                using P = decltype(d);
+                const auto one = P::broadcast(1), half = P::broadcast(.5);
+                const auto u = (t - half) * (t - half);
+                auto k = detail::polynomial(d, fastSlerpK2);
+                k = madd(k, u, detail::polynomial(d, fastSlerpK1));
+                k = madd(k, u, detail::polynomial(d, fastSlerpK0));
+                const auto corrected = madd(t * (t - half) * (t - one), k, t);
+                return std::pair{one - corrected, corrected};
+            },
+            true);
+    }
+
+#if __cplusplus >= 202002L
+    //! The arrays should be at least as long as blend
+    static void slerp(std::span<const QuaternionT> a,
+                      std::span<const QuaternionT> b,
+                      std::span<const T> blend,
+                      std::span<QuaternionT> out) noexcept {
+        slerp(a.data(), b.data(), blend.data(), out.data(), blend.size());
+    }
+
+    static void fastSlerp(std::span<const QuaternionT> a,
+                          std::span<const QuaternionT> b,
+                          std::span<const T> blend,
+                          std::span<QuaternionT> out) noexcept {
+        fastSlerp(a.data(), b.data(), blend.data(), out.data(), blend.size());
+    }
+#endif
+
+    constexpr QuaternionT operator*(T value) const {
+        return QuaternionT(w * value, x * value, y * value, z * value);
+    }
+
+    constexpr QuaternionT inverse() const {
+        auto ret = conjugate();
+        ret /= abs2();
+        return ret;
+    }
+
+    //! Normalize in place and return a reference to this
+    constexpr QuaternionT &normalize() {
+        if (!matmath::simd::isConstantEvaluated() &&
+            matmath::simd::normalize4(data(), data())) {
+            return *this;
+        }
         *this /= abs();
         return *this;
     }
 
-    Quaternion conjugate() const {
-        return Quaternion(w, -x, -y, -z);
+    constexpr QuaternionT normalized() const {
+        auto ret = *this;
+        return ret.normalize();
+    }
+
+    constexpr QuaternionT conjugate() const {
+        if (!matmath::simd::isConstantEvaluated()) {
+            QuaternionT ret;
+            if (matmath::simd::conjugateQuaternion(data(), ret.data())) {
+                return ret;
+            }
+        }
+        return QuaternionT(w, -x, -y, -z);
     }
 
-    Quaternion operator+(const Quaternion q) const {
-        return Quaternion(w + q.w, x + q.x, y + q.y, z + q.z);
+    constexpr QuaternionT operator+(const QuaternionT &q) const {
+        return QuaternionT(w + q.w, x + q.x, y + q.y, z + q.z);
     }
 
-    Quaternion operator-(const Quaternion q) const {
-        return Quaternion(w - q.w, x - q.x, y - q.y, z - q.z);
+    constexpr QuaternionT operator-(const QuaternionT &q) const {
+        return QuaternionT(w - q.w, x - q.x, y - q.y, z - q.z);
     }
 
-    T dot(Quaternion q) const {
-        return w * q.w + x * q.x + y + q.y + z * q.z;
+    constexpr QuaternionT operator-() const {
+        return QuaternionT(-w, -x, -y, -z);
+    }
+
+    constexpr T dot(const QuaternionT &q) const {
+        if (!matmath::simd::isConstantEvaluated()) {
+            T ret = 0;
+            if (matmath::simd::dot4(data(), q.data(), ret)) {
+                return ret;
+            }
+        }
+        return w * q.w + x * q.x + y * q.y + z * q.z;
     }
 
-    T abs2() const {
-        return w * w + x * x + y * y + z * z;
+    constexpr T abs2() const {
+        return dot(*this);
     }
 
-    T abs() const {
-        return sqrt(abs2());
+    constexpr T abs() const {
+        return constmath::dispatch::sqrt(abs2());
     }
 
-    inline T norm() const {
+    constexpr T norm() const {
         return abs();
     }
+
+private:
+    //! Coefficients of the fastSlerp correction, polynomials in the absolute
+    //! value of the dot product d fitted to the minimax error of the rotation
+    //! angle. The correction is k = k0(d) + k1(d) u + k2(d) u^2 where
+    //! u = (t - 1/2)^2, and the adjusted blend value is
+    //! t + t (t - 1/2) (t - 1) k
+    static constexpr double fastSlerpK0[] = {
+        0.8590718052180845,
+        -1.1410967505479583,
+        0.42751326161151193,
+        -0.23246844139426492,
+        0.09221903892218695,
+    };
+
+    static constexpr double fastSlerpK1[] = {
+        0.8176957518090909,
+        -2.2073968192549227,
+        2.4261936242229076,
+        -1.1470094292426427,
+    };
+
+    static constexpr double fastSlerpK2[] = {
+        1.1963086030530297,
+        -4.023215017220571,
+        3.2803029296459707,
+    };
+
+    template <size_t N>
+    static constexpr T polynomial(const double (&coefficients)[N], T x) {
+        T sum = static_cast<T>(coefficients[N - 1]);
+        for (size_t i = N - 1; i > 0; --i) {
+            sum = sum * x + static_cast<T>(coefficients[i - 1]);
+        }
+        return sum;
+    }
+
+    static constexpr T fastSlerpBlend(T t, T d) {
+        const auto u = (t - T(.5)) * (t - T(.5));
+        const auto k = polynomial(fastSlerpK0, d) +
+                       u * (polynomial(fastSlerpK1, d) +
+                            u * polynomial(fastSlerpK2, d));
+        return t + t * (t - T(.5)) * (t - 1) * k;
+    }
+
+    //! Blend a and b with the weights from f(d, blend) where d is the
+    //! absolute value of the dot product, and normalize the result if
+    //! shouldNormalize is set
+    template <class F>
+    static void blendEach(const QuaternionT *a,
+                          const QuaternionT *b,
+                          const T *blend,
+                          QuaternionT *out,
+                          size_t count,
+                          F f,
+                          bool shouldNormalize = false) noexcept {
+        static_assert(sizeof(QuaternionT) == sizeof(T) * 4,
+                      "QuaternionT is expected to be four packed values");
+        const auto pa = reinterpret_cast<const T *>(a);
+        const auto pb = reinterpret_cast<const T *>(b);
+        const auto po = reinterpret_cast<T *>(out);
+
+        matmath::simd::forEachPack<T>(count, [&](auto p, size_t i) {
+            using P = decltype(p);
+            P aw, ax, ay, az, bw, bx, by, bz;
+            P::load4(pa + i * 4, aw, ax, ay, az);
+            P::load4(pb + i * 4, bw, bx, by, bz);
+
+            // Shortest path
+            const auto zero = P::broadcast(0);
+            auto d = madd(aw, bw, madd(ax, bx, madd(ay, by, az * bz)));
+            const auto negative = d < zero;
+            d = select(negative, zero - d, d);
+
+            const auto weights = f(d, P::load(blend + i));
+            const auto wa = weights.first;
+            const auto wb =
+                select(negative, zero - weights.second, weights.second);
+
+            auto w = madd(aw, wa, bw * wb), x = madd(ax, wa, bx * wb);
+            auto y = madd(ay, wa, by * wb), z = madd(az, wa, bz * wb);
+            if (shouldNormalize) {
+                const auto scale =
+                    rsqrt(madd(w, w, madd(x, x, madd(y, y, z * z))));
+                w = w * scale;
+                x = x * scale;
+                y = y * scale;
+                z = z * scale;
+            }
+            P::store4(po + i * 4, w, x, y, z);
+        });
+    }
 };
+
+matmath_export using Quaternion = QuaternionT<float>;
+matmath_export using Quaternionf = QuaternionT<float>;
+matmath_export using Quaterniond = QuaternionT<double>;
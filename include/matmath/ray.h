@@ -0,0 +1,472 @@
+//! Copyright © Mattias Larsson Sköld 2020
+//! Distributed under terms specified under licence.txt
+
+#pragma once
+
+#include "matmath/export.h"
+
+#ifndef matmath_use_modules
+
+#include "aabb.h"
+#include "simd.h"
+#include "vec.h"
+#include "vecsoa.h"
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <type_traits>
+
+#endif
+
+//! Half line from origin along direction. The direction does not have to be
+//! normalized, distances along the ray are measured in multiples of it
+matmath_export template <typename T>
+struct Ray {
+    VecT<T> origin;
+    VecT<T> direction;
+
+    constexpr VecT<T> at(T distance) const {
+        return origin + direction * distance;
+    }
+};
+
+//! The closest hit found so far. Only hits closer than distance are
+//! accepted, so set distance to limit the length of the ray. The hit point
+//! is a * (1 - u - v) + b * u + c * v for the triangle (a, b, c)
+matmath_export template <typename T>
+struct RayHit {
+    T distance = std::numeric_limits<T>::max();
+    T u = 0;
+    T v = 0;
+    //! Set by the functions that test several triangles
+    size_t index = 0;
+};
+
+//! Möller–Trumbore ray triangle intersection. Updates hit and returns true
+//! if the triangle is hit in [0, hit.distance]. Rays parallel to the
+//! triangle, and triangles with zero area, are never hit
+matmath_export template <typename T>
+constexpr bool intersectTriangle(const Ray<T> &ray,
+                                 const VecT<T> &a,
+                                 const VecT<T> &b,
+                                 const VecT<T> &c,
+                                 RayHit<T> &hit) {
+    const auto edge1 = b - a;
+    const auto edge2 = c - a;
+    const auto p = ray.direction.cross(edge2);
+    const auto det = edge1 * p;
+    if (det == 0) {
+        return false;
+    }
+    const auto inverse = 1 / det;
+    const auto s = ray.origin - a;
+    const auto u = (s * p) * inverse;
+    if (u < 0 || u > 1) {
+        return false;
+    }
+    const auto q = s.cross(edge1);
+    const auto v = (ray.direction * q) * inverse;
+    const auto distance = (edge2 * q) * inverse;
+    if (v < 0 || u + v > 1 || distance < 0 || distance > hit.distance) {
+        return false;
+    }
+    hit.distance = distance;
+    hit.u = u;
+    hit.v = v;
+    return true;
+}
+
+//! Slab test. Shrinks [near, far] to the part of the ray that is inside the
+//! box and returns true if it is not empty. Rays that lies exactly in the
+//! plane of a side of the box may or may not hit it
+matmath_export template <typename T>
+bool intersectBox(const Ray<T> &ray,
+                  const AABB<T> &box,
+                  T &near,
+                  T &far) {
+    for (int i = 0; i < 3; ++i) {
+        const auto inverse = 1 / ray.direction[i];
+        auto t1 = (box.min[i] - ray.origin[i]) * inverse;
+        auto t2 = (box.max[i] - ray.origin[i]) * inverse;
+        if (t2 < t1) {
+            const auto t = t1;
+            t1 = t2;
+            t2 = t;
+        }
+        near = t1 > near ? t1 : near;
+        far = t2 < far ? t2 : far;
+    }
+    return near <= far;
+}
+
+//! Shrinks [near, far] to the part of the ray that is inside the sphere and
+//! returns true if it is not empty
+matmath_export template <typename T>
+bool intersectSphere(const Ray<T> &ray,
+                     const VecT<T> &center,
+                     T radius,
+                     T &near,
+                     T &far) {
+    const auto offset = ray.origin - center;
+    const auto a = ray.direction.abs2();
+    const auto b = offset * ray.direction;
+    const auto c = offset.abs2() - radius * radius;
+    const auto discriminant = b * b - a * c;
+    if (discriminant < 0) {
+        return false;
+    }
+    const auto root = std::sqrt(discriminant);
+    const auto t1 = (-b - root) / a;
+    const auto t2 = (-b + root) / a;
+    near = t1 > near ? t1 : near;
+    far = t2 < far ? t2 : far;
+    return near <= far;
+}
+
+//! N rays stored as one array per axis, so that they can be tested with
+//! full simd registers. N is typically 4, 8 or 16. The result of the tests
+//! are bit masks with bit i set for ray i
+matmath_export template <typename T, int N>
+struct RayPacket {
+    static_assert(N > 0 && N <= 32, "the masks are 32 bit");
+
+    //! Mask with all rays set
+    static constexpr unsigned all = N == 32 ? ~0u : (1u << N) - 1;
+
+    alignas(64) T originX[N] = {};
+    alignas(64) T originY[N] = {};
+    alignas(64) T originZ[N] = {};
+    alignas(64) T directionX[N] = {};
+    alignas(64) T directionY[N] = {};
+    alignas(64) T directionZ[N] = {};
+
+    RayPacket() = default;
+
+    //! Load N rays
+    explicit RayPacket(const Ray<T> *rays) {
+        for (int i = 0; i < N; ++i) {
+            ray(i, rays[i]);
+        }
+    }
+
+    Ray<T> ray(int i) const {
+        return {{originX[i], originY[i], originZ[i]},
+                {directionX[i], directionY[i], directionZ[i]}};
+    }
+
+    void ray(int i, const Ray<T> &ray) {
+        originX[i] = ray.origin.x;
+        originY[i] = ray.origin.y;
+        originZ[i] = ray.origin.z;
+        directionX[i] = ray.direction.x;
+        directionY[i] = ray.direction.y;
+        directionZ[i] = ray.direction.z;
+    }
+};
+
+//! The closest hits of a RayPacket, see RayHit
+matmath_export template <typename T, int N>
+struct PacketHit {
+    alignas(64) T distance[N];
+    alignas(64) T u[N] = {};
+    alignas(64) T v[N] = {};
+
+    PacketHit() {
+        for (auto &d : distance) {
+            d = std::numeric_limits<T>::max();
+        }
+    }
+
+    RayHit<T> hit(int i) const {
+        return {distance[i], u[i], v[i]};
+    }
+};
+
+//! Triangles stored as one corner and two edges, in separate arrays per
+//! axis, for testing one ray against many triangles at a time
+matmath_export template <typename T>
+struct TriangleSoA {
+    VecSoA<T> vertex;
+    VecSoA<T> edge1;
+    VecSoA<T> edge2;
+
+    void push_back(const VecT<T> &a, const VecT<T> &b, const VecT<T> &c) {
+        vertex.push_back(a);
+        edge1.push_back(b - a);
+        edge2.push_back(c - a);
+    }
+
+    size_t size() const {
+        return vertex.size();
+    }
+
+    void reserve(size_t count) {
+        vertex.reserve(count);
+        edge1.reserve(count);
+        edge2.reserve(count);
+    }
+
+    void clear() {
+        vertex.clear();
+        edge1.clear();
+        edge2.clear();
+    }
+};
+
+namespace matmath::detail {
+
+//! The widest pack that evenly divides N values
+template <typename T, int N, int S = N>
+struct PacketPackType {
+    using type = std::conditional_t<
+        S != 1 && N % S == 0 && matmath::simd::HasPack<T, S>::value,
+        matmath::simd::Pack<T, S>,
+        typename PacketPackType<T, N, S / 2>::type>;
+};
+
+template <typename T, int N>
+struct PacketPackType<T, N, 1> {
+    using type = matmath::simd::Pack<T, 1>;
+};
+
+//! One axis per pack
+template <class P>
+struct PackVec {
+    P x, y, z;
+
+    friend PackVec operator-(const PackVec &a, const PackVec &b) {
+        return {a.x - b.x, a.y - b.y, a.z - b.z};
+    }
+
+    friend P dot(const PackVec &a, const PackVec &b) {
+        return madd(a.x, b.x, madd(a.y, b.y, a.z * b.z));
+    }
+
+    friend PackVec cross(const PackVec &a, const PackVec &b) {
+        return {a.y * b.z - a.z * b.y,
+                a.z * b.x - a.x * b.z,
+                a.x * b.y - a.y * b.x};
+    }
+};
+
+template <class P, typename T>
+PackVec<P> broadcast(const VecT<T> &v) {
+    return {P::broadcast(v.x), P::broadcast(v.y), P::broadcast(v.z)};
+}
+
+template <class P, typename T>
+PackVec<P> load(const T *x, const T *y, const T *z, size_t i) {
+    return {P::load(x + i), P::load(y + i), P::load(z + i)};
+}
+
+//! Bits of the lanes of P where a Möller–Trumbore test fails, or all bits if
+//! the test could be stopped early. distance, u and v are set for the
+//! other lanes
+template <class P>
+unsigned triangleMisses(const PackVec<P> &origin,
+                        const PackVec<P> &direction,
+                        const PackVec<P> &vertex,
+                        const PackVec<P> &edge1,
+                        const PackVec<P> &edge2,
+                        P maxDistance,
+                        P &distance,
+                        P &u,
+                        P &v) {
+    constexpr unsigned all = (1u << P::size) - 1;
+    const auto zero = P::broadcast(0);
+    const auto one = P::broadcast(1);
+
+    const auto p = cross(direction, edge2);
+    const auto det = dot(edge1, p);
+    const auto parallel = ~maskBits(zero < abs(det)) & all;
+    const auto inverse = one / det;
+    const auto s = origin - vertex;
+    u = dot(s, p) * inverse;
+    auto misses = parallel | maskBits(min(u, one - u) < zero);
+    if (misses == all) {
+        return all;
+    }
+
+    const auto q = cross(s, edge1);
+    v = dot(direction, q) * inverse;
+    distance = dot(edge2, q) * inverse;
+    const auto closest =
+        min(min(v, one - (u + v)), min(distance, maxDistance - distance));
+    return misses | maskBits(closest < zero);
+}
+
+} // namespace matmath::detail
+
+//! Test N rays against one triangle. Rays that hit the triangle closer than
+//! the hits they already have are updated, and returned as a mask
+matmath_export template <typename T, int N>
+unsigned intersectTriangle(const RayPacket<T, N> &rays,
+                           const VecT<T> &a,
+                           const VecT<T> &b,
+                           const VecT<T> &c,
+                           PacketHit<T, N> &hits) noexcept {
+    using P = typename matmath::detail::PacketPackType<T, N>::type;
+    using matmath::detail::broadcast;
+    using matmath::detail::load;
+
+    const auto vertex = broadcast<P>(a);
+    const auto edge1 = broadcast<P>(b - a);
+    const auto edge2 = broadcast<P>(c - a);
+    constexpr unsigned all = (1u << P::size) - 1;
+
+    unsigned ret = 0;
+    for (int i = 0; i < N; i += P::size) {
+        const auto origin =
+            load<P>(rays.originX, rays.originY, rays.originZ, i);
+        const auto direction =
+            load<P>(rays.directionX, rays.directionY, rays.directionZ, i);
+        auto distance = P::load(hits.distance + i);
+        auto u = P{}, v = P{};
+        const auto misses = matmath::detail::triangleMisses(
+            origin, direction, vertex, edge1, edge2, distance, distance, u, v);
+        if (misses == all) {
+            continue;
+        }
+
+        // Few rays hit each triangle, so the hits are written one at a time
+        alignas(64) T values[3][P::size];
+        distance.store(values[0]);
+        u.store(values[1]);
+        v.store(values[2]);
+        for (int lane = 0; lane < P::size; ++lane) {
+            if (!((misses >> lane) & 1)) {
+                hits.distance[i + lane] = values[0][lane];
+                hits.u[i + lane] = values[1][lane];
+                hits.v[i + lane] = values[2][lane];
+            }
+        }
+        ret |= (~misses & all) << i;
+    }
+    return ret;
+}
+
+//! Mask of the rays that pass through the box closer than their hits
+matmath_export template <typename T, int N>
+unsigned intersectBox(const RayPacket<T, N> &rays,
+                      const AABB<T> &box,
+                      const PacketHit<T, N> &hits) noexcept {
+    using P = typename matmath::detail::PacketPackType<T, N>::type;
+    const auto one = P::broadcast(1);
+    const auto zero = P::broadcast(0);
+
+    unsigned ret = 0;
+    for (int i = 0; i < N; i += P::size) {
+        auto near = zero;
+        auto far = P::load(hits.distance + i);
+        const auto slab = [&](const T *origin, const T *direction, int axis) {
+            const auto o = P::load(origin + i);
+            const auto inverse = one / P::load(direction + i);
+            const auto t1 = (P::broadcast(box.min[axis]) - o) * inverse;
+            const auto t2 = (P::broadcast(box.max[axis]) - o) * inverse;
+            near = max(near, min(t1, t2));
+            far = min(far, max(t1, t2));
+        };
+        slab(rays.originX, rays.directionX, 0);
+        slab(rays.originY, rays.directionY, 1);
+        slab(rays.originZ, rays.directionZ, 2);
+        const auto misses = maskBits(far < near);
+        ret |= (~misses & ((1u << P::size) - 1)) << i;
+    }
+    return ret;
+}
+
+//! Mask of the rays that pass through the sphere closer than their hits
+matmath_export template <typename T, int N>
+unsigned intersectSphere(const RayPacket<T, N> &rays,
+                         const VecT<T> &center,
+                         T radius,
+                         const PacketHit<T, N> &hits) noexcept {
+    using P = typename matmath::detail::PacketPackType<T, N>::type;
+    using matmath::detail::load;
+    const auto c = matmath::detail::broadcast<P>(center);
+    const auto zero = P::broadcast(0);
+    const auto radius2 = P::broadcast(radius * radius);
+
+    unsigned ret = 0;
+    for (int i = 0; i < N; i += P::size) {
+        const auto direction =
+            load<P>(rays.directionX, rays.directionY, rays.directionZ, i);
+        const auto offset =
+            load<P>(rays.originX, rays.originY, rays.originZ, i) - c;
+        const auto a = dot(direction, direction);
+        const auto b = dot(offset, direction);
+        const auto discriminant =
+            b * b - a * (dot(offset, offset) - radius2);
+        const auto root = sqrt(max(discriminant, zero));
+        const auto near = max(zero, (zero - b - root) / a);
+        const auto far =
+            min(P::load(hits.distance + i), (root - b) / a);
+        const auto misses =
+            maskBits(discriminant < zero) | maskBits(far < near);
+        ret |= (~misses & ((1u << P::size) - 1)) << i;
+    }
+    return ret;
+}
+
+//! Test one ray against triangles [begin, end). The closest hit, if it is
+//! closer than hit.distance, is written to hit with index set to the
+//! triangle, and true is returned
+matmath_export template <typename T>
+bool intersectTriangles(const Ray<T> &ray,
+                        const TriangleSoA<T> &triangles,
+                        size_t begin,
+                        size_t end,
+                        RayHit<T> &hit) noexcept {
+    using matmath::detail::broadcast;
+    using matmath::detail::load;
+    auto found = false;
+
+    // The packs starts at begin, so that the closest triangle is the same
+    // as when testing them one at a time
+    matmath::simd::forEachPack<T>(end - begin, [&](auto p, size_t i) {
+        using P = decltype(p);
+        constexpr unsigned all = (1u << P::size) - 1;
+        i += begin;
+        const auto &vertex = triangles.vertex;
+        const auto &edge1 = triangles.edge1;
+        const auto &edge2 = triangles.edge2;
+
+        auto distance = P{}, u = P{}, v = P{};
+        const auto misses = matmath::detail::triangleMisses(
+            broadcast<P>(ray.origin),
+            broadcast<P>(ray.direction),
+            load<P>(vertex.x.data(), vertex.y.data(), vertex.z.data(), i),
+            load<P>(edge1.x.data(), edge1.y.data(), edge1.z.data(), i),
+            load<P>(edge2.x.data(), edge2.y.data(), edge2.z.data(), i),
+            P::broadcast(hit.distance),
+            distance,
+            u,
+            v);
+        if (misses == all) {
+            return;
+        }
+
+        alignas(64) T values[3][P::size];
+        distance.store(values[0]);
+        u.store(values[1]);
+        v.store(values[2]);
+        for (int lane = 0; lane < P::size; ++lane) {
+            if (!((misses >> lane) & 1) && values[0][lane] <= hit.distance) {
+                hit = {values[0][lane], values[1][lane], values[2][lane]};
+                hit.index = i + lane;
+                found = true;
+            }
+        }
+    });
+    return found;
+}
+
+matmath_export template <typename T>
+bool intersectTriangles(const Ray<T> &ray,
+                        const TriangleSoA<T> &triangles,
+                        RayHit<T> &hit) noexcept {
+    return intersectTriangles(ray, triangles, 0, triangles.size(), hit);
+}
+
+matmath_export using Rayf = Ray<float>;
+matmath_export using Rayd = Ray<double>;
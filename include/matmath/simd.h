@@ -0,0 +1,1645 @@
+//! Copyright © Mattias Larsson Sköld 2020
+//! Distributed under terms specified under licence.txt
+
+//! Shared simd helpers and kernels used by the other headers
+//!
+//! The kernels are selected at compile time from the instruction sets enabled
+//! for the translation unit (for example -msse4.1, -mavx2 or -march=native).
+//! Define matmath_no_simd to force the scalar code paths. See dispatch.h for
+//! kernels that are selected at runtime instead.
+
+#pragma once
+
+#include "matmath/export.h"
+
+#ifndef matmath_use_modules
+
+#include "constmath.h"
+#include <cmath>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+
+#endif
+
+#if !defined(matmath_no_simd)
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define matmath_sse2
+#endif
+#if defined(__AVX__)
+#define matmath_avx
+#endif
+#if defined(__FMA__)
+#define matmath_fma
+#endif
+#endif
+
+#if defined(matmath_sse2) && !defined(matmath_use_modules)
+#include <immintrin.h>
+#endif
+
+namespace matmath {
+namespace simd {
+
+//! Used to fall back to the scalar constexpr code in constant evaluation,
+//! since intrinsics are not constexpr.
+matmath_export using constmath::isConstantEvaluated;
+
+#if defined(matmath_sse2)
+
+//! a * b + c, fused when fma is available
+matmath_export inline __m128 madd(__m128 a, __m128 b, __m128 c) noexcept {
+#if defined(matmath_fma)
+    return _mm_fmadd_ps(a, b, c);
+#else
+    return _mm_add_ps(_mm_mul_ps(a, b), c);
+#endif
+}
+
+matmath_export inline __m128d madd(__m128d a, __m128d b, __m128d c) noexcept {
+#if defined(matmath_fma)
+    return _mm_fmadd_pd(a, b, c);
+#else
+    return _mm_add_pd(_mm_mul_pd(a, b), c);
+#endif
+}
+
+#endif
+
+#if defined(matmath_avx)
+
+matmath_export inline __m256 madd(__m256 a, __m256 b, __m256 c) noexcept {
+#if defined(matmath_fma)
+    return _mm256_fmadd_ps(a, b, c);
+#else
+    return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+}
+
+matmath_export inline __m256d madd(__m256d a, __m256d b, __m256d c) noexcept {
+#if defined(matmath_fma)
+    return _mm256_fmadd_pd(a, b, c);
+#else
+    return _mm256_add_pd(_mm256_mul_pd(a, b), c);
+#endif
+}
+
+#endif
+
+#if defined(matmath_sse2)
+
+//! Sum of the four rows weighted by w[0] to w[3]
+matmath_export inline __m128 weightedSum(
+    __m128 r0, __m128 r1, __m128 r2, __m128 r3, const float *w) noexcept {
+    auto sum = _mm_mul_ps(r0, _mm_set1_ps(w[0]));
+    sum = madd(r1, _mm_set1_ps(w[1]), sum);
+    sum = madd(r2, _mm_set1_ps(w[2]), sum);
+    return madd(r3, _mm_set1_ps(w[3]), sum);
+}
+
+matmath_export inline __m128d weightedSum(
+    __m128d r0, __m128d r1, __m128d r2, __m128d r3, const double *w) noexcept {
+    auto sum = _mm_mul_pd(r0, _mm_set1_pd(w[0]));
+    sum = madd(r1, _mm_set1_pd(w[1]), sum);
+    sum = madd(r2, _mm_set1_pd(w[2]), sum);
+    return madd(r3, _mm_set1_pd(w[3]), sum);
+}
+
+#endif
+
+#if defined(matmath_avx)
+
+matmath_export inline __m256d weightedSum(
+    __m256d r0, __m256d r1, __m256d r2, __m256d r3, const double *w) noexcept {
+    auto sum = _mm256_mul_pd(r0, _mm256_set1_pd(w[0]));
+    sum = madd(r1, _mm256_set1_pd(w[1]), sum);
+    sum = madd(r2, _mm256_set1_pd(w[2]), sum);
+    return madd(r3, _mm256_set1_pd(w[3]), sum);
+}
+
+#endif
+
+//! Multiply two 4x4 matrices stored as 16 consecutive values in the same
+//! layout as Matrix. Same result as Matrix::operator*, out = a * b.
+//! Each row of the result is the rows of a weighted by a row of b, which is
+//! one broadcast and one multiply-add per row of a.
+//! All loads are made before the first store, so out may alias a or b.
+//! Returns false if there is no simd kernel for the type, in which case
+//! nothing is written.
+matmath_export inline bool multiply4x4(const float *a,
+                                       const float *b,
+                                       float *out) noexcept {
+#if defined(matmath_sse2)
+    const auto a0 = _mm_loadu_ps(a);
+    const auto a1 = _mm_loadu_ps(a + 4);
+    const auto a2 = _mm_loadu_ps(a + 8);
+    const auto a3 = _mm_loadu_ps(a + 12);
+
+    const auto r0 = weightedSum(a0, a1, a2, a3, b);
+    const auto r1 = weightedSum(a0, a1, a2, a3, b + 4);
+    const auto r2 = weightedSum(a0, a1, a2, a3, b + 8);
+    const auto r3 = weightedSum(a0, a1, a2, a3, b + 12);
+
+    _mm_storeu_ps(out, r0);
+    _mm_storeu_ps(out + 4, r1);
+    _mm_storeu_ps(out + 8, r2);
+    _mm_storeu_ps(out + 12, r3);
+    return true;
+#else
+    return false;
+#endif
+}
+
+matmath_export inline bool multiply4x4(const double *a,
+                                       const double *b,
+                                       double *out) noexcept {
+#if defined(matmath_avx)
+    const auto a0 = _mm256_loadu_pd(a);
+    const auto a1 = _mm256_loadu_pd(a + 4);
+    const auto a2 = _mm256_loadu_pd(a + 8);
+    const auto a3 = _mm256_loadu_pd(a + 12);
+
+    const auto r0 = weightedSum(a0, a1, a2, a3, b);
+    const auto r1 = weightedSum(a0, a1, a2, a3, b + 4);
+    const auto r2 = weightedSum(a0, a1, a2, a3, b + 8);
+    const auto r3 = weightedSum(a0, a1, a2, a3, b + 12);
+
+    _mm256_storeu_pd(out, r0);
+    _mm256_storeu_pd(out + 4, r1);
+    _mm256_storeu_pd(out + 8, r2);
+    _mm256_storeu_pd(out + 12, r3);
+    return true;
+#elif defined(matmath_sse2)
+    // Without avx each row is handled as two halves of two values
+    __m128d lo[4], hi[4];
+    for (int i = 0; i < 4; ++i) {
+        lo[i] = _mm_loadu_pd(a + i * 4);
+        hi[i] = _mm_loadu_pd(a + i * 4 + 2);
+    }
+
+    __m128d rows[8];
+    for (int y = 0; y < 4; ++y) {
+        const auto w = b + y * 4;
+        rows[y * 2] = weightedSum(lo[0], lo[1], lo[2], lo[3], w);
+        rows[y * 2 + 1] = weightedSum(hi[0], hi[1], hi[2], hi[3], w);
+    }
+
+    for (int i = 0; i < 8; ++i) {
+        _mm_storeu_pd(out + i * 2, rows[i]);
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+//! Fallback for types without simd kernels
+matmath_export template <typename T>
+bool multiply4x4(const T *, const T *, T *) noexcept {
+    return false;
+}
+
+//! out[i] = a * b[i] for count matrices in the layout of multiply4x4, with a
+//! kept in registers. out may be the same array as b. Returns the number of
+//! matrices written, which is 0 if there is no simd kernel for the type
+matmath_export inline size_t premultiply4x4(const float *a,
+                                            const float *b,
+                                            float *out,
+                                            size_t count) noexcept {
+#if defined(matmath_sse2)
+    const auto a0 = _mm_loadu_ps(a);
+    const auto a1 = _mm_loadu_ps(a + 4);
+    const auto a2 = _mm_loadu_ps(a + 8);
+    const auto a3 = _mm_loadu_ps(a + 12);
+
+    for (size_t i = 0; i < count; ++i, b += 16, out += 16) {
+        const auto r0 = weightedSum(a0, a1, a2, a3, b);
+        const auto r1 = weightedSum(a0, a1, a2, a3, b + 4);
+        const auto r2 = weightedSum(a0, a1, a2, a3, b + 8);
+        const auto r3 = weightedSum(a0, a1, a2, a3, b + 12);
+
+        _mm_storeu_ps(out, r0);
+        _mm_storeu_ps(out + 4, r1);
+        _mm_storeu_ps(out + 8, r2);
+        _mm_storeu_ps(out + 12, r3);
+    }
+    return count;
+#else
+    return 0;
+#endif
+}
+
+matmath_export inline size_t premultiply4x4(const double *a,
+                                            const double *b,
+                                            double *out,
+                                            size_t count) noexcept {
+#if defined(matmath_avx)
+    const auto a0 = _mm256_loadu_pd(a);
+    const auto a1 = _mm256_loadu_pd(a + 4);
+    const auto a2 = _mm256_loadu_pd(a + 8);
+    const auto a3 = _mm256_loadu_pd(a + 12);
+
+    for (size_t i = 0; i < count; ++i, b += 16, out += 16) {
+        const auto r0 = weightedSum(a0, a1, a2, a3, b);
+        const auto r1 = weightedSum(a0, a1, a2, a3, b + 4);
+        const auto r2 = weightedSum(a0, a1, a2, a3, b + 8);
+        const auto r3 = weightedSum(a0, a1, a2, a3, b + 12);
+
+        _mm256_storeu_pd(out, r0);
+        _mm256_storeu_pd(out + 4, r1);
+        _mm256_storeu_pd(out + 8, r2);
+        _mm256_storeu_pd(out + 12, r3);
+    }
+    return count;
+#else
+    return 0;
+#endif
+}
+
+matmath_export template <typename T>
+size_t premultiply4x4(const T *, const T *, T *, size_t) noexcept {
+    return 0;
+}
+
+//! Same as multiply4x4 but for affine matrices stored as 12 values without
+//! the w values (see AffineMatrix). out may alias a or b.
+matmath_export inline bool multiplyAffine(const float *a,
+                                          const float *b,
+                                          float *out) noexcept {
+#if defined(matmath_sse2)
+    // The last value of each register is the first value of the next row
+    const auto a0 = _mm_loadu_ps(a);
+    const auto a1 = _mm_loadu_ps(a + 3);
+    const auto a2 = _mm_loadu_ps(a + 6);
+    // Loaded from a + 8 to not read outside the matrix
+    const auto a3 = _mm_loadu_ps(a + 8);
+    const auto translation = _mm_shuffle_ps(a3, a3, _MM_SHUFFLE(3, 3, 2, 1));
+
+    auto row = [&](const float *w) {
+        auto sum = _mm_mul_ps(a0, _mm_set1_ps(w[0]));
+        sum = madd(a1, _mm_set1_ps(w[1]), sum);
+        return madd(a2, _mm_set1_ps(w[2]), sum);
+    };
+
+    const auto r0 = row(b);
+    const auto r1 = row(b + 3);
+    const auto r2 = row(b + 6);
+    const auto r3 = _mm_add_ps(row(b + 9), translation);
+
+    // Pack the 12 values into three registers
+    const auto r01 = _mm_shuffle_ps(r0, r1, _MM_SHUFFLE(0, 0, 2, 2));
+    const auto r23 = _mm_shuffle_ps(r2, r3, _MM_SHUFFLE(0, 0, 2, 2));
+    _mm_storeu_ps(out, _mm_shuffle_ps(r0, r01, _MM_SHUFFLE(2, 0, 1, 0)));
+    _mm_storeu_ps(out + 4, _mm_shuffle_ps(r1, r2, _MM_SHUFFLE(1, 0, 2, 1)));
+    _mm_storeu_ps(out + 8, _mm_shuffle_ps(r23, r3, _MM_SHUFFLE(2, 1, 2, 0)));
+    return true;
+#else
+    return false;
+#endif
+}
+
+matmath_export template <typename T>
+bool multiplyAffine(const T *, const T *, T *) noexcept {
+    return false;
+}
+
+#if defined(matmath_sse2)
+
+//! (v[x], v[y], v[z], v[w])
+template <int x, int y, int z, int w>
+__m128 swizzle(__m128 v) noexcept {
+    return _mm_shuffle_ps(v, v, _MM_SHUFFLE(w, z, y, x));
+}
+
+//! (a[x], a[y], b[z], b[w])
+template <int x, int y, int z, int w>
+__m128 shuffle(__m128 a, __m128 b) noexcept {
+    return _mm_shuffle_ps(a, b, _MM_SHUFFLE(w, z, y, x));
+}
+
+//! Helpers for 2x2 matrices stored in one register, used by inverse4x4
+//! a * b
+inline __m128 mat2Mul(__m128 a, __m128 b) noexcept {
+    return _mm_add_ps(
+        _mm_mul_ps(a, swizzle<0, 3, 0, 3>(b)),
+        _mm_mul_ps(swizzle<1, 0, 3, 2>(a), swizzle<2, 1, 2, 1>(b)));
+}
+
+//! adjugate(a) * b
+inline __m128 mat2AdjMul(__m128 a, __m128 b) noexcept {
+    return _mm_sub_ps(
+        _mm_mul_ps(swizzle<3, 3, 0, 0>(a), b),
+        _mm_mul_ps(swizzle<1, 1, 2, 2>(a), swizzle<2, 3, 0, 1>(b)));
+}
+
+//! a * adjugate(b)
+inline __m128 mat2MulAdj(__m128 a, __m128 b) noexcept {
+    return _mm_sub_ps(
+        _mm_mul_ps(a, swizzle<3, 0, 3, 0>(b)),
+        _mm_mul_ps(swizzle<1, 0, 3, 2>(a), swizzle<2, 1, 2, 1>(b)));
+}
+
+#endif
+
+//! Invert a 4x4 matrix with the same layout as Matrix and set det to its
+//! determinant. If the determinant is 0 out is not written.
+//! The matrix is split in four 2x2 blocks, and the inverse is built from
+//! the adjugates and determinants of the blocks, see
+//! https://lxjk.github.io/2017/09/03/Fast-4x4-Matrix-Inverse-with-SSE-SIMD-Explained.html
+//! Returns false if there is no simd kernel for the type.
+matmath_export inline bool inverse4x4(const float *m,
+                                      float *out,
+                                      float &det) noexcept {
+#if defined(matmath_sse2)
+    const auto r0 = _mm_loadu_ps(m);
+    const auto r1 = _mm_loadu_ps(m + 4);
+    const auto r2 = _mm_loadu_ps(m + 8);
+    const auto r3 = _mm_loadu_ps(m + 12);
+
+    // The blocks
+    // | a b |
+    // | c d |
+    const auto a = _mm_movelh_ps(r0, r1);
+    const auto b = _mm_movehl_ps(r1, r0);
+    const auto c = _mm_movelh_ps(r2, r3);
+    const auto d = _mm_movehl_ps(r3, r2);
+
+    // Determinants of the blocks as (|a|, |b|, |c|, |d|)
+    const auto detSub =
+        _mm_sub_ps(_mm_mul_ps(shuffle<0, 2, 0, 2>(r0, r2),
+                              shuffle<1, 3, 1, 3>(r1, r3)),
+                   _mm_mul_ps(shuffle<1, 3, 1, 3>(r0, r2),
+                              shuffle<0, 2, 0, 2>(r1, r3)));
+    const auto detA = swizzle<0, 0, 0, 0>(detSub);
+    const auto detB = swizzle<1, 1, 1, 1>(detSub);
+    const auto detC = swizzle<2, 2, 2, 2>(detSub);
+    const auto detD = swizzle<3, 3, 3, 3>(detSub);
+
+    // # means adjugate
+    const auto dc = mat2AdjMul(d, c); // d#c
+    const auto ab = mat2AdjMul(a, b); // a#b
+
+    // The blocks of the inverse before they are divided with the determinant
+    // x# = |d|a - b(d#c)
+    auto x = _mm_sub_ps(_mm_mul_ps(detD, a), mat2Mul(b, dc));
+    // w# = |a|d - c(a#b)
+    auto w = _mm_sub_ps(_mm_mul_ps(detA, d), mat2Mul(c, ab));
+    // y# = |b|c - d(a#b)#
+    auto y = _mm_sub_ps(_mm_mul_ps(detB, c), mat2MulAdj(d, ab));
+    // z# = |c|b - a(d#c)#
+    auto z = _mm_sub_ps(_mm_mul_ps(detC, b), mat2MulAdj(a, dc));
+
+    // |m| = |a||d| + |b||c| - tr((a#b)(d#c))
+    auto tr = _mm_mul_ps(ab, swizzle<0, 2, 1, 3>(dc));
+    tr = _mm_add_ps(tr, swizzle<1, 0, 3, 2>(tr));
+    tr = _mm_add_ps(tr, swizzle<2, 3, 0, 1>(tr));
+    const auto detM = _mm_sub_ps(
+        _mm_add_ps(_mm_mul_ps(detA, detD), _mm_mul_ps(detB, detC)), tr);
+
+    det = _mm_cvtss_f32(detM);
+    if (det == 0) {
+        return true;
+    }
+
+    const auto rDetM = _mm_div_ps(_mm_setr_ps(1, -1, -1, 1), detM);
+    x = _mm_mul_ps(x, rDetM);
+    y = _mm_mul_ps(y, rDetM);
+    z = _mm_mul_ps(z, rDetM);
+    w = _mm_mul_ps(w, rDetM);
+
+    // Apply the adjugate of the blocks while storing
+    _mm_storeu_ps(out, shuffle<3, 1, 3, 1>(x, y));
+    _mm_storeu_ps(out + 4, shuffle<2, 0, 2, 0>(x, y));
+    _mm_storeu_ps(out + 8, shuffle<3, 1, 3, 1>(z, w));
+    _mm_storeu_ps(out + 12, shuffle<2, 0, 2, 0>(z, w));
+    return true;
+#else
+    return false;
+#endif
+}
+
+matmath_export template <typename T>
+bool inverse4x4(const T *, T *, T &) noexcept {
+    return false;
+}
+
+//! Hamilton product of two quaternions stored as (w, x, y, z), out = a * b.
+//! The product is the lanes of b permuted and sign flipped, weighted by
+//! each value of a:
+//!   aw * ( bw,  bx,  by,  bz) + ax * (-bx,  bw, -bz,  by) +
+//!   ay * (-by,  bz,  bw, -bx) + az * (-bz, -by,  bx,  bw)
+//! out may alias a or b. Returns false if there is no simd kernel for the
+//! type, in which case nothing is written.
+matmath_export inline bool multiplyQuaternion(const float *a,
+                                              const float *b,
+                                              float *out) noexcept {
+#if defined(matmath_sse2)
+    const auto qb = _mm_loadu_ps(b);
+    const auto b1 = _mm_xor_ps(swizzle<1, 0, 3, 2>(qb),
+                               _mm_setr_ps(-0.f, 0.f, -0.f, 0.f));
+    const auto b2 = _mm_xor_ps(swizzle<2, 3, 0, 1>(qb),
+                               _mm_setr_ps(-0.f, 0.f, 0.f, -0.f));
+    const auto b3 = _mm_xor_ps(swizzle<3, 2, 1, 0>(qb),
+                               _mm_setr_ps(-0.f, -0.f, 0.f, 0.f));
+    _mm_storeu_ps(out, weightedSum(qb, b1, b2, b3, a));
+    return true;
+#else
+    return false;
+#endif
+}
+
+matmath_export inline bool multiplyQuaternion(const double *a,
+                                              const double *b,
+                                              double *out) noexcept {
+#if defined(matmath_avx)
+    const auto qb = _mm256_loadu_pd(b);
+    const auto swapped = _mm256_permute2f128_pd(qb, qb, 1);
+    const auto b1 = _mm256_xor_pd(_mm256_permute_pd(qb, 0b0101),
+                                  _mm256_setr_pd(-0., 0., -0., 0.));
+    const auto b2 =
+        _mm256_xor_pd(swapped, _mm256_setr_pd(-0., 0., 0., -0.));
+    const auto b3 = _mm256_xor_pd(_mm256_permute_pd(swapped, 0b0101),
+                                  _mm256_setr_pd(-0., -0., 0., 0.));
+    _mm256_storeu_pd(out, weightedSum(qb, b1, b2, b3, a));
+    return true;
+#elif defined(matmath_sse2)
+    // (w, x) and (y, z) in separate registers
+    const auto lo = _mm_loadu_pd(b);
+    const auto hi = _mm_loadu_pd(b + 2);
+    const auto swapLo = _mm_shuffle_pd(lo, lo, 1);
+    const auto swapHi = _mm_shuffle_pd(hi, hi, 1);
+    const auto first = _mm_setr_pd(-0., 0.);
+    const auto rLo = weightedSum(lo,
+                                 _mm_xor_pd(swapLo, first),
+                                 _mm_xor_pd(hi, first),
+                                 _mm_xor_pd(swapHi, _mm_set1_pd(-0.)),
+                                 a);
+    const auto rHi = weightedSum(hi,
+                                 _mm_xor_pd(swapHi, first),
+                                 _mm_xor_pd(lo, _mm_setr_pd(0., -0.)),
+                                 swapLo,
+                                 a);
+    _mm_storeu_pd(out, rLo);
+    _mm_storeu_pd(out + 2, rHi);
+    return true;
+#else
+    return false;
+#endif
+}
+
+matmath_export template <typename T>
+bool multiplyQuaternion(const T *, const T *, T *) noexcept {
+    return false;
+}
+
+//! (w, -x, -y, -z) for a quaternion stored as (w, x, y, z)
+matmath_export inline bool conjugateQuaternion(const float *q,
+                                               float *out) noexcept {
+#if defined(matmath_sse2)
+    _mm_storeu_ps(out,
+                  _mm_xor_ps(_mm_loadu_ps(q),
+                             _mm_setr_ps(0.f, -0.f, -0.f, -0.f)));
+    return true;
+#else
+    return false;
+#endif
+}
+
+matmath_export inline bool conjugateQuaternion(const double *q,
+                                               double *out) noexcept {
+#if defined(matmath_avx)
+    _mm256_storeu_pd(out,
+                     _mm256_xor_pd(_mm256_loadu_pd(q),
+                                   _mm256_setr_pd(0., -0., -0., -0.)));
+    return true;
+#elif defined(matmath_sse2)
+    _mm_storeu_pd(out, _mm_xor_pd(_mm_loadu_pd(q), _mm_setr_pd(0., -0.)));
+    _mm_storeu_pd(out + 2, _mm_xor_pd(_mm_loadu_pd(q + 2), _mm_set1_pd(-0.)));
+    return true;
+#else
+    return false;
+#endif
+}
+
+matmath_export template <typename T>
+bool conjugateQuaternion(const T *, T *) noexcept {
+    return false;
+}
+
+#if defined(matmath_sse2)
+
+//! Sum of the four products a[i] * b[i] in all lanes
+inline __m128 dot4(__m128 a, __m128 b) noexcept {
+    const auto product = _mm_mul_ps(a, b);
+    const auto sum = _mm_add_ps(product, swizzle<1, 0, 3, 2>(product));
+    return _mm_add_ps(sum, swizzle<2, 3, 0, 1>(sum));
+}
+
+//! Sum of the products of (a0, a1) * (b0, b1) and (a2, a3) * (b2, b3) in
+//! both lanes
+inline __m128d dot4(__m128d a0, __m128d a1, __m128d b0, __m128d b1) noexcept {
+    const auto sum = madd(a1, b1, _mm_mul_pd(a0, b0));
+    return _mm_add_pd(sum, _mm_shuffle_pd(sum, sum, 1));
+}
+
+#endif
+
+#if defined(matmath_avx)
+
+inline __m256d dot4(__m256d a, __m256d b) noexcept {
+    const auto product = _mm256_mul_pd(a, b);
+    const auto sum = _mm256_add_pd(
+        product, _mm256_permute2f128_pd(product, product, 1));
+    return _mm256_add_pd(sum, _mm256_permute_pd(sum, 0b0101));
+}
+
+#endif
+
+//! Dot product of two arrays of four values. Returns false if there is no
+//! simd kernel for the type, in which case out is not written.
+matmath_export inline bool dot4(const float *a,
+                                const float *b,
+                                float &out) noexcept {
+#if defined(matmath_sse2)
+    out = _mm_cvtss_f32(dot4(_mm_loadu_ps(a), _mm_loadu_ps(b)));
+    return true;
+#else
+    return false;
+#endif
+}
+
+matmath_export inline bool dot4(const double *a,
+                                const double *b,
+                                double &out) noexcept {
+#if defined(matmath_avx)
+    out = _mm256_cvtsd_f64(dot4(_mm256_loadu_pd(a), _mm256_loadu_pd(b)));
+    return true;
+#elif defined(matmath_sse2)
+    out = _mm_cvtsd_f64(dot4(_mm_loadu_pd(a),
+                             _mm_loadu_pd(a + 2),
+                             _mm_loadu_pd(b),
+                             _mm_loadu_pd(b + 2)));
+    return true;
+#else
+    return false;
+#endif
+}
+
+matmath_export template <typename T>
+bool dot4(const T *, const T *, T &) noexcept {
+    return false;
+}
+
+//! out = a / |a| for an array of four values. A zero vector gives nan.
+//! out may alias a. Returns false if there is no simd kernel for the type.
+matmath_export inline bool normalize4(const float *a, float *out) noexcept {
+#if defined(matmath_sse2)
+    const auto v = _mm_loadu_ps(a);
+    _mm_storeu_ps(out, _mm_div_ps(v, _mm_sqrt_ps(dot4(v, v))));
+    return true;
+#else
+    return false;
+#endif
+}
+
+matmath_export inline bool normalize4(const double *a, double *out) noexcept {
+#if defined(matmath_avx)
+    const auto v = _mm256_loadu_pd(a);
+    _mm256_storeu_pd(out, _mm256_div_pd(v, _mm256_sqrt_pd(dot4(v, v))));
+    return true;
+#elif defined(matmath_sse2)
+    const auto lo = _mm_loadu_pd(a);
+    const auto hi = _mm_loadu_pd(a + 2);
+    const auto length = _mm_sqrt_pd(dot4(lo, hi, lo, hi));
+    _mm_storeu_pd(out, _mm_div_pd(lo, length));
+    _mm_storeu_pd(out + 2, _mm_div_pd(hi, length));
+    return true;
+#else
+    return false;
+#endif
+}
+
+matmath_export template <typename T>
+bool normalize4(const T *, T *) noexcept {
+    return false;
+}
+
+//! Cross product of the first three values of a and b, with 0 as the fourth
+//! value (for finite input). out may alias a or b. Returns false if there is
+//! no simd kernel for the type
+matmath_export inline bool cross4(const float *a,
+                                  const float *b,
+                                  float *out) noexcept {
+#if defined(matmath_sse2)
+    const auto va = _mm_loadu_ps(a), vb = _mm_loadu_ps(b);
+    const auto product = _mm_sub_ps(
+        _mm_mul_ps(va, swizzle<1, 2, 0, 3>(vb)),
+        _mm_mul_ps(swizzle<1, 2, 0, 3>(va), vb));
+    _mm_storeu_ps(out, swizzle<1, 2, 0, 3>(product));
+    return true;
+#else
+    return false;
+#endif
+}
+
+matmath_export template <typename T>
+bool cross4(const T *, const T *, T *) noexcept {
+    return false;
+}
+
+//! out[i] = m * in[i] for count arrays of four values (homogeneous
+//! coordinates), with the matrix m in the layout of multiply4x4 kept in
+//! registers. in and out may be the same array. Returns the number of values
+//! written, which is 0 if there is no simd kernel for the type
+matmath_export inline size_t transform4(const float *m,
+                                        const float *in,
+                                        float *out,
+                                        size_t count) noexcept {
+#if defined(matmath_sse2)
+    const auto r0 = _mm_loadu_ps(m);
+    const auto r1 = _mm_loadu_ps(m + 4);
+    const auto r2 = _mm_loadu_ps(m + 8);
+    const auto r3 = _mm_loadu_ps(m + 12);
+
+    for (size_t i = 0; i < count; ++i) {
+        _mm_storeu_ps(out + i * 4, weightedSum(r0, r1, r2, r3, in + i * 4));
+    }
+    return count;
+#else
+    return 0;
+#endif
+}
+
+matmath_export inline size_t transform4(const double *m,
+                                        const double *in,
+                                        double *out,
+                                        size_t count) noexcept {
+#if defined(matmath_avx)
+    const auto r0 = _mm256_loadu_pd(m);
+    const auto r1 = _mm256_loadu_pd(m + 4);
+    const auto r2 = _mm256_loadu_pd(m + 8);
+    const auto r3 = _mm256_loadu_pd(m + 12);
+
+    for (size_t i = 0; i < count; ++i) {
+        _mm256_storeu_pd(out + i * 4,
+                         weightedSum(r0, r1, r2, r3, in + i * 4));
+    }
+    return count;
+#elif defined(matmath_sse2)
+    __m128d lo[4], hi[4];
+    for (int i = 0; i < 4; ++i) {
+        lo[i] = _mm_loadu_pd(m + i * 4);
+        hi[i] = _mm_loadu_pd(m + i * 4 + 2);
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        const auto w = in + i * 4;
+        const auto l = weightedSum(lo[0], lo[1], lo[2], lo[3], w);
+        const auto h = weightedSum(hi[0], hi[1], hi[2], hi[3], w);
+        _mm_storeu_pd(out + i * 4, l);
+        _mm_storeu_pd(out + i * 4 + 2, h);
+    }
+    return count;
+#else
+    return 0;
+#endif
+}
+
+matmath_export template <typename T>
+size_t transform4(const T *, const T *, T *, size_t) noexcept {
+    return 0;
+}
+
+#if defined(matmath_sse2)
+
+//! Shuffles used to split interleaved xyz values into one register per axis.
+//! pick<i, j>(a, b) = (a[i], a[i], b[j], b[j])
+//! combine(a, b) = (a[0], a[2], b[0], b[2])
+//! The avx versions does the same thing in each 128 bit half.
+template <int i, int j>
+__m128 pick(__m128 a, __m128 b) noexcept {
+    return _mm_shuffle_ps(a, b, _MM_SHUFFLE(j, j, i, i));
+}
+
+inline __m128 combine(__m128 a, __m128 b) noexcept {
+    return _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+#if defined(matmath_avx)
+
+template <int i, int j>
+__m256 pick(__m256 a, __m256 b) noexcept {
+    return _mm256_shuffle_ps(a, b, _MM_SHUFFLE(j, j, i, i));
+}
+
+inline __m256 combine(__m256 a, __m256 b) noexcept {
+    return _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+#endif
+
+//! Split four interleaved xyz values (loaded as a, b and c) into x, y and z
+template <class V>
+void deinterleave3(V a, V b, V c, V &x, V &y, V &z) noexcept {
+    x = combine(pick<0, 3>(a, a), pick<2, 1>(b, c));
+    y = combine(pick<1, 0>(a, b), pick<3, 2>(b, c));
+    z = combine(pick<2, 1>(a, b), pick<0, 3>(c, c));
+}
+
+//! Inverse of deinterleave3
+template <class V>
+void interleave3(V x, V y, V z, V &a, V &b, V &c) noexcept {
+    a = combine(pick<0, 0>(x, y), pick<0, 1>(z, x));
+    b = combine(pick<1, 1>(y, z), pick<2, 2>(x, y));
+    c = combine(pick<2, 3>(z, x), pick<3, 3>(y, z));
+}
+
+//! Double precision versions, two values per 128 bit half
+inline void deinterleave3(
+    __m128d a, __m128d b, __m128d c, __m128d &x, __m128d &y, __m128d &z) {
+    x = _mm_shuffle_pd(a, b, 2);
+    y = _mm_shuffle_pd(a, c, 1);
+    z = _mm_shuffle_pd(b, c, 2);
+}
+
+inline void interleave3(
+    __m128d x, __m128d y, __m128d z, __m128d &a, __m128d &b, __m128d &c) {
+    a = _mm_shuffle_pd(x, y, 0);
+    b = _mm_shuffle_pd(z, x, 2);
+    c = _mm_shuffle_pd(y, z, 3);
+}
+
+#if defined(matmath_avx)
+
+inline void deinterleave3(
+    __m256d a, __m256d b, __m256d c, __m256d &x, __m256d &y, __m256d &z) {
+    x = _mm256_shuffle_pd(a, b, 0b1010);
+    y = _mm256_shuffle_pd(a, c, 0b0101);
+    z = _mm256_shuffle_pd(b, c, 0b1010);
+}
+
+inline void interleave3(
+    __m256d x, __m256d y, __m256d z, __m256d &a, __m256d &b, __m256d &c) {
+    a = _mm256_shuffle_pd(x, y, 0);
+    b = _mm256_shuffle_pd(z, x, 0b1010);
+    c = _mm256_shuffle_pd(y, z, 0b1111);
+}
+
+#endif
+
+#endif
+
+//! Thin wrapper around a native vector register with N lanes of T, so that
+//! batch kernels can be written once for all register widths.
+//! load3 and store3 converts between interleaved xyz values (like an array
+//! of VecT) and one pack per axis, load4 and store4 does the same for four
+//! values (like an array of QuaternionT).
+matmath_export template <typename T, int N>
+struct Pack;
+
+//! Single value version used for the values that does not fill a whole
+//! register, and for types without simd support
+matmath_export template <typename T>
+struct Pack<T, 1> {
+    static constexpr int size = 1;
+    T v;
+
+    static Pack load(const T *p) noexcept {
+        return {*p};
+    }
+
+    static Pack broadcast(T value) noexcept {
+        return {value};
+    }
+
+    void store(T *p) const noexcept {
+        *p = v;
+    }
+
+    static void load3(const T *p, Pack &x, Pack &y, Pack &z) noexcept {
+        x.v = p[0];
+        y.v = p[1];
+        z.v = p[2];
+    }
+
+    static void store3(T *p, Pack x, Pack y, Pack z) noexcept {
+        p[0] = x.v;
+        p[1] = y.v;
+        p[2] = z.v;
+    }
+
+    static void load4(const T *p, Pack &x, Pack &y, Pack &z, Pack &w) noexcept {
+        x.v = p[0];
+        y.v = p[1];
+        z.v = p[2];
+        w.v = p[3];
+    }
+
+    static void store4(T *p, Pack x, Pack y, Pack z, Pack w) noexcept {
+        p[0] = x.v;
+        p[1] = y.v;
+        p[2] = z.v;
+        p[3] = w.v;
+    }
+
+    friend Pack operator+(Pack a, Pack b) noexcept {
+        return {a.v + b.v};
+    }
+
+    friend Pack operator-(Pack a, Pack b) noexcept {
+        return {a.v - b.v};
+    }
+
+    friend Pack operator*(Pack a, Pack b) noexcept {
+        return {a.v * b.v};
+    }
+
+    friend Pack madd(Pack a, Pack b, Pack c) noexcept {
+        return {a.v * b.v + c.v};
+    }
+
+    friend Pack operator/(Pack a, Pack b) noexcept {
+        return {a.v / b.v};
+    }
+
+    friend Pack sqrt(Pack a) noexcept {
+        using std::sqrt;
+        return {sqrt(a.v)};
+    }
+
+    //! 1 / sqrt(a), approximated for float when there is a simd version
+    friend Pack rsqrt(Pack a) noexcept {
+        using std::sqrt;
+        return {T(1) / sqrt(a.v)};
+    }
+
+    friend Pack abs(Pack a) noexcept {
+        using std::abs;
+        return {abs(a.v)};
+    }
+
+    friend Pack min(Pack a, Pack b) noexcept {
+        return {b.v < a.v ? b.v : a.v};
+    }
+
+    friend Pack max(Pack a, Pack b) noexcept {
+        return {a.v < b.v ? b.v : a.v};
+    }
+
+    //! Comparisons gives masks that should only be used with select
+    friend Pack operator<(Pack a, Pack b) noexcept {
+        return {a.v < b.v ? T(1) : T(0)};
+    }
+
+    //! mask ? a : b for each lane
+    friend Pack select(Pack mask, Pack a, Pack b) noexcept {
+        return mask.v != 0 ? a : b;
+    }
+
+    //! One bit per lane of a mask, with the first lane in the lowest bit
+    friend unsigned maskBits(Pack mask) noexcept {
+        return mask.v != 0;
+    }
+};
+
+#if defined(matmath_sse2)
+
+matmath_export template <>
+struct Pack<float, 4> {
+    static constexpr int size = 4;
+    __m128 v;
+
+    static Pack load(const float *p) noexcept {
+        return {_mm_loadu_ps(p)};
+    }
+
+    static Pack broadcast(float value) noexcept {
+        return {_mm_set1_ps(value)};
+    }
+
+    void store(float *p) const noexcept {
+        _mm_storeu_ps(p, v);
+    }
+
+    static void load3(const float *p, Pack &x, Pack &y, Pack &z) noexcept {
+        deinterleave3(_mm_loadu_ps(p),
+                      _mm_loadu_ps(p + 4),
+                      _mm_loadu_ps(p + 8),
+                      x.v,
+                      y.v,
+                      z.v);
+    }
+
+    static void store3(float *p, Pack x, Pack y, Pack z) noexcept {
+        __m128 a, b, c;
+        interleave3(x.v, y.v, z.v, a, b, c);
+        _mm_storeu_ps(p, a);
+        _mm_storeu_ps(p + 4, b);
+        _mm_storeu_ps(p + 8, c);
+    }
+
+    static void load4(
+        const float *p, Pack &x, Pack &y, Pack &z, Pack &w) noexcept {
+        x.v = _mm_loadu_ps(p);
+        y.v = _mm_loadu_ps(p + 4);
+        z.v = _mm_loadu_ps(p + 8);
+        w.v = _mm_loadu_ps(p + 12);
+        _MM_TRANSPOSE4_PS(x.v, y.v, z.v, w.v);
+    }
+
+    static void store4(float *p, Pack x, Pack y, Pack z, Pack w) noexcept {
+        _MM_TRANSPOSE4_PS(x.v, y.v, z.v, w.v);
+        _mm_storeu_ps(p, x.v);
+        _mm_storeu_ps(p + 4, y.v);
+        _mm_storeu_ps(p + 8, z.v);
+        _mm_storeu_ps(p + 12, w.v);
+    }
+
+    friend Pack operator+(Pack a, Pack b) noexcept {
+        return {_mm_add_ps(a.v, b.v)};
+    }
+
+    friend Pack operator-(Pack a, Pack b) noexcept {
+        return {_mm_sub_ps(a.v, b.v)};
+    }
+
+    friend Pack operator*(Pack a, Pack b) noexcept {
+        return {_mm_mul_ps(a.v, b.v)};
+    }
+
+    friend Pack madd(Pack a, Pack b, Pack c) noexcept {
+        return {madd(a.v, b.v, c.v)};
+    }
+
+    friend Pack operator/(Pack a, Pack b) noexcept {
+        return {_mm_div_ps(a.v, b.v)};
+    }
+
+    friend Pack sqrt(Pack a) noexcept {
+        return {_mm_sqrt_ps(a.v)};
+    }
+
+    friend Pack rsqrt(Pack a) noexcept {
+        // Approximation with 12 bits precision and one Newton iteration
+        const auto y = _mm_rsqrt_ps(a.v);
+        const auto ayy = _mm_mul_ps(_mm_mul_ps(a.v, y), y);
+        return {_mm_mul_ps(_mm_mul_ps(_mm_set1_ps(.5f), y),
+                           _mm_sub_ps(_mm_set1_ps(3.f), ayy))};
+    }
+
+    friend Pack abs(Pack a) noexcept {
+        return {_mm_andnot_ps(_mm_set1_ps(-0.f), a.v)};
+    }
+
+    friend Pack min(Pack a, Pack b) noexcept {
+        return {_mm_min_ps(a.v, b.v)};
+    }
+
+    friend Pack max(Pack a, Pack b) noexcept {
+        return {_mm_max_ps(a.v, b.v)};
+    }
+
+    friend Pack operator<(Pack a, Pack b) noexcept {
+        return {_mm_cmplt_ps(a.v, b.v)};
+    }
+
+    friend Pack select(Pack mask, Pack a, Pack b) noexcept {
+        return {_mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v))};
+    }
+
+    friend unsigned maskBits(Pack mask) noexcept {
+        return static_cast<unsigned>(_mm_movemask_ps(mask.v));
+    }
+
+    //! Swap lane 0 with 1, 2 with 3 and so on. Only for packs with more
+    //! than one lane
+    friend Pack swapPairs(Pack a) noexcept {
+        return {_mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(2, 3, 0, 1))};
+    }
+};
+
+matmath_export template <>
+struct Pack<double, 2> {
+    static constexpr int size = 2;
+    __m128d v;
+
+    static Pack load(const double *p) noexcept {
+        return {_mm_loadu_pd(p)};
+    }
+
+    static Pack broadcast(double value) noexcept {
+        return {_mm_set1_pd(value)};
+    }
+
+    void store(double *p) const noexcept {
+        _mm_storeu_pd(p, v);
+    }
+
+    static void load3(const double *p, Pack &x, Pack &y, Pack &z) noexcept {
+        deinterleave3(_mm_loadu_pd(p),
+                      _mm_loadu_pd(p + 2),
+                      _mm_loadu_pd(p + 4),
+                      x.v,
+                      y.v,
+                      z.v);
+    }
+
+    static void store3(double *p, Pack x, Pack y, Pack z) noexcept {
+        __m128d a, b, c;
+        interleave3(x.v, y.v, z.v, a, b, c);
+        _mm_storeu_pd(p, a);
+        _mm_storeu_pd(p + 2, b);
+        _mm_storeu_pd(p + 4, c);
+    }
+
+    static void load4(
+        const double *p, Pack &x, Pack &y, Pack &z, Pack &w) noexcept {
+        const auto lo0 = _mm_loadu_pd(p), hi0 = _mm_loadu_pd(p + 2);
+        const auto lo1 = _mm_loadu_pd(p + 4), hi1 = _mm_loadu_pd(p + 6);
+        x.v = _mm_unpacklo_pd(lo0, lo1);
+        y.v = _mm_unpackhi_pd(lo0, lo1);
+        z.v = _mm_unpacklo_pd(hi0, hi1);
+        w.v = _mm_unpackhi_pd(hi0, hi1);
+    }
+
+    static void store4(double *p, Pack x, Pack y, Pack z, Pack w) noexcept {
+        _mm_storeu_pd(p, _mm_unpacklo_pd(x.v, y.v));
+        _mm_storeu_pd(p + 2, _mm_unpacklo_pd(z.v, w.v));
+        _mm_storeu_pd(p + 4, _mm_unpackhi_pd(x.v, y.v));
+        _mm_storeu_pd(p + 6, _mm_unpackhi_pd(z.v, w.v));
+    }
+
+    friend Pack operator+(Pack a, Pack b) noexcept {
+        return {_mm_add_pd(a.v, b.v)};
+    }
+
+    friend Pack operator-(Pack a, Pack b) noexcept {
+        return {_mm_sub_pd(a.v, b.v)};
+    }
+
+    friend Pack operator*(Pack a, Pack b) noexcept {
+        return {_mm_mul_pd(a.v, b.v)};
+    }
+
+    friend Pack madd(Pack a, Pack b, Pack c) noexcept {
+        return {madd(a.v, b.v, c.v)};
+    }
+
+    friend Pack operator/(Pack a, Pack b) noexcept {
+        return {_mm_div_pd(a.v, b.v)};
+    }
+
+    friend Pack sqrt(Pack a) noexcept {
+        return {_mm_sqrt_pd(a.v)};
+    }
+
+    friend Pack rsqrt(Pack a) noexcept {
+        return {_mm_div_pd(_mm_set1_pd(1.), _mm_sqrt_pd(a.v))};
+    }
+
+    friend Pack abs(Pack a) noexcept {
+        return {_mm_andnot_pd(_mm_set1_pd(-0.), a.v)};
+    }
+
+    friend Pack min(Pack a, Pack b) noexcept {
+        return {_mm_min_pd(a.v, b.v)};
+    }
+
+    friend Pack max(Pack a, Pack b) noexcept {
+        return {_mm_max_pd(a.v, b.v)};
+    }
+
+    friend Pack operator<(Pack a, Pack b) noexcept {
+        return {_mm_cmplt_pd(a.v, b.v)};
+    }
+
+    friend Pack select(Pack mask, Pack a, Pack b) noexcept {
+        return {_mm_or_pd(_mm_and_pd(mask.v, a.v), _mm_andnot_pd(mask.v, b.v))};
+    }
+
+    friend unsigned maskBits(Pack mask) noexcept {
+        return static_cast<unsigned>(_mm_movemask_pd(mask.v));
+    }
+
+    friend Pack swapPairs(Pack a) noexcept {
+        return {_mm_shuffle_pd(a.v, a.v, 1)};
+    }
+};
+
+#endif
+
+#if defined(matmath_avx)
+
+//! The 256 bit packs are treated as two 128 bit halves in load3 and store3,
+//! the first half holds the first values and the second half the rest
+matmath_export template <>
+struct Pack<float, 8> {
+    static constexpr int size = 8;
+    __m256 v;
+
+    static Pack load(const float *p) noexcept {
+        return {_mm256_loadu_ps(p)};
+    }
+
+    static Pack broadcast(float value) noexcept {
+        return {_mm256_set1_ps(value)};
+    }
+
+    void store(float *p) const noexcept {
+        _mm256_storeu_ps(p, v);
+    }
+
+    static void load3(const float *p, Pack &x, Pack &y, Pack &z) noexcept {
+        deinterleave3(halves(p, p + 12),
+                      halves(p + 4, p + 16),
+                      halves(p + 8, p + 20),
+                      x.v,
+                      y.v,
+                      z.v);
+    }
+
+    static void store3(float *p, Pack x, Pack y, Pack z) noexcept {
+        __m256 a, b, c;
+        interleave3(x.v, y.v, z.v, a, b, c);
+        _mm_storeu_ps(p, _mm256_castps256_ps128(a));
+        _mm_storeu_ps(p + 4, _mm256_castps256_ps128(b));
+        _mm_storeu_ps(p + 8, _mm256_castps256_ps128(c));
+        _mm_storeu_ps(p + 12, _mm256_extractf128_ps(a, 1));
+        _mm_storeu_ps(p + 16, _mm256_extractf128_ps(b, 1));
+        _mm_storeu_ps(p + 20, _mm256_extractf128_ps(c, 1));
+    }
+
+    //! A 4x4 transpose in each half, the first half holds the first four
+    //! groups of values
+    static void load4(
+        const float *p, Pack &x, Pack &y, Pack &z, Pack &w) noexcept {
+        const auto r0 = halves(p, p + 16), r1 = halves(p + 4, p + 20);
+        const auto r2 = halves(p + 8, p + 24), r3 = halves(p + 12, p + 28);
+        const auto t0 = _mm256_unpacklo_ps(r0, r1);
+        const auto t1 = _mm256_unpackhi_ps(r0, r1);
+        const auto t2 = _mm256_unpacklo_ps(r2, r3);
+        const auto t3 = _mm256_unpackhi_ps(r2, r3);
+        x.v = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+        y.v = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+        z.v = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+        w.v = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+    }
+
+    static void store4(float *p, Pack x, Pack y, Pack z, Pack w) noexcept {
+        const auto t0 = _mm256_unpacklo_ps(x.v, y.v);
+        const auto t1 = _mm256_unpackhi_ps(x.v, y.v);
+        const auto t2 = _mm256_unpacklo_ps(z.v, w.v);
+        const auto t3 = _mm256_unpackhi_ps(z.v, w.v);
+        const __m256 r[] = {
+            _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0)),
+            _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2)),
+            _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0)),
+            _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2)),
+        };
+        for (int i = 0; i < 4; ++i) {
+            _mm_storeu_ps(p + i * 4, _mm256_castps256_ps128(r[i]));
+            _mm_storeu_ps(p + 16 + i * 4, _mm256_extractf128_ps(r[i], 1));
+        }
+    }
+
+    friend Pack operator+(Pack a, Pack b) noexcept {
+        return {_mm256_add_ps(a.v, b.v)};
+    }
+
+    friend Pack operator-(Pack a, Pack b) noexcept {
+        return {_mm256_sub_ps(a.v, b.v)};
+    }
+
+    friend Pack operator*(Pack a, Pack b) noexcept {
+        return {_mm256_mul_ps(a.v, b.v)};
+    }
+
+    friend Pack madd(Pack a, Pack b, Pack c) noexcept {
+        return {madd(a.v, b.v, c.v)};
+    }
+
+    friend Pack operator/(Pack a, Pack b) noexcept {
+        return {_mm256_div_ps(a.v, b.v)};
+    }
+
+    friend Pack sqrt(Pack a) noexcept {
+        return {_mm256_sqrt_ps(a.v)};
+    }
+
+    friend Pack rsqrt(Pack a) noexcept {
+        const auto y = _mm256_rsqrt_ps(a.v);
+        const auto ayy = _mm256_mul_ps(_mm256_mul_ps(a.v, y), y);
+        return {_mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(.5f), y),
+                              _mm256_sub_ps(_mm256_set1_ps(3.f), ayy))};
+    }
+
+    friend Pack abs(Pack a) noexcept {
+        return {_mm256_andnot_ps(_mm256_set1_ps(-0.f), a.v)};
+    }
+
+    friend Pack min(Pack a, Pack b) noexcept {
+        return {_mm256_min_ps(a.v, b.v)};
+    }
+
+    friend Pack max(Pack a, Pack b) noexcept {
+        return {_mm256_max_ps(a.v, b.v)};
+    }
+
+    friend Pack operator<(Pack a, Pack b) noexcept {
+        return {_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)};
+    }
+
+    friend Pack select(Pack mask, Pack a, Pack b) noexcept {
+        return {_mm256_blendv_ps(b.v, a.v, mask.v)};
+    }
+
+    friend unsigned maskBits(Pack mask) noexcept {
+        return static_cast<unsigned>(_mm256_movemask_ps(mask.v));
+    }
+
+    friend Pack swapPairs(Pack a) noexcept {
+        return {_mm256_permute_ps(a.v, _MM_SHUFFLE(2, 3, 0, 1))};
+    }
+
+private:
+    static __m256 halves(const float *low, const float *high) noexcept {
+        return _mm256_insertf128_ps(
+            _mm256_castps128_ps256(_mm_loadu_ps(low)), _mm_loadu_ps(high), 1);
+    }
+};
+
+matmath_export template <>
+struct Pack<double, 4> {
+    static constexpr int size = 4;
+    __m256d v;
+
+    static Pack load(const double *p) noexcept {
+        return {_mm256_loadu_pd(p)};
+    }
+
+    static Pack broadcast(double value) noexcept {
+        return {_mm256_set1_pd(value)};
+    }
+
+    void store(double *p) const noexcept {
+        _mm256_storeu_pd(p, v);
+    }
+
+    static void load3(const double *p, Pack &x, Pack &y, Pack &z) noexcept {
+        deinterleave3(halves(p, p + 6),
+                      halves(p + 2, p + 8),
+                      halves(p + 4, p + 10),
+                      x.v,
+                      y.v,
+                      z.v);
+    }
+
+    static void store3(double *p, Pack x, Pack y, Pack z) noexcept {
+        __m256d a, b, c;
+        interleave3(x.v, y.v, z.v, a, b, c);
+        _mm_storeu_pd(p, _mm256_castpd256_pd128(a));
+        _mm_storeu_pd(p + 2, _mm256_castpd256_pd128(b));
+        _mm_storeu_pd(p + 4, _mm256_castpd256_pd128(c));
+        _mm_storeu_pd(p + 6, _mm256_extractf128_pd(a, 1));
+        _mm_storeu_pd(p + 8, _mm256_extractf128_pd(b, 1));
+        _mm_storeu_pd(p + 10, _mm256_extractf128_pd(c, 1));
+    }
+
+    static void load4(
+        const double *p, Pack &x, Pack &y, Pack &z, Pack &w) noexcept {
+        const auto r0 = _mm256_loadu_pd(p), r1 = _mm256_loadu_pd(p + 4);
+        const auto r2 = _mm256_loadu_pd(p + 8), r3 = _mm256_loadu_pd(p + 12);
+        // (x0, x1, z0, z1), (y0, y1, w0, w1) and the same for 2 and 3
+        const auto t0 = _mm256_unpacklo_pd(r0, r1);
+        const auto t1 = _mm256_unpackhi_pd(r0, r1);
+        const auto t2 = _mm256_unpacklo_pd(r2, r3);
+        const auto t3 = _mm256_unpackhi_pd(r2, r3);
+        x.v = _mm256_permute2f128_pd(t0, t2, 0x20);
+        y.v = _mm256_permute2f128_pd(t1, t3, 0x20);
+        z.v = _mm256_permute2f128_pd(t0, t2, 0x31);
+        w.v = _mm256_permute2f128_pd(t1, t3, 0x31);
+    }
+
+    static void store4(double *p, Pack x, Pack y, Pack z, Pack w) noexcept {
+        const auto t0 = _mm256_permute2f128_pd(x.v, z.v, 0x20);
+        const auto t1 = _mm256_permute2f128_pd(y.v, w.v, 0x20);
+        const auto t2 = _mm256_permute2f128_pd(x.v, z.v, 0x31);
+        const auto t3 = _mm256_permute2f128_pd(y.v, w.v, 0x31);
+        _mm256_storeu_pd(p, _mm256_unpacklo_pd(t0, t1));
+        _mm256_storeu_pd(p + 4, _mm256_unpackhi_pd(t0, t1));
+        _mm256_storeu_pd(p + 8, _mm256_unpacklo_pd(t2, t3));
+        _mm256_storeu_pd(p + 12, _mm256_unpackhi_pd(t2, t3));
+    }
+
+    friend Pack operator+(Pack a, Pack b) noexcept {
+        return {_mm256_add_pd(a.v, b.v)};
+    }
+
+    friend Pack operator-(Pack a, Pack b) noexcept {
+        return {_mm256_sub_pd(a.v, b.v)};
+    }
+
+    friend Pack operator*(Pack a, Pack b) noexcept {
+        return {_mm256_mul_pd(a.v, b.v)};
+    }
+
+    friend Pack madd(Pack a, Pack b, Pack c) noexcept {
+        return {madd(a.v, b.v, c.v)};
+    }
+
+    friend Pack operator/(Pack a, Pack b) noexcept {
+        return {_mm256_div_pd(a.v, b.v)};
+    }
+
+    friend Pack sqrt(Pack a) noexcept {
+        return {_mm256_sqrt_pd(a.v)};
+    }
+
+    friend Pack rsqrt(Pack a) noexcept {
+        return {_mm256_div_pd(_mm256_set1_pd(1.), _mm256_sqrt_pd(a.v))};
+    }
+
+    friend Pack abs(Pack a) noexcept {
+        return {_mm256_andnot_pd(_mm256_set1_pd(-0.), a.v)};
+    }
+
+    friend Pack min(Pack a, Pack b) noexcept {
+        return {_mm256_min_pd(a.v, b.v)};
+    }
+
+    friend Pack max(Pack a, Pack b) noexcept {
+        return {_mm256_max_pd(a.v, b.v)};
+    }
+
+    friend Pack operator<(Pack a, Pack b) noexcept {
+        return {_mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ)};
+    }
+
+    friend Pack select(Pack mask, Pack a, Pack b) noexcept {
+        return {_mm256_blendv_pd(b.v, a.v, mask.v)};
+    }
+
+    friend unsigned maskBits(Pack mask) noexcept {
+        return static_cast<unsigned>(_mm256_movemask_pd(mask.v));
+    }
+
+    friend Pack swapPairs(Pack a) noexcept {
+        return {_mm256_permute_pd(a.v, 0b0101)};
+    }
+
+private:
+    static __m256d halves(const double *low, const double *high) noexcept {
+        return _mm256_insertf128_pd(
+            _mm256_castpd128_pd256(_mm_loadu_pd(low)), _mm_loadu_pd(high), 1);
+    }
+};
+
+#endif
+
+//! The widest pack available for T, or void if there is none
+matmath_export template <typename T>
+struct NativePackType {
+    using type = void;
+};
+
+#if defined(matmath_avx)
+matmath_export template <>
+struct NativePackType<float> {
+    using type = Pack<float, 8>;
+};
+
+matmath_export template <>
+struct NativePackType<double> {
+    using type = Pack<double, 4>;
+};
+#elif defined(matmath_sse2)
+matmath_export template <>
+struct NativePackType<float> {
+    using type = Pack<float, 4>;
+};
+
+matmath_export template <>
+struct NativePackType<double> {
+    using type = Pack<double, 2>;
+};
+#endif
+
+matmath_export template <typename T>
+using NativePack = typename NativePackType<T>::type;
+
+//! True if there is a Pack<T, N> for the current target
+matmath_export template <typename T, int N, class = void>
+struct HasPack : std::false_type {};
+
+matmath_export template <typename T, int N>
+struct HasPack<T, N, std::void_t<decltype(sizeof(Pack<T, N>))>>
+    : std::true_type {};
+
+//! Call f(pack, i) for each block of NativePack<T> values starting at index
+//! i and then f(Pack<T, 1>, i) for each of the remaining values. The pack
+//! argument only carries the type, so that the same generic lambda can be
+//! used for both.
+matmath_export template <typename T, class F>
+void forEachPack(size_t count, F &&f) {
+    // The trip counts are computed before the loops, otherwise gcc can warn
+    // (-Waggressive-loop-optimizations) when f is inlined and indexes with i
+    size_t i = 0;
+    using P = NativePack<T>;
+    if constexpr (!std::is_void_v<P>) {
+        const auto packs = count / P::size;
+        for (size_t j = 0; j < packs; ++j, i += P::size) {
+            f(P{}, i);
+        }
+    }
+    const auto rest = count - i;
+    for (size_t j = 0; j < rest; ++j) {
+        f(Pack<T, 1>{}, i + j);
+    }
+}
+
+//! Allocator for arrays that should start on a cache line (or any other
+//! alignment), for example to make simd loads of the first value aligned
+matmath_export template <typename T, size_t alignment = 64>
+struct AlignedAllocator {
+    using value_type = T;
+
+    template <class U>
+    struct rebind {
+        using other = AlignedAllocator<U, alignment>;
+    };
+
+    AlignedAllocator() = default;
+
+    template <class U>
+    AlignedAllocator(const AlignedAllocator<U, alignment> &) noexcept {}
+
+    T *allocate(size_t n) {
+        return static_cast<T *>(
+            ::operator new(n * sizeof(T), std::align_val_t{alignment}));
+    }
+
+    void deallocate(T *p, size_t) noexcept {
+        ::operator delete(p, std::align_val_t{alignment});
+    }
+
+    template <class U>
+    bool operator==(const AlignedAllocator<U, alignment> &) const noexcept {
+        return true;
+    }
+
+    template <class U>
+    bool operator!=(const AlignedAllocator<U, alignment> &) const noexcept {
+        return false;
+    }
+};
+
+//! How transform3 should treat the translation of the matrix
+matmath_export enum class TransformMode {
+    Point,     //!< Rotate, scale and translate
+    Direction, //!< Only rotate and scale
+};
+
+//! Transform count xyz triplets from in to out with the 4x4 matrix m (same
+//! layout as Matrix), the same way as Matrix::operator*(Vec). The values are
+//! processed in blocks of the native pack size and the number of values
+//! transformed is returned, the caller handles the rest.
+//! in and out may be the same array.
+//! Use stride 3 for matrices without the w values, like AffineMatrix.
+//! P can be set to use another pack than the native one
+matmath_export template <typename T, class P = NativePack<T>>
+size_t transform3(const T *m,
+                  const T *in,
+                  T *out,
+                  size_t count,
+                  TransformMode mode,
+                  int stride = 4) noexcept {
+    if constexpr (std::is_void_v<P>) {
+        return 0;
+    }
+    else {
+        // Named after the members of Matrix
+        const auto r1 = m, r2 = m + stride, r3 = m + stride * 2,
+                   r4 = m + stride * 3;
+        const auto x1 = P::broadcast(r1[0]), y1 = P::broadcast(r1[1]),
+                   z1 = P::broadcast(r1[2]);
+        const auto x2 = P::broadcast(r2[0]), y2 = P::broadcast(r2[1]),
+                   z2 = P::broadcast(r2[2]);
+        const auto x3 = P::broadcast(r3[0]), y3 = P::broadcast(r3[1]),
+                   z3 = P::broadcast(r3[2]);
+        const auto isPoint = mode == TransformMode::Point;
+        const auto x4 = P::broadcast(isPoint ? r4[0] : T{});
+        const auto y4 = P::broadcast(isPoint ? r4[1] : T{});
+        const auto z4 = P::broadcast(isPoint ? r4[2] : T{});
+
+        const size_t blocks = count / P::size;
+        for (size_t i = 0; i < blocks; ++i) {
+            P x, y, z;
+            P::load3(in + i * P::size * 3, x, y, z);
+            const auto ox = madd(x, x1, madd(y, x2, madd(z, x3, x4)));
+            const auto oy = madd(x, y1, madd(y, y2, madd(z, y3, y4)));
+            const auto oz = madd(x, z1, madd(y, z2, madd(z, z3, z4)));
+            P::store3(out + i * P::size * 3, ox, oy, oz);
+        }
+
+        return blocks * P::size;
+    }
+}
+
+//! Transform count axis aligned boxes stored as (min xyz, max xyz) with the
+//! matrix m, the same way as transform3, using Arvo's method: the new
+//! center is m * center and the new extents are abs(m) * extents. The
+//! number of boxes transformed is returned, the caller handles the rest.
+//! in and out may be the same array
+matmath_export template <typename T, class P = NativePack<T>>
+size_t transformBounds3(const T *m,
+                        const T *in,
+                        T *out,
+                        size_t count,
+                        int stride = 4) noexcept {
+    if constexpr (std::is_void_v<P>) {
+        return 0;
+    }
+    else {
+        // Each pack holds both corners of P::size / 2 boxes, with min in the
+        // even lanes and max in the odd lanes. Half the difference to the
+        // other corner is then -extents for min and extents for max.
+        static_assert(P::size % 2 == 0, "boxes are loaded in pairs");
+        const auto r1 = m, r2 = m + stride, r3 = m + stride * 2,
+                   r4 = m + stride * 3;
+        const auto x1 = P::broadcast(r1[0]), y1 = P::broadcast(r1[1]),
+                   z1 = P::broadcast(r1[2]);
+        const auto x2 = P::broadcast(r2[0]), y2 = P::broadcast(r2[1]),
+                   z2 = P::broadcast(r2[2]);
+        const auto x3 = P::broadcast(r3[0]), y3 = P::broadcast(r3[1]),
+                   z3 = P::broadcast(r3[2]);
+        const auto x4 = P::broadcast(r4[0]), y4 = P::broadcast(r4[1]),
+                   z4 = P::broadcast(r4[2]);
+        const auto ax1 = abs(x1), ay1 = abs(y1), az1 = abs(z1);
+        const auto ax2 = abs(x2), ay2 = abs(y2), az2 = abs(z2);
+        const auto ax3 = abs(x3), ay3 = abs(y3), az3 = abs(z3);
+        const auto half = P::broadcast(T(.5));
+
+        constexpr size_t boxesPerBlock = P::size / 2;
+        const size_t blocks = count / boxesPerBlock;
+        for (size_t i = 0; i < blocks; ++i) {
+            P x, y, z;
+            P::load3(in + i * P::size * 3, x, y, z);
+            const auto sx = swapPairs(x), sy = swapPairs(y),
+                       sz = swapPairs(z);
+            const auto cx = (x + sx) * half, cy = (y + sy) * half,
+                       cz = (z + sz) * half;
+            const auto ex = (x - sx) * half, ey = (y - sy) * half,
+                       ez = (z - sz) * half;
+
+            const auto ox = madd(cx, x1, madd(cy, x2, madd(cz, x3, x4))) +
+                            madd(ex, ax1, madd(ey, ax2, ez * ax3));
+            const auto oy = madd(cx, y1, madd(cy, y2, madd(cz, y3, y4))) +
+                            madd(ex, ay1, madd(ey, ay2, ez * ay3));
+            const auto oz = madd(cx, z1, madd(cy, z2, madd(cz, z3, z4))) +
+                            madd(ex, az1, madd(ey, az2, ez * az3));
+            P::store3(out + i * P::size * 3, ox, oy, oz);
+        }
+
+        return blocks * boxesPerBlock;
+    }
+}
+
+//! Rotate count xyz triplets from in to out with the quaternion q stored as
+//! (w, x, y, z), the same way as QuaternionT::rotate. Like transform3 the
+//! number of values rotated is returned and the caller handles the rest.
+//! in and out may be the same array.
+matmath_export template <typename T, class P = NativePack<T>>
+size_t rotate3(const T *q, const T *in, T *out, size_t count) noexcept {
+    if constexpr (std::is_void_v<P>) {
+        return 0;
+    }
+    else {
+        const auto w = P::broadcast(q[0]);
+        const auto qx = P::broadcast(q[1]), qy = P::broadcast(q[2]),
+                   qz = P::broadcast(q[3]);
+        const auto qx2 = qx + qx, qy2 = qy + qy, qz2 = qz + qz;
+
+        const size_t blocks = count / P::size;
+        for (size_t i = 0; i < blocks; ++i) {
+            P x, y, z;
+            P::load3(in + i * P::size * 3, x, y, z);
+
+            // t = 2 (v x q)
+            const auto tx = y * qz2 - z * qy2;
+            const auto ty = z * qx2 - x * qz2;
+            const auto tz = x * qy2 - y * qx2;
+
+            // v + w t + t x q
+            const auto ox = madd(w, tx, x) + (ty * qz - tz * qy);
+            const auto oy = madd(w, ty, y) + (tz * qx - tx * qz);
+            const auto oz = madd(w, tz, z) + (tx * qy - ty * qx);
+            P::store3(out + i * P::size * 3, ox, oy, oz);
+        }
+
+        return blocks * P::size;
+    }
+}
+
+} // namespace simd
+} // namespace matmath
@@ -0,0 +1,340 @@
+//! Copyright © Mattias Larsson Sköld 2020
+//! Distributed under terms specified under licence.txt
+
+//! Batch versions of sin, cos, atan2, sqrt and 1 / sqrt for arrays of float
+//! and double
+//!
+//! sincos and atan2 are evaluated with minimax polynomials on all lanes of
+//! the widest available register, without branches. The values after the
+//! last whole register are copied to a padded register, so the result for
+//! a value does not depend on its position in the array.
+//!
+//! Maximum error compared to the correctly rounded result, measured in
+//! units in the last place (ulp) with and without fma:
+//!
+//!   function   float    double
+//!   sincos     2 ulp    2 ulp     for |x| < 6000 (float), 1e8 (double)
+//!   atan2      3 ulp    3 ulp     for finite x and y
+//!   sqrt       0.5 ulp  0.5 ulp
+//!   rsqrt      4 ulp    1.5 ulp   for positive normal values
+//!
+//! The angle reduction of sincos subtracts pi / 2 in parts that gives exact
+//! products for the ranges above, so the error holds also for angles close
+//! to multiples of pi / 2. Packs with larger angles, or infinities, are
+//! slower since those lanes are calculated one at a time with std::sin and
+//! std::cos. Signed zeros and nan are not handled specially.
+
+#pragma once
+
+#include "matmath/export.h"
+
+#ifndef matmath_use_modules
+
+#include "simd.h"
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
+
+#endif
+
+namespace matmath {
+namespace simd {
+
+namespace detail {
+
+template <typename T>
+struct MathConstants;
+
+template <>
+struct MathConstants<float> {
+    //! Adding and subtracting this rounds to the nearest integer
+    static constexpr float round = 0x1.8p23f;
+
+    //! The largest angle where the reduction with pi_2 is exact
+    static constexpr float maxAngle = 6000;
+
+    //! pi / 2 split in parts of at most 12 bits, so that the products with
+    //! the quadrant are exact for quadrants below 2^12, with or without fma.
+    //! The last part is the rounded rest, in total about 78 bits
+    static constexpr float pi_2[] = {
+        0x1.92p0f, 0x1.fb4p-12f, 0x1.444p-24f, 0x1.68cp-39f, 0x1.1a6264p-54f};
+
+    //! sin(x) / x and cos(x) as polynomials in x^2 for x in [-pi/4, pi/4]
+    static constexpr float sin[] = {
+        1.f,
+        -1.666665022e-01f,
+        8.332016453e-03f,
+        -1.950182201e-04f,
+    };
+
+    static constexpr float cos[] = {
+        1.f,
+        -4.999999957e-01f,
+        4.166661323e-02f,
+        -1.388652915e-03f,
+        2.437267921e-05f,
+    };
+
+    //! atan(x) / x as polynomial in x^2 for x in [0, tan(pi / 8)]
+    static constexpr float atan[] = {
+        1.f,
+        -3.333330763e-01f,
+        1.999821695e-01f,
+        -1.424008303e-01f,
+        1.057347994e-01f,
+        -6.034790691e-02f,
+    };
+};
+
+template <>
+struct MathConstants<double> {
+    static constexpr double round = 0x1.8p52;
+
+    static constexpr double maxAngle = 1e8;
+
+    //! Parts of at most 27 bits for quadrants below 2^26, about 168 bits
+    static constexpr double pi_2[] = {0x1.921fb54p0,
+                                      0x1.10b461p-30,
+                                      0x1.a62633p-58,
+                                      0x1.45c06ep-86,
+                                      0x1.cd129024e088ap-115};
+
+    static constexpr double sin[] = {
+        1.,
+        -1.666666666666661578144e-01,
+        8.333333333320001867772e-03,
+        -1.984126982840212871477e-04,
+        2.755731329901509206654e-06,
+        -2.505070584644571094216e-08,
+        1.589413637854159929228e-10,
+    };
+
+    static constexpr double cos[] = {
+        1.,
+        -5.000000000000000000000e-01,
+        4.166666666666642843131e-02,
+        -1.388888888885896110217e-03,
+        2.480158728289947114853e-05,
+        -2.755731286569802901714e-07,
+        2.087555514593521123989e-09,
+        -1.135212321896609885407e-11,
+    };
+
+    static constexpr double atan[] = {
+        1.,
+        -3.333333333333313164282e-01,
+        1.999999999994273303106e-01,
+        -1.428571427941697780106e-01,
+        1.111111075266719705468e-01,
+        -9.090897019166005454949e-02,
+        7.692048884053130641814e-02,
+        -6.662990413300318159884e-02,
+        5.847147723725077544943e-02,
+        -5.036270404446306636626e-02,
+        3.799387351221136799317e-02,
+        -1.783567787669129017791e-02,
+    };
+};
+
+//! Polynomial in x evaluated with Horner's method
+template <class P, typename T, size_t N>
+P polynomial(P x, const T (&coefficients)[N]) noexcept {
+    auto sum = P::broadcast(coefficients[N - 1]);
+    for (size_t i = N - 1; i > 0; --i) {
+        sum = madd(sum, x, P::broadcast(coefficients[i - 1]));
+    }
+    return sum;
+}
+
+//! Round to nearest integer, valid for |x| < 2^22 (float) and 2^51 (double)
+template <typename T, class P>
+P roundNearest(P x) noexcept {
+    const auto magic = P::broadcast(MathConstants<T>::round);
+    return (x + magic) - magic;
+}
+
+template <typename T, class P>
+void sincos(P x, P &sin, P &cos) noexcept {
+    using C = MathConstants<T>;
+    const auto one = P::broadcast(1);
+
+    // x = q * pi / 2 + r where r is in [-pi / 4, pi / 4] (Cody-Waite). The
+    // products are exact and so are the differences when r is small, which
+    // keeps the precision close to multiples of pi / 2. When r is large the
+    // rounding errors of the differences are collected and added at the end
+    const auto q = roundNearest<T>(x * P::broadcast(T(2 / pi)));
+    auto r = x;
+    auto error = P::broadcast(0);
+    for (auto part : C::pi_2) {
+        const auto product = q * P::broadcast(part);
+        const auto next = r - product;
+        error = error + ((r - next) - product);
+        r = next;
+    }
+    r = r + error;
+
+    const auto r2 = r * r;
+    const auto sinR = r * polynomial(r2, C::sin);
+    const auto cosR = polynomial(r2, C::cos);
+
+    // The quadrant q mod 4 in [0, 4), the floor is calculated by rounding
+    // since all values are integers
+    const auto q4 = roundNearest<T>(q * P::broadcast(.25) -
+                                    P::broadcast(.375));
+    const auto quadrant = q - q4 * P::broadcast(4);
+    const auto half = roundNearest<T>(quadrant * P::broadcast(.5) -
+                                      P::broadcast(.25));
+    const auto odd = quadrant - half - half;
+
+    // Odd quadrants swaps sin and cos. sin is negative in quadrant 2 and 3
+    // and cos in quadrant 1 and 2
+    const auto swap = P::broadcast(.5) < odd;
+    const auto cosNegative = odd + half - P::broadcast(2) * odd * half;
+    sin = select(swap, cosR, sinR) * (one - half - half);
+    cos = select(swap, sinR, cosR) * (one - cosNegative - cosNegative);
+}
+
+//! sincos for any angle, lanes above maxAngle where the reduction is not
+//! exact (or not done at all) are calculated with std::sin and std::cos
+template <typename T, class P>
+void sincosAnyAngle(P x, P &sin, P &cos) noexcept {
+    sincos<T>(x, sin, cos);
+
+    T angles[P::size];
+    x.store(angles);
+    auto isLarge = false;
+    for (auto angle : angles) {
+        isLarge |= std::abs(angle) > MathConstants<T>::maxAngle;
+    }
+    if (!isLarge) {
+        return;
+    }
+
+    T s[P::size], c[P::size];
+    sin.store(s);
+    cos.store(c);
+    for (int i = 0; i < P::size; ++i) {
+        if (std::abs(angles[i]) > MathConstants<T>::maxAngle) {
+            s[i] = std::sin(angles[i]);
+            c[i] = std::cos(angles[i]);
+        }
+    }
+    sin = P::load(s);
+    cos = P::load(c);
+}
+
+template <typename T, class P>
+P atan2(P y, P x) noexcept {
+    using C = MathConstants<T>;
+    const auto zero = P::broadcast(0);
+    const auto one = P::broadcast(1);
+    const auto ax = abs(x), ay = abs(y);
+
+    // atan of the smaller over the larger value, in [0, 1]
+    const auto larger = max(ax, ay);
+    auto a = select(zero < larger, min(ax, ay) / larger, zero);
+
+    // Above tan(pi / 8), use atan(a) = pi / 4 + atan((a - 1) / (a + 1))
+    const auto reduce = P::broadcast(T(0.41421356237309504880)) < a;
+    a = select(reduce, (a - one) / (a + one), a);
+    auto angle = a * polynomial(a * a, C::atan) +
+                 select(reduce, P::broadcast(T(pi / 4)), zero);
+
+    angle = select(ax < ay, P::broadcast(T(pi / 2)) - angle, angle);
+    angle = select(x < zero, P::broadcast(T(pi)) - angle, angle);
+    return select(y < zero, zero - angle, angle);
+}
+
+//! Calls f(P{}, i, n) for each native pack P of values starting at i, where
+//! the last pack may have fewer than P::size values. All values goes
+//! through the same pack type, which is not true for forEachPack where the
+//! rest is handled by Pack<T, 1> with other rounding
+template <typename T, class F>
+void forEachPaddedPack(size_t count, F &&f) {
+    using Native = NativePack<T>;
+    using P = std::conditional_t<std::is_void_v<Native>, Pack<T, 1>, Native>;
+    size_t i = 0;
+    for (; i + P::size <= count; i += P::size) {
+        f(P{}, i, P::size);
+    }
+    if (i < count) {
+        f(P{}, i, count - i);
+    }
+}
+
+//! Load n values, the rest of the lanes are filled with the last value
+template <class P, typename T>
+P loadPadded(const T *p, size_t n) noexcept {
+    if (n == P::size) {
+        return P::load(p);
+    }
+    T buffer[P::size];
+    for (size_t i = 0; i < P::size; ++i) {
+        buffer[i] = p[i < n ? i : n - 1];
+    }
+    return P::load(buffer);
+}
+
+//! Store the first n lanes
+template <class P, typename T>
+void storePadded(P value, T *p, size_t n) noexcept {
+    if (n == P::size) {
+        value.store(p);
+        return;
+    }
+    T buffer[P::size];
+    value.store(buffer);
+    for (size_t i = 0; i < n; ++i) {
+        p[i] = buffer[i];
+    }
+}
+
+} // namespace detail
+
+//! sin and cos of count angles. sin and cos may be the same array as angles
+//! but not each other
+matmath_export template <typename T>
+void sincos(const T *angles, T *sin, T *cos, size_t count) noexcept {
+    detail::forEachPaddedPack<T>(count, [&](auto p, size_t i, size_t n) {
+        using P = decltype(p);
+        P s, c;
+        detail::sincosAnyAngle<T>(detail::loadPadded<P>(angles + i, n), s, c);
+        detail::storePadded(s, sin + i, n);
+        detail::storePadded(c, cos + i, n);
+    });
+}
+
+//! out[i] = atan2(y[i], x[i]), same argument order as std::atan2
+matmath_export template <typename T>
+void atan2(const T *y, const T *x, T *out, size_t count) noexcept {
+    detail::forEachPaddedPack<T>(count, [&](auto p, size_t i, size_t n) {
+        using P = decltype(p);
+        detail::storePadded(detail::atan2<T>(detail::loadPadded<P>(y + i, n),
+                                             detail::loadPadded<P>(x + i, n)),
+                            out + i,
+                            n);
+    });
+}
+
+matmath_export template <typename T>
+void sqrt(const T *in, T *out, size_t count) noexcept {
+    detail::forEachPaddedPack<T>(count, [&](auto p, size_t i, size_t n) {
+        using P = decltype(p);
+        detail::storePadded(sqrt(detail::loadPadded<P>(in + i, n)), out + i, n);
+    });
+}
+
+//! out[i] = 1 / sqrt(in[i]). Faster than sqrt followed by division for
+//! float, where it uses the hardware approximation refined with one Newton
+//! iteration
+matmath_export template <typename T>
+void rsqrt(const T *in, T *out, size_t count) noexcept {
+    detail::forEachPaddedPack<T>(count, [&](auto p, size_t i, size_t n) {
+        using P = decltype(p);
+        detail::storePadded(
+            rsqrt(detail::loadPadded<P>(in + i, n)), out + i, n);
+    });
+}
+
+} // namespace simd
+} // namespace matmath
@@ -7,8 +7,14 @@
 #ifndef matmath_use_modules
 
 #include "constmath.h"
+#include "simdmath.h"
 #include "vec2.h"
+#include <algorithm>
+#include <cstddef>
 #include <iosfwd>
+#if __cplusplus >= 202002L
+#include <span>
+#endif
 
 #endif
 
@@ -21,8 +27,8 @@ public:
         : pos(pos), rotation(rotation) {}
 
     constexpr Transform2T(Vec2T<T> pos, double angle, double scale = 1)
-        : pos(pos), rotation(scale * constmath::cos(angle),
-                             scale * constmath::sin(angle)) {}
+        : pos(pos), rotation(scale * constmath::dispatch::cos(angle),
+                             scale * constmath::dispatch::sin(angle)) {}
 
     // Everything else is default
     constexpr Transform2T() = default;
@@ -72,6 +78,28 @@ public:
         return {{}, angle};
     }
 
+    //! Create count rotation transforms at once, with simd::sincos
+    static void Rotation(const T *angles,
+                         Transform2T *out,
+                         size_t count) noexcept {
+        constexpr size_t block = 64;
+        T sin[block], cos[block];
+        for (size_t i = 0; i < count; i += block) {
+            const auto n = std::min(block, count - i);
+            matmath::simd::sincos(angles + i, sin, cos, n);
+            for (size_t j = 0; j < n; ++j) {
+                out[i + j] = {{}, {cos[j], sin[j]}};
+            }
+        }
+    }
+
+#if __cplusplus >= 202002L
+    static void Rotation(std::span<const T> angles,
+                         std::span<Transform2T> out) noexcept {
+        Rotation(angles.data(), out.data(), angles.size());
+    }
+#endif
+
     Vec2T<T> pos;
     Vec2T<T> rotation = {1, 0};
 };
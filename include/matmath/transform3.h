@@ -0,0 +1,203 @@
+//! Copyright © Mattias Larsson Sköld 2020
+//! Distributed under terms specified under licence.txt
+#pragma once
+
+#include "matmath/export.h"
+
+#ifndef matmath_use_modules
+
+#include "constmath.h"
+#include "matrix.h"
+#include "quaternion.h"
+#include "vec.h"
+
+#endif
+
+//! Position, rotation and uniform scale, the 3d version of Transform2T.
+//! t * v scales v, rotates it with rotation (as QuaternionT::rotate) and then
+//! adds pos, and t1 * t2 applies t2 first, as for Matrix
+matmath_export template <class T>
+class Transform3T {
+public:
+    constexpr Transform3T(VecT<T> pos,
+                          QuaternionT<T> rotation = {},
+                          T scale = 1)
+        : rotation(rotation), pos(pos), scale(scale) {}
+
+    //! Decompose a matrix that only contains translation, rotation and
+    //! uniform scale
+    constexpr explicit Transform3T(const Matrix<T> &m)
+        : pos(m.x4, m.y4, m.z4),
+          scale(constmath::dispatch::sqrt(m.x1 * m.x1 + m.y1 * m.y1 +
+                                          m.z1 * m.z1)) {
+        auto r = m;
+        const auto inv = 1 / scale;
+        for (int y = 0; y < 3; ++y) {
+            for (int x = 0; x < 3; ++x) {
+                r(x, y) *= inv;
+            }
+        }
+        rotation = QuaternionT<T>{r};
+    }
+
+    constexpr Transform3T() = default;
+
+    //! Scale, rotate and translate
+    constexpr VecT<T> operator*(const VecT<T> &v) const {
+        return rotation.rotate(v * scale) + pos;
+    }
+
+    //! Scale and rotate, without translation
+    constexpr VecT<T> transformDirection(const VecT<T> &v) const {
+        return rotation.rotate(v * scale);
+    }
+
+    //! The transform that applies other first and then this, about 40
+    //! multiplications compared to the 64 of Matrix::operator*
+    constexpr Transform3T operator*(const Transform3T &other) const {
+        return {
+            *this * other.pos,
+            other.rotation * rotation,
+            scale * other.scale,
+        };
+    }
+
+    constexpr Transform3T &operator*=(const Transform3T &other) {
+        return *this = *this * other;
+    }
+
+    //! Inverse, assuming that rotation is normalized
+    constexpr Transform3T inverse() const {
+        const auto r = rotation.conjugate();
+        const auto s = 1 / scale;
+        return {-r.rotate(pos) * s, r, s};
+    }
+
+    constexpr bool operator==(const Transform3T &t) const {
+        return pos == t.pos && rotation.w == t.rotation.w &&
+               rotation.x == t.rotation.x && rotation.y == t.rotation.y &&
+               rotation.z == t.rotation.z && scale == t.scale;
+    }
+
+    constexpr bool operator!=(const Transform3T &t) const {
+        return !(*this == t);
+    }
+
+    constexpr operator Matrix<T>() const {
+        return toMatrix();
+    }
+
+    constexpr Matrix<T> toMatrix() const {
+        auto m = Matrix<T>(rotation);
+        for (int y = 0; y < 3; ++y) {
+            for (int x = 0; x < 3; ++x) {
+                m(x, y) *= scale;
+            }
+        }
+        m.x4 = pos.x;
+        m.y4 = pos.y;
+        m.z4 = pos.z;
+        return m;
+    }
+
+    constexpr static Transform3T Scale(T value) {
+        return {{}, {}, value};
+    }
+
+    constexpr static Transform3T Translate(VecT<T> v) {
+        return {v};
+    }
+
+    constexpr static Transform3T Identity() {
+        return {};
+    }
+
+    constexpr static Transform3T Rotation(QuaternionT<T> rotation) {
+        return {{}, rotation};
+    }
+
+    QuaternionT<T> rotation;
+    VecT<T> pos;
+    T scale = 1;
+};
+
+//! Interpolate position and scale linearly and rotation with normalized lerp
+matmath_export template <class T>
+constexpr Transform3T<T> lerp(const Transform3T<T> &a,
+                              const Transform3T<T> &b,
+                              T amount) {
+    return {a.pos * (1 - amount) + b.pos * amount,
+            a.rotation.interpolate(b.rotation, amount),
+            a.scale * (1 - amount) + b.scale * amount};
+}
+
+//! As lerp, but with QuaternionT::slerp for the rotation
+matmath_export template <class T>
+constexpr Transform3T<T> slerp(const Transform3T<T> &a,
+                               const Transform3T<T> &b,
+                               T amount) {
+    return {a.pos * (1 - amount) + b.pos * amount,
+            a.rotation.slerp(b.rotation, amount),
+            a.scale * (1 - amount) + b.scale * amount};
+}
+
+//! Transform3T together with its matrix, that is only calculated when it is
+//! requested after the transform has changed. Kept separate from Transform3T
+//! so that the transform itself stays small
+matmath_export template <class T>
+class CachedTransform3T {
+public:
+    constexpr CachedTransform3T() = default;
+    constexpr CachedTransform3T(const Transform3T<T> &transform)
+        : _transform(transform) {}
+
+    constexpr const Transform3T<T> &transform() const {
+        return _transform;
+    }
+
+    constexpr void transform(const Transform3T<T> &transform) {
+        _transform = transform;
+        _isDirty = true;
+    }
+
+    constexpr void pos(const VecT<T> &pos) {
+        _transform.pos = pos;
+        _isDirty = true;
+    }
+
+    constexpr void rotation(const QuaternionT<T> &rotation) {
+        _transform.rotation = rotation;
+        _isDirty = true;
+    }
+
+    constexpr void scale(T scale) {
+        _transform.scale = scale;
+        _isDirty = true;
+    }
+
+    constexpr bool isDirty() const {
+        return _isDirty;
+    }
+
+    //! The matrix of the transform, recalculated if the transform has
+    //! changed since the last call
+    const Matrix<T> &matrix() const {
+        if (_isDirty) {
+            _matrix = _transform.toMatrix();
+            _isDirty = false;
+        }
+        return _matrix;
+    }
+
+private:
+    Transform3T<T> _transform;
+    mutable Matrix<T> _matrix;
+    mutable bool _isDirty = true;
+};
+
+matmath_export using Transform3d = Transform3T<double>;
+matmath_export using Transform3f = Transform3T<float>;
+matmath_export using Transform3 = Transform3d;
+matmath_export using CachedTransform3d = CachedTransform3T<double>;
+matmath_export using CachedTransform3f = CachedTransform3T<float>;
+matmath_export using CachedTransform3 = CachedTransform3d;
@@ -0,0 +1,317 @@
+//! Copyright © Mattias Larsson Sköld 2020
+//! Distributed under terms specified under licence.txt
+
+#pragma once
+
+#include "matmath/export.h"
+
+#ifndef matmath_use_modules
+
+#include "affinematrix.h"
+#include "matrix.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#if __cplusplus >= 202002L
+#include <span>
+#endif
+
+#endif
+
+//! Local and world matrices of a tree of nodes, where the world matrix of a
+//! node is the world matrix of its parent times its local matrix.
+//!
+//! The matrices are stored in depth first order, so that every subtree is a
+//! contiguous range that starts with its root and parents always comes
+//! before their children. Changing a local matrix marks the subtree as dirty
+//! and update() only recalculates the dirty subtrees, optionally split
+//! between several threads.
+//!
+//! Nodes are referred to by the handle returned from add(), which does not
+//! change when the nodes are reordered. slot() gives the position of a node
+//! in worldMatrices()
+matmath_export template <typename T>
+class TransformHierarchy {
+public:
+    using Node = uint32_t;
+
+    static constexpr Node none = std::numeric_limits<Node>::max();
+
+    void reserve(size_t size) {
+        _local.reserve(size);
+        _world.reserve(size);
+        _parent.reserve(size);
+        _size.reserve(size);
+        _node.reserve(size);
+        _slot.reserve(size);
+        _parentNode.reserve(size);
+    }
+
+    //! Add a node with parent (that has to be added before) or none for a
+    //! root. The new node is placed in depth first order on the next update
+    Node add(const AffineMatrix<T> &local = {}, Node parent = none) {
+        if (parent != none && parent >= _slot.size()) {
+            throw "parent is not a node in the hierarchy";
+        }
+        const auto node = static_cast<Node>(_slot.size());
+        _local.push_back(local);
+        _world.push_back(local);
+        _parent.push_back(none);
+        _size.push_back(1);
+        _node.push_back(node);
+        _slot.push_back(node);
+        _parentNode.push_back(parent);
+        _isStructureChanged = true;
+        return node;
+    }
+
+    size_t size() const {
+        return _slot.size();
+    }
+
+    Node parent(Node node) const {
+        return _parentNode.at(node);
+    }
+
+    const AffineMatrix<T> &local(Node node) const {
+        return _local[_slot.at(node)];
+    }
+
+    //! Set the local matrix and mark the subtree of node as dirty
+    void local(Node node, const AffineMatrix<T> &local) {
+        _local[_slot.at(node)] = local;
+        _dirty.push_back(node);
+    }
+
+    void local(Node node, const Matrix<T> &local) {
+        this->local(node, AffineMatrix<T>{local});
+    }
+
+    //! World matrix as calculated by the last update
+    const AffineMatrix<T> &world(Node node) const {
+        return _world[_slot.at(node)];
+    }
+
+    Matrix<T> worldMatrix(Node node) const {
+        return world(node).toMatrix();
+    }
+
+    //! Position of the node in worldMatrices() and nodes()
+    size_t slot(Node node) const {
+        return _slot.at(node);
+    }
+
+    //! Number of nodes in the subtree of node, including node itself. The
+    //! subtree is the range [slot(node), slot(node) + subtreeSize(node)).
+    //! Only valid after update() if nodes has been added
+    size_t subtreeSize(Node node) const {
+        return _size[_slot.at(node)];
+    }
+
+    //! World matrices in depth first order, valid until the next call to add
+    //! or update
+    const AffineMatrix<T> *worldData() const {
+        return _world.data();
+    }
+
+    //! The node handle of each slot
+    const Node *nodeData() const {
+        return _node.data();
+    }
+
+#if __cplusplus >= 202002L
+    std::span<const AffineMatrix<T>> worldMatrices() const {
+        return {_world.data(), _world.size()};
+    }
+
+    std::span<const Node> nodes() const {
+        return {_node.data(), _node.size()};
+    }
+#endif
+
+    bool isDirty() const {
+        return _isStructureChanged || !_dirty.empty();
+    }
+
+    //! Recalculate the world matrices of all dirty subtrees. When pool has
+    //! more than one thread, large subtrees are split into the subtrees of
+    //! their children so that the threads get similar amounts of work
+    void update(matmath::ThreadPool &pool = matmath::ThreadPool::global()) {
+        _ranges.clear();
+        if (_isStructureChanged) {
+            sort();
+            for (size_t i = 0; i < _world.size(); i += _size[i]) {
+                _ranges.push_back({static_cast<Node>(i), _size[i]});
+            }
+        }
+        else {
+            for (auto &node : _dirty) {
+                node = _slot[node];
+            }
+            std::sort(_dirty.begin(), _dirty.end());
+
+            // Subtrees inside another dirty subtree are already included
+            size_t end = 0;
+            for (auto slot : _dirty) {
+                if (slot >= end) {
+                    _ranges.push_back({slot, _size[slot]});
+                    end = slot + _size[slot];
+                }
+            }
+        }
+        _dirty.clear();
+
+        const auto threads = pool.size();
+        if (threads <= 1) {
+            for (auto &range : _ranges) {
+                updateRange(range);
+            }
+            return;
+        }
+
+        size_t total = 0;
+        for (auto &range : _ranges) {
+            total += range.size;
+        }
+        _tasks.clear();
+        const auto grain = std::max<size_t>(minTaskSize, total / threads / 8);
+        for (auto &range : _ranges) {
+            split(range, grain);
+        }
+
+        // The tasks are already large, so they are handed out one at a time
+        pool.parallelFor(_tasks.size(), 1, [this](size_t begin, size_t end) {
+            for (auto i = begin; i < end; ++i) {
+                updateRange(_tasks[i]);
+            }
+        });
+    }
+
+private:
+    //! Subtrees smaller than this are not split between threads
+    static constexpr size_t minTaskSize = 1024;
+
+    struct Range {
+        Node first;
+        Node size;
+    };
+
+    void updateWorld(size_t slot) {
+        const auto parent = _parent[slot];
+        _world[slot] =
+            parent == none ? _local[slot] : _world[parent] * _local[slot];
+    }
+
+    //! The parent of the first node is outside of the range and has to be
+    //! calculated before
+    void updateRange(Range range) {
+        const size_t end = range.first + range.size;
+        for (size_t i = range.first; i < end; ++i) {
+            updateWorld(i);
+        }
+    }
+
+    //! Calculate the root of large subtrees directly and add the subtrees of
+    //! the children as separate tasks
+    void split(Range range, size_t grain) {
+        _stack.assign(1, range);
+        while (!_stack.empty()) {
+            const auto r = _stack.back();
+            _stack.pop_back();
+            if (r.size <= grain) {
+                _tasks.push_back(r);
+                continue;
+            }
+            updateWorld(r.first);
+            const size_t end = r.first + r.size;
+            for (size_t child = r.first + 1; child < end;
+                 child += _size[child]) {
+                _stack.push_back({static_cast<Node>(child), _size[child]});
+            }
+        }
+    }
+
+    //! Reorder all nodes in depth first order, with the children in the
+    //! order they were added
+    void sort() {
+        const auto count = _slot.size();
+
+        // Children of each node in compressed rows, roots are stored last
+        auto offsets = std::vector<Node>(count + 2, 0);
+        for (auto parent : _parentNode) {
+            ++offsets[(parent == none ? count : parent) + 1];
+        }
+        for (size_t i = 1; i < offsets.size(); ++i) {
+            offsets[i] += offsets[i - 1];
+        }
+        auto children = std::vector<Node>(count);
+        auto fill = offsets;
+        for (Node node = 0; node < count; ++node) {
+            const auto parent = _parentNode[node];
+            children[fill[parent == none ? count : parent]++] = node;
+        }
+
+        auto order = std::vector<Node>{};
+        order.reserve(count);
+        auto stack = std::vector<Node>{};
+        for (auto i = offsets[count + 1]; i > offsets[count]; --i) {
+            stack.push_back(children[i - 1]);
+        }
+        while (!stack.empty()) {
+            const auto node = stack.back();
+            stack.pop_back();
+            order.push_back(node);
+            for (auto i = offsets[node + 1]; i > offsets[node]; --i) {
+                stack.push_back(children[i - 1]);
+            }
+        }
+
+        auto local = std::vector<AffineMatrix<T>>(count);
+        for (Node slot = 0; slot < count; ++slot) {
+            const auto node = order[slot];
+            local[slot] = _local[_slot[node]];
+        }
+        _local.swap(local);
+
+        for (Node slot = 0; slot < count; ++slot) {
+            _slot[order[slot]] = slot;
+        }
+        for (Node slot = 0; slot < count; ++slot) {
+            const auto parent = _parentNode[order[slot]];
+            _parent[slot] = parent == none ? none : _slot[parent];
+            _size[slot] = 1;
+        }
+        for (auto slot = count; slot-- > 0;) {
+            if (_parent[slot] != none) {
+                _size[_parent[slot]] += _size[slot];
+            }
+        }
+        _node.swap(order);
+        _isStructureChanged = false;
+    }
+
+    // Stored by slot
+    std::vector<AffineMatrix<T>> _local;
+    std::vector<AffineMatrix<T>> _world;
+    std::vector<Node> _parent;
+    std::vector<Node> _size;
+    std::vector<Node> _node;
+
+    // Stored by node
+    std::vector<Node> _slot;
+    std::vector<Node> _parentNode;
+
+    //! Nodes with changed local matrices since the last update
+    std::vector<Node> _dirty;
+    bool _isStructureChanged = false;
+
+    std::vector<Range> _ranges;
+    std::vector<Range> _tasks;
+    std::vector<Range> _stack;
+};
+
+matmath_export using TransformHierarchyf = TransformHierarchy<float>;
+matmath_export using TransformHierarchyd = TransformHierarchy<double>;
@@ -9,10 +9,12 @@
 
 #include <cmath>
 #include <ostream>
+#include <type_traits>
 #if __cplusplus >= 201103L
 #include <tuple>
 #endif
 
+#include "constmath.h"
 #include "pi.h"
 
 #endif
@@ -131,7 +133,7 @@ public:
     }
 
     constexpr T abs() const {
-        return sqrt(x * x + y * y + z * z);
+        return constmath::dispatch::sqrt(x * x + y * y + z * z);
     }
 
     constexpr T abs2() const {
@@ -155,7 +157,7 @@ public:
 
     //! Relative angle
     constexpr T angle(T a) const {
-        T angle = atan2(x, y) + a;
+        T angle = constmath::dispatch::atan2(x, y) + a;
 
         while (angle < pi) {
             angle += pi2;
@@ -168,7 +170,7 @@ public:
     }
 
     constexpr T angle() const {
-        return atan2(x, y);
+        return constmath::dispatch::atan2(x, y);
     }
 
 #if __cplusplus >= 201103L
@@ -195,7 +197,11 @@ constexpr std::ostream &operator<<(std::ostream &out, const VecT<T> &v) {
     return out;
 }
 
-matmath_export template <class T, class U>
+//! Only for scalars, so that other types can define their own operator*
+matmath_export template <
+    class T,
+    class U,
+    class = std::enable_if_t<std::is_arithmetic_v<T>>>
 constexpr auto operator*(T f, const VecT<U> &v) {
     return v * f;
 }
@@ -7,6 +7,7 @@
 
 #ifndef matmath_use_modules
 
+#include "constmath.h"
 #include "pi.h"
 #include <cmath>
 #include <limits>
@@ -37,7 +38,7 @@ public:
     }
 
     constexpr T abs() const {
-        return sqrt(abs2());
+        return constmath::dispatch::sqrt(abs2());
     }
 
     constexpr T length() const {
@@ -46,7 +47,7 @@ public:
 
     //! Relative angle
     constexpr T angle(T a) const {
-        T angle = atan2(x, y) - a;
+        T angle = constmath::dispatch::atan2(x, y) - a;
 
         while (angle < pi) {
             angle += pi2;
@@ -59,7 +60,7 @@ public:
     }
 
     constexpr T angle() const {
-        return atan2(x, y);
+        return constmath::dispatch::atan2(x, y);
     }
 
     constexpr Vec2T operator+(Vec2T v) const {
@@ -0,0 +1,253 @@
+//! Copyright © Mattias Larsson Sköld 2020
+//! Distributed under terms specified under licence.txt
+
+#pragma once
+
+#include "matmath/export.h"
+
+#ifndef matmath_use_modules
+
+#include "matrix.h"
+#include "simd.h"
+#include "vec.h"
+#include <cstddef>
+#include <ostream>
+#if __cplusplus >= 202002L
+#include <span>
+#endif
+
+#endif
+
+//! Four component vector aligned to the size of a simd register, so that
+//! arrays of it can be loaded with one vector load per value.
+//!
+//! All operations works on all four values, including abs, normalize and
+//! the dot product. Converting from VecT sets w to 0 (pass 1 for points),
+//! which makes them give the same result as for VecT. cross() only uses x,
+//! y and z and sets w to 0.
+matmath_export template <typename T>
+class alignas(sizeof(T) * 4) Vec4T {
+public:
+    T x = 0, y = 0, z = 0, w = 0;
+
+    constexpr Vec4T() = default;
+    constexpr Vec4T(T x, T y, T z = 0, T w = 0) : x(x), y(y), z(z), w(w) {}
+
+    constexpr Vec4T(const VecT<T> &v, T w = 0)
+        : x(v.x), y(v.y), z(v.z), w(w) {}
+
+    template <typename U>
+    constexpr explicit Vec4T(const Vec4T<U> &v)
+        : x(static_cast<T>(v.x)), y(static_cast<T>(v.y)),
+          z(static_cast<T>(v.z)), w(static_cast<T>(v.w)) {}
+
+    //! Drops w. Explicit so that arithmetic with a VecT never silently uses
+    //! the VecT operators and drops w, use xyz() to get the VecT
+    constexpr explicit operator VecT<T>() const {
+        return {x, y, z};
+    }
+
+    constexpr VecT<T> xyz() const {
+        return {x, y, z};
+    }
+
+    constexpr T *data() {
+        return &x;
+    }
+
+    constexpr const T *data() const {
+        return &x;
+    }
+
+    constexpr T &operator[](int index) {
+        return (&x)[index];
+    }
+
+    constexpr T operator[](int index) const {
+        return (&x)[index];
+    }
+
+    constexpr Vec4T operator+(const Vec4T &v) const {
+        if constexpr (hasPack) {
+            if (!matmath::simd::isConstantEvaluated()) {
+                return fromPack(pack() + v.pack());
+            }
+        }
+        return {x + v.x, y + v.y, z + v.z, w + v.w};
+    }
+
+    constexpr Vec4T operator-(const Vec4T &v) const {
+        if constexpr (hasPack) {
+            if (!matmath::simd::isConstantEvaluated()) {
+                return fromPack(pack() - v.pack());
+            }
+        }
+        return {x - v.x, y - v.y, z - v.z, w - v.w};
+    }
+
+    constexpr Vec4T operator*(T t) const {
+        if constexpr (hasPack) {
+            if (!matmath::simd::isConstantEvaluated()) {
+                return fromPack(pack() * Pack::broadcast(t));
+            }
+        }
+        return {x * t, y * t, z * t, w * t};
+    }
+
+    constexpr Vec4T operator/(T t) const {
+        if constexpr (hasPack) {
+            if (!matmath::simd::isConstantEvaluated()) {
+                return fromPack(pack() / Pack::broadcast(t));
+            }
+        }
+        return {x / t, y / t, z / t, w / t};
+    }
+
+    constexpr Vec4T operator-() const {
+        return *this * T(-1);
+    }
+
+    constexpr Vec4T &operator+=(const Vec4T &v) {
+        return *this = *this + v;
+    }
+
+    constexpr Vec4T &operator-=(const Vec4T &v) {
+        return *this = *this - v;
+    }
+
+    constexpr Vec4T &operator*=(T t) {
+        return *this = *this * t;
+    }
+
+    constexpr Vec4T &operator/=(T t) {
+        return *this = *this / t;
+    }
+
+    //! Dot product of all four values
+    constexpr T operator*(const Vec4T &v) const {
+        if (!matmath::simd::isConstantEvaluated()) {
+            T ret{};
+            if (matmath::simd::dot4(data(), v.data(), ret)) {
+                return ret;
+            }
+        }
+        return x * v.x + y * v.y + z * v.z + w * v.w;
+    }
+
+    constexpr bool operator==(const Vec4T &v) const {
+        return x == v.x && y == v.y && z == v.z && w == v.w;
+    }
+
+    constexpr bool operator!=(const Vec4T &v) const {
+        return !(*this == v);
+    }
+
+    constexpr T abs2() const {
+        return *this * *this;
+    }
+
+    constexpr T abs() const {
+        return constmath::dispatch::sqrt(abs2());
+    }
+
+    constexpr Vec4T &normalize() {
+        if (!matmath::simd::isConstantEvaluated() &&
+            matmath::simd::normalize4(data(), data())) {
+            return *this;
+        }
+        return *this /= abs();
+    }
+
+    constexpr Vec4T cross(const Vec4T &v) const {
+        if (!matmath::simd::isConstantEvaluated()) {
+            Vec4T ret;
+            if (matmath::simd::cross4(data(), v.data(), ret.data())) {
+                return ret;
+            }
+        }
+        // clang-format off
+        return {
+            y * v.z - z * v.y,
+            z * v.x - x * v.z,
+            x * v.y - y * v.x
+        };
+        // clang-format on
+    }
+
+private:
+    static constexpr bool hasPack = matmath::simd::HasPack<T, 4>::value;
+
+    using Pack = matmath::simd::Pack<T, 4>;
+
+    Pack pack() const noexcept {
+        return Pack::load(data());
+    }
+
+    static Vec4T fromPack(Pack p) noexcept {
+        Vec4T ret;
+        p.store(ret.data());
+        return ret;
+    }
+};
+
+matmath_export template <
+    class T,
+    class U,
+    class = std::enable_if_t<std::is_arithmetic_v<T>>>
+constexpr Vec4T<U> operator*(T f, const Vec4T<U> &v) {
+    return v * static_cast<U>(f);
+}
+
+matmath_export template <typename T>
+constexpr T abs(const Vec4T<T> &v) {
+    return v.abs();
+}
+
+//! Homogeneous transform, m * v with all four rows of the matrix. Gives the
+//! same x, y and z as Matrix::operator*(Vec) when w is 1
+matmath_export template <typename T>
+constexpr Vec4T<T> operator*(const Matrix<T> &m, const Vec4T<T> &v) {
+    Vec4T<T> product;
+    if (!matmath::simd::isConstantEvaluated() &&
+        matmath::simd::transform4(m.data(), v.data(), product.data(), 1)) {
+        return product;
+    }
+    const auto row = [&](int x) {
+        return m(x, 0) * v.x + m(x, 1) * v.y + m(x, 2) * v.z + m(x, 3) * v.w;
+    };
+    return {row(0), row(1), row(2), row(3)};
+}
+
+//! out[i] = m * in[i] for count values. in and out may be the same array
+matmath_export template <typename T>
+void transform(const Matrix<T> &m,
+               const Vec4T<T> *in,
+               Vec4T<T> *out,
+               size_t count) noexcept {
+    const auto src = reinterpret_cast<const T *>(in);
+    const auto dst = reinterpret_cast<T *>(out);
+    const auto done = matmath::simd::transform4(m.data(), src, dst, count);
+    for (size_t i = done; i < count; ++i) {
+        out[i] = m * in[i];
+    }
+}
+
+#if __cplusplus >= 202002L
+//! out should be at least as long as in
+matmath_export template <typename T>
+void transform(const Matrix<T> &m,
+               std::span<const Vec4T<T>> in,
+               std::span<Vec4T<T>> out) noexcept {
+    transform(m, in.data(), out.data(), in.size());
+}
+#endif
+
+matmath_export template <class T>
+std::ostream &operator<<(std::ostream &out, const Vec4T<T> &v) {
+    out << v.x << ", " << v.y << ", " << v.z << ", " << v.w;
+    return out;
+}
+
+matmath_export using Vec4d = Vec4T<double>;
+matmath_export using Vec4f = Vec4T<float>;
+matmath_export using Vec4 = Vec4d;
@@ -0,0 +1,255 @@
+//! Copyright © Mattias Larsson Sköld 2020
+//! Distributed under terms specified under licence.txt
+
+#pragma once
+
+#include "matmath/export.h"
+
+#ifndef matmath_use_modules
+
+#include "simd.h"
+#include "vec.h"
+#include <cstddef>
+#include <vector>
+
+#endif
+
+//! Many 3d vectors stored as separate x, y and z arrays (structure of
+//! arrays), so that operations on all of them can be made with full simd
+//! registers. The operations mirrors the ones in VecT and are made elementwise.
+//! The arrays are aligned to cache lines and should always have the same size
+matmath_export template <typename T>
+class VecSoA {
+public:
+    using Array = std::vector<T, matmath::simd::AlignedAllocator<T>>;
+
+    Array x, y, z;
+
+    VecSoA() = default;
+    VecSoA(const VecSoA &) = default;
+    VecSoA(VecSoA &&) = default;
+    VecSoA &operator=(const VecSoA &) = default;
+    VecSoA &operator=(VecSoA &&) = default;
+
+    //! Create count zero vectors
+    explicit VecSoA(size_t count) : x(count), y(count), z(count) {}
+
+    VecSoA(const VecT<T> *v, size_t count) {
+        assign(v, count);
+    }
+
+    VecSoA(const std::vector<VecT<T>> &v) {
+        assign(v.data(), v.size());
+    }
+
+    //! Replace the content with count vectors from an array of VecT
+    VecSoA &assign(const VecT<T> *v, size_t count) {
+        resize(count);
+        auto in = reinterpret_cast<const T *>(v);
+        matmath::simd::forEachPack<T>(count, [&](auto p, size_t i) {
+            using P = decltype(p);
+            P px, py, pz;
+            P::load3(in + i * 3, px, py, pz);
+            px.store(x.data() + i);
+            py.store(y.data() + i);
+            pz.store(z.data() + i);
+        });
+        return *this;
+    }
+
+    //! Write all vectors to an array of VecT with room for size() vectors
+    void copyTo(VecT<T> *v) const {
+        auto out = reinterpret_cast<T *>(v);
+        matmath::simd::forEachPack<T>(size(), [&](auto p, size_t i) {
+            using P = decltype(p);
+            P::store3(out + i * 3,
+                      P::load(x.data() + i),
+                      P::load(y.data() + i),
+                      P::load(z.data() + i));
+        });
+    }
+
+    std::vector<VecT<T>> toVector() const {
+        auto ret = std::vector<VecT<T>>(size());
+        copyTo(ret.data());
+        return ret;
+    }
+
+    operator std::vector<VecT<T>>() const {
+        return toVector();
+    }
+
+    size_t size() const {
+        return x.size();
+    }
+
+    bool empty() const {
+        return x.empty();
+    }
+
+    void resize(size_t count) {
+        x.resize(count);
+        y.resize(count);
+        z.resize(count);
+    }
+
+    void reserve(size_t count) {
+        x.reserve(count);
+        y.reserve(count);
+        z.reserve(count);
+    }
+
+    void clear() {
+        x.clear();
+        y.clear();
+        z.clear();
+    }
+
+    void push_back(VecT<T> v) {
+        x.push_back(v.x);
+        y.push_back(v.y);
+        z.push_back(v.z);
+    }
+
+    //! Get a copy of a single vector
+    VecT<T> operator[](size_t i) const {
+        return {x[i], y[i], z[i]};
+    }
+
+    VecSoA &set(size_t i, VecT<T> v) {
+        x[i] = v.x;
+        y[i] = v.y;
+        z[i] = v.z;
+        return *this;
+    }
+
+    VecSoA &operator+=(const VecSoA &v) {
+        checkSize(v);
+        matmath::simd::forEachPack<T>(size(), [&](auto p, size_t i) {
+            using P = decltype(p);
+            (P::load(&x[i]) + P::load(&v.x[i])).store(&x[i]);
+            (P::load(&y[i]) + P::load(&v.y[i])).store(&y[i]);
+            (P::load(&z[i]) + P::load(&v.z[i])).store(&z[i]);
+        });
+        return *this;
+    }
+
+    VecSoA &operator-=(const VecSoA &v) {
+        checkSize(v);
+        matmath::simd::forEachPack<T>(size(), [&](auto p, size_t i) {
+            using P = decltype(p);
+            (P::load(&x[i]) - P::load(&v.x[i])).store(&x[i]);
+            (P::load(&y[i]) - P::load(&v.y[i])).store(&y[i]);
+            (P::load(&z[i]) - P::load(&v.z[i])).store(&z[i]);
+        });
+        return *this;
+    }
+
+    VecSoA &operator*=(T t) {
+        matmath::simd::forEachPack<T>(size(), [&](auto p, size_t i) {
+            using P = decltype(p);
+            const auto pt = P::broadcast(t);
+            (P::load(&x[i]) * pt).store(&x[i]);
+            (P::load(&y[i]) * pt).store(&y[i]);
+            (P::load(&z[i]) * pt).store(&z[i]);
+        });
+        return *this;
+    }
+
+    //! Add v multiplied with t, for example position += velocity * dt
+    VecSoA &addScaled(const VecSoA &v, T t) {
+        checkSize(v);
+        matmath::simd::forEachPack<T>(size(), [&](auto p, size_t i) {
+            using P = decltype(p);
+            const auto pt = P::broadcast(t);
+            madd(P::load(&v.x[i]), pt, P::load(&x[i])).store(&x[i]);
+            madd(P::load(&v.y[i]), pt, P::load(&y[i])).store(&y[i]);
+            madd(P::load(&v.z[i]), pt, P::load(&z[i])).store(&z[i]);
+        });
+        return *this;
+    }
+
+    VecSoA operator+(const VecSoA &v) const {
+        return VecSoA{*this} += v;
+    }
+
+    VecSoA operator-(const VecSoA &v) const {
+        return VecSoA{*this} -= v;
+    }
+
+    VecSoA operator*(T t) const {
+        return VecSoA{*this} *= t;
+    }
+
+    //! Dot product of each pair of vectors
+    Array operator*(const VecSoA &v) const {
+        checkSize(v);
+        auto ret = Array(size());
+        matmath::simd::forEachPack<T>(size(), [&](auto p, size_t i) {
+            using P = decltype(p);
+            auto dot = P::load(&x[i]) * P::load(&v.x[i]);
+            dot = madd(P::load(&y[i]), P::load(&v.y[i]), dot);
+            dot = madd(P::load(&z[i]), P::load(&v.z[i]), dot);
+            dot.store(&ret[i]);
+        });
+        return ret;
+    }
+
+    VecSoA cross(const VecSoA &v) const {
+        checkSize(v);
+        auto ret = VecSoA(size());
+        matmath::simd::forEachPack<T>(size(), [&](auto p, size_t i) {
+            using P = decltype(p);
+            const auto ax = P::load(&x[i]), ay = P::load(&y[i]),
+                       az = P::load(&z[i]);
+            const auto bx = P::load(&v.x[i]), by = P::load(&v.y[i]),
+                       bz = P::load(&v.z[i]);
+            (ay * bz - az * by).store(&ret.x[i]);
+            (az * bx - ax * bz).store(&ret.y[i]);
+            (ax * by - ay * bx).store(&ret.z[i]);
+        });
+        return ret;
+    }
+
+    Array abs2() const {
+        return *this * *this;
+    }
+
+    Array abs() const {
+        auto ret = abs2();
+        matmath::simd::forEachPack<T>(size(), [&](auto p, size_t i) {
+            using P = decltype(p);
+            sqrt(P::load(&ret[i])).store(&ret[i]);
+        });
+        return ret;
+    }
+
+    VecSoA &normalize() {
+        matmath::simd::forEachPack<T>(size(), [&](auto p, size_t i) {
+            using P = decltype(p);
+            const auto px = P::load(&x[i]), py = P::load(&y[i]),
+                       pz = P::load(&z[i]);
+            const auto length = sqrt(madd(px, px, madd(py, py, pz * pz)));
+            (px / length).store(&x[i]);
+            (py / length).store(&y[i]);
+            (pz / length).store(&z[i]);
+        });
+        return *this;
+    }
+
+private:
+    //! The operations with two VecSoA works on pairs of vectors
+    void checkSize(const VecSoA &v) const {
+        if (v.size() != size()) {
+            throw "VecSoA sizes does not match";
+        }
+    }
+};
+
+matmath_export template <typename T>
+VecSoA<T> operator*(T t, const VecSoA<T> &v) {
+    return v * t;
+}
+
+matmath_export using VecSoAf = VecSoA<float>;
+matmath_export using VecSoAd = VecSoA<double>;
@@ -0,0 +1,14 @@
+#include <cstddef>
+#include <limits>
+#include <ostream>
+#include <span>
+
+export module matmath.aabb;
+
+export import matmath.vec;
+export import matmath.matrix;
+export import matmath.affinematrix;
+import matmath.simd;
+
+#define matmath_use_modules
+#include "matmath/aabb.h"
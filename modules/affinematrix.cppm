@@ -0,0 +1,11 @@
+
+#include <cstddef>
+#include <span>
+
+export module matmath.affinematrix;
+
+export import matmath.matrix;
+import matmath.simd;
+
+#define matmath_use_modules
+#include "matmath/affinematrix.h"
@@ -0,0 +1,19 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+export module matmath.bvh;
+
+export import matmath.vec;
+export import matmath.matrix;
+export import matmath.aabb;
+export import matmath.ray;
+export import matmath.parallel;
+import matmath.simd;
+
+#define matmath_use_modules
+#include "matmath/bvh.h"
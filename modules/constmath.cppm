@@ -1,3 +1,7 @@
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <type_traits>
 
 export module matmath.constmath;
 
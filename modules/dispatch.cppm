@@ -0,0 +1,19 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#if defined(__x86_64__) && !defined(_MSC_VER)
+#include <cpuid.h>
+#include <immintrin.h>
+#elif defined(_M_X64)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+export module matmath.dispatch;
+
+export import matmath.simd;
+export import matmath.simdmath;
+
+#define matmath_use_modules
+#include "matmath/dispatch.h"
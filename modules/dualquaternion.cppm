@@ -0,0 +1,10 @@
+#include <cstddef>
+#include <span>
+
+export module matmath.dualquaternion;
+
+export import matmath.quaternion;
+import matmath.simd;
+
+#define matmath_use_modules
+#include "matmath/dualquaternion.h"
@@ -0,0 +1,11 @@
+
+#include <type_traits>
+#include <utility>
+
+export module matmath.expression;
+
+export import matmath.matrix;
+export import matmath.vec;
+
+#define matmath_use_modules
+#include "matmath/expression.h"
@@ -0,0 +1,15 @@
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+export module matmath.frustum;
+
+export import matmath.vec;
+export import matmath.matrix;
+export import matmath.vecsoa;
+export import matmath.aabb;
+import matmath.simd;
+
+#define matmath_use_modules
+#include "matmath/frustum.h"
@@ -0,0 +1,14 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+export module matmath.kdtree;
+
+export import matmath.vec;
+export import matmath.vec2;
+export import matmath.parallel;
+
+#define matmath_use_modules
+#include "matmath/kdtree.h"
@@ -1,9 +1,14 @@
 
+#include <algorithm>
 #include <cmath>
+#include <cstddef>
+#include <span>
 
 export module matmath.matrix;
 
 export import matmath.vec;
+import matmath.simd;
+import matmath.simdmath;
 
 #define matmath_use_modules
 #include "matmath/matrix.h"
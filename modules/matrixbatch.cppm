@@ -0,0 +1,12 @@
+#include <algorithm>
+#include <cstddef>
+#include <span>
+#include <type_traits>
+
+export module matmath.matrixbatch;
+
+export import matmath.matrix;
+import matmath.simd;
+
+#define matmath_use_modules
+#include "matmath/matrixbatch.h"
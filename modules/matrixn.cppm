@@ -0,0 +1,12 @@
+
+#include <type_traits>
+#include <utility>
+
+export module matmath.matrixn;
+
+export import matmath.matrix;
+export import matmath.vec2;
+import matmath.simd;
+
+#define matmath_use_modules
+#include "matmath/matrixn.h"
@@ -0,0 +1,17 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+export module matmath.parallel;
+
+export import matmath.matrix;
+
+#define matmath_use_modules
+#include "matmath/parallel.h"
@@ -1,9 +1,10 @@
-
 #include <cmath>
 
 export module matmath.quaternion;
 
 export import matmath.matrix;
+import matmath.constmath;
+import matmath.simd;
 
 #define matmath_use_modules
 #include "matmath/quaternion.h"
@@ -0,0 +1,15 @@
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+export module matmath.ray;
+
+export import matmath.vec;
+export import matmath.aabb;
+export import matmath.vecsoa;
+import matmath.simd;
+
+#define matmath_use_modules
+#include "matmath/ray.h"
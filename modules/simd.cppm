@@ -0,0 +1,14 @@
+
+#include <cmath>
+#include <cstddef>
+#include <immintrin.h>
+#include <limits>
+#include <new>
+#include <type_traits>
+
+export module matmath.simd;
+
+import matmath.constmath;
+
+#define matmath_use_modules
+#include "matmath/simd.h"
@@ -0,0 +1,11 @@
+
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
+
+export module matmath.simdmath;
+
+export import matmath.simd;
+
+#define matmath_use_modules
+#include "matmath/simdmath.h"
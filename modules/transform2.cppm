@@ -1,12 +1,16 @@
 
+#include <algorithm>
 #include <cmath>
+#include <cstddef>
 #include <ostream>
+#include <span>
 
 export module matmath.transform2;
 
 export import matmath.vec2;
 export import matmath.constmath;
 export import matmath.pi;
+import matmath.simdmath;
 
 #define matmath_use_modules
 #include "matmath/transform2.h"
@@ -0,0 +1,10 @@
+#include <cmath>
+#include <cstddef>
+
+export module matmath.transform3;
+
+export import matmath.quaternion;
+import matmath.constmath;
+
+#define matmath_use_modules
+#include "matmath/transform3.h"
@@ -0,0 +1,15 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+export module matmath.transformhierarchy;
+
+export import matmath.affinematrix;
+export import matmath.matrix;
+export import matmath.parallel;
+
+#define matmath_use_modules
+#include "matmath/transformhierarchy.h"
@@ -1,9 +1,12 @@
 
 #include <cmath>
+#include <limits>
 #include <ostream>
+#include <type_traits>
 
 export module matmath.vec;
 
+export import matmath.constmath;
 export import matmath.pi;
 
 #define matmath_use_modules
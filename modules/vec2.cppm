@@ -5,6 +5,7 @@
 
 export module matmath.vec2;
 
+export import matmath.constmath;
 export import matmath.pi;
 
 #define matmath_use_modules
@@ -0,0 +1,13 @@
+#include <cstddef>
+#include <ostream>
+#include <span>
+#include <type_traits>
+
+export module matmath.vec4;
+
+export import matmath.vec;
+export import matmath.matrix;
+import matmath.simd;
+
+#define matmath_use_modules
+#include "matmath/vec4.h"
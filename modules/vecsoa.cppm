@@ -0,0 +1,11 @@
+
+#include <cstddef>
+#include <vector>
+
+export module matmath.vecsoa;
+
+export import matmath.vec;
+import matmath.simd;
+
+#define matmath_use_modules
+#include "matmath/vecsoa.h"
@@ -0,0 +1,117 @@
+// Copyright © Mattias Larsson Sköld
+
+#include "matmath/aabb.h"
+#include "mls-unit-test/unittest.h"
+#include "testmatrix.h"
+#include <vector>
+
+constexpr double smallNumber = .0001;
+
+namespace {
+
+//! The box around all eight transformed corners
+template <typename T, class M>
+AABB<T> transformCorners(const M &m, const AABB<T> &box) {
+    auto ret = AABB<T>{};
+    for (int i = 0; i < 8; ++i) {
+        ret = ret.merge(m * VecT<T>{i & 1 ? box.max.x : box.min.x,
+                                    i & 2 ? box.max.y : box.min.y,
+                                    i & 4 ? box.max.z : box.min.z});
+    }
+    return ret;
+}
+
+template <typename T>
+double distance(const AABB<T> &a, const AABB<T> &b) {
+    return (a.min - b.min).abs() + (a.max - b.max).abs();
+}
+
+template <typename T>
+std::vector<AABB<T>> testBoxes() {
+    auto boxes = std::vector<AABB<T>>{};
+    for (int i = 0; i < 19; ++i) {
+        const auto min = VecT<T>{T(i), T(i % 3) - 1, T(-i) / 2};
+        boxes.push_back({min, min + VecT<T>{1, T(i % 5), 2}});
+    }
+    return boxes;
+}
+
+template <typename T>
+void testOperations() {
+    const auto a = AABB<T>{{0, 0, 0}, {2, 2, 2}};
+    const auto b = AABB<T>{{1, -1, 1}, {3, 1, 4}};
+    const auto c = AABB<T>{{5, 5, 5}, {6, 6, 6}};
+
+    ASSERT(AABB<T>{}.isEmpty(), "default box should be empty");
+    ASSERT(!a.isEmpty(), "should not be empty");
+    ASSERT_EQ(a.center(), (VecT<T>{1, 1, 1}));
+    ASSERT_EQ(b.extents(), (VecT<T>{1, 1, 1.5}));
+
+    ASSERT(a.contains(VecT<T>{1, 2, 0}), "point on the side is inside");
+    ASSERT(!a.contains(VecT<T>{1, 2.5, 0}), "point should be outside");
+    ASSERT(a.contains(AABB<T>{{.5, .5, .5}, {1, 1, 1}}), "should be inside");
+    ASSERT(!a.contains(b), "b is partly outside");
+
+    ASSERT(a.intersects(b) && b.intersects(a), "should intersect");
+    ASSERT(!a.intersects(c) && !c.intersects(a), "should not intersect");
+
+    ASSERT_EQ(a.merge(b), (AABB<T>{{0, -1, 0}, {3, 2, 4}}));
+    ASSERT_EQ(AABB<T>{}.merge(a), a);
+    ASSERT_EQ(a.merge(VecT<T>{-1, 1, 3}), (AABB<T>{{-1, 0, 0}, {2, 2, 3}}));
+    ASSERT_EQ(a.intersection(b), (AABB<T>{{1, 0, 1}, {2, 1, 2}}));
+    ASSERT(a.intersection(c).isEmpty(), "should not overlap");
+
+    const VecT<T> points[] = {{1, 2, 3}, {-1, 0, 4}, {2, -5, 0}};
+    ASSERT_EQ(AABB<T>::FromPoints(points, 3),
+              (AABB<T>{{-1, -5, 0}, {2, 2, 4}}));
+}
+
+template <typename T>
+void testTransform() {
+    const auto m = testMatrix<T>();
+    const auto affine = AffineMatrix<T>{m};
+    const auto boxes = testBoxes<T>();
+
+    for (auto &box : boxes) {
+        const auto expected = transformCorners(m, box);
+        ASSERT_LT(distance(m * box, expected), smallNumber);
+        ASSERT_LT(distance(affine * box, expected), smallNumber);
+    }
+
+    auto out = std::vector<AABB<T>>(boxes.size());
+    auto affineOut = out;
+    transform(m, boxes.data(), out.data(), boxes.size());
+    transform(affine, boxes.data(), affineOut.data(), boxes.size());
+    for (size_t i = 0; i < boxes.size(); ++i) {
+        ASSERT_LT(distance(out[i], m * boxes[i]), smallNumber);
+        ASSERT_LT(distance(affineOut[i], m * boxes[i]), smallNumber);
+    }
+
+    // In place
+    auto inPlace = boxes;
+    transform(m, inPlace.data(), inPlace.data(), inPlace.size());
+    ASSERT_LT(distance(inPlace.back(), out.back()), smallNumber);
+}
+
+} // namespace
+
+TEST_SUIT_BEGIN
+
+TEST_CASE("constexpr") {
+    constexpr auto box = AABBd{{0, 0, 0}, {1, 1, 1}}.merge(Vecd{2, -1, 0});
+    static_assert(box.min.y == -1 && box.max.x == 2);
+    constexpr auto moved = AffineMatrixd::Translation(1, 2, 3) * box;
+    static_assert(moved.min.x == 1 && moved.max.z == 4);
+}
+
+TEST_CASE("operations") {
+    testOperations<float>();
+    testOperations<double>();
+}
+
+TEST_CASE("transform") {
+    testTransform<float>();
+    testTransform<double>();
+}
+
+TEST_SUIT_END
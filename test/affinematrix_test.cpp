@@ -0,0 +1,87 @@
+// Copyright © Mattias Larsson Sköld
+
+#include "matmath/affinematrix.h"
+#include "mls-unit-test/unittest.h"
+#include "testmatrix.h"
+#include <vector>
+
+constexpr double smallNumber = .00001;
+
+TEST_SUIT_BEGIN
+
+TEST_CASE("size") {
+    static_assert(sizeof(AffineMatrixf) == sizeof(float) * 12);
+    static_assert(sizeof(AffineMatrixd) == sizeof(double) * 12);
+}
+
+TEST_CASE("conversion") {
+    const auto m = testMatrix();
+    const auto a = AffineMatrixf{m};
+
+    ASSERT_EQ((a.toMatrix() - m).abs2(), 0.f);
+    ASSERT_EQ((Matrixf{a} - m).abs2(), 0.f);
+
+    constexpr auto identity = AffineMatrixf::Identity().toMatrix();
+    static_assert(identity.isAffine());
+}
+
+TEST_CASE("composition") {
+    const auto m1 = testMatrix();
+    const auto m2 = Matrixf::RotationY(.4) * Matrixf::Translation(1, 2, 3);
+
+    const auto a = AffineMatrixf{m1} * AffineMatrixf{m2};
+    ASSERT_LT((a.toMatrix() - m1 * m2).abs2(), smallNumber);
+
+    auto b = AffineMatrixf{m2};
+    b *= AffineMatrixf{m1};
+    ASSERT_LT((b.toMatrix() - m2 * m1).abs2(), smallNumber);
+
+    ASSERT_LT((AffineMatrixf{m1} * m2 - m1 * m2).abs2(), smallNumber);
+}
+
+TEST_CASE("transform") {
+    const auto m = testMatrix();
+    const auto a = AffineMatrixf{m};
+
+    std::vector<Vecf> points;
+    for (int i = 0; i < 13; ++i) {
+        points.push_back({i * 1.f, 2.f - i, i * .3f});
+    }
+
+    auto transformed = std::vector<Vecf>(points.size());
+    a.transformPoints(points.data(), transformed.data(), points.size());
+    auto directions = std::vector<Vecf>(points.size());
+    a.transformDirections(points.data(), directions.data(), points.size());
+
+    for (size_t i = 0; i < points.size(); ++i) {
+        const auto expected = Vecf{m * Vec{points[i]}};
+        ASSERT_LT((a * points[i] - expected).abs2(), smallNumber);
+        ASSERT_LT((transformed[i] - expected).abs2(), smallNumber);
+        ASSERT_LT((directions[i] - a.transformDirection(points[i])).abs2(),
+                  smallNumber);
+    }
+}
+
+TEST_CASE("inverse") {
+    const auto identity = Matrixf::Identity();
+    const auto a = AffineMatrixf{testMatrix()};
+
+    ASSERT_LT(((a * a.inverse()).toMatrix() - identity).abs2(), smallNumber);
+
+    auto inv = AffineMatrixf{};
+    ASSERT_NEAR(a.tryInverse(inv), 2 * 3 * 4, smallNumber);
+    ASSERT_LT(((inv * a).toMatrix() - identity).abs2(), smallNumber);
+
+    ASSERT_EQ(AffineMatrixf::Scale(1, 0, 1).tryInverse(inv), 0.f);
+
+    const auto rotation =
+        AffineMatrixf{Matrixf::RotationX(.5) * Matrixf::Translation(1, 2, 3)};
+    const auto normalized = rotation * rotation.inverseNormalized();
+    ASSERT_LT((normalized.toMatrix() - identity).abs2(), smallNumber);
+
+    const auto scaled = AffineMatrixf::Scale(2, 3, 4) * rotation;
+    const auto orthogonal = scaled * scaled.inverseOrthogonal();
+    ASSERT_LT((orthogonal.toMatrix() - identity).abs2(), smallNumber);
+}
+
+TEST_SUIT_END
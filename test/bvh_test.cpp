@@ -0,0 +1,301 @@
+// Copyright © Mattias Larsson Sköld
+
+#include "matmath/bvh.h"
+#include "mls-unit-test/unittest.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+constexpr double smallNumber = .0001;
+
+namespace {
+
+//! Small triangles spread in a box, enough of them for the parallel build
+//! to split the work
+template <typename T>
+std::vector<VecT<T>> testTriangles(size_t count) {
+    auto random = std::minstd_rand{1u};
+    auto xy = std::uniform_real_distribution<T>{-10, 10};
+    auto z = std::uniform_real_distribution<T>{0, 1};
+    auto offset = std::uniform_real_distribution<T>{-.5, .5};
+    auto vertices = std::vector<VecT<T>>{};
+    for (size_t i = 0; i < count; ++i) {
+        const auto center = VecT<T>{xy(random), xy(random), z(random)};
+        for (int j = 0; j < 3; ++j) {
+            vertices.push_back(center + VecT<T>{offset(random),
+                                                offset(random),
+                                                offset(random)});
+        }
+    }
+    return vertices;
+}
+
+template <typename T>
+std::vector<Ray<T>> testRays(size_t count) {
+    auto random = std::minstd_rand{7u};
+    auto xy = std::uniform_real_distribution<T>{-10, 10};
+    auto slope = std::uniform_real_distribution<T>{-.5, .5};
+    auto rays = std::vector<Ray<T>>{};
+    for (size_t i = 0; i < count; ++i) {
+        const auto origin = VecT<T>{xy(random), xy(random), 5};
+        rays.push_back({origin, {slope(random), slope(random), -1}});
+    }
+    return rays;
+}
+
+template <typename T>
+bool bruteForceRaycast(const Ray<T> &ray,
+                       const std::vector<VecT<T>> &vertices,
+                       RayHit<T> &hit) {
+    auto found = false;
+    for (size_t i = 0; i < vertices.size() / 3; ++i) {
+        if (intersectTriangle(ray,
+                              vertices[i * 3],
+                              vertices[i * 3 + 1],
+                              vertices[i * 3 + 2],
+                              hit)) {
+            hit.index = i;
+            found = true;
+        }
+    }
+    return found;
+}
+
+template <typename T>
+void testRaycast(const Bvh<T> &bvh, const std::vector<VecT<T>> &vertices) {
+    size_t hitCount = 0;
+    for (auto &ray : testRays<T>(200)) {
+        auto expected = RayHit<T>{};
+        const auto found = bruteForceRaycast(ray, vertices, expected);
+        auto hit = RayHit<T>{};
+        ASSERT_EQ(bvh.raycast(ray, hit), found);
+        if (found) {
+            ASSERT_EQ(hit.index, expected.index);
+            ASSERT_NEAR(hit.distance, expected.distance, smallNumber);
+            ASSERT_NEAR(hit.u, expected.u, smallNumber);
+        }
+        hitCount += found;
+    }
+    ASSERT_GT(hitCount, 20);
+}
+
+template <typename T>
+void testTriangleQueries(matmath::ThreadPool &pool) {
+    const auto vertices = testTriangles<T>(3000);
+    auto bvh = Bvh<T>{};
+    bvh.build(vertices.data(), vertices.size() / 3, pool);
+    ASSERT_EQ(bvh.size(), 3000);
+    ASSERT_EQ(bvh.bounds(),
+              (AABB<T>::FromPoints(vertices.data(), vertices.size())));
+
+    testRaycast(bvh, vertices);
+
+    auto random = std::minstd_rand{3u};
+    auto xy = std::uniform_real_distribution<T>{-12, 12};
+    auto z = std::uniform_real_distribution<T>{-2, 2};
+    for (int i = 0; i < 50; ++i) {
+        const auto p = VecT<T>{xy(random), xy(random), z(random)};
+        auto expected = typename Bvh<T>::Closest{};
+        for (size_t j = 0; j < vertices.size() / 3; ++j) {
+            const auto point = closestPointOnTriangle(
+                p, vertices[j * 3], vertices[j * 3 + 1], vertices[j * 3 + 2]);
+            const auto distance = (point - p).abs();
+            if (distance < expected.distance) {
+                expected = {point, distance, j};
+            }
+        }
+
+        auto closest = typename Bvh<T>::Closest{};
+        ASSERT(bvh.closestPoint(p, closest), "should find a point");
+        ASSERT_NEAR(closest.distance, expected.distance, smallNumber);
+        ASSERT_LT((closest.point - expected.point).abs(), smallNumber);
+    }
+
+    const auto box = AABB<T>{{-2, -3, 0}, {1, 0, 1}};
+    auto expected = std::vector<size_t>{};
+    for (size_t i = 0; i < vertices.size() / 3; ++i) {
+        if (AABB<T>::FromPoints(vertices.data() + i * 3, 3).intersects(box)) {
+            expected.push_back(i);
+        }
+    }
+    auto found = std::vector<size_t>{};
+    bvh.overlap(box, [&](size_t index) { found.push_back(index); });
+    std::sort(found.begin(), found.end());
+    ASSERT_GT(expected.size(), 0);
+    ASSERT_EQ(found, expected);
+}
+
+template <typename T>
+void testRefit() {
+    auto vertices = testTriangles<T>(2000);
+    auto bvh = Bvh<T>{};
+    bvh.build(vertices.data(), vertices.size() / 3);
+
+    const auto m =
+        Matrix<T>::Translation(1, 2, -3) * Matrix<T>::RotationZ(.4) *
+        Matrix<T>::RotationX(-.2) * Matrix<T>::Scale(1.2, .8, 1);
+    bvh.refit(m);
+    for (auto &v : vertices) {
+        v = m * v;
+    }
+    ASSERT_LT((bvh.bounds().min -
+               AABB<T>::FromPoints(vertices.data(), vertices.size()).min)
+                  .abs(),
+              smallNumber);
+    testRaycast(bvh, vertices);
+
+    // New positions for the same triangles
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        vertices[i].z += T(i % 7) / 10;
+    }
+    bvh.refit(vertices.data());
+    ASSERT_EQ(bvh.bounds(),
+              (AABB<T>::FromPoints(vertices.data(), vertices.size())));
+    testRaycast(bvh, vertices);
+}
+
+template <typename T>
+void testBoxes() {
+    auto random = std::minstd_rand{5u};
+    auto xy = std::uniform_real_distribution<T>{-10, 10};
+    auto unit = std::uniform_real_distribution<T>{0, 1};
+    auto boxes = std::vector<AABB<T>>{};
+    for (int i = 0; i < 400; ++i) {
+        const auto min = VecT<T>{xy(random), xy(random), unit(random)};
+        boxes.push_back({min, min + VecT<T>{unit(random), unit(random), 1}});
+    }
+
+    auto bvh = Bvh<T>{};
+    bvh.build(boxes.data(), boxes.size());
+    ASSERT_EQ(bvh.size(), boxes.size());
+
+    size_t hitCount = 0;
+    for (auto &ray : testRays<T>(100)) {
+        auto expected = std::numeric_limits<T>::max();
+        size_t index = 0;
+        for (size_t i = 0; i < boxes.size(); ++i) {
+            T near = 0, far = expected;
+            if (intersectBox(ray, boxes[i], near, far) && near < expected) {
+                expected = near;
+                index = i;
+            }
+        }
+
+        auto hit = RayHit<T>{};
+        const auto found = bvh.raycast(ray, hit);
+        ASSERT_EQ(found, expected != std::numeric_limits<T>::max());
+        if (found) {
+            ASSERT_NEAR(hit.distance, expected, smallNumber);
+            ASSERT_EQ(hit.index, index);
+        }
+        hitCount += found;
+    }
+    ASSERT_GT(hitCount, 10);
+
+    // Points inside of a box are their own closest point
+    auto closest = typename Bvh<T>::Closest{};
+    ASSERT(bvh.closestPoint(boxes[10].center(), closest), "should be found");
+    ASSERT_NEAR(closest.distance, 0, smallNumber);
+
+    const auto m = Matrix<T>::Translation(0, 0, 5) * Matrix<T>::RotationZ(1);
+    bvh.refit(m);
+    auto moved = AABB<T>{};
+    for (auto &box : boxes) {
+        moved = moved.merge(m * box);
+    }
+    ASSERT_LT((bvh.bounds().max - moved.max).abs(), smallNumber);
+
+    // Rotating back should give the original boxes, and not boxes that has
+    // grown from being rotated twice
+    const auto r = Matrix<T>::RotationZ(.7) * Matrix<T>::RotationX(.3);
+    bvh.refit(r);
+    bvh.refit(r.inverse() * r);
+    auto original = AABB<T>{};
+    for (auto &box : boxes) {
+        original = original.merge(box);
+    }
+    ASSERT_LT((bvh.bounds().min - original.min).abs(), smallNumber);
+    ASSERT_LT((bvh.bounds().max - original.max).abs(), smallNumber);
+
+    const auto region = AABB<T>{{-3, -3, 0}, {3, 3, 2}};
+    auto expected = std::vector<size_t>{};
+    for (size_t i = 0; i < boxes.size(); ++i) {
+        if (boxes[i].intersects(region)) {
+            expected.push_back(i);
+        }
+    }
+    auto found = std::vector<size_t>{};
+    bvh.overlap(region, [&](size_t index) { found.push_back(index); });
+    std::sort(found.begin(), found.end());
+    ASSERT_EQ(found, expected);
+}
+
+} // namespace
+
+TEST_SUIT_BEGIN
+
+TEST_CASE("empty") {
+    auto bvh = Bvhf{};
+    auto hit = RayHit<float>{};
+    ASSERT(!bvh.raycast(Rayf{{0, 0, 0}, {0, 0, -1}}, hit), "nothing to hit");
+    bvh.build(static_cast<const Vecf *>(nullptr), 0);
+    ASSERT(bvh.empty(), "should be empty");
+    auto closest = Bvhf::Closest{};
+    ASSERT(!bvh.closestPoint(Vecf{}, closest), "no points");
+}
+
+TEST_CASE("closest point on triangle") {
+    const auto a = Vecd{0, 0, 0}, b = Vecd{2, 0, 0}, c = Vecd{0, 2, 0};
+    ASSERT_EQ(closestPointOnTriangle(Vecd{.5, .5, 3}, a, b, c),
+              (Vecd{.5, .5, 0}));
+    ASSERT_EQ(closestPointOnTriangle(Vecd{-1, -1, 0}, a, b, c), a);
+    ASSERT_EQ(closestPointOnTriangle(Vecd{1, -1, 1}, a, b, c),
+              (Vecd{1, 0, 0}));
+    ASSERT_EQ(closestPointOnTriangle(Vecd{2, 2, 0}, a, b, c),
+              (Vecd{1, 1, 0}));
+}
+
+TEST_CASE("triangles") {
+    auto single = matmath::ThreadPool{1};
+    testTriangleQueries<float>(single);
+    testTriangleQueries<double>(single);
+}
+
+TEST_CASE("parallel build") {
+    auto pool = matmath::ThreadPool{4};
+    testTriangleQueries<float>(pool);
+    testTriangleQueries<double>(pool);
+}
+
+TEST_CASE("refit") {
+    testRefit<float>();
+    testRefit<double>();
+}
+
+TEST_CASE("boxes") {
+    testBoxes<float>();
+    testBoxes<double>();
+}
+
+TEST_CASE("refit with the wrong kind of primitives") {
+    const auto vertices = testTriangles<float>(10);
+    const auto boxes = std::vector<AABBf>(10, AABBf{{0, 0, 0}, {1, 1, 1}});
+
+    auto throws = [](auto f) {
+        try {
+            f();
+        }
+        catch (const char *) {
+            return true;
+        }
+        return false;
+    };
+
+    auto bvh = Bvhf{};
+    bvh.build(vertices.data(), vertices.size() / 3);
+    ASSERT(throws([&] { bvh.refit(boxes.data()); }), "built with triangles");
+    bvh.build(boxes.data(), boxes.size());
+    ASSERT(throws([&] { bvh.refit(vertices.data()); }), "built with boxes");
+}
+
+TEST_SUIT_END
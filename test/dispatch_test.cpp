@@ -0,0 +1,158 @@
+// Copyright © Mattias Larsson Sköld
+
+#include "matmath/dispatch.h"
+#include "matmath/matrix.h"
+#include "matmath/quaternion.h"
+#include "mls-unit-test/unittest.h"
+#include "testmatrix.h"
+#include <cmath>
+#include <vector>
+
+using namespace matmath::simd;
+
+constexpr double smallNumber = .0001;
+
+namespace {
+
+//! Every instruction set that the cpu can run
+std::vector<InstructionSet> supportedSets() {
+    auto sets = std::vector<InstructionSet>{};
+    for (int i = 0; i <= static_cast<int>(cpuFeatures().best()); ++i) {
+        sets.push_back(static_cast<InstructionSet>(i));
+    }
+    return sets;
+}
+
+//! Odd count so that both the simd and the scalar tail is used
+std::vector<Vecf> testPoints(size_t count = 1001) {
+    auto points = std::vector<Vecf>{};
+    for (size_t i = 0; i < count; ++i) {
+        points.push_back({.1f * i, 1.f - .03f * i, std::sin(.01f * i)});
+    }
+    return points;
+}
+
+float maxDistance(const std::vector<Vecf> &a, const std::vector<Vecf> &b) {
+    auto distance = 0.f;
+    for (size_t i = 0; i < a.size(); ++i) {
+        distance = std::max(distance, (a[i] - b[i]).abs());
+    }
+    return distance;
+}
+
+} // namespace
+
+TEST_SUIT_BEGIN
+
+TEST_CASE("names") {
+    for (auto set : supportedSets()) {
+        auto parsed = InstructionSet::Scalar;
+        ASSERT(parseInstructionSet(name(set), parsed), "could not parse");
+        ASSERT_EQ(static_cast<int>(parsed), static_cast<int>(set));
+    }
+    auto parsed = InstructionSet::Avx2;
+    ASSERT(!parseInstructionSet("mmx", parsed), "mmx is not supported");
+    ASSERT(!parseInstructionSet(nullptr, parsed), "should handle nullptr");
+}
+
+TEST_CASE("override") {
+    const auto before = instructionSet();
+
+    instructionSet(InstructionSet::Scalar);
+    ASSERT_EQ(static_cast<int>(instructionSet()),
+              static_cast<int>(InstructionSet::Scalar));
+
+    // Sets that the cpu does not support are lowered
+    instructionSet(InstructionSet::Avx512);
+    ASSERT_EQ(static_cast<int>(instructionSet()),
+              static_cast<int>(cpuFeatures().best()));
+
+    instructionSet(before);
+}
+
+TEST_CASE("multiply") {
+    auto a = std::vector<Matrixf>{}, b = std::vector<Matrixf>{};
+    for (int i = 0; i < 37; ++i) {
+        a.push_back(rigidTestMatrix(i));
+        b.push_back(rigidTestMatrix(i + 5).inverse());
+    }
+
+    for (auto set : supportedSets()) {
+        auto out = std::vector<Matrixf>(a.size());
+        kernels(set).multiply(a.front().data(),
+                              b.front().data(),
+                              out.front().data(),
+                              a.size());
+        for (size_t i = 0; i < a.size(); ++i) {
+            ASSERT_LT((out[i] - a[i] * b[i]).abs2(), smallNumber);
+        }
+
+        // In place
+        auto inPlace = a;
+        kernels(set).multiply(inPlace.front().data(),
+                              b.front().data(),
+                              inPlace.front().data(),
+                              a.size());
+        ASSERT_LT((inPlace.back() - out.back()).abs2(), smallNumber);
+    }
+}
+
+TEST_CASE("transform and rotate") {
+    const auto points = testPoints();
+    const auto m = rigidTestMatrix(3);
+    const auto q = Quaternionf{Matrixf::RotationY(.7f) *
+                               Matrixf::RotationZ(-.2f)};
+
+    auto expected = std::vector<Vecf>{}, directions = std::vector<Vecf>{},
+         rotated = std::vector<Vecf>{};
+    for (auto &p : points) {
+        expected.push_back(m * p);
+        directions.push_back(m * p - m * Vecf{});
+        rotated.push_back(q.rotate(p));
+    }
+
+    for (auto set : supportedSets()) {
+        auto out = points;
+        kernels(set).transform3(m.data(),
+                                &out.front().x,
+                                &out.front().x,
+                                out.size(),
+                                TransformMode::Point);
+        ASSERT_LT(maxDistance(out, expected), smallNumber);
+
+        kernels(set).transform3(m.data(),
+                                &points.front().x,
+                                &out.front().x,
+                                out.size(),
+                                TransformMode::Direction);
+        ASSERT_LT(maxDistance(out, directions), smallNumber);
+
+        kernels(set).rotate3(
+            &q.w, &points.front().x, &out.front().x, out.size());
+        ASSERT_LT(maxDistance(out, rotated), smallNumber);
+    }
+}
+
+TEST_CASE("sincos") {
+    auto angles = std::vector<float>{};
+    for (int i = 0; i < 1001; ++i) {
+        angles.push_back(-100.f + .2f * i);
+    }
+    // Angles where the reduction in the kernels is not exact
+    for (float x = 1e4f; x < 1e30f; x *= 3) {
+        angles.push_back(x);
+        angles.push_back(-x);
+    }
+
+    for (auto set : supportedSets()) {
+        auto s = std::vector<float>(angles.size());
+        auto c = std::vector<float>(angles.size());
+        kernels(set).sincos(angles.data(), s.data(), c.data(), angles.size());
+        for (size_t i = 0; i < angles.size(); ++i) {
+            ASSERT_NEAR(s[i], std::sin(angles[i]), smallNumber);
+            ASSERT_NEAR(c[i], std::cos(angles[i]), smallNumber);
+        }
+    }
+}
+
+TEST_SUIT_END
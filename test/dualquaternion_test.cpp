@@ -0,0 +1,169 @@
+// Copyright © Mattias Larsson Sköld
+
+#include "matmath/dualquaternion.h"
+#include "mls-unit-test/unittest.h"
+#include "testmatrix.h"
+#include <cstdint>
+#include <vector>
+
+constexpr double smallNumber = .00001;
+
+namespace {
+
+template <typename T>
+double distance(const VecT<T> &a, const VecT<T> &b) {
+    return (VecT<double>{a} - VecT<double>{b}).abs();
+}
+
+} // namespace
+
+TEST_SUIT_BEGIN
+
+TEST_CASE("size") {
+    static_assert(sizeof(DualQuaternionf) == sizeof(float) * 8);
+    static_assert(sizeof(DualQuaterniond) == sizeof(double) * 8);
+}
+
+TEST_CASE("matrix conversion") {
+    const auto m = rigidTestMatrix<double>(0);
+    const auto dq = DualQuaterniond{m};
+
+    ASSERT_LT((Matrixd{dq} - m).abs2(), smallNumber);
+
+    const auto translation = dq.translation();
+    const auto expected = Vecd{m.x4, m.y4, m.z4};
+    ASSERT_LT(distance(translation, expected), smallNumber);
+
+    const auto p = Vecd{1, -2, 3};
+    ASSERT_LT(distance(dq.transformPoint(p), m * p), smallNumber);
+    ASSERT_LT(distance(dq.transformDirection(p), Matrixd{dq.real} * p),
+              smallNumber);
+}
+
+TEST_CASE("composition") {
+    const auto a = rigidTestMatrix<double>(1);
+    const auto b = rigidTestMatrix<double>(2);
+
+    // Same order as for QuaternionT, a is applied first
+    const auto product = DualQuaterniond{a} * DualQuaterniond{b};
+    ASSERT_LT((Matrixd{product} - b * a).abs2(), smallNumber);
+
+    auto c = DualQuaterniond{a};
+    c *= DualQuaterniond::Translation({1, 2, 3});
+    ASSERT_LT((Matrixd{c} - Matrixd::Translation(1, 2, 3) * a).abs2(),
+              smallNumber);
+}
+
+TEST_CASE("inverse") {
+    const auto m = rigidTestMatrix<double>(3);
+    const auto dq = DualQuaterniond{m};
+
+    ASSERT_LT((Matrixd{dq.inverse()} - m.inverseNormalized()).abs2(),
+              smallNumber);
+
+    const auto identity = Matrixd{dq * dq.inverse()};
+    ASSERT_LT((identity - Matrixd::Identity()).abs2(), smallNumber);
+}
+
+TEST_CASE("normalize") {
+    const auto dq = DualQuaterniond{rigidTestMatrix<double>(4)};
+    auto scaled = dq * 3.;
+    scaled.dual = scaled.dual + scaled.real * .1;
+    scaled.normalize();
+
+    ASSERT_NEAR(scaled.real.abs(), 1., smallNumber);
+    ASSERT_NEAR(scaled.real.dot(scaled.dual), 0., smallNumber);
+    ASSERT_LT((Matrixd{scaled} - Matrixd{dq}).abs2(), smallNumber);
+}
+
+TEST_CASE("blend") {
+    const DualQuaterniond transforms[] = {
+        DualQuaterniond{rigidTestMatrix<double>(1)},
+        DualQuaterniond{rigidTestMatrix<double>(1)} * -1.,
+    };
+    const double weights[] = {.3, .7};
+
+    // Blending a transform with itself (with the sign flipped) gives the same
+    // transform
+    const auto blended = DualQuaterniond::blend(transforms, weights, 2);
+    ASSERT_LT((Matrixd{blended} - rigidTestMatrix<double>(1)).abs2(),
+              smallNumber);
+
+    // A pure translation blends linearly
+    const DualQuaterniond translations[] = {
+        DualQuaterniond::Translation({1, 0, 0}),
+        DualQuaterniond::Translation({0, 2, 0}),
+    };
+    const auto translation =
+        DualQuaterniond::blend(translations, weights, 2).translation();
+    ASSERT_LT(distance(translation, Vecd{.3, 1.4, 0}), smallNumber);
+}
+
+template <typename T>
+void testSkin() {
+    constexpr size_t joints = 5;
+    constexpr size_t vertices = 37;
+
+    auto palette = std::vector<DualQuaternion<T>>{};
+    for (size_t i = 0; i < joints; ++i) {
+        palette.push_back(DualQuaternion<T>{rigidTestMatrix<T>(i)});
+    }
+    // Same rotation as the first but with the opposite sign
+    palette.back() = palette.front() * T(-1);
+
+    auto indices = std::vector<uint16_t>{};
+    auto weights = std::vector<T>{};
+    auto positions = std::vector<VecT<T>>{};
+    for (size_t i = 0; i < vertices; ++i) {
+        T sum = 0;
+        for (size_t k = 0; k < 4; ++k) {
+            indices.push_back(static_cast<uint16_t>((i + k * 3) % joints));
+            weights.push_back(static_cast<T>((i * 7 + k * 5) % 11) + 1);
+            sum += weights.back();
+        }
+        for (size_t k = 0; k < 4; ++k) {
+            weights[i * 4 + k] /= sum;
+        }
+        // The last influence is unused for some of the vertices
+        if (i % 3 == 0) {
+            weights[i * 4 + 3] = 0;
+        }
+        positions.push_back(
+            {static_cast<T>(i), static_cast<T>(i % 4) - 2, T(.5)});
+    }
+
+    auto points = std::vector<VecT<T>>(vertices);
+    auto normals = positions;
+    DualQuaternion<T>::skin(palette.data(),
+                            indices.data(),
+                            weights.data(),
+                            positions.data(),
+                            points.data(),
+                            vertices);
+    DualQuaternion<T>::skin(palette.data(),
+                            indices.data(),
+                            weights.data(),
+                            normals.data(),
+                            normals.data(),
+                            vertices,
+                            matmath::simd::TransformMode::Direction);
+
+    for (size_t i = 0; i < vertices; ++i) {
+        DualQuaternion<T> influences[4];
+        for (size_t k = 0; k < 4; ++k) {
+            influences[k] = palette[indices[i * 4 + k]];
+        }
+        const auto expected =
+            DualQuaternion<T>::blend(influences, weights.data() + i * 4, 4);
+        const auto &p = positions[i];
+        ASSERT_LT(distance(points[i], expected.transformPoint(p)), .0001);
+        ASSERT_LT(distance(normals[i], expected.transformDirection(p)), .0001);
+    }
+}
+
+TEST_CASE("skin") {
+    testSkin<float>();
+    testSkin<double>();
+}
+
+TEST_SUIT_END
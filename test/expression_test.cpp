@@ -0,0 +1,97 @@
+// Copyright © Mattias Larsson Sköld
+
+#include "matmath/expression.h"
+#include "mls-unit-test/unittest.h"
+#include "testmatrix.h"
+
+using matmath::expr::lazy;
+
+constexpr double smallNumber = .00001;
+
+TEST_SUIT_BEGIN
+
+TEST_CASE("vector expressions") {
+    const auto a = Vecf{1, 2, 3};
+    const auto b = Vecf{-4, 5, .5};
+    const auto c = Vecf{2, 0, 1};
+    const auto d = Vecf{.3f, 7, -1};
+    const auto s = 1.5f;
+
+    Vecf v = lazy(a) * s + b - lazy(c).cross(d);
+    ASSERT_EQ(v, a * s + b - c.cross(d));
+
+    v = s * lazy(a) - b / 2.f;
+    ASSERT_EQ(v, a * s - b / 2.f);
+
+    v = -lazy(a) + b;
+    ASSERT_EQ(v, -a + b);
+
+    ASSERT_EQ(lazy(a) * (lazy(b) + c), a * (b + c));
+    ASSERT_EQ((lazy(a) - b).abs2(), (a - b).abs2());
+    ASSERT_EQ(eval(lazy(a) + b), a + b);
+
+    constexpr auto ca = Vecf{1, 2, 3};
+    constexpr Vecf cv = lazy(ca) * 2.f + ca;
+    static_assert(cv.x == 3 && cv.y == 6 && cv.z == 9);
+}
+
+TEST_CASE("matrix element wise expressions") {
+    const auto m1 = testMatrix();
+    const auto m2 = Matrixf::RotationY(.4);
+
+    Matrixf m = lazy(m1) + lazy(m2) * 2.f - lazy(m1) / 4.f;
+    for (int i = 0; i < 16; ++i) {
+        ASSERT_NEAR(m[i], m1[i] + m2[i] * 2.f - m1[i] / 4.f, smallNumber);
+    }
+
+    // Products are evaluated before they are added
+    m = lazy(m1) * m2 + m1;
+    const auto product = m1 * m2;
+    for (int i = 0; i < 16; ++i) {
+        ASSERT_NEAR(m[i], product[i] + m1[i], smallNumber);
+    }
+}
+
+TEST_CASE("matrix products") {
+    const auto m1 = testMatrix();
+    const auto m2 = Matrixf::RotationY(.4);
+    const auto m3 = Matrixf::Translation(1, 2, 3);
+
+    Matrixf m = lazy(m1) * m2 * m3;
+    ASSERT_LT((m - m1 * m2 * m3).abs2(), smallNumber);
+
+    // Temporaries are stored in the expression
+    m = lazy(m1) * Matrixf::RotationY(.4);
+    ASSERT_LT((m - m1 * m2).abs2(), smallNumber);
+}
+
+TEST_CASE("matrix vector products") {
+    const auto m1 = testMatrix();
+    const auto m2 = Matrixf::RotationY(.4);
+    auto m3 = Matrixf::Translation(1, 2, 3);
+    const auto v = Vecf{1, 2, 3};
+
+    const auto expected = Vecf{m1 * m2 * m3 * Vec{v}};
+
+    Vecf p = lazy(m1) * m2 * m3 * v;
+    ASSERT_LT((p - expected).abs2(), smallNumber);
+
+    p = lazy(m1) * (m2 * m3) * v;
+    ASSERT_LT((p - expected).abs2(), smallNumber);
+
+    // Sums and scaling distributes over the vector
+    const Matrixf sum = lazy(m1) + m2;
+    p = (lazy(m1) + m2) * 2.f * v;
+    ASSERT_LT((p - Vecf{sum * Vec{v}} * 2.f).abs2(), .0001);
+
+    // The w value of non affine matrices must be kept between the products
+    m3.w1 = .5;
+    const auto projected = Vecf{m1 * m3 * Vec{v}};
+    p = lazy(m1) * m3 * v;
+    ASSERT_LT((p - projected).abs2(), smallNumber);
+
+    p = lazy(m1) * v + v;
+    ASSERT_LT((p - (Vecf{m1 * Vec{v}} + v)).abs2(), smallNumber);
+}
+
+TEST_SUIT_END
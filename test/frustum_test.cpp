@@ -0,0 +1,164 @@
+// Copyright © Mattias Larsson Sköld
+
+#include "matmath/frustum.h"
+#include "mls-unit-test/unittest.h"
+#include <vector>
+
+constexpr double smallNumber = .00001;
+
+namespace {
+
+//! Right handed perspective projection looking along -z, with the depth
+//! range of OpenGL or Direct3D
+template <typename T>
+Matrix<T> perspective(T aspect, T near, T far, ClipDepth depth) {
+    const T f = 1; // 90 degrees vertical field of view
+    const T a = depth == ClipDepth::ZeroToOne ? far / (near - far)
+                                              : (near + far) / (near - far);
+    const T b = depth == ClipDepth::ZeroToOne
+                    ? near * far / (near - far)
+                    : 2 * near * far / (near - far);
+    // clang-format off
+    return {
+        f / aspect, 0, 0,  0,
+        0,          f, 0,  0,
+        0,          0, a, -1,
+        0,          0, b,  0,
+    };
+    // clang-format on
+}
+
+template <typename T>
+Frustum<T> testFrustum(ClipDepth depth = ClipDepth::NegativeOneToOne) {
+    const auto view = Matrix<T>::Translation(-1, -2, -3);
+    const auto projection = perspective<T>(2, 1, 100, depth);
+    return Frustum<T>::fromMatrix(projection * view, depth);
+}
+
+//! Points around and inside of the frustum, with the camera at (1, 2, 3)
+template <typename T>
+std::vector<VecT<T>> testPoints() {
+    auto points = std::vector<VecT<T>>{};
+    for (int i = 0; i < 67; ++i) {
+        points.push_back({T((i * 7) % 23 - 11) * 5 + 1,
+                          T((i * 5) % 17 - 8) * 3 + 2,
+                          T(3 - (i * 11) % 37 * 3 + 5)});
+    }
+    return points;
+}
+
+template <typename T>
+void testPlanes() {
+    for (auto depth : {ClipDepth::NegativeOneToOne, ClipDepth::ZeroToOne}) {
+        const auto frustum = testFrustum<T>(depth);
+        for (auto &plane : frustum.planes) {
+            ASSERT_NEAR(plane.normal.abs(), 1, smallNumber);
+        }
+
+        using F = Frustum<T>;
+        ASSERT_NEAR(frustum.planes[F::Near].distanceTo({1, 2, 2}),
+                    0,
+                    smallNumber);
+        // The far plane is less precise for float
+        ASSERT_NEAR(frustum.planes[F::Far].distanceTo({1, 2, -97}),
+                    0,
+                    .001);
+        ASSERT_NEAR(frustum.planes[F::Left].distanceTo({-1, 2, 2}),
+                    0,
+                    smallNumber);
+        ASSERT_NEAR(frustum.planes[F::Top].distanceTo({1, 3, 2}),
+                    0,
+                    smallNumber);
+
+        ASSERT(frustum.contains({1, 2, 0}), "should be inside");
+        ASSERT(frustum.contains({1, 2, -96}), "should be inside");
+        ASSERT(!frustum.contains({1, 2, 2.5}), "should be outside");
+        ASSERT(!frustum.contains({1, 2, -98}), "should be outside");
+        ASSERT(!frustum.contains({1, 6, 0}), "should be outside");
+        ASSERT(!frustum.contains({-6, 2, 0}), "should be outside");
+    }
+}
+
+template <typename T>
+void testSingle() {
+    const auto frustum = testFrustum<T>();
+
+    ASSERT(frustum.intersectsSphere({1, 2, 2.5}, 1), "should be inside");
+    ASSERT(!frustum.intersectsSphere({1, 2, 4}, 1), "should be outside");
+    ASSERT(frustum.intersectsSphere({1, 6, 0}, 2), "should be inside");
+    ASSERT(!frustum.intersectsSphere({1, 8, 0}, 2), "should be outside");
+
+    const auto box = [&frustum](VecT<T> min, VecT<T> max) {
+        return frustum.intersectsBox(min, max);
+    };
+    ASSERT(box({0, 1, 1.5}, {2, 3, 5}), "should be inside");
+    ASSERT(!box({0, 1, 2.5}, {2, 3, 4}), "should be outside");
+    ASSERT(box({-100, -100, -100}, {100, 100, 100}), "should be inside");
+    ASSERT(!box({20, 1, -5}, {30, 3, -3}), "should be outside");
+    ASSERT(frustum.intersectsBox(AABB<T>{{0, 1, 1.5}, {2, 3, 5}}),
+           "should be inside");
+}
+
+template <typename T>
+void testBatch() {
+    const auto frustum = testFrustum<T>();
+    const auto points = testPoints<T>();
+    const auto count = points.size();
+
+    auto radii = std::vector<T>{};
+    auto max = std::vector<VecT<T>>{};
+    auto soa = VecSoA<T>{points};
+    for (size_t i = 0; i < count; ++i) {
+        radii.push_back(T(i % 5));
+        max.push_back(points[i] + VecT<T>{1, 2, 3} * T(i % 4));
+    }
+
+    auto spheres = std::vector<uint32_t>(Frustum<T>::maskSize(count), ~0u);
+    auto spheresSoA = spheres;
+    auto boxes = spheres;
+    frustum.cullSpheres(points.data(), radii.data(), count, spheres.data());
+    frustum.cullSpheres(soa, radii.data(), spheresSoA.data());
+    frustum.cullBoxes(points.data(), max.data(), count, boxes.data());
+
+    size_t visibleSpheres = 0;
+    size_t visibleBoxes = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const auto sphere = frustum.intersectsSphere(points[i], radii[i]);
+        const auto box = frustum.intersectsBox(points[i], max[i]);
+        ASSERT_EQ(Frustum<T>::isVisible(spheres.data(), i), sphere);
+        ASSERT_EQ(Frustum<T>::isVisible(spheresSoA.data(), i), sphere);
+        ASSERT_EQ(Frustum<T>::isVisible(boxes.data(), i), box);
+        visibleSpheres += sphere;
+        visibleBoxes += box;
+    }
+
+    // Make sure that the test has both cases
+    ASSERT_GT(visibleSpheres, 0);
+    ASSERT_LT(visibleSpheres, count);
+    ASSERT_GT(visibleBoxes, 0);
+    ASSERT_LT(visibleBoxes, count);
+
+    // Bits after the last object are cleared
+    ASSERT_EQ(spheres.back() >> (count % 32), 0);
+}
+
+} // namespace
+
+TEST_SUIT_BEGIN
+
+TEST_CASE("extract planes") {
+    testPlanes<float>();
+    testPlanes<double>();
+}
+
+TEST_CASE("single volumes") {
+    testSingle<float>();
+    testSingle<double>();
+}
+
+TEST_CASE("batch culling") {
+    testBatch<float>();
+    testBatch<double>();
+}
+
+TEST_SUIT_END
@@ -0,0 +1,205 @@
+// Copyright © Mattias Larsson Sköld
+
+#include "matmath/kdtree.h"
+#include "mls-unit-test/unittest.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+constexpr double smallNumber = .0001;
+
+namespace {
+
+//! Points and query points for one vector type, with some duplicates and a
+//! line of points with the same coordinates on one axis
+template <class Vec>
+struct TestSet {
+    using T = typename KdTree<Vec>::T;
+    using Neighbour = typename KdTree<Vec>::Neighbour;
+
+    std::minstd_rand random{5489u};
+    std::vector<Vec> points;
+    std::vector<Vec> queries;
+    KdTree<Vec> tree;
+
+    TestSet(size_t count, matmath::ThreadPool &pool) {
+        for (size_t i = 0; i < count; ++i) {
+            if (i % 17 == 16) {
+                points.push_back(points[i / 2]);
+            }
+            else if (i % 13 == 12) {
+                auto p = point();
+                p.x = 5;
+                points.push_back(p);
+            }
+            else {
+                points.push_back(point());
+            }
+        }
+        for (int i = 0; i < 100; ++i) {
+            queries.push_back(point());
+        }
+        tree.build(points.data(), points.size(), pool);
+    }
+
+    Vec point() {
+        auto value = std::uniform_real_distribution<double>{0, 10};
+        if constexpr (KdTree<Vec>::dimensions == 2) {
+            return {T(value(random)), T(value(random))};
+        }
+        else {
+            return {T(value(random)), T(value(random)), T(value(random) / 5)};
+        }
+    }
+
+    //! All squared distances from p, sorted
+    std::vector<double> sortedDistances(const Vec &p) const {
+        auto distances = std::vector<double>{};
+        for (auto &point : points) {
+            distances.push_back((point - p).abs2());
+        }
+        std::sort(distances.begin(), distances.end());
+        return distances;
+    }
+};
+
+template <class Vec>
+void testNearest(matmath::ThreadPool &pool) {
+    const auto set = TestSet<Vec>{5000, pool};
+    ASSERT_EQ(set.tree.size(), set.points.size());
+    for (auto &p : set.queries) {
+        auto nearest = typename TestSet<Vec>::Neighbour{};
+        ASSERT(set.tree.nearest(p, nearest), "should find a point");
+        ASSERT_NEAR(
+            nearest.distance2, set.sortedDistances(p).front(), smallNumber);
+        ASSERT_NEAR((set.points[nearest.index] - p).abs2(),
+                    nearest.distance2,
+                    smallNumber);
+    }
+}
+
+template <class Vec>
+void testKNearest(matmath::ThreadPool &pool) {
+    const auto set = TestSet<Vec>{5000, pool};
+    for (auto &p : set.queries) {
+        const auto expected = set.sortedDistances(p);
+        typename TestSet<Vec>::Neighbour neighbours[10];
+        ASSERT_EQ(set.tree.kNearest(p, neighbours, 10), 10);
+        for (size_t j = 0; j < 10; ++j) {
+            ASSERT_NEAR(neighbours[j].distance2, expected[j], smallNumber);
+            ASSERT_NEAR((set.points[neighbours[j].index] - p).abs2(),
+                        neighbours[j].distance2,
+                        smallNumber);
+        }
+    }
+}
+
+template <class Vec>
+void testRadiusSearch(matmath::ThreadPool &pool) {
+    const auto set = TestSet<Vec>{5000, pool};
+    const auto radius = .3;
+    const auto radius2 = radius * radius;
+    for (auto &p : set.queries) {
+        const auto expected = set.sortedDistances(p);
+        const auto inside = static_cast<size_t>(
+            std::upper_bound(expected.begin(), expected.end(), radius2) -
+            expected.begin());
+        auto found = std::vector<size_t>{};
+        set.tree.radiusSearch(p, radius, [&](size_t index, auto distance2) {
+            ASSERT_LT(distance2, radius2 + smallNumber);
+            found.push_back(index);
+        });
+        std::sort(found.begin(), found.end());
+        ASSERT(std::unique(found.begin(), found.end()) == found.end(),
+               "each point should be found once");
+        ASSERT_EQ(found.size(), inside);
+    }
+}
+
+//! Batched queries gives the same result as one at a time
+template <class Vec>
+void testBatches(matmath::ThreadPool &pool) {
+    using Neighbour = typename TestSet<Vec>::Neighbour;
+    const auto set = TestSet<Vec>{5000, pool};
+    const auto &queries = set.queries;
+    auto nearest = std::vector<Neighbour>(queries.size());
+    set.tree.nearest(queries.data(), queries.size(), nearest.data(), pool);
+    constexpr size_t k = 4;
+    auto kNearest = std::vector<Neighbour>(queries.size() * k);
+    set.tree.kNearest(
+        queries.data(), queries.size(), kNearest.data(), k, pool);
+    for (size_t i = 0; i < queries.size(); ++i) {
+        auto expected = Neighbour{};
+        set.tree.nearest(queries[i], expected);
+        ASSERT_EQ(nearest[i].distance2, expected.distance2);
+        ASSERT_EQ(kNearest[i * k].distance2, expected.distance2);
+        ASSERT_LT(kNearest[i * k].distance2,
+                  kNearest[i * k + k - 1].distance2 + smallNumber);
+    }
+}
+
+template <class Vec>
+void testLimits() {
+    using Neighbour = typename KdTree<Vec>::Neighbour;
+    auto single = matmath::ThreadPool{1};
+    const auto set = TestSet<Vec>{5, single};
+    const auto &points = set.points;
+
+    // Fewer points than asked for
+    Neighbour neighbours[8];
+    ASSERT_EQ(set.tree.kNearest(points[2], neighbours, 8), 5);
+    ASSERT_EQ(neighbours[0].distance2, 0);
+    ASSERT_EQ(set.tree.kNearest(points[2], neighbours, 0), 0);
+
+    // Nothing within the limit
+    auto far = points[2];
+    far.x += 100;
+    auto nearest = Neighbour{};
+    nearest.distance2 = 1;
+    ASSERT(!set.tree.nearest(far, nearest), "should be too far away");
+    ASSERT_EQ(set.tree.kNearest(far, neighbours, 8, 1), 0);
+
+    auto empty = KdTree<Vec>{};
+    ASSERT(empty.empty(), "should be empty");
+    ASSERT(!empty.nearest(points[0], nearest), "no points");
+    ASSERT_EQ(empty.kNearest(points[0], neighbours, 8), 0);
+}
+
+} // namespace
+
+TEST_SUIT_BEGIN
+
+TEST_CASE("nearest") {
+    auto single = matmath::ThreadPool{1};
+    testNearest<VecT<float>>(single);
+    testNearest<VecT<double>>(single);
+    testNearest<Vec2T<float>>(single);
+    testNearest<Vec2T<double>>(single);
+}
+
+TEST_CASE("k nearest") {
+    auto single = matmath::ThreadPool{1};
+    testKNearest<VecT<float>>(single);
+    testKNearest<Vec2T<double>>(single);
+}
+
+TEST_CASE("radius search") {
+    auto single = matmath::ThreadPool{1};
+    testRadiusSearch<VecT<double>>(single);
+    testRadiusSearch<Vec2T<float>>(single);
+}
+
+TEST_CASE("parallel") {
+    auto pool = matmath::ThreadPool{4};
+    testNearest<VecT<float>>(pool);
+    testKNearest<Vec2T<double>>(pool);
+    testBatches<VecT<float>>(pool);
+    testBatches<Vec2T<double>>(pool);
+}
+
+TEST_CASE("limits") {
+    testLimits<VecT<float>>();
+    testLimits<Vec2T<double>>();
+}
+
+TEST_SUIT_END
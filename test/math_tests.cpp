@@ -1,5 +1,6 @@
 #include "matmath/constmath.h"
 #include "mls-unit-test/unittest.h"
+#include <cmath>
 
 constexpr double small_number = 0.00000001;
 
@@ -10,28 +11,92 @@ constexpr bool isNear(double a, double b, double e = small_number) {
 TEST_SUIT_BEGIN
 
 TEST_CASE("sin") {
-    using namespace constmath;
     // These tests runs in compile time
-    static_assert(isNear(sin(0.), 0.));
-    static_assert(isNear(sin(pi / 6.), 1. / 2.));
-    static_assert(isNear(sin(pi / -6.), -1. / 2.));
-    static_assert(isNear(sin(pi / 2), 1.));
-    static_assert(isNear(sin(-pi / 2), -1.));
-    static_assert(isNear(sin(pi), 0.));
+    static_assert(isNear(constmath::sin(0.), 0.));
+    static_assert(isNear(constmath::sin(pi / 6.), 1. / 2.));
+    static_assert(isNear(constmath::sin(pi / -6.), -1. / 2.));
+    static_assert(isNear(constmath::sin(pi / 2), 1.));
+    static_assert(isNear(constmath::sin(-pi / 2), -1.));
+    static_assert(isNear(constmath::sin(pi), 0.));
 
-    static_assert(isNear(sin(30), sin(-30)));
-    static_assert(isNear(sin(340.), sin(340. + pi * 2)));
+    static_assert(isNear(constmath::sin(-.5), -constmath::sin(.5)));
+    static_assert(isNear(constmath::sin(5 * pi / 6), .5));
+    static_assert(isNear(constmath::sin(340.), constmath::sin(340. + pi * 2)));
+
+    for (double x = -20; x < 20; x += .01) {
+        ASSERT_NEAR(constmath::sin(x), std::sin(x), 1e-14);
+    }
+
+    ASSERT(std::isnan(constmath::sin(std::nan(""))), "nan should give nan");
+    ASSERT(std::isnan(constmath::sin(HUGE_VAL)), "inf should give nan");
+    ASSERT(std::isnan(constmath::cos(-HUGE_VAL)), "inf should give nan");
+    ASSERT(std::isnan(constmath::tan(1e300)), "too large to reduce");
+    ASSERT(std::isnan(constmath::cos(-1e19)), "too large to reduce");
 }
 
 TEST_CASE("cos") {
-    using namespace constmath;
-    static_assert(isNear(cos(0), 1));
+    static_assert(isNear(constmath::cos(0), 1));
+    static_assert(isNear(constmath::cos(pi / 3), .5));
+    static_assert(isNear(constmath::cos(pi), -1.));
+
+    for (double x = -20; x < 20; x += .01) {
+        ASSERT_NEAR(constmath::cos(x), std::cos(x), 1e-14);
+    }
+}
+
+TEST_CASE("tan") {
+    static_assert(isNear(constmath::tan(pi / 4), 1.));
+    static_assert(isNear(constmath::tan(-pi / 4), -1.));
+
+    for (double x = -1.5; x < 1.5; x += .01) {
+        ASSERT_NEAR(constmath::tan(x), std::tan(x), 1e-12);
+    }
 }
 
 TEST_CASE("catan2") {
-    using namespace constmath;
-    //    static_assert(isNear(atan2(0, 1), 0.));
-    //    static_assert(isNear(atan2(1, 1), 1.));
+    static_assert(isNear(constmath::atan2(0., 1.), 0.));
+    static_assert(isNear(constmath::atan2(1., 1.), pi / 4));
+    static_assert(isNear(constmath::atan2(1., 0.), pi / 2));
+    static_assert(isNear(constmath::atan2(0., -1.), pi));
+    static_assert(isNear(constmath::atan2(-1., -1.), -pi * 3 / 4));
+
+    for (double a = -3.1; a < 3.1; a += .01) {
+        const auto y = std::sin(a) * 3, x = std::cos(a) * 3;
+        ASSERT_NEAR(constmath::atan2(y, x), std::atan2(y, x), 1e-14);
+    }
+}
+
+TEST_CASE("asin and acos") {
+    static_assert(isNear(constmath::asin(.5), pi / 6));
+    static_assert(isNear(constmath::acos(.5), pi / 3));
+    static_assert(isNear(constmath::acos(-1.), pi));
+
+    ASSERT(std::isnan(constmath::asin(2.)), "out of range should give nan");
+
+    for (double x = -1; x <= 1; x += .01) {
+        ASSERT_NEAR(constmath::asin(x), std::asin(x), 1e-14);
+        ASSERT_NEAR(constmath::acos(x), std::acos(x), 1e-14);
+    }
+}
+
+TEST_CASE("sqrt") {
+    static_assert(constmath::sqrt(4.) == 2.);
+    static_assert(constmath::sqrt(0.) == 0.);
+    static_assert(constmath::sqrt(1e300) == 1e150);
+    static_assert(isNear(constmath::sqrt(2.f), 1.41421356f, 1e-6));
+
+    ASSERT(std::isnan(constmath::sqrt(-1.)), "negative should give nan");
+
+    for (double x = 1e-30; x < 1e30; x *= 1.37) {
+        ASSERT_NEAR(constmath::sqrt(x) / std::sqrt(x), 1., 1e-15);
+    }
+}
+
+TEST_CASE("floor") {
+    static_assert(constmath::floor(-2.) == -2.);
+    static_assert(constmath::floor(-2.5) == -3.);
+    static_assert(constmath::floor(2.5) == 2.);
+    static_assert(constmath::round(-2.5) == -2.);
 }
 
 TEST_SUIT_END
@@ -7,7 +7,9 @@
 
 #include "matmath/matrix.h"
 #include "mls-unit-test/unittest.h"
+#include "testmatrix.h"
 #include <iomanip> //setprecision
+#include <vector>
 
 constexpr double epsilon = 0.000000001;
 
@@ -220,6 +222,22 @@ TEST_CASE("rotate vertex") {
     ASSERT_LT((m * v - Vec(-2, -3, 4)).abs2(), epsilon);
 }
 
+TEST_CASE("axis rotations are proper rotations") {
+    // A reflection would have the determinant -1
+    auto inv = Matrixd{};
+    ASSERT_NEAR(Matrixd::RotationX(.4).tryInverse(inv), 1., 1e-12);
+    ASSERT_NEAR(Matrixd::RotationY(.4).tryInverse(inv), 1., 1e-12);
+    ASSERT_NEAR(Matrixd::RotationZ(.4).tryInverse(inv), 1., 1e-12);
+
+    // All three turns the same way relative to Rotation(angle, axis)
+    const auto x = Matrixd::Rotation(-.4, Vec(1, 0, 0));
+    const auto y = Matrixd::Rotation(-.4, Vec(0, 1, 0));
+    const auto z = Matrixd::Rotation(-.4, Vec(0, 0, 1));
+    ASSERT_LT((Matrixd::RotationX(.4) - x).abs2(), 1e-24);
+    ASSERT_LT((Matrixd::RotationY(.4) - y).abs2(), 1e-24);
+    ASSERT_LT((Matrixd::RotationZ(.4) - z).abs2(), 1e-24);
+}
+
 TEST_CASE("normalize scale") {
     auto m = Matrixf::Scale(2, 3, 4);
 
@@ -366,4 +384,178 @@ TEST_CASE("rotated translation") {
     static_assert(almostEqual(m.z4, (9.f + 10.f + 11.f) * 2.f + 12.f));
 }
 
+TEST_CASE("multiplication") {
+    // clang-format off
+    constexpr Matrixf m1({
+        1, 2, 3, 4,
+        5, 6, 7, 8,
+        9, 10,11,12,
+        13,14,15,16
+    });
+
+    constexpr Matrixf m2({
+        2, 0, 1, 0,
+        0, 3, 0, 1,
+        1, 0, 4, 0,
+        0, 1, 0, 5
+    });
+    // clang-format on
+
+    // Evaluated with the scalar version in compile time
+    constexpr auto expected = m1 * m2;
+    static_assert(almostEqual(expected.x1, 11.f));
+    static_assert(almostEqual(expected.w4, 88.f));
+
+    printMatrix(m1 * m2);
+    printMatrix(expected);
+    ASSERT_LT((m1 * m2 - expected).abs2(), epsilon);
+
+    auto m3 = m1;
+    m3 *= m2;
+    ASSERT_LT((m3 - expected).abs2(), epsilon);
+
+    // Same thing for double precision
+    const Matrixd d1 = m1;
+    const Matrixd d2 = m2;
+    ASSERT_LT((d1 * d2 - expected).abs2(), epsilon);
+
+    auto d3 = d1;
+    d3 *= d2;
+    ASSERT_LT((d3 - expected).abs2(), epsilon);
+}
+
+TEST_CASE("batch transform points and directions") {
+    const auto m = testMatrix();
+
+    // Odd size to also test the values that does not fill a whole register
+    std::vector<Vecf> points;
+    for (int i = 0; i < 37; ++i) {
+        points.push_back({i * .5f, 1.f - i, i * .1f + 2.f});
+    }
+
+    auto transformed = std::vector<Vecf>(points.size());
+    m.transformPoints(points.data(), transformed.data(), points.size());
+
+    auto directions = std::vector<Vecf>(points.size());
+    m.transformDirections(points.data(), directions.data(), points.size());
+
+    const auto rotation = m.rotationPart();
+    for (size_t i = 0; i < points.size(); ++i) {
+        ASSERT_LT((transformed[i] - m * Vec(points[i])).abs2(), .0001);
+        ASSERT_LT((directions[i] - rotation * Vec(points[i])).abs2(), .0001);
+    }
+
+    // In place
+    m.transformPoints(points.data(), points.data(), points.size());
+    for (size_t i = 0; i < points.size(); ++i) {
+        ASSERT_LT((transformed[i] - points[i]).abs2(), .0001);
+    }
+}
+
+TEST_CASE("batch transform with double precision") {
+    auto m = Matrixd::RotationY(.7);
+    m.translateGlobal(1, 2, 3);
+
+    std::vector<Vecd> points;
+    for (int i = 0; i < 11; ++i) {
+        points.push_back({i * 1., i * 2., i * -3.});
+    }
+
+    auto transformed = std::vector<Vecd>(points.size());
+    m.transformPoints(points.data(), transformed.data(), points.size());
+
+    for (size_t i = 0; i < points.size(); ++i) {
+        ASSERT_LT((transformed[i] - m * points[i]).abs2(), epsilon);
+    }
+}
+
+TEST_CASE("batch transform normals") {
+    auto m = Matrixf::RotationZ(.5);
+    m.scale(1, 4, 1);
+    m.translateGlobal(1, 2, 3);
+
+    // Tangents on a surface and the normal of that surface
+    const auto tangents = std::vector<Vecf>{{1, 1, 0}, {0, 0, 1}};
+    const auto normals = std::vector<Vecf>{{1, -1, 0}};
+
+    auto transformedTangents = std::vector<Vecf>(tangents.size());
+    auto transformedNormals = std::vector<Vecf>(normals.size());
+
+    m.transformDirections(
+        tangents.data(), transformedTangents.data(), tangents.size());
+    m.transformNormals(
+        normals.data(), transformedNormals.data(), normals.size());
+
+    ASSERT_GT(transformedNormals.front().abs2(), .1);
+    for (auto &t : transformedTangents) {
+        ASSERT_LT(std::abs(t * transformedNormals.front()), .0001);
+    }
+}
+
+TEST_CASE("try inverse") {
+    const auto identity = Matrixf::Identity();
+
+    // Not affine, like a projection matrix
+    // clang-format off
+    const Matrixf m({
+        2, 0, 0, 0,
+        0, 3, 0, 0,
+        0, 0, -1.2f, -1,
+        1, 2, -2.2f, 0,
+    });
+    // clang-format on
+
+    auto inv = Matrixf{};
+    static_assert(noexcept(m.tryInverse(inv)), "should not throw");
+    const auto det = m.tryInverse(inv);
+    printMatrix(inv);
+    ASSERT_NEAR(det, 2.f * 3.f * -2.2f, .0001);
+    ASSERT_LT((m * inv - identity).abs2(), .00001);
+
+    // Affine
+    auto a = Matrixf::RotationX(.3) * Matrixf::Scale(2, 3, 4);
+    a.translateGlobal(1, 2, 3);
+    ASSERT(a.isAffine(), "matrix should be affine");
+    ASSERT_NEAR(a.tryInverse(inv), 2.f * 3.f * 4.f, .0001);
+    ASSERT_LT((a * inv - identity).abs2(), .00001);
+    ASSERT_LT((a.inverse() - inv).abs2(), .00001);
+
+    // Singular, output should be untouched
+    auto singular = Matrixf::Scale(1, 0, 1);
+    inv = identity;
+    ASSERT_EQ(singular.tryInverse(inv), 0.f);
+    ASSERT_EQ((inv - identity).abs2(), 0.f);
+    singular.w1 = 1;
+    singular.w2 = 0;
+    ASSERT_EQ(singular.tryInverse(inv), 0.f);
+    ASSERT_EQ((inv - identity).abs2(), 0.f);
+
+    // Double precision and compile time
+    constexpr auto md = [] {
+        auto md = Matrixd::Scale(2, 4, 8);
+        md.w1 = 1;
+        auto inv = Matrixd{};
+        md.tryInverse(inv);
+        return inv;
+    }();
+    static_assert(almostEqual(md.y2, .25));
+    static_assert(almostEqual(md.w1, -.5));
+}
+
+TEST_CASE("constexpr factories") {
+    constexpr auto rotation = Matrixd::RotationZ(pi / 6);
+    static_assert(almostEqual(rotation.x1, constmath::sqrt(3.) / 2));
+    static_assert(almostEqual(rotation.x2, .5));
+
+    constexpr auto axis = Matrixd::Rotation(pi / 2, {0, 0, 1});
+    static_assert(almostEqual(axis.x1, 0));
+    static_assert(almostEqual(axis.x2, -1));
+
+    static_assert(almostEqual(Vec(3, 4, 12).abs(), 13));
+    static_assert(almostEqual(Matrixd::Identity().abs(), 2));
+
+    const auto runtime = Matrixd::RotationZ(pi / 6);
+    ASSERT_LT((runtime - rotation).abs2(), 1e-20);
+}
+
 TEST_SUIT_END
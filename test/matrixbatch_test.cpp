@@ -0,0 +1,119 @@
+// Copyright © Mattias Larsson Sköld
+
+#include "matmath/matrixbatch.h"
+#include "mls-unit-test/unittest.h"
+#include "testmatrix.h"
+#include <vector>
+
+constexpr double smallNumber = .0001;
+
+namespace {
+
+//! A matrix that is not affine or orthogonal
+template <typename T>
+Matrix<T> generalMatrix(size_t i) {
+    auto m = rigidTestMatrix<T>(static_cast<int>(i));
+    m.scale(2, 3, 4);
+    m.w1 = T(.1) * static_cast<T>(i % 3);
+    m.w3 = T(.2);
+    return m;
+}
+
+template <typename T>
+double difference(const Matrix<T> &a, const Matrix<T> &b) {
+    return (Matrixd{a} - Matrixd{b}).abs2();
+}
+
+template <typename T, size_t Lanes>
+void testOperations() {
+    using Batch = MatrixBatch<T, Lanes>;
+    constexpr size_t count = Lanes * 3 - 1;
+
+    auto matrices = std::vector<Matrix<T>>{};
+    auto general = std::vector<Matrix<T>>{};
+    for (size_t i = 0; i < count; ++i) {
+        matrices.push_back(rigidTestMatrix<T>(static_cast<int>(i)));
+        general.push_back(generalMatrix<T>(i));
+    }
+
+    auto batches = std::vector<Batch>(3);
+    auto generalBatches = std::vector<Batch>(3);
+    Batch::pack(matrices.data(), batches.data(), count);
+    Batch::pack(general.data(), generalBatches.data(), count);
+
+    auto unpacked = std::vector<Matrix<T>>(count);
+    Batch::unpack(batches.data(), unpacked.data(), count);
+    for (size_t i = 0; i < count; ++i) {
+        ASSERT_EQ(difference(unpacked[i], matrices[i]), 0.);
+    }
+
+    // The unused lane is identity
+    ASSERT_EQ(difference(batches.back()[Lanes - 1], Matrix<T>::Identity()),
+              0.);
+
+    for (size_t b = 0; b < 3; ++b) {
+        const auto &batch = batches[b];
+        const auto product = batch * generalBatches[b];
+        const auto inverse = generalBatches[b].inverse();
+        const auto orthogonal = batch.inverseOrthogonal();
+        const auto normalized = batch.inverseNormalized();
+
+        VecT<T> points[Lanes];
+        VecT<T> transformed[Lanes];
+        for (size_t lane = 0; lane < Lanes; ++lane) {
+            points[lane] = {static_cast<T>(lane), 1, 2};
+        }
+        batch.transformPoints(points, transformed);
+
+        for (size_t lane = 0; lane < Lanes && b * Lanes + lane < count;
+             ++lane) {
+            const auto i = b * Lanes + lane;
+            const auto &m = matrices[i];
+            const auto &g = general[i];
+
+            ASSERT_LT(difference(product[lane], m * g), smallNumber);
+            ASSERT_LT(difference(inverse[lane], g.inverse()), smallNumber);
+            ASSERT_LT(difference(orthogonal[lane], m.inverseOrthogonal()),
+                      smallNumber);
+            ASSERT_LT(difference(normalized[lane], m.inverseNormalized()),
+                      smallNumber);
+
+            const auto expected = m * Vec{points[lane]};
+            ASSERT_LT((Vec{transformed[lane]} - expected).abs(), smallNumber);
+        }
+    }
+}
+
+} // namespace
+
+TEST_SUIT_BEGIN
+
+TEST_CASE("default is identity") {
+    const auto batch = MatrixBatchf{};
+    for (size_t lane = 0; lane < MatrixBatchf::lanes; ++lane) {
+        ASSERT_EQ(difference(batch[lane], Matrixf::Identity()), 0.);
+    }
+}
+
+TEST_CASE("operations") {
+    testOperations<float, 8>();
+    testOperations<float, 16>();
+    testOperations<float, 4>();
+    testOperations<float, 1>();
+    testOperations<double, 4>();
+    testOperations<double, 8>();
+}
+
+TEST_CASE("determinant") {
+    auto m = Matrixd::Identity();
+    m.scale(2, 3, 4);
+    auto batch = MatrixBatchd::Broadcast(m);
+    batch.set(1, Matrixd::Scale(0));
+
+    double det[4];
+    batch.determinant(det);
+    ASSERT_NEAR(det[0], 24., smallNumber);
+    ASSERT_NEAR(det[1], 0., smallNumber);
+}
+
+TEST_SUIT_END
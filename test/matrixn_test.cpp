@@ -0,0 +1,185 @@
+// Copyright © Mattias Larsson Sköld
+
+#include "matmath/matrixn.h"
+#include "mls-unit-test/unittest.h"
+#include "testmatrix.h"
+
+constexpr double smallNumber = .00001;
+
+namespace {
+
+//! Reference product without any unrolling or simd
+template <class T, int R, int C, int K>
+MatrixN<T, R, K> naiveProduct(const MatrixN<T, R, C> &a,
+                              const MatrixN<T, C, K> &b) {
+    MatrixN<T, R, K> ret;
+    for (int row = 0; row < R; ++row) {
+        for (int col = 0; col < K; ++col) {
+            for (int i = 0; i < C; ++i) {
+                ret(row, col) += a(row, i) * b(i, col);
+            }
+        }
+    }
+    return ret;
+}
+
+template <class T, int R, int C>
+MatrixN<T, R, C> sequence(T offset) {
+    MatrixN<T, R, C> ret;
+    for (int i = 0; i < R * C; ++i) {
+        ret[i] = offset + i * (i % 3 ? 1 : -1);
+    }
+    return ret;
+}
+
+} // namespace
+
+TEST_SUIT_BEGIN
+
+TEST_CASE("layout") {
+    static_assert(sizeof(Matrix3f) == sizeof(float) * 9);
+    static_assert(sizeof(Matrix3x4d) == sizeof(double) * 12);
+
+    // clang-format off
+    constexpr auto m = MatrixN<float, 2, 3>{
+        1, 2,
+        3, 4,
+        5, 6,
+    };
+    // clang-format on
+    static_assert(m(0, 0) == 1);
+    static_assert(m(1, 0) == 2);
+    static_assert(m(0, 2) == 5);
+
+    constexpr auto t = m.transpose();
+    static_assert(t.rows == 3 && t.cols == 2);
+    static_assert(t(0, 1) == 2);
+    static_assert(t(2, 0) == 5);
+}
+
+TEST_CASE("conversion to and from Matrix") {
+    const auto m = testMatrix();
+    const auto n = MatrixN<float, 4, 4>{m};
+
+    for (int x = 0; x < 4; ++x) {
+        for (int y = 0; y < 4; ++y) {
+            ASSERT_EQ(n(x, y), m(x, y));
+        }
+    }
+
+    ASSERT_EQ((Matrixf{n} - m).abs2(), 0.f);
+
+    const auto rotation = Matrix3f{m};
+    const auto back = rotation.toMatrix();
+    ASSERT_EQ(back.x4, 0.f);
+    ASSERT_EQ(back.w4, 1.f);
+    ASSERT_EQ(back.z3, m.z3);
+}
+
+TEST_CASE("multiplication") {
+    {
+        const auto a = MatrixN<float, 4, 4>{testMatrix()};
+        const auto b = MatrixN<float, 4, 4>{Matrixf::RotationY(.4)};
+        const auto expected = testMatrix() * Matrixf::RotationY(.4);
+        ASSERT_LT((Matrixf{a * b} - expected).abs2(), smallNumber);
+    }
+
+    {
+        const auto a = sequence<float, 4, 3>(1);
+        const auto b = sequence<float, 3, 5>(2);
+        ASSERT_LT((a * b - naiveProduct(a, b)).abs2(), smallNumber);
+    }
+
+    {
+        const auto a = sequence<double, 4, 2>(1);
+        const auto b = sequence<double, 2, 4>(2);
+        ASSERT_LT((a * b - naiveProduct(a, b)).abs2(), smallNumber);
+    }
+
+    {
+        const auto a = sequence<double, 3, 4>(1);
+        const auto b = sequence<double, 4, 2>(-2);
+        ASSERT_LT((a * b - naiveProduct(a, b)).abs2(), smallNumber);
+    }
+
+    constexpr auto product = Matrix2f{1, 2, 3, 4} * Matrix2f{5, 6, 7, 8};
+    static_assert(product(0, 0) == 1 * 5 + 3 * 6);
+    static_assert(product(1, 1) == 2 * 7 + 4 * 8);
+}
+
+TEST_CASE("determinant") {
+    static_assert(Matrix2f{1, 2, 3, 4}.determinant() == -2);
+    static_assert(Matrix3d::Identity().determinant() == 1);
+
+    const auto m = testMatrix();
+    const auto n4 = MatrixN<float, 4, 4>{m};
+    auto inverse = Matrixf{};
+    ASSERT_NEAR(n4.determinant(), m.tryInverse(inverse), .0001);
+
+    // Scale is 2 * 3 * 4 and rotations does not change the determinant
+    ASSERT_NEAR(Matrix3f{m}.determinant(), 24., .0001);
+
+    auto n5 = MatrixN<double, 5, 5>::Identity();
+    n5(0, 0) = 2;
+    n5(4, 4) = 3;
+    n5(1, 3) = 7;
+    ASSERT_NEAR(n5.determinant(), 6., smallNumber);
+}
+
+TEST_CASE("inverse") {
+    const auto m = testMatrix();
+
+    {
+        const auto n = MatrixN<float, 4, 4>{m};
+        const auto identity = MatrixN<float, 4, 4>::Identity();
+        ASSERT_LT((n * n.inverse() - identity).abs2(), smallNumber);
+    }
+
+    {
+        const auto n = Matrix3f{m};
+        ASSERT_LT((n * n.inverse() - Matrix3f::Identity()).abs2(),
+                  smallNumber);
+    }
+
+    {
+        const auto n = Matrix2d{1, 2, 3, 4};
+        ASSERT_LT((n.inverse() * n - Matrix2d::Identity()).abs2(),
+                  smallNumber);
+    }
+
+    {
+        auto n = sequence<double, 6, 6>(1);
+        for (int i = 0; i < 6; ++i) {
+            n(i, i) += 10;
+        }
+        const auto identity = MatrixN<double, 6, 6>::Identity();
+        ASSERT_LT((n * n.inverse() - identity).abs2(), smallNumber);
+    }
+
+    auto out = Matrix3f::Identity();
+    ASSERT_EQ(Matrix3f{}.tryInverse(out), 0.f);
+    ASSERT_EQ(out(0, 0), 1.f);
+
+    bool thrown = false;
+    try {
+        MatrixN<double, 5, 5>{}.inverse();
+    }
+    catch (const char *) {
+        thrown = true;
+    }
+    ASSERT(thrown, "singular matrix should throw");
+}
+
+TEST_CASE("vector multiplication") {
+    const auto m = testMatrix();
+    const auto n = Matrix3f{m};
+    const auto v = Vecf{1, 2, 3};
+
+    const auto expected = m * Vec{v} - Vec{m.x4, m.y4, m.z4};
+    ASSERT_LT((n * v - Vecf{expected}).abs2(), smallNumber);
+
+    constexpr auto rotated = Matrix2f{0, 1, -1, 0} * Vec2f{1, 0};
+    static_assert(rotated.x == 0 && rotated.y == 1);
+}
+
+TEST_SUIT_END
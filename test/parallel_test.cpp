@@ -0,0 +1,111 @@
+// Copyright © Mattias Larsson Sköld
+
+#include "matmath/parallel.h"
+#include "mls-unit-test/unittest.h"
+#include <atomic>
+#include <vector>
+
+namespace {
+
+template <typename T>
+std::vector<Matrix<T>> testMatrices(size_t count, T offset) {
+    auto ret = std::vector<Matrix<T>>{};
+    ret.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        const auto a = static_cast<T>(i) * T(.01) + offset;
+        ret.push_back(Matrix<T>::RotationZ(a) * Matrix<T>::RotationX(a * 3) *
+                      Matrix<T>::Translation(1, a, 3));
+    }
+    return ret;
+}
+
+template <typename T>
+bool isEqual(const Matrix<T> &a, const Matrix<T> &b) {
+    for (int i = 0; i < 16; ++i) {
+        if (a(i) != b(i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename T>
+void testBatch(matmath::ThreadPool &pool) {
+    constexpr size_t count = 10007;
+    const auto a = testMatrices<T>(count, 0);
+    const auto b = testMatrices<T>(count, 1);
+    const auto m = Matrix<T>::RotationY(.3) * Matrix<T>::Translation(3, 2, 1);
+
+    auto out = std::vector<Matrix<T>>(count);
+    matmath::multiply(a.data(), b.data(), out.data(), count, pool);
+    for (size_t i = 0; i < count; ++i) {
+        ASSERT(isEqual(out[i], a[i] * b[i]), "wrong product");
+    }
+
+    matmath::premultiply(m, a.data(), out.data(), count, pool);
+    for (size_t i = 0; i < count; ++i) {
+        ASSERT(isEqual(out[i], m * a[i]), "wrong premultiplied product");
+    }
+
+    // In place
+    out = b;
+    matmath::premultiply(m, out.data(), out.data(), count, pool);
+    for (size_t i = 0; i < count; ++i) {
+        ASSERT(isEqual(out[i], m * b[i]), "wrong in place product");
+    }
+}
+
+} // namespace
+
+TEST_SUIT_BEGIN
+
+TEST_CASE("parallel for visits each index once") {
+    auto pool = matmath::ThreadPool{4};
+    ASSERT_EQ(pool.size(), 4u);
+
+    auto visits = std::vector<std::atomic<int>>(1000);
+    for (int repetition = 0; repetition < 20; ++repetition) {
+        pool.parallelFor(visits.size(), 7, [&](size_t begin, size_t end) {
+            for (auto i = begin; i < end; ++i) {
+                ++visits[i];
+            }
+        });
+    }
+    for (auto &visit : visits) {
+        ASSERT_EQ(visit.load(), 20);
+    }
+}
+
+TEST_CASE("chunk size") {
+    auto pool = matmath::ThreadPool{4};
+
+    // Chunks of three values of 12 bytes does not end on a cache line
+    const auto chunk = pool.chunkSize(1000000, 12);
+    ASSERT_EQ(chunk * 12 % matmath::cacheLineSize, 0u);
+    ASSERT_GT(chunk, 0u);
+
+    // Small arrays are not split
+    ASSERT_GT(pool.chunkSize(100, sizeof(Matrixf)), 99u);
+}
+
+TEST_CASE("batch multiply") {
+    for (auto threads : {1u, 3u, 8u}) {
+        auto pool = matmath::ThreadPool{threads};
+        testBatch<float>(pool);
+        testBatch<double>(pool);
+    }
+}
+
+TEST_CASE("single threaded batch functions") {
+    const auto a = testMatrices<float>(5, 0);
+    const auto b = testMatrices<float>(5, 1);
+    auto out = std::vector<Matrixf>(5);
+
+    Matrixf::multiply(a.data(), b.data(), out.data(), 5);
+    ASSERT(isEqual(out[4], a[4] * b[4]), "wrong product");
+
+    Matrixf::premultiply(a[0], b.data(), out.data(), 5);
+    ASSERT(isEqual(out[4], a[0] * b[4]), "wrong premultiplied product");
+}
+
+TEST_SUIT_END
@@ -7,7 +7,10 @@
 
 #include "matmath/quaternion.h"
 #include "mls-unit-test/unittest.h"
+#include <algorithm>
+#include <cmath>
 #include <iomanip> //setprecision
+#include <vector>
 
 using namespace std;
 
@@ -32,6 +35,27 @@ std::ostream &operator<<(std::ostream &os, Matrixf m) {
     return os;
 }
 
+//! Angle of the rotation between two normalized quaternions. Calculated from
+//! the distance instead of the dot product to be accurate for small angles
+template <class T>
+double rotationAngle(QuaternionT<T> a, QuaternionT<T> b) {
+    if (a.dot(b) < 0) {
+        b = -b;
+    }
+    const auto d = QuaternionT<double>(a - b).abs();
+    return 4 * std::asin(std::min(d / 2, 1.));
+}
+
+//! Unit quaternion that differs from the previous ones in a irregular way
+template <class T>
+QuaternionT<T> testQuaternion(int i) {
+    return QuaternionT<T>(std::sin(i * 1.3),
+                          std::cos(i * .7),
+                          std::sin(i * 2.9 + 1),
+                          std::cos(i * 4.1 + 2))
+        .normalize();
+}
+
 bool isAlmostEqual(const Matrixf &m1,
                    const Matrixf &m2,
                    float epsilon = ::epsilon) {
@@ -125,4 +149,238 @@ TEST_CASE("Conversion from matrix") {
     }
 }
 
+TEST_CASE("layout") {
+    static_assert(sizeof(Quaternion) == 4 * sizeof(float));
+    static_assert(alignof(Quaternion) == 16);
+    static_assert(sizeof(Quaterniond) == 4 * sizeof(double));
+    static_assert(alignof(Quaterniond) == 32);
+}
+
+TEST_CASE("double precision operations") {
+    // The constexpr versions uses the scalar code
+    constexpr auto q1 = Quaterniond{1, 2, 3, 4};
+    constexpr auto q2 = Quaterniond{5, 6, 7, 8};
+    constexpr auto product = q1 * q2;
+    static_assert(product.w == -60 && product.x == 12);
+    static_assert(product.y == 30 && product.z == 24);
+    static_assert(q1.dot(q2) == 70);
+    static_assert(q1.conjugate().x == -2 && q1.conjugate().w == 1);
+
+    const auto runtime = Quaterniond{1, 2, 3, 4} * Quaterniond{5, 6, 7, 8};
+    ASSERT_EQ(runtime.w, product.w);
+    ASSERT_EQ(runtime.x, product.x);
+    ASSERT_EQ(runtime.y, product.y);
+    ASSERT_EQ(runtime.z, product.z);
+
+    auto q = q1;
+    q *= q2;
+    ASSERT_EQ((q - product).abs2(), 0.);
+    ASSERT_EQ(q1.dot(q2), 70.);
+
+    const auto conjugate = Quaterniond{1, 2, 3, 4}.conjugate();
+    ASSERT_EQ(conjugate.w, 1.);
+    ASSERT_EQ(conjugate.y, -3.);
+    ASSERT_EQ(conjugate.z, -4.);
+
+    ASSERT_NEAR(q1.normalized().abs(), 1., 1e-15);
+    ASSERT_NEAR(q1.normalized().y, 3. / std::sqrt(30.), 1e-15);
+    ASSERT_LT((q1 * q1.inverse() - Quaterniond{}).abs2(), 1e-28);
+    ASSERT_LT((Quaterniond(Quaternion{1, 2, 3, 4}) - q1).abs2(), 1e-28);
+}
+
+TEST_CASE("simd and scalar versions gives the same result") {
+    for (int i = 0; i < 50; ++i) {
+        const auto a = Quaternion{std::sin(i * .3f),
+                                  std::cos(i * .7f),
+                                  std::sin(i * 1.1f),
+                                  std::cos(i * .2f)};
+        const auto b = Quaternion{std::cos(i * .4f), .5f, -1, i * .1f};
+
+        const auto product = a * b;
+        ASSERT_NEAR(product.w, a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+                    1e-6);
+        ASSERT_NEAR(product.x, a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+                    1e-6);
+        ASSERT_NEAR(product.y, a.w * b.y + a.y * b.w + a.z * b.x - a.x * b.z,
+                    1e-6);
+        ASSERT_NEAR(product.z, a.w * b.z + a.z * b.w + a.x * b.y - a.y * b.x,
+                    1e-6);
+        ASSERT_NEAR(a.dot(b), a.w * b.w + a.x * b.x + a.y * b.y + a.z * b.z,
+                    1e-6);
+    }
+}
+
+TEST_CASE("matrix round trip") {
+    // Includes half turns where the w component is zero
+    for (int i = 0; i < 200; ++i) {
+        const auto axis = Vec(std::sin(i * .37), std::cos(i * .91), i % 3)
+                              .normalize();
+        const auto angle = (i % 10 == 0) ? pi : i * .13 - 13;
+        const auto m = Matrixd::Rotation(angle, axis);
+        const auto q = Quaterniond(m);
+
+        ASSERT_NEAR(q.abs(), 1., 1e-12);
+        ASSERT_LT((Matrixd(q) - m).abs2(), 1e-24);
+    }
+}
+
+TEST_CASE("interpolate takes the shortest path") {
+    const auto a = Quaternion(Matrixf::RotationZ(.1));
+    const auto b = Quaternion(Matrixf::RotationZ(.3));
+    const auto flipped = b * -1.f;
+
+    const auto expected = Quaternion(Matrixf::RotationZ(.2));
+    ASSERT_LT((a.interpolate(b, .5f) - expected).abs2(), 1e-10);
+    ASSERT_LT((a.interpolate(flipped, .5f) - expected).abs2(), 1e-10);
+}
+
+TEST_CASE("rotate vector") {
+    for (int i = 0; i < 100; ++i) {
+        const auto axis =
+            Vec(std::cos(i * .3), std::sin(i * .7), .5).normalize();
+        const auto m = Matrixd::Rotation(i * .21 - 10, axis);
+        const auto q = Quaterniond(m);
+        const auto v = Vecd(i * .1 - 3, 2, -1);
+
+        const auto expected = m * v;
+        const auto rotated = q.rotate(v);
+        ASSERT_LT((rotated - expected).abs(), 1e-12);
+        ASSERT_LT((Matrixd(q) * v - expected).abs(), 1e-12);
+    }
+
+    constexpr auto q = Quaterniond{std::sqrt(.5), 0, 0, std::sqrt(.5)};
+    constexpr auto v = q.rotate({1, 0, 0});
+    static_assert(v.x < 1e-15 && v.x > -1e-15 && v.y < -.99999);
+}
+
+TEST_CASE("rotate batch") {
+    // Odd sizes so that both the simd and scalar code is used
+    for (size_t count : {0, 1, 7, 33}) {
+        auto input = std::vector<Vecf>{};
+        for (size_t i = 0; i < count; ++i) {
+            input.emplace_back(i * .1f, 1.f - i, i % 3);
+        }
+        const auto q = Quaternion(Matrixf::Rotation(
+                                      1.3, Vec(1, 2, 3).normalize()))
+                           .normalize();
+
+        auto output = std::vector<Vecf>(count);
+        q.rotate(input.data(), output.data(), count);
+        for (size_t i = 0; i < count; ++i) {
+            ASSERT_LT((output[i] - q.rotate(input[i])).abs(), 1e-4);
+        }
+
+        // In place
+        q.rotate(input.data(), input.data(), count);
+        for (size_t i = 0; i < count; ++i) {
+            ASSERT_EQ(input[i].x, output[i].x);
+            ASSERT_EQ(input[i].z, output[i].z);
+        }
+    }
+
+    auto input = std::vector<Vecd>(17, Vecd{1, 2, 3});
+    auto output = std::vector<Vecd>(input.size());
+    const auto q = Quaterniond(Matrixd::RotationY(.4));
+    q.rotate(input.data(), output.data(), input.size());
+    const auto expected = Matrixd::RotationY(.4) * Vecd{1, 2, 3};
+    for (auto &v : output) {
+        ASSERT_LT((v - expected).abs(), 1e-12);
+    }
+}
+
+TEST_CASE("slerp") {
+    const auto a = Quaterniond(Matrixd::RotationZ(.1));
+    const auto b = Quaterniond(Matrixd::RotationZ(1.9));
+    for (double t = 0; t <= 1; t += .125) {
+        const auto expected = Quaterniond(Matrixd::RotationZ(.1 + 1.8 * t));
+        ASSERT_LT(rotationAngle(a.slerp(b, t), expected), 1e-14);
+        ASSERT_LT(rotationAngle(a.slerp(-b, t), expected), 1e-14);
+    }
+
+    // Constant angular velocity for arbitrary rotations
+    for (int i = 0; i < 100; ++i) {
+        const auto q1 = testQuaternion<double>(i);
+        const auto q2 = testQuaternion<double>(i + 1000);
+        const auto total = rotationAngle(q1, q2);
+        for (double t = 0; t <= 1; t += .25) {
+            const auto q = q1.slerp(q2, t);
+            ASSERT_NEAR(q.abs(), 1., 1e-14);
+            ASSERT_NEAR(rotationAngle(q1, q), total * t, 1e-12);
+            ASSERT_NEAR(rotationAngle(q, q2), total * (1 - t), 1e-12);
+        }
+    }
+
+    // Equal quaternions should not divide by zero
+    const auto same = a.slerp(a, .3);
+    ASSERT_LT(rotationAngle(same, a), 1e-15);
+}
+
+TEST_CASE("fast slerp is close to slerp") {
+    double maxError = 0;
+    for (int i = 0; i < 2000; ++i) {
+        const auto q1 = testQuaternion<double>(i);
+        const auto q2 = testQuaternion<double>(i * 7 + 3);
+        for (double t = 0; t <= 1; t += 1. / 32) {
+            maxError = std::max(
+                maxError, rotationAngle(q1.fastSlerp(q2, t), q1.slerp(q2, t)));
+        }
+    }
+    ASSERT_LT(maxError, 4e-5);
+
+    maxError = 0;
+    for (int i = 0; i < 2000; ++i) {
+        const auto q1 = testQuaternion<float>(i);
+        const auto q2 = testQuaternion<float>(i * 7 + 3);
+        for (float t = 0; t <= 1; t += 1.f / 32) {
+            maxError = std::max(
+                maxError, rotationAngle(q1.fastSlerp(q2, t), q1.slerp(q2, t)));
+        }
+    }
+    ASSERT_LT(maxError, 1e-4);
+}
+
+template <class T>
+void testBatchBlend(size_t count) {
+    auto a = std::vector<QuaternionT<T>>{};
+    auto b = std::vector<QuaternionT<T>>{};
+    auto blend = std::vector<T>{};
+    for (size_t i = 0; i < count; ++i) {
+        a.push_back(testQuaternion<T>(i));
+        // Some equal pairs, to test the division by zero
+        b.push_back(i % 5 ? testQuaternion<T>(i + 500) : a.back());
+        blend.push_back(static_cast<T>(i % 11) / 10);
+    }
+
+    auto out = std::vector<QuaternionT<T>>(count);
+    QuaternionT<T>::slerp(a.data(), b.data(), blend.data(), out.data(), count);
+    for (size_t i = 0; i < count; ++i) {
+        const auto expected = a[i].slerp(b[i], blend[i]);
+        ASSERT_LT(rotationAngle(out[i], expected), 1e-5);
+        ASSERT_NEAR(out[i].abs(), 1., 1e-5);
+    }
+
+    QuaternionT<T>::fastSlerp(
+        a.data(), b.data(), blend.data(), out.data(), count);
+    for (size_t i = 0; i < count; ++i) {
+        const auto expected = a[i].fastSlerp(b[i], blend[i]);
+        ASSERT_LT(rotationAngle(out[i], expected), 1e-5);
+    }
+
+    // In place
+    QuaternionT<T>::fastSlerp(
+        a.data(), b.data(), blend.data(), a.data(), count);
+    for (size_t i = 0; i < count; ++i) {
+        ASSERT_EQ(a[i].w, out[i].w);
+        ASSERT_EQ(a[i].z, out[i].z);
+    }
+}
+
+TEST_CASE("batch blending") {
+    // Odd sizes so that both the simd and scalar code is used
+    for (size_t count : {0, 1, 3, 17, 100}) {
+        testBatchBlend<float>(count);
+        testBatchBlend<double>(count);
+    }
+}
+
 TEST_SUIT_END
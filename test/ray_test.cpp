@@ -0,0 +1,216 @@
+// Copyright © Mattias Larsson Sköld
+
+#include "matmath/ray.h"
+#include "mls-unit-test/unittest.h"
+#include <vector>
+
+constexpr double smallNumber = .0001;
+
+namespace {
+
+struct Triangle {
+    Vecd a, b, c;
+};
+
+//! A few triangles in front of the rays, some of them behind each other
+std::vector<Triangle> testTriangles() {
+    auto triangles = std::vector<Triangle>{};
+    for (int i = 0; i < 11; ++i) {
+        const auto z = -2. - i * .7;
+        const auto x = ((i % 4) - 1.5) * .5;
+        const auto y = ((i % 3) - 1.) * .5;
+        triangles.push_back({{x - 1, y - 1, z},
+                             {x + 1.5, y - 1, z + .2},
+                             {x, y + 1.3, z - .1}});
+    }
+    return triangles;
+}
+
+//! Rays from the origin spread over the triangles
+template <typename T>
+std::vector<Ray<T>> testRays(int count) {
+    auto rays = std::vector<Ray<T>>{};
+    for (int i = 0; i < count; ++i) {
+        const auto x = T((i * 7) % 13) / 16 - T(.375);
+        const auto y = T((i * 5) % 11) / 16 - T(.3125);
+        rays.push_back({{0, 0, 0}, {x, y, -1}});
+    }
+    return rays;
+}
+
+template <typename T>
+VecT<T> convert(const Vecd &v) {
+    return {T(v.x), T(v.y), T(v.z)};
+}
+
+template <typename T>
+void testSingle() {
+    const auto a = VecT<T>{-1, -1, -2};
+    const auto b = VecT<T>{1, -1, -2};
+    const auto c = VecT<T>{0, 1, -2};
+
+    auto hit = RayHit<T>{};
+    ASSERT(intersectTriangle(Ray<T>{{0, 0, 0}, {0, 0, -1}}, a, b, c, hit),
+           "should hit");
+    ASSERT_NEAR(hit.distance, 2, smallNumber);
+    ASSERT_NEAR(hit.u, .25, smallNumber);
+    ASSERT_NEAR(hit.v, .5, smallNumber);
+
+    // Behind, outside, parallel and further away than the last hit
+    ASSERT(!intersectTriangle(Ray<T>{{0, 0, 0}, {0, 0, 1}}, a, b, c, hit),
+           "should miss");
+    ASSERT(!intersectTriangle(Ray<T>{{2, 0, 0}, {0, 0, -1}}, a, b, c, hit),
+           "should miss");
+    ASSERT(!intersectTriangle(Ray<T>{{0, 0, -2}, {1, 0, 0}}, a, b, c, hit),
+           "should miss");
+    auto shorter = RayHit<T>{};
+    shorter.distance = 1;
+    ASSERT(!intersectTriangle(
+               Ray<T>{{0, 0, 0}, {0, 0, -1}}, a, b, c, shorter),
+           "should be too far away");
+
+    const auto box = AABB<T>{{-1, -1, -5}, {1, 1, -3}};
+    T near = 0, far = 100;
+    ASSERT(intersectBox(Ray<T>{{0, 0, 0}, {0, 0, -1}}, box, near, far),
+           "should hit the box");
+    ASSERT_NEAR(near, 3, smallNumber);
+    ASSERT_NEAR(far, 5, smallNumber);
+    near = 0, far = 100;
+    ASSERT(!intersectBox(Ray<T>{{0, 0, 0}, {1, 0, -1}}, box, near, far),
+           "should miss the box");
+
+    near = 0, far = 100;
+    ASSERT(intersectSphere(Ray<T>{{0, 0, 0}, {0, 0, -2}},
+                           VecT<T>{0, 1, -4},
+                           T(2),
+                           near,
+                           far),
+           "should hit the sphere");
+    ASSERT_NEAR(near, 2 - std::sqrt(3.) / 2, smallNumber);
+    ASSERT_NEAR(far, 2 + std::sqrt(3.) / 2, smallNumber);
+    near = 0, far = 100;
+    ASSERT(!intersectSphere(Ray<T>{{0, 0, 0}, {0, 0, -1}},
+                            VecT<T>{0, 3, -4},
+                            T(2),
+                            near,
+                            far),
+           "should miss the sphere");
+}
+
+template <typename T, int N>
+void testPacket() {
+    const auto rays = testRays<T>(N);
+    const auto packet = RayPacket<T, N>{rays.data()};
+    auto hits = PacketHit<T, N>{};
+    auto expected = std::vector<RayHit<T>>(N);
+
+    size_t hitCount = 0;
+    for (auto &t : testTriangles()) {
+        const auto a = convert<T>(t.a), b = convert<T>(t.b),
+                   c = convert<T>(t.c);
+        auto expectedMask = 0u;
+        for (int i = 0; i < N; ++i) {
+            if (intersectTriangle(rays[i], a, b, c, expected[i])) {
+                expectedMask |= 1u << i;
+            }
+        }
+        ASSERT_EQ(intersectTriangle(packet, a, b, c, hits), expectedMask);
+        hitCount += expectedMask != 0;
+    }
+    ASSERT_GT(hitCount, 1);
+
+    for (int i = 0; i < N; ++i) {
+        ASSERT_NEAR(hits.distance[i], expected[i].distance, smallNumber);
+        ASSERT_NEAR(hits.u[i], expected[i].u, smallNumber);
+        ASSERT_NEAR(hits.v[i], expected[i].v, smallNumber);
+    }
+
+    // Boxes and spheres are only hit closer than the hits
+    const auto box = AABB<T>{{.1, -1, -2.5}, {1, 1, -1.5}};
+    const auto center = VecT<T>{.5, 0, -2.5};
+    auto boxMask = 0u;
+    auto sphereMask = 0u;
+    for (int i = 0; i < N; ++i) {
+        T near = 0, far = hits.distance[i];
+        if (intersectBox(rays[i], box, near, far)) {
+            boxMask |= 1u << i;
+        }
+        near = 0, far = hits.distance[i];
+        if (intersectSphere(rays[i], center, T(.5), near, far)) {
+            sphereMask |= 1u << i;
+        }
+    }
+    ASSERT_NE(boxMask, 0);
+    ASSERT_NE(sphereMask, 0);
+    ASSERT_NE(boxMask, (RayPacket<T, N>::all));
+    ASSERT_EQ(intersectBox(packet, box, hits), boxMask);
+    ASSERT_EQ(intersectSphere(packet, center, T(.5), hits), sphereMask);
+}
+
+template <typename T>
+void testTriangleSoA() {
+    auto soa = TriangleSoA<T>{};
+    const auto triangles = testTriangles();
+    for (auto &t : triangles) {
+        soa.push_back(convert<T>(t.a), convert<T>(t.b), convert<T>(t.c));
+    }
+    ASSERT_EQ(soa.size(), triangles.size());
+
+    size_t hitCount = 0;
+    for (auto &ray : testRays<T>(23)) {
+        auto expected = RayHit<T>{};
+        auto found = false;
+        for (size_t i = 0; i < triangles.size(); ++i) {
+            auto &t = triangles[i];
+            if (intersectTriangle(ray,
+                                  convert<T>(t.a),
+                                  convert<T>(t.b),
+                                  convert<T>(t.c),
+                                  expected)) {
+                expected.index = i;
+                found = true;
+            }
+        }
+
+        auto hit = RayHit<T>{};
+        ASSERT_EQ(intersectTriangles(ray, soa, hit), found);
+        ASSERT_EQ(hit.index, expected.index);
+        ASSERT_NEAR(hit.distance, expected.distance, smallNumber);
+        ASSERT_NEAR(hit.u, expected.u, smallNumber);
+        hitCount += found;
+
+        // Only a part of the triangles
+        auto partHit = RayHit<T>{};
+        if (intersectTriangles(ray, soa, 3, 8, partHit)) {
+            ASSERT_GT(partHit.index + 1, 3);
+            ASSERT_LT(partHit.index, 8);
+        }
+    }
+    ASSERT_GT(hitCount, 0);
+}
+
+} // namespace
+
+TEST_SUIT_BEGIN
+
+TEST_CASE("single ray") {
+    testSingle<float>();
+    testSingle<double>();
+}
+
+TEST_CASE("packets") {
+    testPacket<float, 4>();
+    testPacket<float, 8>();
+    testPacket<float, 16>();
+    testPacket<double, 4>();
+    testPacket<double, 8>();
+    testPacket<double, 16>();
+    testPacket<float, 3>();
+}
+
+TEST_CASE("one ray against many triangles") {
+    testTriangleSoA<float>();
+    testTriangleSoA<double>();
+}
+
+TEST_SUIT_END
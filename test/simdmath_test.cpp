@@ -0,0 +1,237 @@
+// Copyright © Mattias Larsson Sköld
+
+#include "matmath/matrix.h"
+#include "matmath/simdmath.h"
+#include "matmath/transform2.h"
+#include "mls-unit-test/unittest.h"
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace {
+
+//! Distance from the reference in units in the last place of T
+template <typename T>
+double ulpError(T value, long double reference) {
+    const auto rounded = static_cast<T>(reference);
+    const auto magnitude = std::max(std::abs(rounded),
+                                    std::numeric_limits<T>::min());
+    const auto ulp =
+        std::nextafter(magnitude, std::numeric_limits<T>::infinity()) -
+        magnitude;
+    return static_cast<double>(std::abs(value - reference) / ulp);
+}
+
+//! Odd sizes so that both whole and padded packs are used
+template <typename T>
+std::vector<T> range(T from, T to, size_t count = 10001) {
+    auto ret = std::vector<T>(count);
+    for (size_t i = 0; i < count; ++i) {
+        ret[i] = from + (to - from) * static_cast<T>(i) / (count - 1);
+    }
+    return ret;
+}
+
+//! The values on both sides of k * pi / 2 for every step:th k below limit,
+//! where the angle reduction loses the most precision if it is not exact
+template <typename T>
+std::vector<T> closeToHalfPi(T limit, long long step) {
+    const auto halfPi = 1.570796326794896619231321691639751442L;
+    auto ret = std::vector<T>{};
+    for (long long k = 1; k * halfPi < limit; k += step) {
+        const auto closest = static_cast<T>(k * halfPi);
+        for (auto x : {std::nextafter(closest, T(0)),
+                       closest,
+                       std::nextafter(closest, limit)}) {
+            ret.push_back(x);
+            ret.push_back(-x);
+        }
+    }
+    return ret;
+}
+
+template <typename T>
+void testSincos(T limit, long long step) {
+    auto angles = range<T>(-limit, limit);
+    const auto close = closeToHalfPi(limit, step);
+    angles.insert(angles.end(), close.begin(), close.end());
+    auto s = std::vector<T>(angles.size());
+    auto c = std::vector<T>(angles.size());
+    matmath::simd::sincos(angles.data(), s.data(), c.data(), angles.size());
+
+    double maxError = 0;
+    for (size_t i = 0; i < angles.size(); ++i) {
+        const auto x = static_cast<long double>(angles[i]);
+        maxError = std::max(maxError, ulpError(s[i], std::sin(x)));
+        maxError = std::max(maxError, ulpError(c[i], std::cos(x)));
+    }
+    ASSERT_LT(maxError, 2.);
+}
+
+//! Angles above the exact reduction are calculated with std::sin and
+//! std::cos, also when they are mixed with small angles in the same pack
+template <typename T>
+void testLargeAngles() {
+    auto angles = std::vector<T>{};
+    for (T x = 1000; x < T(1e30); x *= T(1.7)) {
+        angles.push_back(x);
+        angles.push_back(-x);
+        angles.push_back(T(.5));
+    }
+    angles.push_back(std::numeric_limits<T>::max());
+    auto s = std::vector<T>(angles.size());
+    auto c = std::vector<T>(angles.size());
+    matmath::simd::sincos(angles.data(), s.data(), c.data(), angles.size());
+
+    for (size_t i = 0; i < angles.size(); ++i) {
+        ASSERT_LT(std::abs(s[i]), T(1.000001));
+        ASSERT_LT(std::abs(c[i]), T(1.000001));
+        ASSERT_NEAR(s[i], std::sin(angles[i]), 1e-5);
+        ASSERT_NEAR(c[i], std::cos(angles[i]), 1e-5);
+    }
+
+    const auto infinity = std::numeric_limits<T>::infinity();
+    T sin, cos;
+    matmath::simd::sincos(&infinity, &sin, &cos, 1);
+    ASSERT(std::isnan(sin) && std::isnan(cos), "infinity should give nan");
+}
+
+template <typename T>
+void testAtan2() {
+    const auto angles = range<T>(-3.14, 3.14);
+    auto y = std::vector<T>(angles.size());
+    auto x = std::vector<T>(angles.size());
+    for (size_t i = 0; i < angles.size(); ++i) {
+        y[i] = std::sin(angles[i]) * (1 + i % 7);
+        x[i] = std::cos(angles[i]) * (1 + i % 7);
+    }
+    auto out = std::vector<T>(angles.size());
+    matmath::simd::atan2(y.data(), x.data(), out.data(), out.size());
+
+    double maxError = 0;
+    for (size_t i = 0; i < angles.size(); ++i) {
+        const auto reference = std::atan2(static_cast<long double>(y[i]),
+                                          static_cast<long double>(x[i]));
+        maxError = std::max(maxError, ulpError(out[i], reference));
+    }
+    ASSERT_LT(maxError, 3.);
+
+    const T zero = 0, one = 1;
+    T result = 1;
+    matmath::simd::atan2(&zero, &zero, &result, 1);
+    ASSERT_EQ(result, T(0));
+    matmath::simd::atan2(&one, &zero, &result, 1);
+    ASSERT_NEAR(result, pi / 2, 1e-6);
+}
+
+template <typename T>
+void testSqrt(double maxRsqrtError) {
+    const auto values = range<T>(.001, 1000);
+    auto root = std::vector<T>(values.size());
+    auto inverse = std::vector<T>(values.size());
+    matmath::simd::sqrt(values.data(), root.data(), values.size());
+    matmath::simd::rsqrt(values.data(), inverse.data(), values.size());
+
+    double maxError = 0;
+    for (size_t i = 0; i < values.size(); ++i) {
+        const auto x = static_cast<long double>(values[i]);
+        ASSERT_EQ(root[i], std::sqrt(values[i]));
+        maxError = std::max(maxError, ulpError(inverse[i], 1 / std::sqrt(x)));
+    }
+    ASSERT_LT(maxError, maxRsqrtError);
+}
+
+//! The result for a value is the same in the padded last pack as anywhere
+//! else in the array
+template <typename T>
+void testPosition() {
+    const auto values = range<T>(.5, 20, 37);
+    auto sin = std::vector<T>(values.size()), cos = sin;
+    auto atan = sin, inverse = sin;
+    matmath::simd::sincos(values.data(), sin.data(), cos.data(), sin.size());
+    matmath::simd::atan2(
+        values.data(), values.data() + 1, atan.data(), values.size() - 1);
+    matmath::simd::rsqrt(values.data(), inverse.data(), values.size());
+
+    for (size_t i = 0; i + 1 < values.size(); ++i) {
+        T s, c, a, r;
+        matmath::simd::sincos(&values[i], &s, &c, 1);
+        matmath::simd::atan2(&values[i], &values[i + 1], &a, 1);
+        matmath::simd::rsqrt(&values[i], &r, 1);
+        ASSERT_EQ(s, sin[i]);
+        ASSERT_EQ(c, cos[i]);
+        ASSERT_EQ(a, atan[i]);
+        ASSERT_EQ(r, inverse[i]);
+    }
+}
+
+} // namespace
+
+TEST_SUIT_BEGIN
+
+TEST_CASE("sincos float") {
+    testSincos<float>(6000, 1);
+    testSincos<float>(10, 1);
+}
+
+TEST_CASE("sincos double") {
+    testSincos<double>(1e8, 997);
+    testSincos<double>(1e5, 1);
+    testSincos<double>(10, 1);
+}
+
+TEST_CASE("sincos large angles") {
+    testLargeAngles<float>();
+    testLargeAngles<double>();
+}
+
+TEST_CASE("sincos in place") {
+    auto values = range<float>(-4, 4, 37);
+    const auto copy = values;
+    auto c = std::vector<float>(values.size());
+    matmath::simd::sincos(values.data(), values.data(), c.data(), c.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+        ASSERT_NEAR(values[i], std::sin(copy[i]), 1e-6);
+        ASSERT_NEAR(c[i], std::cos(copy[i]), 1e-6);
+    }
+}
+
+TEST_CASE("atan2 float") {
+    testAtan2<float>();
+}
+
+TEST_CASE("atan2 double") {
+    testAtan2<double>();
+}
+
+TEST_CASE("sqrt and rsqrt") {
+    testSqrt<float>(4.);
+    testSqrt<double>(1.5);
+}
+
+TEST_CASE("independent of position") {
+    testPosition<float>();
+    testPosition<double>();
+}
+
+TEST_CASE("batch rotations") {
+    const auto angles = range<double>(-7, 7, 203);
+
+    auto transforms = std::vector<Transform2>(angles.size());
+    Transform2::Rotation(angles.data(), transforms.data(), angles.size());
+
+    auto matrices = std::vector<Matrixd>(angles.size());
+    Matrixd::RotationZ(angles.data(), matrices.data(), angles.size());
+
+    for (size_t i = 0; i < angles.size(); ++i) {
+        const auto t = Transform2::Rotation(angles[i]);
+        ASSERT_NEAR(transforms[i].rotation.x, t.rotation.x, 1e-15);
+        ASSERT_NEAR(transforms[i].rotation.y, t.rotation.y, 1e-15);
+        ASSERT_EQ(transforms[i].pos.x, 0.);
+
+        const auto m = Matrixd::RotationZ(angles[i]);
+        ASSERT_LT((matrices[i] - m).abs2(), 1e-28);
+    }
+}
+
+TEST_SUIT_END
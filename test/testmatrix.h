@@ -0,0 +1,23 @@
+// Copyright © Mattias Larsson Sköld
+
+#pragma once
+
+#include "matmath/matrix.h"
+
+//! Affine matrix with rotation, non uniform scale and translation, for tests
+//! that does not care about the exact values
+template <typename T = float>
+Matrix<T> testMatrix() {
+    auto m = Matrix<T>::RotationZ(.3) * Matrix<T>::RotationX(1.2);
+    m.scale(2, 3, 4);
+    m.translateGlobal(5, 6, 7);
+    return m;
+}
+
+//! Rotation and translation without scale, different for each i
+template <typename T = float>
+Matrix<T> rigidTestMatrix(int i) {
+    return Matrix<T>::RotationZ(.3 + .1 * i) *
+           Matrix<T>::RotationX(1.2 - .7 * i) *
+           Matrix<T>::Translation(1, .01 * i, 2 - .3 * i);
+}
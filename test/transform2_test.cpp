@@ -150,4 +150,14 @@ TEST_CASE("scaling") {
     ASSERT_EQ((t * v), (Vec2{10, 20}));
 }
 
+TEST_CASE("constexpr rotation") {
+    constexpr auto t = Transform2::Rotation(pi / 2);
+    static_assert(t.rotation.x < 1e-15 && t.rotation.x > -1e-15);
+    static_assert(t.rotation.y == 1);
+
+    constexpr auto p = t * Vec2{1, 0};
+    static_assert(p.x < 1e-15 && p.x > -1e-15);
+    static_assert(p.y == -1);
+}
+
 TEST_SUIT_END
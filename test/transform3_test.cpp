@@ -0,0 +1,101 @@
+// Copyright © Mattias Larsson Sköld
+
+#include "matmath/transform3.h"
+#include "mls-unit-test/unittest.h"
+
+constexpr double smallNumber = .00001;
+
+namespace {
+
+Transform3 testTransform(int i = 0) {
+    return {{1. + i, 2, 3. - i},
+            Quaterniond{Matrixd::RotationZ(.3 + i) *
+                        Matrixd::RotationX(1.2 - i * .7)},
+            1.5 + i * .2};
+}
+
+double distance(const Vecd &a, const Vecd &b) {
+    return (a - b).abs();
+}
+
+} // namespace
+
+TEST_SUIT_BEGIN
+
+TEST_CASE("size") {
+    static_assert(sizeof(Transform3f) == 32);
+}
+
+TEST_CASE("instantiation") {
+    constexpr auto t = Transform3{};
+    static_assert(t.pos.x == 0 && t.pos.y == 0 && t.pos.z == 0);
+    static_assert(t.rotation.w == 1 && t.scale == 1);
+
+    constexpr auto translated = Transform3::Translate({1, 2, 3});
+    constexpr auto p = translated * Vecd{1, 1, 1};
+    static_assert(p.x == 2 && p.y == 3 && p.z == 4);
+}
+
+TEST_CASE("matrix conversion") {
+    const auto t = testTransform();
+    const auto m = t.toMatrix();
+    const auto v = Vecd{1, -2, 3};
+
+    ASSERT_LT(distance(t * v, m * v), smallNumber);
+
+    const auto back = Transform3{m};
+    ASSERT_LT((back.toMatrix() - m).abs2(), smallNumber);
+    ASSERT_NEAR(back.scale, t.scale, smallNumber);
+}
+
+TEST_CASE("composition") {
+    const auto a = testTransform(1);
+    const auto b = testTransform(2);
+    const auto v = Vecd{1, -2, 3};
+
+    ASSERT_LT(((a * b).toMatrix() - a.toMatrix() * b.toMatrix()).abs2(),
+              smallNumber);
+    ASSERT_LT(distance((a * b) * v, a * (b * v)), smallNumber);
+
+    auto c = a;
+    c *= b;
+    ASSERT_EQ(c, a * b);
+}
+
+TEST_CASE("inverse") {
+    const auto t = testTransform(3);
+    const auto identity = (t * t.inverse()).toMatrix();
+
+    ASSERT_LT((identity - Matrixd::Identity()).abs2(), smallNumber);
+    ASSERT_LT((t.inverse().toMatrix() - t.toMatrix().inverse()).abs2(),
+              smallNumber);
+}
+
+TEST_CASE("interpolation") {
+    const auto a = testTransform(1);
+    const auto b = testTransform(2);
+
+    ASSERT_LT((lerp(a, b, 0.).toMatrix() - a.toMatrix()).abs2(), smallNumber);
+    ASSERT_LT((slerp(a, b, 1.).toMatrix() - b.toMatrix()).abs2(), smallNumber);
+
+    const auto half = slerp(a, b, .5);
+    ASSERT_LT(distance(half.pos, (a.pos + b.pos) / 2), smallNumber);
+    ASSERT_NEAR(half.scale, (a.scale + b.scale) / 2, smallNumber);
+    ASSERT_NEAR(half.rotation.dot(a.rotation), half.rotation.dot(b.rotation),
+                smallNumber);
+}
+
+TEST_CASE("cached matrix") {
+    auto cached = CachedTransform3{testTransform()};
+    ASSERT(cached.isDirty(), "matrix should not be calculated yet");
+
+    const auto &m = cached.matrix();
+    ASSERT(!cached.isDirty(), "matrix should be calculated");
+    ASSERT_EQ((m - testTransform().toMatrix()).abs2(), 0.);
+
+    cached.pos({5, 6, 7});
+    ASSERT(cached.isDirty(), "changing the transform should invalidate");
+    ASSERT_EQ(cached.matrix().x4, 5.);
+}
+
+TEST_SUIT_END
@@ -0,0 +1,141 @@
+// Copyright © Mattias Larsson Sköld
+
+#include "matmath/transformhierarchy.h"
+#include "mls-unit-test/unittest.h"
+#include "testmatrix.h"
+#include <vector>
+
+constexpr double smallNumber = .00001;
+
+namespace {
+
+using Node = TransformHierarchyd::Node;
+
+AffineMatrixd testMatrix(size_t i) {
+    return AffineMatrixd{rigidTestMatrix<double>(static_cast<int>(i))};
+}
+
+//! Parents that are not in depth first order, with some deep branches
+std::vector<Node> testParents(size_t count) {
+    auto parents = std::vector<Node>{};
+    for (size_t i = 0; i < count; ++i) {
+        if (i % 500 == 0) {
+            parents.push_back(TransformHierarchyd::none);
+        }
+        else if (i % 3 == 0) {
+            parents.push_back(static_cast<Node>(i - 1));
+        }
+        else {
+            parents.push_back(static_cast<Node>((i * 7919) % i));
+        }
+    }
+    return parents;
+}
+
+TransformHierarchyd testHierarchy(const std::vector<Node> &parents) {
+    auto hierarchy = TransformHierarchyd{};
+    hierarchy.reserve(parents.size());
+    for (size_t i = 0; i < parents.size(); ++i) {
+        hierarchy.add(testMatrix(i), parents[i]);
+    }
+    return hierarchy;
+}
+
+//! Calculate the world matrices without the hierarchy, with Matrix
+bool isCorrect(const TransformHierarchyd &hierarchy) {
+    auto world = std::vector<Matrixd>(hierarchy.size());
+    for (Node node = 0; node < hierarchy.size(); ++node) {
+        const auto parent = hierarchy.parent(node);
+        const auto local = hierarchy.local(node).toMatrix();
+        world[node] = parent == TransformHierarchyd::none
+                          ? local
+                          : world[parent] * local;
+        if ((hierarchy.worldMatrix(node) - world[node]).abs2() >
+            smallNumber) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+TEST_SUIT_BEGIN
+
+TEST_CASE("depth first order") {
+    const auto parents = testParents(5000);
+    auto hierarchy = testHierarchy(parents);
+    hierarchy.update();
+
+    ASSERT(isCorrect(hierarchy), "wrong world matrices");
+
+    for (Node node = 0; node < hierarchy.size(); ++node) {
+        const auto parent = parents[node];
+        ASSERT_EQ(hierarchy.nodeData()[hierarchy.slot(node)], node);
+        if (parent == TransformHierarchyd::none) {
+            continue;
+        }
+
+        // Every node is inside the range of the subtree of its parent
+        const auto slot = hierarchy.slot(node);
+        const auto parentSlot = hierarchy.slot(parent);
+        ASSERT_GT(slot, parentSlot);
+        ASSERT_LT(slot + hierarchy.subtreeSize(node),
+                  parentSlot + hierarchy.subtreeSize(parent) + 1);
+    }
+}
+
+TEST_CASE("dirty subtrees") {
+    auto hierarchy = testHierarchy(testParents(5000));
+    hierarchy.update();
+    ASSERT(!hierarchy.isDirty(), "everything should be updated");
+
+    const auto before = hierarchy.world(4999);
+    hierarchy.local(1, AffineMatrixd::Translation(5, 6, 7));
+    hierarchy.local(2, AffineMatrixd::Translation(1, 2, 3));
+    hierarchy.local(1, AffineMatrixd::Scale(2));
+    ASSERT(hierarchy.isDirty(), "nodes was changed");
+
+    hierarchy.update();
+    ASSERT(isCorrect(hierarchy), "wrong world matrices after change");
+
+    // Node 4999 is in another root's subtree and should not be changed
+    ASSERT_EQ((hierarchy.world(4999).toMatrix() - before.toMatrix()).abs2(),
+              0.);
+}
+
+TEST_CASE("adding nodes after update") {
+    auto hierarchy = testHierarchy(testParents(100));
+    hierarchy.update();
+    hierarchy.add(testMatrix(3), 3);
+    hierarchy.add(testMatrix(4), 0);
+    hierarchy.update();
+    ASSERT(isCorrect(hierarchy), "wrong world matrices after adding nodes");
+    ASSERT_EQ(hierarchy.slot(0), 0);
+}
+
+TEST_CASE("multi threaded update") {
+    auto pool = matmath::ThreadPool{4};
+    auto hierarchy = testHierarchy(testParents(50000));
+    hierarchy.update(pool);
+    ASSERT(isCorrect(hierarchy), "wrong world matrices");
+
+    for (Node node = 0; node < hierarchy.size(); node += 97) {
+        hierarchy.local(node, testMatrix(node + 1));
+    }
+    hierarchy.update(pool);
+    ASSERT(isCorrect(hierarchy), "wrong world matrices after change");
+}
+
+TEST_CASE("deep hierarchy") {
+    auto pool = matmath::ThreadPool{4};
+    auto hierarchy = TransformHierarchyd{};
+    auto parent = TransformHierarchyd::none;
+    for (size_t i = 0; i < 100000; ++i) {
+        parent = hierarchy.add(AffineMatrixd::Translation(1, 0, 0), parent);
+    }
+    hierarchy.update(pool);
+    ASSERT_NEAR(hierarchy.world(parent).x4, 100000., smallNumber);
+}
+
+TEST_SUIT_END
@@ -0,0 +1,128 @@
+// Copyright © Mattias Larsson Sköld
+
+#include "matmath/vec4.h"
+#include "mls-unit-test/unittest.h"
+#include "testmatrix.h"
+#include <type_traits>
+#include <vector>
+
+constexpr double smallNumber = .00001;
+
+namespace {
+
+template <typename T>
+double distance(const Vec4T<T> &a, const Vec4T<T> &b) {
+    return (a - b).abs();
+}
+
+template <typename T>
+void testOperators() {
+    const auto a = Vec4T<T>{1, 2, 3, 4};
+    const auto b = Vec4T<T>{-2, .5, 7, 1};
+
+    ASSERT_EQ(a + b, (Vec4T<T>{-1, 2.5, 10, 5}));
+    ASSERT_EQ(a - b, (Vec4T<T>{3, 1.5, -4, 3}));
+    ASSERT_EQ(a * T(2), (Vec4T<T>{2, 4, 6, 8}));
+    ASSERT_EQ(T(2) * a, a * T(2));
+    ASSERT_EQ(a / T(2), (Vec4T<T>{.5, 1, 1.5, 2}));
+    ASSERT_EQ(-a, (Vec4T<T>{-1, -2, -3, -4}));
+    ASSERT_NEAR(a * b, -2 + 1 + 21 + 4, smallNumber);
+    ASSERT_NEAR(a.abs2(), 30, smallNumber);
+
+    auto c = a;
+    c += b;
+    c -= a;
+    ASSERT_EQ(c, b);
+    c *= 3;
+    c /= 3;
+    ASSERT_LT(distance(c, b), smallNumber);
+}
+
+template <typename T>
+void testVecCompatibility() {
+    const auto a = VecT<T>{1, -2, 3};
+    const auto b = VecT<T>{.5, 4, -1};
+    const auto a4 = Vec4T<T>{a}, b4 = Vec4T<T>{b};
+
+    ASSERT_NEAR(a4.abs(), a.abs(), smallNumber);
+    ASSERT_NEAR(a4 * b4, a * b, smallNumber);
+    ASSERT_LT((VecT<T>{a4.cross(b4)} - a.cross(b)).abs(), smallNumber);
+    ASSERT_EQ(a4.cross(b4).w, 0);
+
+    auto n = a4;
+    n.normalize();
+    auto expected = a;
+    expected.normalize();
+    ASSERT_LT((n.xyz() - expected).abs(), smallNumber);
+
+    // VecT widens to Vec4T, the other way drops w and has to be explicit
+    static_assert(std::is_convertible_v<VecT<T>, Vec4T<T>>);
+    static_assert(!std::is_convertible_v<Vec4T<T>, VecT<T>>);
+    static_assert(std::is_same_v<decltype(a4 + b), Vec4T<T>>);
+    ASSERT_LT(distance(a4 + b, Vec4T<T>{a + b}), smallNumber);
+    const auto converted = static_cast<VecT<T>>(a4 + b4);
+    ASSERT_LT((converted - (a + b)).abs(), smallNumber);
+}
+
+template <typename T>
+void testMatrixMultiplication() {
+    const auto m = testMatrix<T>();
+    const auto p = VecT<T>{1, -2, 3};
+
+    const auto point = m * Vec4T<T>{p, 1};
+    ASSERT_LT((point.xyz() - m * p).abs(), smallNumber);
+    ASSERT_NEAR(point.w, 1, smallNumber);
+
+    const auto direction = m * Vec4T<T>{p};
+    ASSERT_LT((direction.xyz() - (m * p - m * VecT<T>{})).abs(),
+              smallNumber);
+    ASSERT_NEAR(direction.w, 0, smallNumber);
+
+    auto points = std::vector<Vec4T<T>>{};
+    for (int i = 0; i < 11; ++i) {
+        points.push_back({T(i), T(1 - i), T(i * .5), 1});
+    }
+    auto out = std::vector<Vec4T<T>>(points.size());
+    transform(m, points.data(), out.data(), points.size());
+    for (size_t i = 0; i < points.size(); ++i) {
+        ASSERT_LT(distance(out[i], m * points[i]), smallNumber);
+    }
+
+    // In place
+    transform(m, points.data(), points.data(), points.size());
+    ASSERT_LT(distance(points.back(), out.back()), smallNumber);
+}
+
+} // namespace
+
+TEST_SUIT_BEGIN
+
+TEST_CASE("alignment") {
+    static_assert(sizeof(Vec4f) == 16 && alignof(Vec4f) == 16);
+    static_assert(sizeof(Vec4d) == 32 && alignof(Vec4d) == 32);
+}
+
+TEST_CASE("constexpr") {
+    constexpr auto v = Vec4d{1, 2, 3} + Vec4d{Vecd{1, 1, 1}, 1};
+    static_assert(v.x == 2 && v.y == 3 && v.z == 4 && v.w == 1);
+    constexpr auto m = Matrixd::Translation(1, 2, 3) * Vec4d{0, 0, 0, 1};
+    static_assert(m.x == 1 && m.y == 2 && m.z == 3 && m.w == 1);
+    static_assert(Vec4d{0, 3, 0, 4}.abs2() == 25);
+}
+
+TEST_CASE("operators") {
+    testOperators<float>();
+    testOperators<double>();
+}
+
+TEST_CASE("VecT compatibility") {
+    testVecCompatibility<float>();
+    testVecCompatibility<double>();
+}
+
+TEST_CASE("matrix multiplication") {
+    testMatrixMultiplication<float>();
+    testMatrixMultiplication<double>();
+}
+
+TEST_SUIT_END
@@ -0,0 +1,105 @@
+// Copyright © Mattias Larsson Sköld
+
+#include "matmath/vecsoa.h"
+#include "mls-unit-test/unittest.h"
+#include <cstdint>
+
+constexpr double smallNumber = .00001;
+
+namespace {
+
+// Odd size so that some values does not fill a whole register
+std::vector<Vecf> testVectors(int count = 21) {
+    std::vector<Vecf> ret;
+    for (int i = 0; i < count; ++i) {
+        ret.push_back({i * .5f + 1, 2.f - i, i * .25f});
+    }
+    return ret;
+}
+
+} // namespace
+
+TEST_SUIT_BEGIN
+
+TEST_CASE("conversion to and from vectors") {
+    const auto vectors = testVectors();
+    const auto soa = VecSoAf{vectors};
+
+    ASSERT_EQ(soa.size(), vectors.size());
+    for (size_t i = 0; i < vectors.size(); ++i) {
+        ASSERT_EQ(soa[i], vectors[i]);
+    }
+
+    const auto back = soa.toVector();
+    ASSERT_EQ(back.size(), vectors.size());
+    for (size_t i = 0; i < vectors.size(); ++i) {
+        ASSERT_EQ(back[i], vectors[i]);
+    }
+}
+
+TEST_CASE("aligned arrays") {
+    const auto soa = VecSoAf{testVectors()};
+
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(soa.x.data()) % 64, 0);
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(soa.y.data()) % 64, 0);
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(soa.z.data()) % 64, 0);
+}
+
+TEST_CASE("arithmetic") {
+    const auto a = testVectors();
+    auto b = testVectors();
+    for (auto &v : b) {
+        v = v.cross({1, 2, 3}) + Vecf{0, 0, 1};
+    }
+
+    const auto sa = VecSoAf{a};
+    const auto sb = VecSoAf{b};
+
+    const auto sum = sa + sb;
+    const auto difference = sa - sb;
+    const auto scaled = sa * 3.f;
+    const auto dot = sa * sb;
+    const auto cross = sa.cross(sb);
+    const auto abs = sa.abs();
+    const auto abs2 = sa.abs2();
+    auto normalized = sb;
+    normalized.normalize();
+    auto moved = sa;
+    moved.addScaled(sb, 2.f);
+
+    for (size_t i = 0; i < a.size(); ++i) {
+        ASSERT_LT((sum[i] - (a[i] + b[i])).abs(), smallNumber);
+        ASSERT_LT((difference[i] - (a[i] - b[i])).abs(), smallNumber);
+        ASSERT_LT((scaled[i] - a[i] * 3.f).abs(), smallNumber);
+        ASSERT_NEAR(dot[i], a[i] * b[i], smallNumber);
+        ASSERT_LT((cross[i] - a[i].cross(b[i])).abs(), smallNumber);
+        ASSERT_NEAR(abs[i], a[i].abs(), smallNumber);
+        ASSERT_NEAR(abs2[i], a[i].abs2(), smallNumber);
+        ASSERT_LT((normalized[i] - Vecf{b[i]}.normalize()).abs(), smallNumber);
+        ASSERT_LT((moved[i] - (a[i] + b[i] * 2.f)).abs(), smallNumber);
+    }
+}
+
+TEST_CASE("different sizes") {
+    auto a = VecSoAf{testVectors()};
+    const auto b = VecSoAf{testVectors(20)};
+
+    auto throws = [](auto f) {
+        try {
+            f();
+        }
+        catch (const char *) {
+            return true;
+        }
+        return false;
+    };
+    ASSERT(throws([&] { a += b; }), "+= should throw");
+    ASSERT(throws([&] { a -= b; }), "-= should throw");
+    ASSERT(throws([&] { a.addScaled(b, 2.f); }), "addScaled should throw");
+    ASSERT(throws([&] { a + b; }), "+ should throw");
+    ASSERT(throws([&] { a * b; }), "dot product should throw");
+    ASSERT(throws([&] { a.cross(b); }), "cross should throw");
+    ASSERT(!throws([&] { a += a; }), "same size should not throw");
+}
+
+TEST_SUIT_END